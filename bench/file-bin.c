@@ -0,0 +1,129 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2026 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#include <lib-common/file-bin.h>
+#include <lib-common/hash.h>
+#include <lib-common/thr.h>
+#include <lib-common/unix.h>
+#include <lib-common/zbenchmark.h>
+
+/* 64MB of records of 200 bytes. */
+#define BENCH_RECORDS  (320 * 1024)
+#define BENCH_REC_SIZE  200
+
+static atomic_uint_fast64_t file_bin_bench_sum_g;
+
+/* Hash the records to simulate their processing. */
+static int file_bin_bench_cb(void *priv, int chunk, lstr_t record)
+{
+    atomic_fetch_add(&file_bin_bench_sum_g,
+                     icrc32c(0, record.data, record.len));
+    return 0;
+}
+
+static void file_bin_bench_write(lstr_t path, bool v2)
+{
+    byte rec[BENCH_REC_SIZE];
+    file_bin_t *file;
+
+    if (v2) {
+        file = file_bin_create_v2(path, 0, FILE_BIN_TRUNCATE);
+    } else {
+        file = file_bin_create(path, 0, true);
+    }
+    if (!file) {
+        e_panic("cannot create %*pM", LSTR_FMT_ARG(path));
+    }
+    for (int i = 0; i < BENCH_RECORDS; i++) {
+        for (int j = 0; j < countof(rec); j++) {
+            rec[j] = i + j;
+        }
+        if (file_bin_put_record(file, rec, countof(rec)) < 0) {
+            e_panic("cannot write %*pM", LSTR_FMT_ARG(path));
+        }
+    }
+    if (file_bin_close(&file) < 0) {
+        e_panic("cannot close %*pM", LSTR_FMT_ARG(path));
+    }
+}
+
+static int file_bin_bench_read_seq(file_bin_t *file)
+{
+    file_bin_for_each_entry(file, rec) {
+        file_bin_bench_cb(NULL, 0, rec);
+    }
+    return 0;
+}
+
+ZBENCH_GROUP_EXPORT(file_bin) {
+    t_scope;
+    lstr_t path_v1 = t_lstr_fmt("/tmp/zbench-file-bin-v1-%d", getpid());
+    lstr_t path_v2 = t_lstr_fmt("/tmp/zbench-file-bin-v2-%d", getpid());
+    uint64_t sum;
+
+    file_bin_bench_write(path_v1, false);
+    file_bin_bench_write(path_v2, true);
+
+    /* Reference result. */
+    {
+        file_bin_t *file = file_bin_open(path_v1);
+
+        file_bin_bench_sum_g = 0;
+        file_bin_bench_read_seq(file);
+        sum = file_bin_bench_sum_g;
+        IGNORE(file_bin_close(&file));
+    }
+
+#define READ_BENCH(_name, _path, _read)                                      \
+    ZBENCH(_name) {                                                          \
+        ZBENCH_LOOP() {                                                      \
+            file_bin_t *file = file_bin_open(_path);                         \
+            int res = 0;                                                     \
+                                                                             \
+            file_bin_bench_sum_g = 0;                                        \
+            ZBENCH_MEASURE() {                                               \
+                res = (_read);                                               \
+            } ZBENCH_MEASURE_END                                             \
+            if (res < 0 || !file_bin_is_finished(file)                       \
+            ||  file_bin_bench_sum_g != sum)                                 \
+            {                                                                \
+                e_panic("KO");                                               \
+            }                                                                \
+            IGNORE(file_bin_close(&file));                                   \
+        } ZBENCH_LOOP_END                                                    \
+    } ZBENCH_END
+
+    READ_BENCH(sequential_v1, path_v1, file_bin_bench_read_seq(file));
+    READ_BENCH(sequential_v2, path_v2, file_bin_bench_read_seq(file));
+
+    MODULE_REQUIRE(thr);
+    READ_BENCH(read_parallel_v1, path_v1,
+               file_bin_read_parallel(file, 0, &file_bin_bench_cb, NULL));
+    READ_BENCH(read_parallel_v2, path_v2,
+               file_bin_read_parallel(file, 0, &file_bin_bench_cb, NULL));
+    READ_BENCH(replay_v1, path_v1,
+               file_bin_replay(file, &file_bin_bench_cb, NULL));
+    READ_BENCH(replay_v2, path_v2,
+               file_bin_replay(file, &file_bin_bench_cb, NULL));
+    MODULE_RELEASE(thr);
+
+#undef READ_BENCH
+
+    unlink(path_v1.s);
+    unlink(path_v2.s);
+} ZBENCH_GROUP_END
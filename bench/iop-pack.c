@@ -19,6 +19,7 @@
 #include <lib-common/iop-json.h>
 #include <lib-common/xmlr.h>
 #include <lib-common/iop-yaml.h>
+#include <lib-common/thr.h>
 #include <lib-common/zbenchmark.h>
 
 
@@ -177,6 +178,189 @@ ZBENCH_GROUP_EXPORT(iop_pack) {
             } ZBENCH_LOOP_END
         } ZBENCH_END
     }
+    /* bin, generic vs specialized codecs */
+    {
+        t_scope;
+        const iop_struct_t *st_ss;
+        const iop_struct_t *st_us;
+        tstiop__specialized_struct__t ss;
+        tstiop__unspecialized_struct__t us;
+        lstr_t out_ss;
+        lstr_t out_us;
+        bool eq = false;
+
+        st_ss = iop_env_get_struct(iop_env, LSTR("tstiop.SpecializedStruct"));
+        st_us = iop_env_get_struct(iop_env,
+                                   LSTR("tstiop.UnspecializedStruct"));
+
+        iop_init_desc(st_ss, &ss);
+        ss.a = 42;
+        ss.b = 5;
+        ss.c = 120;
+        ss.d = 230;
+        ss.e = 540;
+        ss.f = 2000;
+        ss.g = 10000;
+        ss.h = 20000;
+        ss.i = true;
+        ss.j = 3.14159265;
+        ss.k = MY_ENUM_A_B;
+        ss.l = LSTR("baré© \" foo .");
+        ss.m = LSTR("foo");
+        OPT_SET(ss.n, 12);
+        ss.s = 1234567890123;
+        memcpy(&us, &ss, sizeof(us));
+
+        out_ss = t_iop_bpack_struct(st_ss, &ss);
+        out_us = t_iop_bpack_struct(st_us, &us);
+
+        ZBENCH(bpack_generic) {
+            ZBENCH_LOOP() {
+                ZBENCH_MEASURE() {
+                    /* ast-grep-ignore */
+                    out_us = t_iop_bpack_struct(st_us, &us);
+                } ZBENCH_MEASURE_END
+
+                if (!out_us.s) {
+                    e_panic("KO");
+                }
+            } ZBENCH_LOOP_END
+        } ZBENCH_END
+
+        ZBENCH(bpack_specialized) {
+            ZBENCH_LOOP() {
+                ZBENCH_MEASURE() {
+                    /* ast-grep-ignore */
+                    out_ss = t_iop_bpack_struct(st_ss, &ss);
+                } ZBENCH_MEASURE_END
+
+                if (!out_ss.s) {
+                    e_panic("KO");
+                }
+            } ZBENCH_LOOP_END
+        } ZBENCH_END
+
+        ZBENCH(bunpack_generic) {
+            ZBENCH_LOOP() {
+                t_scope;
+                tstiop__unspecialized_struct__t us2;
+                int res = 0;
+
+                ZBENCH_MEASURE() {
+                    res = iop_bunpack(t_pool(), iop_env, st_us, &us2,
+                                      ps_initlstr(&out_us), false);
+                } ZBENCH_MEASURE_END
+
+                if (res < 0 || !iop_equals_desc(st_us, &us, &us2)) {
+                    e_panic("KO");
+                }
+            } ZBENCH_LOOP_END
+        } ZBENCH_END
+
+        ZBENCH(bunpack_specialized) {
+            ZBENCH_LOOP() {
+                t_scope;
+                tstiop__specialized_struct__t ss2;
+                int res = 0;
+
+                ZBENCH_MEASURE() {
+                    res = iop_bunpack(t_pool(), iop_env, st_ss, &ss2,
+                                      ps_initlstr(&out_ss), false);
+                } ZBENCH_MEASURE_END
+
+                if (res < 0 || !iop_equals_desc(st_ss, &ss, &ss2)) {
+                    e_panic("KO");
+                }
+            } ZBENCH_LOOP_END
+        } ZBENCH_END
+
+        ZBENCH(equals_generic) {
+            ZBENCH_LOOP() {
+                tstiop__unspecialized_struct__t us2 = us;
+
+                ZBENCH_MEASURE() {
+                    eq = iop_equals_desc(st_us, &us, &us2);
+                } ZBENCH_MEASURE_END
+
+                if (!eq) {
+                    e_panic("KO");
+                }
+            } ZBENCH_LOOP_END
+        } ZBENCH_END
+
+        ZBENCH(equals_specialized) {
+            ZBENCH_LOOP() {
+                tstiop__specialized_struct__t ss2 = ss;
+
+                ZBENCH_MEASURE() {
+                    eq = iop_equals_desc(st_ss, &ss, &ss2);
+                } ZBENCH_MEASURE_END
+
+                if (!eq) {
+                    e_panic("KO");
+                }
+            } ZBENCH_LOOP_END
+        } ZBENCH_END
+    }
+    /* json vs bin, large arrays */
+    {
+        t_scope;
+        const iop_struct_t *st_i;
+        tstiop__my_struct_i__t si;
+        int32_t *i32 = t_new_raw(int32_t, 10000);
+        int64_t *i64 = t_new_raw(int64_t, 10000);
+        double *dbl = t_new_raw(double, 10000);
+        lstr_t bpacked;
+        SB_1k(jpacked);
+
+        st_i = iop_env_get_struct(iop_env, LSTR("tstiop.MyStructI"));
+        for (int i = 0; i < 10000; i++) {
+            i32[i] = i * 7 - 5000;
+            i64[i] = (int64_t)i * 1000003;
+            dbl[i] = i * 0.25;
+        }
+        iop_init_desc(st_i, &si);
+        si.i = IOP_TYPED_ARRAY(i32, i32, 10000);
+        si.l = IOP_TYPED_ARRAY(i64, i64, 10000);
+        si.d = IOP_TYPED_ARRAY(double, dbl, 10000);
+        bpacked = t_iop_bpack_struct(st_i, &si);
+        iop_sb_jpack(&jpacked, st_i, &si, IOP_JPACK_MINIMAL);
+
+        ZBENCH(junpack_arrays) {
+            ZBENCH_LOOP() {
+                t_scope;
+                pstream_t ps = ps_initsb(&jpacked);
+                void *si2 = NULL;
+                int res = 0;
+
+                ZBENCH_MEASURE() {
+                    res = t_iop_junpack_ptr_ps(iop_env, &ps, st_i, &si2, 0,
+                                               NULL);
+                } ZBENCH_MEASURE_END
+
+                if (res < 0 || !iop_equals_desc(st_i, &si, si2)) {
+                    e_panic("KO");
+                }
+            } ZBENCH_LOOP_END
+        } ZBENCH_END
+
+        ZBENCH(bunpack_arrays) {
+            ZBENCH_LOOP() {
+                t_scope;
+                tstiop__my_struct_i__t si2;
+                int res = 0;
+
+                ZBENCH_MEASURE() {
+                    res = iop_bunpack(t_pool(), iop_env, st_i, &si2,
+                                      ps_initlstr(&bpacked), false);
+                } ZBENCH_MEASURE_END
+
+                if (res < 0 || !iop_equals_desc(st_i, &si, &si2)) {
+                    e_panic("KO");
+                }
+            } ZBENCH_LOOP_END
+        } ZBENCH_END
+    }
 #if 0
     /* {{{ XML */
 
@@ -251,6 +435,102 @@ ZBENCH_GROUP_EXPORT(iop_pack) {
         } ZBENCH_END
     }
 
+    /* compiled filters on large vectors */
+    {
+        enum { N = 10 * 1000 * 1000 };
+        const iop_struct_t *st_rs;
+        tstiop__my_referenced_struct__t *objs;
+        int values[256];
+        void *ptrs[countof(values)];
+        byte *bitmap;
+
+        st_rs = iop_env_get_struct(iop_env,
+                                   LSTR("tstiop.MyReferencedStruct"));
+        objs = p_new_raw(tstiop__my_referenced_struct__t, N);
+        for (int i = 0; i < N; i++) {
+            objs[i].a = ((uint32_t)i * 2654435761U) >> 20;
+        }
+        for (int i = 0; i < countof(values); i++) {
+            values[i] = i * 16;
+            ptrs[i] = &values[i];
+        }
+        bitmap = p_new(byte, BITS_TO_ARRAY_LEN(byte, N));
+
+#define FILTER_BENCH(_name, _values_len)                                     \
+        ZBENCH(_name) {                                                      \
+            ZBENCH_LOOP() {                                                  \
+                iop_filter_prog_t *prog;                                     \
+                                                                             \
+                prog = mp_iop_filter_prog_compile(NULL, iop_env, st_rs,      \
+                                                  LSTR("a"), ptrs,           \
+                                                  (_values_len), 0, NULL);   \
+                ZBENCH_MEASURE() {                                           \
+                    iop_filter_prog_run(prog, objs, N, BITMAP_OP_OR,         \
+                                        bitmap);                             \
+                } ZBENCH_MEASURE_END                                         \
+                mp_iop_filter_prog_delete(NULL, &prog);                      \
+            } ZBENCH_LOOP_END                                                \
+        } ZBENCH_END
+
+        FILTER_BENCH(filter_prog_1, 1);
+        FILTER_BENCH(filter_prog_16, 16);
+        FILTER_BENCH(filter_prog_256, 256);
+
+        MODULE_REQUIRE(thr);
+        FILTER_BENCH(filter_prog_1_thr, 1);
+        FILTER_BENCH(filter_prog_16_thr, 16);
+        FILTER_BENCH(filter_prog_256_thr, 256);
+        MODULE_RELEASE(thr);
+
+#undef FILTER_BENCH
+
+        p_delete(&bitmap);
+        p_delete(&objs);
+    }
+
+    /* sorting large vectors */
+    {
+        enum { N = 1000 * 1000 };
+        const iop_struct_t *st_rs;
+        tstiop__my_referenced_struct__t *objs;
+        tstiop__my_referenced_struct__t *vec;
+
+        st_rs = iop_env_get_struct(iop_env,
+                                   LSTR("tstiop.MyReferencedStruct"));
+        objs = p_new_raw(tstiop__my_referenced_struct__t, N);
+        vec = p_new_raw(tstiop__my_referenced_struct__t, N);
+        for (int i = 0; i < N; i++) {
+            objs[i].a = (int)((uint32_t)i * 2654435761U);
+        }
+
+#define SORT_BENCH(_name)                                                    \
+        ZBENCH(_name) {                                                      \
+            ZBENCH_LOOP() {                                                  \
+                int res = 0;                                                 \
+                                                                             \
+                p_copy(vec, objs, N);                                        \
+                ZBENCH_MEASURE() {                                           \
+                    res = iop_sort_desc(iop_env, st_rs, vec, N, LSTR("a"),   \
+                                        0, NULL);                            \
+                } ZBENCH_MEASURE_END                                         \
+                if (res < 0) {                                               \
+                    e_panic("KO");                                           \
+                }                                                            \
+            } ZBENCH_LOOP_END                                                \
+        } ZBENCH_END
+
+        SORT_BENCH(sort_int);
+
+        MODULE_REQUIRE(thr);
+        SORT_BENCH(sort_int_thr);
+        MODULE_RELEASE(thr);
+
+#undef SORT_BENCH
+
+        p_delete(&vec);
+        p_delete(&objs);
+    }
+
     iop_dso_close(&dso);
     iop_env_delete(&iop_env);
 } ZBENCH_GROUP_END
@@ -16,6 +16,8 @@
 /*                                                                         */
 /***************************************************************************/
 
+#include <math.h>
+
 #include <lib-common/unix.h>
 #include <lib-common/datetime.h>
 #include <lib-common/zbenchmark.h>
@@ -37,16 +39,80 @@ typedef struct mcms_event_t {
     unsigned payload_allocated;
 } mcms_event_t;
 
+#define EVENT_FMT  "%d|%c|%lld|%d|%d|%u|%d|\n"
+
+/* snprintf is a macro for isnprintf: the literal format is compiled on its
+ * first use.
+ */
 static long snprintf_event(const mcms_event_t *event)
 {
     char buf[BUFSIZ];
 
-    return snprintf(buf, sizeof(buf),
-                    "%d|%c|%lld|%d|%d|%u|%d|\n",
+    return snprintf(buf, sizeof(buf), EVENT_FMT,
+                    event->stamp, event->type,
+                    (long long)event->msisdn,
+                    event->camp_lineno, event->camp_id,
+                    event->remote_id, event->payload_len);
+}
+
+/* The format is not in a read-only segment: it is parsed on each call. */
+static long snprintf_event_uncached(const mcms_event_t *event,
+                                    const char *fmt)
+{
+    char buf[BUFSIZ];
+
+    CC_WARNING_IGNORE_PUSH
+    CC_WARNING_IGNORE_FORMAT_NONLITERAL
+    return snprintf(buf, sizeof(buf), fmt,
                     event->stamp, event->type,
                     (long long)event->msisdn,
                     event->camp_lineno, event->camp_id,
                     event->remote_id, event->payload_len);
+    CC_WARNING_IGNORE_POP
+}
+
+static long libc_snprintf_event(const mcms_event_t *event)
+{
+    char buf[BUFSIZ];
+
+    return (snprintf)(buf, sizeof(buf), EVENT_FMT,
+                      event->stamp, event->type,
+                      (long long)event->msisdn,
+                      event->camp_lineno, event->camp_id,
+                      event->remote_id, event->payload_len);
+}
+
+static void bench_event_init(mcms_event_t *event, int i)
+{
+    event->stamp = 1178096605;
+    event->type = "ABDG"[i & 3];
+    event->msisdn = 33612345678LL + i + (i ^ 4321);
+    event->camp_lineno = i & 16383;
+    event->camp_id = i >> 14;
+    event->remote_id = 1;
+    event->payload_len = 0;
+}
+
+/* Random integers of all the magnitudes. */
+static void bench_ints_init(int64_t *ints, int len)
+{
+    for (int i = 0; i < len; i++) {
+        ints[i] = (int64_t)rand64() >> (i % 64);
+    }
+}
+
+/* Random doubles: both random bit patterns and "human" values with few
+ * decimals. */
+static void bench_doubles_init(double *doubles, int len)
+{
+    for (int i = 0; i < len; i++) {
+        union { double d; uint64_t u; } v = { .u = rand64() };
+
+        if (i % 2 || !isfinite(v.d)) {
+            v.d = rand_range(-100000000, 100000000) / 100.;
+        }
+        doubles[i] = v.d;
+    }
 }
 
 ZBENCH_GROUP_EXPORT(iprintf_bench) {
@@ -56,14 +122,7 @@ ZBENCH_GROUP_EXPORT(iprintf_bench) {
 
         p_clear(event, 1);
         ZBENCH_LOOP() {
-            event->stamp = 1178096605;
-            event->type = "ABDG"[i & 3];
-            event->msisdn = 33612345678LL + i + (i ^ 4321);
-            event->camp_lineno = i & 16383;
-            event->camp_id = i >> 14;
-            event->remote_id = 1;
-            event->payload_len = 0;
-            i++;
+            bench_event_init(event, i++);
 
             ZBENCH_MEASURE() {
                 for (int j = 0; j < 1000; j++) {
@@ -72,4 +131,143 @@ ZBENCH_GROUP_EXPORT(iprintf_bench) {
             } ZBENCH_MEASURE_END
         } ZBENCH_LOOP_END
     } ZBENCH_END
+
+    ZBENCH(snprintf_uncached) {
+        int i = 0;
+        mcms_event_t ev, *event = &ev;
+        char fmt[] = EVENT_FMT;
+
+        p_clear(event, 1);
+        ZBENCH_LOOP() {
+            bench_event_init(event, i++);
+
+            ZBENCH_MEASURE() {
+                for (int j = 0; j < 1000; j++) {
+                    snprintf_event_uncached(event, fmt);
+                }
+            } ZBENCH_MEASURE_END
+        } ZBENCH_LOOP_END
+    } ZBENCH_END
+
+    ZBENCH(libc_snprintf) {
+        int i = 0;
+        mcms_event_t ev, *event = &ev;
+
+        p_clear(event, 1);
+        ZBENCH_LOOP() {
+            bench_event_init(event, i++);
+
+            ZBENCH_MEASURE() {
+                for (int j = 0; j < 1000; j++) {
+                    libc_snprintf_event(event);
+                }
+            } ZBENCH_MEASURE_END
+        } ZBENCH_LOOP_END
+    } ZBENCH_END
+
+    /* {{{ integers */
+
+    ZBENCH(ints_snprintf) {
+        int64_t ints[1000];
+
+        bench_ints_init(ints, countof(ints));
+        ZBENCH_LOOP() {
+            char buf[64];
+
+            ZBENCH_MEASURE() {
+                for (int j = 0; j < countof(ints); j++) {
+                    snprintf(buf, sizeof(buf), "%"PRIi64" %d", ints[j],
+                             (int)ints[j]);
+                }
+            } ZBENCH_MEASURE_END
+        } ZBENCH_LOOP_END
+    } ZBENCH_END
+
+    ZBENCH(ints_libc_snprintf) {
+        int64_t ints[1000];
+
+        bench_ints_init(ints, countof(ints));
+        ZBENCH_LOOP() {
+            char buf[64];
+
+            ZBENCH_MEASURE() {
+                for (int j = 0; j < countof(ints); j++) {
+                    (snprintf)(buf, sizeof(buf), "%"PRIi64" %d", ints[j],
+                               (int)ints[j]);
+                }
+            } ZBENCH_MEASURE_END
+        } ZBENCH_LOOP_END
+    } ZBENCH_END
+
+    /* }}} */
+
+    /* {{{ doubles */
+
+    ZBENCH(dtoa_sprintf) {
+        double doubles[1000];
+
+        bench_doubles_init(doubles, countof(doubles));
+        ZBENCH_LOOP() {
+            char buf[64];
+
+            ZBENCH_MEASURE() {
+                for (int j = 0; j < countof(doubles); j++) {
+                    sprintf(buf, "%.17g", doubles[j]);
+                }
+            } ZBENCH_MEASURE_END
+        } ZBENCH_LOOP_END
+    } ZBENCH_END
+
+    ZBENCH(dtoa_shortest) {
+        double doubles[1000];
+
+        bench_doubles_init(doubles, countof(doubles));
+        ZBENCH_LOOP() {
+            char buf[DTOA_SHORTEST_BUFSIZ];
+
+            ZBENCH_MEASURE() {
+                for (int j = 0; j < countof(doubles); j++) {
+                    dtoa_shortest(buf, doubles[j]);
+                }
+            } ZBENCH_MEASURE_END
+        } ZBENCH_LOOP_END
+    } ZBENCH_END
+
+    ZBENCH(strtod) {
+        double doubles[1000];
+
+        bench_doubles_init(doubles, countof(doubles));
+        ZBENCH_LOOP() {
+            char bufs[countof(doubles)][DTOA_SHORTEST_BUFSIZ];
+
+            for (int j = 0; j < countof(doubles); j++) {
+                dtoa_shortest(bufs[j], doubles[j]);
+            }
+            ZBENCH_MEASURE() {
+                for (int j = 0; j < countof(doubles); j++) {
+                    strtod(bufs[j], NULL);
+                }
+            } ZBENCH_MEASURE_END
+        } ZBENCH_LOOP_END
+    } ZBENCH_END
+
+    ZBENCH(memtod) {
+        double doubles[1000];
+
+        bench_doubles_init(doubles, countof(doubles));
+        ZBENCH_LOOP() {
+            char bufs[countof(doubles)][DTOA_SHORTEST_BUFSIZ];
+
+            for (int j = 0; j < countof(doubles); j++) {
+                dtoa_shortest(bufs[j], doubles[j]);
+            }
+            ZBENCH_MEASURE() {
+                for (int j = 0; j < countof(doubles); j++) {
+                    memtod(bufs[j], -1, NULL);
+                }
+            } ZBENCH_MEASURE_END
+        } ZBENCH_LOOP_END
+    } ZBENCH_END
+
+    /* }}} */
 } ZBENCH_GROUP_END
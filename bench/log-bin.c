@@ -0,0 +1,86 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2026 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#include <lib-common/file-log.h>
+#include <lib-common/log-bin.h>
+#include <lib-common/unix.h>
+#include <lib-common/zbenchmark.h>
+
+#define BENCH_LOGS  10000
+
+static logger_t log_bin_bench_logger_g =
+    LOGGER_INIT_INHERITS(NULL, "log-bin-bench");
+
+static void log_bin_bench_log(void)
+{
+    lstr_t str = LSTR("some string");
+
+    for (int i = 0; i < BENCH_LOGS; i++) {
+        logger_notice(&log_bin_bench_logger_g,
+                      "request %d from %s: %pL, %zu bytes in %.3f ms",
+                      i, "127.0.0.1", &str, (size_t)i * 16, i / 1000.);
+    }
+}
+
+ZBENCH_GROUP_EXPORT(log_bin) {
+    t_scope;
+    lstr_t dir = t_lstr_fmt("/tmp/zbench-log-bin-%d", getpid());
+
+    if (mkdir_p(dir.s, 0755) < 0) {
+        e_panic("cannot create %*pM", LSTR_FMT_ARG(dir));
+    }
+
+    /* Reference: the text handler, writing to stderr. */
+    ZBENCH(text) {
+        const char *path = t_fmt("%*pM/text.log", LSTR_FMT_ARG(dir));
+        int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        int stderr_fd = dup(STDERR_FILENO);
+
+        if (fd < 0 || stderr_fd < 0 || dup2(fd, STDERR_FILENO) < 0) {
+            e_panic("cannot redirect stderr to %s", path);
+        }
+        ZBENCH_LOOP() {
+            ZBENCH_MEASURE() {
+                log_bin_bench_log();
+            } ZBENCH_MEASURE_END
+        } ZBENCH_LOOP_END
+        dup2(stderr_fd, STDERR_FILENO);
+        p_close(&stderr_fd);
+        p_close(&fd);
+    } ZBENCH_END
+
+    ZBENCH(binary) {
+        log_file_t *file;
+
+        file = log_file_new(t_fmt("%*pM/bin", LSTR_FMT_ARG(dir)), 0);
+        if (log_file_open(file, true) < 0) {
+            e_panic("cannot open the binary log file in %*pM",
+                    LSTR_FMT_ARG(dir));
+        }
+        log_bin_start(file);
+        ZBENCH_LOOP() {
+            ZBENCH_MEASURE() {
+                log_bin_bench_log();
+            } ZBENCH_MEASURE_END
+        } ZBENCH_LOOP_END
+        log_bin_stop();
+        IGNORE(log_file_close(&file));
+    } ZBENCH_END
+
+    rmdir_r(dir.s, false);
+} ZBENCH_GROUP_END
@@ -311,6 +311,109 @@ size_t count_non_zero128(const void *_data, size_t n)
     return n - (acc0 + acc1 + acc2 + acc3);
 }
 
+/* Returns the mask of the positions i of the 16 first bytes of p for which
+ * p[i..] starts with "\r\n" (or with "\r\n\r\n" if twice is true).
+ *
+ * It reads up to 16 + 3 bytes at p.
+ */
+static ALWAYS_INLINE int crlf_mask16(const char *p, bool twice)
+{
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+    int m;
+
+#define LOAD(offs)  _mm_loadu_si128((const __m128i *)(p + (offs)))
+    m = _mm_movemask_epi8(_mm_cmpeq_epi8(LOAD(0), cr));
+    if (likely(!m)) {
+        return 0;
+    }
+    m &= _mm_movemask_epi8(_mm_cmpeq_epi8(LOAD(1), lf));
+    if (twice && m) {
+        m &= _mm_movemask_epi8(_mm_cmpeq_epi8(LOAD(2), cr));
+        m &= _mm_movemask_epi8(_mm_cmpeq_epi8(LOAD(3), lf));
+    }
+#undef LOAD
+    return m;
+}
+
+static ALWAYS_INLINE const char *
+scan_crlf_(const char *p, size_t len, bool twice)
+{
+    size_t plen = twice ? 4 : 2;
+    size_t pos = 0;
+
+    /* The pattern can start in the block and end in the next one, so we
+     * need plen - 1 more bytes than the block to be readable. */
+    for (; pos + 16 + plen - 1 <= len; pos += 16) {
+        int m = crlf_mask16(p + pos, twice);
+
+        if (m) {
+            return p + pos + __builtin_ctz(m);
+        }
+    }
+    return memmem(p + pos, len - pos, twice ? "\r\n\r\n" : "\r\n", plen);
+}
+
+const char *scan_crlf(const char *p, size_t len)
+{
+    return scan_crlf_(p, len, false);
+}
+
+const char *scan_crlfcrlf(const char *p, size_t len)
+{
+    return scan_crlf_(p, len, true);
+}
+
+/* Returns the mask of the bytes of x that cannot appear in an HTTP token:
+ * the controls, the space, DEL and the separators ()<>@,;:\/[]?={}.
+ *
+ * The ranges are tested with an unsigned comparison of x - lo to hi - lo.
+ */
+static ALWAYS_INLINE int http_non_token_mask16(__m128i x)
+{
+#define IN_RANGE(lo, hi)  \
+    ({  __m128i d = _mm_sub_epi8(x, _mm_set1_epi8(lo));                      \
+        _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8((hi) - (lo))), d);      \
+    })
+#define IS(c)  _mm_cmpeq_epi8(x, _mm_set1_epi8(c))
+    __m128i m;
+
+    m = _mm_or_si128(IN_RANGE(0x00, ' '), IN_RANGE('(', ')'));
+    m = _mm_or_si128(m, _mm_or_si128(IS(','), IS('/')));
+    m = _mm_or_si128(m, _mm_or_si128(IN_RANGE(':', '@'),
+                                     IN_RANGE('[', ']')));
+    m = _mm_or_si128(m, _mm_or_si128(IS('{'), IS('}')));
+    m = _mm_or_si128(m, IS(0x7f));
+#undef IS
+#undef IN_RANGE
+    return _mm_movemask_epi8(m);
+}
+
+size_t scan_http_token(const char *p, size_t len)
+{
+    size_t pos = 0;
+    char tail[16];
+    int m;
+
+    for (; pos + 16 <= len; pos += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(p + pos));
+
+        m = http_non_token_mask16(x);
+        if (m) {
+            return pos + __builtin_ctz(m);
+        }
+    }
+    if (pos == len) {
+        return len;
+    }
+
+    /* Pad the tail with spaces, so that the mask is never empty. */
+    memset(tail, ' ', sizeof(tail));
+    memcpy(tail, p + pos, len - pos);
+    m = http_non_token_mask16(_mm_loadu_si128((const __m128i *)tail));
+    return pos + __builtin_ctz(m);
+}
+
 /* }}} */
 /* Tests {{{ */
 
@@ -325,6 +428,71 @@ size_t count_non_zero128(const void *_data, size_t n)
 #define IS_ZERO64(Val)      (Val == 0)
 
 
+static int test_scan_crlf(void)
+{
+    for (int n = 0; n < 80; n++) {
+        t_scope;
+        char *buf = t_new(char, n);
+
+        memset(buf, 'a', n);
+        Z_ASSERT_NULL(scan_crlf(buf, n));
+        Z_ASSERT_NULL(scan_crlfcrlf(buf, n));
+
+        for (int i = 0; i + 4 <= n; i++) {
+            memset(buf, 'a', n);
+
+            /* Lone CR and LF, and CRLF not followed by another one must not
+             * match. */
+            buf[i] = '\r';
+            Z_ASSERT_NULL(scan_crlf(buf, n), "n=%d, i=%d", n, i);
+            buf[i + 1] = '\r';
+            buf[i + 2] = '\n';
+            buf[i + 3] = '\n';
+            Z_ASSERT(scan_crlf(buf, n) == buf + i + 1, "n=%d, i=%d", n, i);
+            Z_ASSERT_NULL(scan_crlfcrlf(buf, n), "n=%d, i=%d", n, i);
+
+            memcpy(buf + i, "\r\n\r\n", 4);
+            Z_ASSERT(scan_crlf(buf, n) == buf + i, "n=%d, i=%d", n, i);
+            Z_ASSERT(scan_crlfcrlf(buf, n) == buf + i, "n=%d, i=%d", n, i);
+
+            /* The pattern must not be found outside of the buffer */
+            Z_ASSERT_NULL(scan_crlfcrlf(buf, i + 3), "n=%d, i=%d", n, i);
+        }
+    }
+    Z_HELPER_END;
+}
+
+static bool http_is_token_naive(uint8_t c)
+{
+    return c > ' ' && c != 0x7f && !strchr("()<>@,;:\\/[]?={}", c);
+}
+
+static int test_scan_http_token(void)
+{
+    char buf[64];
+
+    for (int c = 0; c < 256; c++) {
+        bool is_token = http_is_token_naive(c);
+
+        for (int n = 1; n < countof(buf); n++) {
+            for (int i = 0; i < n; i += 7) {
+                memset(buf, 'a', n);
+                buf[i] = c;
+                Z_ASSERT_EQ(scan_http_token(buf, n), is_token ? n : i,
+                            "c=%d, n=%d, i=%d", c, n, i);
+            }
+        }
+    }
+
+    /* The scan must stop at the end of the buffer */
+    memcpy(buf, "Content-Length: 12", 18);
+    Z_ASSERT_EQ(scan_http_token(buf, 18), 14u);
+    Z_ASSERT_EQ(scan_http_token(buf, 7), 7u);
+    Z_ASSERT_ZERO(scan_http_token(buf, 0));
+
+    Z_HELPER_END;
+}
+
 static int test_scan_non_zero16(void)
 {
     for (int n = 1; n < 140; n++) {
@@ -451,6 +619,14 @@ Z_GROUP_EXPORT(arith_sse)
     Z_TEST(scan_non_zero32) {
         Z_HELPER_RUN(test_scan_non_zero32());
     } Z_TEST_END;
+
+    Z_TEST(scan_crlf) {
+        Z_HELPER_RUN(test_scan_crlf());
+    } Z_TEST_END;
+
+    Z_TEST(scan_http_token) {
+        Z_HELPER_RUN(test_scan_http_token());
+    } Z_TEST_END;
 #undef GET
 #undef DO_TEST
 } Z_GROUP_END
@@ -37,4 +37,29 @@ size_t count_non_zero32(const uint32_t u32[], size_t len);
 extern size_t (* nonnull count_non_zero64)(const uint64_t u64[], size_t len);
 size_t count_non_zero128(const void * nonnull u128, size_t len);
 
+/** Find the first "\r\n" in the \p len first bytes of \p p.
+ *
+ * Contrary to the other scans, \p p does not need to be aligned.
+ *
+ * \return a pointer to the "\r\n", or NULL if it was not found.
+ */
+const char * nullable scan_crlf(const char * nonnull p, size_t len);
+
+/** Find the first "\r\n\r\n" in the \p len first bytes of \p p.
+ *
+ * This is typically used to find the end of the headers of HTTP messages.
+ *
+ * \see scan_crlf
+ */
+const char * nullable scan_crlfcrlf(const char * nonnull p, size_t len);
+
+/** Return the length of the HTTP token at the start of \p p.
+ *
+ * The token stops at the first control character, space, DEL or separator
+ * among ()<>@,;:\/[]?={}, typically the colon ending a header name.
+ *
+ * \see scan_crlf
+ */
+size_t scan_http_token(const char * nonnull p, size_t len);
+
 #endif
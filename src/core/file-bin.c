@@ -17,8 +17,11 @@
 /***************************************************************************/
 
 #include <lib-common/arith.h>
+#include <lib-common/datetime.h>
+#include <lib-common/hash.h>
 #include <lib-common/log.h>
 #include <lib-common/file-bin.h>
+#include <lib-common/thr.h>
 #include <lib-common/unix.h>
 
 /* File header */
@@ -26,7 +29,7 @@
 
 /* Should always be 16 characters long */
 #define SIG_0100  "IS_binary/v01.0\0"
-#define SIG       SIG_0100
+#define SIG_0200  "IS_binary/v02.0\0"
 
 typedef struct file_bin_header_t {
     char   version[16];
@@ -40,12 +43,34 @@ typedef struct file_bin_header_t {
 /* Slot header */
 typedef le32_t slot_hdr_t;
 
-#define SLOT_HDR_SIZE(file)  \
-    ((file)->version == 0 ? 0 : ssizeof(slot_hdr_t))
+/* In version 2, the slot header is followed by the number of the record
+ * pointed by the slot header, by the date (in milliseconds) at which the
+ * slot header was written, and by the CRC32C of all that:
+ *     next record (le32) | record number (le64) | date (le64) | crc (le32)
+ */
+#define SLOT_HDR_V2_SIZE  (4 + 8 + 8 + 4)
 
-/* Record header */
+#define SLOT_HDR_SIZE(file)                                                  \
+    ((file)->version == 0 ? 0 :                                              \
+     (file)->version == 1 ? ssizeof(slot_hdr_t) : SLOT_HDR_V2_SIZE)
+
+typedef struct slot_hdr_v2_t {
+    uint32_t next_rec;
+    uint64_t rec_no;
+    uint64_t msec;
+
+    /* Offset of the record pointed by the slot header. */
+    off_t rec_off;
+} slot_hdr_v2_t;
+
+/* Record header; in version 2, the length is followed by the CRC32C of the
+ * length and of the data. */
 typedef le32_t rc_hdr_t;
-#define RC_HDR_SIZE  ssizeof(rc_hdr_t)
+#define RC_HDR_SIZE(file)  \
+    ((file)->version >= 2 ? 2 * ssizeof(rc_hdr_t) : ssizeof(rc_hdr_t))
+
+/* The mmap writers extend their file by chunks of this size. */
+#define MMAP_CHUNK_SIZE  (8 << 20)
 
 static struct {
     logger_t logger;
@@ -126,7 +151,7 @@ static off_t file_bin_get_next_entry_off(const file_bin_t *f, uint32_t d_len)
     }
     /* else it means res is exactly at the end of a slot so remaining is 0 */
 
-    if (remaining < RC_HDR_SIZE) {
+    if (remaining < RC_HDR_SIZE(f)) {
         /* if there is not enough space in the slot to put the record header,
          * go to the beginning of the next slot
          */
@@ -135,6 +160,15 @@ static off_t file_bin_get_next_entry_off(const file_bin_t *f, uint32_t d_len)
     return res;
 }
 
+static uint32_t file_bin_rec_crc(uint32_t len, const void *data)
+{
+    le32_t len_le32 = cpu_to_le32(len);
+    uint32_t crc = icrc32c(0, &len_le32, sizeof(len_le32));
+
+    /* data can be NULL for the empty records. */
+    return len ? icrc32c(crc, data, len) : crc;
+}
+
 /* }}} */
 /* {{{ Reading */
 
@@ -153,6 +187,10 @@ static int file_bin_parse_header(lstr_t path, void *data, size_t len,
     if (strequal(header->version, SIG_0100)) {
         *version = 1;
         *slot_size = le_to_cpu32p(&header->slot_size);
+    } else
+    if (strequal(header->version, SIG_0200)) {
+        *version = 2;
+        *slot_size = le_to_cpu32p(&header->slot_size);
     } else {
         /* Unknown header. File is probably in version 0 */
         *version = 0;
@@ -256,11 +294,76 @@ static int _file_bin_skip(file_bin_t *file, off_t toskip)
     return 0;
 }
 
-static int _file_bin_get_next_record(file_bin_t *file, lstr_t *rec)
+/* Parse the version 2 header of the slot number slot_no. */
+static int file_bin_get_slot_hdr_v2(const file_bin_t *file, off_t slot_no,
+                                    slot_hdr_v2_t *hdr)
+{
+    off_t pos = slot_no == 0 ? HEADER_SIZE(file) : slot_no * file->slot_size;
+    const byte *p = file->map + pos;
+
+    assert (file->version >= 2);
+    THROW_ERR_IF(pos + SLOT_HDR_V2_SIZE > file->length);
+    THROW_ERR_IF(icrc32c(0, p, SLOT_HDR_V2_SIZE - 4)
+                 != get_unaligned_le32(p + SLOT_HDR_V2_SIZE - 4));
+
+    hdr->next_rec = get_unaligned_le32(p);
+    hdr->rec_no   = get_unaligned_le64(p + 4);
+    hdr->msec     = get_unaligned_le64(p + 12);
+    hdr->rec_off  = pos + SLOT_HDR_V2_SIZE + hdr->next_rec;
+    return 0;
+}
+
+/* Read the slot header at the current position, and get the offset of the
+ * next record from the end of the slot header. */
+static int file_bin_read_slot_hdr(file_bin_t *file, uint32_t *next_rec)
+{
+    slot_hdr_v2_t hdr;
+
+    if (file->version < 2) {
+        return file_bin_get_cpu32(file, next_rec);
+    }
+
+    if (file_bin_get_slot_hdr_v2(file, file->cur / file->slot_size,
+                                 &hdr) < 0)
+    {
+        if (file_bin_has(file, SLOT_HDR_V2_SIZE)) {
+            logger_error(&_G.logger, "corrupted slot header in file '%*pM' "
+                         "at pos %jd", LSTR_FMT_ARG(file->path),
+                         (intmax_t)file->cur);
+        }
+        return -1;
+    }
+    *next_rec = hdr.next_rec;
+    file->cur += SLOT_HDR_V2_SIZE;
+    return 0;
+}
+
+/* In version 2, the zeroed headers were not written yet: the mmap writers
+ * extend the files with zeros before writing in them, and a valid header
+ * cannot be zeroed because of its CRC. */
+static bool file_bin_is_unwritten(const file_bin_t *file, int hdr_size)
+{
+    if (file->version < 2 || !file_bin_has(file, hdr_size)) {
+        return false;
+    }
+    for (int i = 0; i < hdr_size; i++) {
+        if (file->map[file->cur + i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Read the record at the current position; rec_off is set to the offset of
+ * the record header. */
+static int _file_bin_get_next_record(file_bin_t *file, lstr_t *rec,
+                                     off_t *rec_off)
 {
     off_t prev_off = file->cur;
     off_t rec_end_off;
     uint32_t sz;
+    uint32_t rec_len;
+    uint32_t rec_crc = 0;
     uint32_t check_slot_hdr;
     bool is_spanning = false;
 
@@ -275,7 +378,7 @@ static int _file_bin_get_next_record(file_bin_t *file, lstr_t *rec)
     sb_reset(&file->record_buf);
 
     sz = file_bin_remaining_space_in_slot(file);
-    if (sz < RC_HDR_SIZE) {
+    if (sz < RC_HDR_SIZE(file)) {
         if (_file_bin_skip(file, sz) < 0) {
             return -1;
         }
@@ -283,7 +386,11 @@ static int _file_bin_get_next_record(file_bin_t *file, lstr_t *rec)
 
     if (file->version > 0) {
         while (is_at_slot_start(file)) {
-            if (file_bin_get_cpu32(file, &sz) < 0
+            if (file_bin_is_unwritten(file, SLOT_HDR_SIZE(file))) {
+                file->cur = prev_off;
+                return -1;
+            }
+            if (file_bin_read_slot_hdr(file, &sz) < 0
             ||  _file_bin_skip(file, sz) < 0)
             {
                 goto error;
@@ -294,9 +401,18 @@ static int _file_bin_get_next_record(file_bin_t *file, lstr_t *rec)
     if (file_bin_is_finished(file)) {
         return -1;
     }
+    if (file_bin_is_unwritten(file, RC_HDR_SIZE(file))) {
+        file->cur = prev_off;
+        return -1;
+    }
+    *rec_off = file->cur;
     if (file_bin_get_cpu32(file, &sz) < 0) {
         goto error;
     }
+    if (file->version >= 2 && file_bin_get_cpu32(file, &rec_crc) < 0) {
+        goto error;
+    }
+    rec_len = sz;
 
     rec_end_off = file_bin_get_entry_end_off(file, sz);
     if (rec_end_off > file->length) {
@@ -315,7 +431,8 @@ static int _file_bin_get_next_record(file_bin_t *file, lstr_t *rec)
          * are in the first case.
          */
         if (_file_bin_skip(file, file_bin_remaining_space_in_slot(file)) < 0
-        ||  file_bin_get_cpu32(file, &tmp_size) < 0
+        ||  file_bin_is_unwritten(file, SLOT_HDR_SIZE(file))
+        ||  file_bin_read_slot_hdr(file, &tmp_size) < 0
         ||  rec_end_off == file->cur + tmp_size)
         {
             file->cur = prev_off;
@@ -323,7 +440,7 @@ static int _file_bin_get_next_record(file_bin_t *file, lstr_t *rec)
         }
         logger_error(&_G.logger, "corrupted record length in file '%*pM' at "
                      "pos %jd", LSTR_FMT_ARG(file->path), prev_off);
-        file->cur -= sizeof(slot_hdr_t);
+        file->cur -= SLOT_HDR_SIZE(file);
         *rec = LSTR_NULL_V;
         return 0;
     }
@@ -339,6 +456,9 @@ static int _file_bin_get_next_record(file_bin_t *file, lstr_t *rec)
             /* In V0, the end of the slots are filled with 0s. Go to error so
              * that we jump to next slot. */
             goto error;
+        } else
+        if (file->version >= 2 && rec_crc != file_bin_rec_crc(0, NULL)) {
+            goto corrupted;
         } else {
             *rec = LSTR_EMPTY_V;
             return 0;
@@ -365,6 +485,11 @@ static int _file_bin_get_next_record(file_bin_t *file, lstr_t *rec)
                 sb_add_lstr(&file->record_buf, res);
                 *rec = LSTR_SB_V(&file->record_buf);
             }
+            if (file->version >= 2
+            &&  rec_crc != file_bin_rec_crc(rec_len, rec->data))
+            {
+                goto corrupted;
+            }
             return 0;
         }
 
@@ -389,7 +514,7 @@ static int _file_bin_get_next_record(file_bin_t *file, lstr_t *rec)
         }
 
         /* Consuming slot header */
-        if (file_bin_get_cpu32(file, &tmp_size) < 0) {
+        if (file_bin_read_slot_hdr(file, &tmp_size) < 0) {
             goto error;
         }
 
@@ -404,6 +529,11 @@ static int _file_bin_get_next_record(file_bin_t *file, lstr_t *rec)
 
     assert (false);
 
+  corrupted:
+    logger_error(&_G.logger, "corrupted record in file '%*pM' at pos %jd, "
+                 "jumping to next slot", LSTR_FMT_ARG(file->path),
+                 (intmax_t)prev_off);
+
   error:
     /* An error occured, try to jump to the next slot. */
     if (_file_bin_skip(file, file_bin_remaining_space_in_slot(file)) < 0) {
@@ -419,11 +549,12 @@ lstr_t file_bin_get_next_record(file_bin_t *file)
 {
     int res;
     lstr_t rec = LSTR_NULL_V;
+    off_t rec_off;
 
     assert (file->read_mode);
 
     do {
-        res = _file_bin_get_next_record(file, &rec);
+        res = _file_bin_get_next_record(file, &rec, &rec_off);
     } while (res >= 0 && !rec.s);
 
     return rec;
@@ -444,7 +575,7 @@ int t_file_bin_get_last_records(file_bin_t *file, int count, qv_t(lstr) *out)
         prev_slot = slot_off;
         file->cur = slot_off = file_bin_get_prev_slot(file, prev_slot - 1);
 
-        while (file->cur <= prev_slot - RC_HDR_SIZE
+        while (file->cur <= prev_slot - RC_HDR_SIZE(file)
             && !file_bin_is_finished(file))
         {
             lstr_t res = file_bin_get_next_record(file);
@@ -468,6 +599,84 @@ int t_file_bin_get_last_records(file_bin_t *file, int count, qv_t(lstr) *out)
     return 0;
 }
 
+/* Find the last slot whose header is valid and whose record number (or
+ * date) is lower than or equal to key. The keys of the slot headers are
+ * sorted. */
+static int file_bin_find_slot(const file_bin_t *file, bool by_date,
+                              uint64_t key, slot_hdr_v2_t *res)
+{
+    off_t lo = 0;
+    off_t hi = DIV_ROUND_UP(file->length, file->slot_size) - 1;
+    bool found = false;
+
+    while (lo <= hi) {
+        off_t mid = lo + (hi - lo) / 2;
+        off_t slot_no = mid;
+        slot_hdr_v2_t hdr;
+
+        /* Use the closest valid slot header. */
+        while (slot_no >= lo
+           &&  file_bin_get_slot_hdr_v2(file, slot_no, &hdr) < 0)
+        {
+            slot_no--;
+        }
+        if (slot_no < lo) {
+            lo = mid + 1;
+            continue;
+        }
+
+        if ((by_date ? hdr.msec : hdr.rec_no) <= key) {
+            *res = hdr;
+            found = true;
+            lo = mid + 1;
+        } else {
+            hi = slot_no - 1;
+        }
+    }
+
+    return found ? 0 : -1;
+}
+
+int file_bin_seek_record(file_bin_t *file, uint64_t rec_no)
+{
+    off_t save_cur = file->cur;
+    slot_hdr_v2_t hdr;
+    uint64_t cur_no = 0;
+
+    assert (file->read_mode);
+    THROW_ERR_IF(file->version < 2);
+
+    file->cur = HEADER_SIZE(file);
+    if (file_bin_find_slot(file, false, rec_no, &hdr) >= 0) {
+        file->cur = hdr.rec_off;
+        cur_no = hdr.rec_no;
+    }
+
+    for (; cur_no < rec_no; cur_no++) {
+        if (!file_bin_get_next_record(file).s) {
+            file->cur = save_cur;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int file_bin_seek_date(file_bin_t *file, uint64_t msec)
+{
+    slot_hdr_v2_t hdr;
+
+    assert (file->read_mode);
+    THROW_ERR_IF(file->version < 2);
+
+    file->cur = HEADER_SIZE(file);
+    if (msec > 0 && file_bin_find_slot(file, true, msec - 1, &hdr) >= 0) {
+        file->cur = hdr.rec_off;
+    }
+
+    return 0;
+}
+
 file_bin_t *file_bin_open(lstr_t path)
 {
     file_bin_t *res;
@@ -530,6 +739,286 @@ file_bin_t *file_bin_open(lstr_t path)
     return NULL;
 }
 
+/* }}} */
+/* {{{ Parallel reading */
+
+/* The replays read the files by chunks of about this size. */
+#define REPLAY_CHUNK_SIZE  (4 << 20)
+
+typedef struct file_bin_chunk_t {
+    thr_job_t   job;
+    thr_syn_t   syn;
+    file_bin_t *file;
+    int         id;
+
+    /* Offsets of the first record of the chunk, and of the first record of
+     * the next chunk. */
+    off_t start;
+    off_t end;
+
+    /* Offset of the end of the last record read, -1 if none was read. */
+    off_t pos;
+
+    /* Callback of the parallel reading; when NULL, the records are kept in
+     * the records vector. */
+    file_bin_record_f *cb;
+    void *priv;
+    atomic_bool *stop;
+    int res;
+
+    qv_t(lstr) records;
+} file_bin_chunk_t;
+
+/* Initialize a reader of the mapping of a file, with a position of its
+ * own. */
+static file_bin_t *file_bin_init_reader(file_bin_t *rd,
+                                        const file_bin_t *file, off_t pos)
+{
+    file_bin_init(rd);
+    rd->read_mode = true;
+    rd->path      = file->path;
+    rd->slot_size = file->slot_size;
+    rd->version   = file->version;
+    rd->length    = file->length;
+    rd->map       = file->map;
+    rd->cur       = pos;
+    return rd;
+}
+
+/* Get the offset of the first record starting after pos, that must be the
+ * start of a slot. */
+static off_t file_bin_first_record_off(const file_bin_t *file, off_t pos)
+{
+    file_bin_t rd;
+    lstr_t rec = LSTR_NULL_V;
+    off_t rec_off = file->length;
+
+    file_bin_init_reader(&rd, file, pos);
+    while (!rec.s && _file_bin_get_next_record(&rd, &rec, &rec_off) >= 0) {
+    }
+    sb_wipe(&rd.record_buf);
+
+    return rec.s ? rec_off : file->length;
+}
+
+/* Split the records of a file, from its current position, in chunks of
+ * slots_per_chunk slots. */
+static file_bin_chunk_t *file_bin_split(file_bin_t *file,
+                                        off_t slots_per_chunk, int *len)
+{
+    off_t from = MAX(file->cur, HEADER_SIZE(file));
+    off_t first_slot = from / file->slot_size;
+    off_t slots = DIV_ROUND_UP(file->length, file->slot_size) - first_slot;
+    file_bin_chunk_t *chunks;
+
+    *len = MAX(1, DIV_ROUND_UP(slots, slots_per_chunk));
+    chunks = p_new(file_bin_chunk_t, *len);
+
+    for (int i = 0; i < *len; i++) {
+        file_bin_chunk_t *chunk = &chunks[i];
+
+        chunk->file = file;
+        chunk->id   = i;
+        chunk->pos  = -1;
+        qv_init(&chunk->records);
+
+        if (i == 0) {
+            chunk->start = from;
+        } else {
+            off_t slot = first_slot + i * slots_per_chunk;
+
+            chunk->start = file_bin_first_record_off(file,
+                                                     slot * file->slot_size);
+            chunk->start = MAX(chunk->start, chunks[i - 1].start);
+            chunks[i - 1].end = chunk->start;
+        }
+    }
+    chunks[*len - 1].end = file->length;
+
+    return chunks;
+}
+
+static void file_bin_chunk_read(file_bin_chunk_t *chunk)
+{
+    file_bin_t rd;
+
+    file_bin_init_reader(&rd, chunk->file, chunk->start);
+    while (rd.cur < chunk->end) {
+        lstr_t rec = LSTR_NULL_V;
+        off_t rec_off = rd.cur;
+
+        if (_file_bin_get_next_record(&rd, &rec, &rec_off) < 0) {
+            break;
+        }
+        if (!rec.s) {
+            /* Corrupted record. */
+            continue;
+        }
+        if (rec_off >= chunk->end) {
+            break;
+        }
+        chunk->pos = rd.cur;
+
+        if (!chunk->cb) {
+            if (rec.data != rd.record_buf.data) {
+                qv_append(&chunk->records, rec);
+            } else {
+                /* The record spans on several slots. */
+                qv_append(&chunk->records, lstr_dup(rec));
+            }
+        } else
+        if (atomic_load(chunk->stop)) {
+            break;
+        } else
+        if ((*chunk->cb)(chunk->priv, chunk->id, rec) < 0) {
+            chunk->res = -1;
+            atomic_store(chunk->stop, true);
+            break;
+        }
+    }
+    sb_wipe(&rd.record_buf);
+}
+
+static void file_bin_chunk_job(thr_job_t *job, thr_syn_t *syn)
+{
+    file_bin_chunk_read(container_of(job, file_bin_chunk_t, job));
+}
+
+/* Set the position of the file after the last record read by the
+ * chunks. */
+static void file_bin_chunks_set_pos(file_bin_t *file,
+                                    const file_bin_chunk_t *chunks, int len)
+{
+    for (int i = len; i-- > 0; ) {
+        if (chunks[i].pos >= 0) {
+            file->cur = chunks[i].pos;
+            return;
+        }
+    }
+}
+
+static void file_bin_chunks_delete(file_bin_chunk_t **chunks, int len)
+{
+    for (int i = 0; i < len; i++) {
+        qv_deep_wipe(&(*chunks)[i].records, lstr_wipe);
+    }
+    p_delete(chunks);
+}
+
+int file_bin_read_parallel(file_bin_t *file, int nb_chunks,
+                           file_bin_record_f *cb, void *priv)
+{
+    bool threaded = MODULE_IS_LOADED(thr) && thr_parallelism_g > 1;
+    off_t slots = DIV_ROUND_UP(file->length, file->slot_size);
+    atomic_bool stop = false;
+    file_bin_chunk_t *chunks;
+    int len;
+    int res = 0;
+
+    assert (file->read_mode);
+
+    if (nb_chunks <= 0) {
+        nb_chunks = threaded ? thr_parallelism_g : 1;
+    }
+    chunks = file_bin_split(file, MAX(1, DIV_ROUND_UP(slots, nb_chunks)),
+                            &len);
+
+    if (threaded) {
+        thr_syn_t syn;
+
+        thr_syn_init(&syn);
+        for (int i = 0; i < len; i++) {
+            chunks[i].job.run = &file_bin_chunk_job;
+            chunks[i].cb = cb;
+            chunks[i].priv = priv;
+            chunks[i].stop = &stop;
+            thr_syn_schedule(&syn, &chunks[i].job);
+        }
+        thr_syn_wait(&syn);
+        thr_syn_wipe(&syn);
+    } else {
+        for (int i = 0; i < len && !stop; i++) {
+            chunks[i].cb = cb;
+            chunks[i].priv = priv;
+            chunks[i].stop = &stop;
+            file_bin_chunk_read(&chunks[i]);
+        }
+    }
+
+    for (int i = 0; i < len; i++) {
+        if (chunks[i].res < 0) {
+            res = -1;
+        }
+    }
+    if (res >= 0) {
+        file_bin_chunks_set_pos(file, chunks, len);
+    }
+    file_bin_chunks_delete(&chunks, len);
+
+    return res;
+}
+
+int file_bin_replay(file_bin_t *file, file_bin_record_f *cb, void *priv)
+{
+    bool threaded = MODULE_IS_LOADED(thr) && thr_parallelism_g > 1;
+    int window = threaded ? 2 * thr_parallelism_g : 1;
+    file_bin_chunk_t *chunks;
+    int len;
+    int end;
+    int scheduled = 0;
+    int res = 0;
+
+    assert (file->read_mode);
+
+    chunks = file_bin_split(file,
+                            MAX(1U, REPLAY_CHUNK_SIZE / file->slot_size),
+                            &len);
+    end = len;
+
+    /* The chunks are read in advance by the thread jobs, in a window of
+     * chunks following the one being replayed; the records are delivered in
+     * the order of the file by the calling thread. */
+    for (int i = 0; i < end; i++) {
+        file_bin_chunk_t *chunk = &chunks[i];
+
+        for (; threaded && scheduled < MIN(end, i + window); scheduled++) {
+            file_bin_chunk_t *next = &chunks[scheduled];
+
+            next->job.run = &file_bin_chunk_job;
+            thr_syn_init(&next->syn);
+            thr_syn_schedule(&next->syn, &next->job);
+        }
+        if (threaded) {
+            thr_syn_wait(&chunk->syn);
+            thr_syn_wipe(&chunk->syn);
+        } else {
+            file_bin_chunk_read(chunk);
+        }
+
+        if (res >= 0) {
+            tab_for_each_entry(rec, &chunk->records) {
+                if ((*cb)(priv, i, rec) < 0) {
+                    res = -1;
+                    break;
+                }
+            }
+            if (res >= 0 && chunk->pos >= 0) {
+                file->cur = chunk->pos;
+            }
+        }
+        qv_deep_clear(&chunk->records, lstr_wipe);
+
+        if (res < 0) {
+            /* Only wait for the chunks being read. */
+            end = threaded ? scheduled : i + 1;
+        }
+    }
+
+    file_bin_chunks_delete(&chunks, len);
+
+    return res;
+}
+
 /* }}} */
 /* {{{ Writing */
 
@@ -547,16 +1036,61 @@ int file_bin_sync(file_bin_t *file)
 {
     RETHROW(file_bin_flush(file));
 
+    if (file->use_mmap) {
+        if (file->map && msync(file->map, file->cur, MS_SYNC) < 0) {
+            return logger_error(&_G.logger, "cannot sync file '%*pM': %m",
+                                LSTR_FMT_ARG(file->path));
+        }
+    } else
     if (fsync(fileno(file->f)) < 0) {
         return logger_error(&_G.logger, "cannot sync file '%*pM': %m",
                             LSTR_FMT_ARG(file->path));
     }
 
+    file->synced_pos  = file->cur;
+    file->synced_msec = lp_getmsec();
+
+    return 0;
+}
+
+void file_bin_set_group_commit(file_bin_t *file, uint32_t max_bytes,
+                               uint32_t max_delay)
+{
+    assert (!file->read_mode);
+
+    file->commit_max_bytes = max_bytes;
+    file->commit_max_delay = max_delay;
+    file->synced_pos  = file->cur;
+    file->synced_msec = lp_getmsec();
+}
+
+static int file_bin_group_commit(file_bin_t *file)
+{
+    if (file->commit_max_bytes
+    &&  file->cur - file->synced_pos >= file->commit_max_bytes)
+    {
+        return file_bin_sync(file);
+    }
+    if (file->commit_max_delay
+    &&  lp_getmsec() >= file->synced_msec + file->commit_max_delay)
+    {
+        return file_bin_sync(file);
+    }
     return 0;
 }
 
 int file_bin_truncate(file_bin_t *file, off_t pos)
 {
+    if (file->use_mmap) {
+        /* Keep the size of the file, the zeroed part is ignored by the
+         * readers. */
+        if (pos < file->cur) {
+            memset(file->map + pos, 0, file->cur - pos);
+            file->cur = pos;
+        }
+        return 0;
+    }
+
     RETHROW(file_bin_flush(file));
 
     if (xftruncate(fileno(file->f), pos) < 0) {
@@ -596,11 +1130,60 @@ static int file_bin_pad(file_bin_t *file, off_t new_pos)
     return 0;
 }
 
+/* Make sure that the mapping of an mmap writer contains the offset end. */
+static int file_bin_mmap_reserve(file_bin_t *file, off_t end)
+{
+    off_t len;
+    void *new_map = NULL;
+
+    if (end <= file->length) {
+        return 0;
+    }
+
+    len = ROUND_UP(end, MMAP_CHUNK_SIZE);
+    if (xftruncate(fileno(file->f), len) < 0) {
+        return logger_error(&_G.logger, "cannot extend file '%*pM': %m",
+                            LSTR_FMT_ARG(file->path));
+    }
+
+#ifdef __linux__
+    if (file->map) {
+        new_map = mremap(file->map, file->length, len, MREMAP_MAYMOVE);
+    }
+#else
+    if (file->map) {
+        munmap(file->map, file->length);
+        file->map = NULL;
+        file->length = 0;
+    }
+#endif
+    if (!file->map) {
+        new_map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED,
+                       fileno(file->f), 0);
+    }
+    if (new_map == MAP_FAILED) {
+        return logger_error(&_G.logger, "cannot map file '%*pM': %m",
+                            LSTR_FMT_ARG(file->path));
+    }
+
+    file->map = new_map;
+    file->length = len;
+
+    return 0;
+}
+
 /* Write opaque data in file starting at offset file->cur */
 static int _write_file_bin(file_bin_t *file, const void *data, uint32_t len)
 {
     uint32_t res;
 
+    if (file->use_mmap) {
+        RETHROW(file_bin_mmap_reserve(file, file->cur + len));
+        memcpy(file->map + file->cur, data, len);
+        file->cur += len;
+        return 0;
+    }
+
     RETHROW(file_bin_pad(file, file->cur));
 
     res = fwrite(data, 1, len, file->f);
@@ -618,7 +1201,8 @@ static int _write_file_bin(file_bin_t *file, const void *data, uint32_t len)
 
 static int file_bin_write_header(file_bin_t *file)
 {
-    lstr_t version_str = LSTR_DATA(SIG, 16);
+    lstr_t version_str = LSTR_DATA(file->version >= 2 ? SIG_0200 : SIG_0100,
+                                   HEADER_VERSION_SIZE);
     le32_t slot_size = cpu_to_le32(file->slot_size);
 
     RETHROW(_write_file_bin(file, version_str.data, version_str.len));
@@ -627,15 +1211,26 @@ static int file_bin_write_header(file_bin_t *file)
     return 0;
 }
 
-static int file_bin_write_slot_header(file_bin_t *file, off_t next_entry)
+/* Write the header of the slot starting at the current position; next_entry
+ * is the offset of the next record starting in the file, and rec_no its
+ * number. */
+static int file_bin_write_slot_header(file_bin_t *file, off_t next_entry,
+                                      uint64_t rec_no)
 {
     off_t to_write = next_entry - (file->cur + SLOT_HDR_SIZE(file));
-    slot_hdr_t towrite_le32 = cpu_to_le32((uint32_t)to_write);
+    byte hdr[SLOT_HDR_V2_SIZE];
 
     assert (next_entry >= (long)(file->cur + SLOT_HDR_SIZE(file)));
     assert (to_write <= UINT32_MAX);
 
-    return _write_file_bin(file, &towrite_le32, SLOT_HDR_SIZE(file));
+    put_unaligned_le32(hdr, to_write);
+    if (file->version >= 2) {
+        put_unaligned_le64(hdr + 4, rec_no);
+        put_unaligned_le64(hdr + 12, lp_getmsec());
+        put_unaligned_le32(hdr + 20, icrc32c(0, hdr, SLOT_HDR_V2_SIZE - 4));
+    }
+
+    return _write_file_bin(file, hdr, SLOT_HDR_SIZE(file));
 }
 
 /* Write data in file and write slot headers when necessary */
@@ -647,9 +1242,12 @@ static int file_bin_write_data(file_bin_t *f, const void *data, uint32_t len,
 
         if (is_at_slot_start(f)) {
             if (r_start) {
-                file_bin_write_slot_header(f, f->cur + SLOT_HDR_SIZE(f));
+                RETHROW(file_bin_write_slot_header(f,
+                                                   f->cur + SLOT_HDR_SIZE(f),
+                                                   f->rec_no));
             } else {
-                file_bin_write_slot_header(f, next_entry);
+                RETHROW(file_bin_write_slot_header(f, next_entry,
+                                                   f->rec_no + 1));
             }
         }
 
@@ -667,8 +1265,8 @@ static int file_bin_write_data(file_bin_t *f, const void *data, uint32_t len,
 
 int file_bin_put_record(file_bin_t *file, const void *data, uint32_t len)
 {
-    rc_hdr_t rec_len_le32 = cpu_to_le32(len);
-    uint32_t total_size = len + RC_HDR_SIZE;
+    rc_hdr_t rec_hdr[2] = { cpu_to_le32(len) };
+    uint32_t total_size = len + RC_HDR_SIZE(file);
     off_t next_entry;
     uint32_t remaining;
 
@@ -676,31 +1274,67 @@ int file_bin_put_record(file_bin_t *file, const void *data, uint32_t len)
         /* File beginning */
         RETHROW(file_bin_write_header(file));
     }
+    if (file->version >= 2) {
+        rec_hdr[1] = cpu_to_le32(file_bin_rec_crc(len, data));
+    }
 
     remaining = file_bin_remaining_space_in_slot(file);
 
-    if (remaining < RC_HDR_SIZE
+    if (remaining < RC_HDR_SIZE(file)
     ||  (file->version == 0 && remaining < total_size))
     {
         file->cur += remaining;
     }
     next_entry = file_bin_get_next_entry_off(file, total_size);
 
-    RETHROW(file_bin_write_data(file, &rec_len_le32, RC_HDR_SIZE,
+    RETHROW(file_bin_write_data(file, rec_hdr, RC_HDR_SIZE(file),
                                 next_entry, true));
     RETHROW(file_bin_write_data(file, data, len, next_entry, false));
+    file->rec_no++;
 
-    return 0;
+    return file_bin_group_commit(file);
 }
 
-file_bin_t *file_bin_create(lstr_t path, uint32_t slot_size, bool trunc)
+/* Find the end of the last record of a version 2 file and the number of the
+ * next record, to append records to the file. */
+static int file_bin_find_end(file_bin_t *file, off_t *end)
+{
+    file_bin_t *rd = RETHROW_PN(file_bin_open(file->path));
+    slot_hdr_v2_t hdr;
+
+    file->rec_no = 0;
+    for (off_t slot_no = (rd->length - 1) / rd->slot_size; slot_no >= 0;
+         slot_no--)
+    {
+        if (file_bin_get_slot_hdr_v2(rd, slot_no, &hdr) >= 0
+        &&  hdr.rec_off <= rd->length)
+        {
+            rd->cur = hdr.rec_off;
+            file->rec_no = hdr.rec_no;
+            break;
+        }
+    }
+
+    *end = rd->cur;
+    while (file_bin_get_next_record(rd).s) {
+        file->rec_no++;
+        *end = rd->cur;
+    }
+
+    return file_bin_close(&rd);
+}
+
+static file_bin_t *file_bin_create_version(lstr_t path, uint32_t slot_size,
+                                           bool trunc, uint16_t version,
+                                           bool use_mmap)
 {
     file_bin_t *res;
     FILE *file;
     lstr_t r_path = lstr_dup(path);
     uint32_t min_slot_size;
 
-    file = fopen(r_path.s, trunc ? "w" : "a+");
+    /* The mappings need a file opened for reading. */
+    file = fopen(r_path.s, trunc ? (use_mmap ? "w+" : "w") : "a+");
     if (!file) {
         logger_error(&_G.logger, "cannot open file '%*pM': %m",
                      LSTR_FMT_ARG(path));
@@ -719,12 +1353,13 @@ file_bin_t *file_bin_create(lstr_t path, uint32_t slot_size, bool trunc)
     GOTO_ERROR_IF_FAIL(file_bin_seek(res, 0, SEEK_END));
     GOTO_ERROR_IF_FAIL((res->cur = file_bin_tell(res)));
 
-    res->version = CURRENT_VERSION;
+    res->version = version;
     res->slot_size = slot_size;
 
     if (res->cur > 0) {
         /* Appending an already existing file */
         byte buf[20];
+        off_t end;
 
         if (res->cur < countof(buf)) {
             res->slot_size = FILE_BIN_DEFAULT_SLOT_SIZE;
@@ -743,10 +1378,27 @@ file_bin_t *file_bin_create(lstr_t path, uint32_t slot_size, bool trunc)
         GOTO_ERROR_IF_FAIL(file_bin_parse_header(r_path, buf, countof(buf),
                                                  &res->version,
                                                  &res->slot_size));
+        if (res->version < 2) {
+            /* The mmap writers extend the files with zeros, which are
+             * valid records in the previous versions. */
+            return res;
+        }
+
+        /* Drop what follows the last record (zeros written by an mmap
+         * writer, or the end of a record not completely written). */
+        GOTO_ERROR_IF_FAIL(file_bin_find_end(res, &end));
+        if (use_mmap) {
+            res->use_mmap = true;
+            res->cur = end;
+            GOTO_ERROR_IF_FAIL(file_bin_mmap_reserve(res, end));
+        } else
+        if (end < res->cur) {
+            GOTO_ERROR_IF_FAIL(file_bin_truncate(res, end));
+        }
         return res;
     }
 
-    min_slot_size = HEADER_SIZE(res) + SLOT_HDR_SIZE(res) + RC_HDR_SIZE;
+    min_slot_size = HEADER_SIZE(res) + SLOT_HDR_SIZE(res) + RC_HDR_SIZE(res);
 
     if (unlikely(slot_size < min_slot_size)) {
         logger_error(&_G.logger, "slot size should be higher than %u, got "
@@ -754,6 +1406,7 @@ file_bin_t *file_bin_create(lstr_t path, uint32_t slot_size, bool trunc)
                      LSTR_FMT_ARG(r_path));
         goto error;
     }
+    res->use_mmap = use_mmap;
 
     return res;
 
@@ -764,6 +1417,20 @@ file_bin_t *file_bin_create(lstr_t path, uint32_t slot_size, bool trunc)
     return NULL;
 }
 
+file_bin_t *file_bin_create(lstr_t path, uint32_t slot_size, bool trunc)
+{
+    return file_bin_create_version(path, slot_size, trunc, CURRENT_VERSION,
+                                   false);
+}
+
+file_bin_t *file_bin_create_v2(lstr_t path, uint32_t slot_size,
+                               unsigned flags)
+{
+    return file_bin_create_version(path, slot_size,
+                                   flags & FILE_BIN_TRUNCATE, 2,
+                                   flags & FILE_BIN_MMAP);
+}
+
 /* }}} */
 
 int file_bin_close(file_bin_t **file_ptr)
@@ -17,6 +17,7 @@
 /***************************************************************************/
 
 #include <lib-common/file.h>
+#include <lib-common/thr.h>
 #include <lib-common/unix.h>
 
 /****************************************************************************/
@@ -351,3 +352,348 @@ int file_truncate(file_t *f, off_t len)
 
     return 0;
 }
+
+/****************************************************************************/
+/* bulk I/O                                                                 */
+/****************************************************************************/
+
+#define FILE_BULK_DEFAULT_BUF_SIZE  (1 << 20)
+
+struct file_bulk_t {
+    int   fd;
+    bool  writing;
+    bool  direct;           /* O_DIRECT is in use */
+    bool  async;            /* the I/Os are done in a thread job */
+    bool  eof;
+
+    size_t buf_size;
+    byte  *bufs[2];
+    int    cur;             /* buffer being filled by the writer */
+    size_t cur_len;
+
+    off_t  pos;             /* offset of the next block */
+    off_t  dropped;         /* start of the range left in the page cache */
+    off_t  prealloc;
+
+    /* pending I/O */
+    bool      io_pending;
+    byte     *io_buf;
+    size_t    io_len;
+    off_t     io_off;
+    ssize_t   io_res;
+    int       io_errno;
+    thr_job_t job;
+    thr_syn_t syn;
+};
+
+/* Drop from the page cache the part of the file before end. The written
+ * pages can only be dropped once they are written back.
+ */
+static void file_bulk_drop_cache(file_bulk_t *f, off_t end)
+{
+    if (end <= f->dropped) {
+        return;
+    }
+    if (f->writing) {
+        sync_file_range(f->fd, f->dropped, end - f->dropped,
+                        SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE
+                      | SYNC_FILE_RANGE_WAIT_AFTER);
+    }
+    posix_fadvise(f->fd, f->dropped, end - f->dropped, POSIX_FADV_DONTNEED);
+    f->dropped = end;
+}
+
+static void file_bulk_do_io(file_bulk_t *f)
+{
+    size_t done = 0;
+
+    while (done < f->io_len) {
+        ssize_t res;
+
+        if (f->writing) {
+            res = pwrite(f->fd, f->io_buf + done, f->io_len - done,
+                         f->io_off + done);
+        } else {
+            res = pread(f->fd, f->io_buf + done, f->io_len - done,
+                        f->io_off + done);
+        }
+        if (res < 0) {
+            if (ERR_RW_RETRIABLE(errno)) {
+                continue;
+            }
+            f->io_errno = errno;
+            f->io_res = -1;
+            return;
+        }
+        if (res == 0) {
+            if (f->writing) {
+                f->io_errno = EIO;
+                f->io_res = -1;
+                return;
+            }
+            /* end of file */
+            break;
+        }
+        done += res;
+    }
+
+    if (!f->direct && done > 0) {
+        if (f->writing) {
+            /* start the write back of the block, and drop the previous
+             * ones, whose write back had been started before */
+            sync_file_range(f->fd, f->io_off, done, SYNC_FILE_RANGE_WRITE);
+            file_bulk_drop_cache(f, f->io_off);
+        } else {
+            file_bulk_drop_cache(f, f->io_off + done);
+        }
+    }
+    f->io_res = done;
+}
+
+static void file_bulk_io_job(thr_job_t *job, thr_syn_t *syn)
+{
+    file_bulk_t *f = container_of(job, file_bulk_t, job);
+
+    thr_enter_blocking_syscall();
+    file_bulk_do_io(f);
+    thr_exit_blocking_syscall();
+}
+
+static void file_bulk_io_start(file_bulk_t *f, byte *buf, size_t len,
+                               off_t off)
+{
+    assert (!f->io_pending);
+    f->io_pending = true;
+    f->io_buf = buf;
+    f->io_len = len;
+    f->io_off = off;
+    if (f->async) {
+        thr_syn_schedule(&f->syn, &f->job);
+    } else {
+        file_bulk_do_io(f);
+    }
+}
+
+/* Wait for the pending I/O, and return its result. */
+static ssize_t file_bulk_io_wait(file_bulk_t *f)
+{
+    if (!f->io_pending) {
+        return 0;
+    }
+    if (f->async) {
+        thr_syn_wait(&f->syn);
+    }
+    f->io_pending = false;
+    if (f->io_res < 0) {
+        errno = f->io_errno;
+        return -1;
+    }
+    return f->io_res;
+}
+
+static file_bulk_t *file_bulk_open(const char *path, int oflags,
+                                   mode_t mode, unsigned flags,
+                                   size_t buf_size)
+{
+    file_bulk_t *f;
+    int fd = -1;
+
+    if (flags & FILE_BULK_DIRECT) {
+        fd = open(path, oflags | O_DIRECT | O_CLOEXEC, mode);
+        /* EINVAL: the file system does not support O_DIRECT */
+        if (fd < 0 && errno != EINVAL) {
+            return NULL;
+        }
+    }
+    if (fd < 0) {
+        fd = RETHROW_NP(open(path, oflags | O_CLOEXEC, mode));
+    }
+
+    f = p_new(file_bulk_t, 1);
+    f->fd = fd;
+    f->direct = fcntl(fd, F_GETFL) & O_DIRECT;
+    f->buf_size = ROUND_UP(buf_size ?: FILE_BULK_DEFAULT_BUF_SIZE,
+                           (size_t)FILE_BULK_ALIGN);
+    for (int i = 0; i < countof(f->bufs); i++) {
+        f->bufs[i] = mpa_new_raw(&mem_pool_cl_aligned, byte, f->buf_size,
+                                 FILE_BULK_ALIGN);
+    }
+    f->async = MODULE_IS_LOADED(thr);
+    if (f->async) {
+        f->job.run = &file_bulk_io_job;
+        thr_syn_init(&f->syn);
+    }
+    return f;
+}
+
+static void file_bulk_delete(file_bulk_t **fp)
+{
+    file_bulk_t *f = *fp;
+
+    if (f->async) {
+        thr_syn_wipe(&f->syn);
+    }
+    for (int i = 0; i < countof(f->bufs); i++) {
+        mp_delete(&mem_pool_cl_aligned, &f->bufs[i]);
+    }
+    p_close(&f->fd);
+    p_delete(fp);
+}
+
+file_bulk_t *file_bulk_open_read(const char *path, unsigned flags,
+                                 size_t buf_size)
+{
+    file_bulk_t *f = RETHROW_P(file_bulk_open(path, O_RDONLY, 0, flags,
+                                              buf_size));
+
+    if (!f->direct) {
+        /* double the read ahead window of the kernel */
+        posix_fadvise(f->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+    file_bulk_io_start(f, f->bufs[0], f->buf_size, 0);
+    return f;
+}
+
+ssize_t file_bulk_read(file_bulk_t *f, lstr_t *block)
+{
+    const byte *buf = f->io_buf;
+    ssize_t len;
+
+    if (unlikely(f->writing)) {
+        errno = EBADF;
+        return -1;
+    }
+    if (f->eof) {
+        *block = LSTR_NULL_V;
+        return 0;
+    }
+
+    len = file_bulk_io_wait(f);
+    if (len < 0) {
+        f->eof = true;
+        return -1;
+    }
+    f->pos += len;
+    if ((size_t)len < f->buf_size) {
+        f->eof = true;
+    } else {
+        /* read the next block in the other buffer */
+        file_bulk_io_start(f, f->bufs[buf == f->bufs[0]], f->buf_size,
+                           f->pos);
+    }
+
+    *block = LSTR_INIT_V((const char *)buf, len);
+    return len;
+}
+
+file_bulk_t *file_bulk_open_write(const char *path, unsigned flags,
+                                  mode_t mode, size_t buf_size,
+                                  off_t prealloc)
+{
+    file_bulk_t *f = RETHROW_P(file_bulk_open(path,
+                                              O_WRONLY | O_CREAT | O_TRUNC,
+                                              mode, flags, buf_size));
+
+    f->writing = true;
+    if (prealloc > 0) {
+        if (fallocate(f->fd, FALLOC_FL_KEEP_SIZE, 0, prealloc) < 0) {
+            if (errno != EOPNOTSUPP && errno != ENOSYS) {
+                FAIL_ERRNO(file_bulk_delete(&f), NULL);
+            }
+        } else {
+            f->prealloc = prealloc;
+        }
+    }
+    return f;
+}
+
+static int file_bulk_write_block(file_bulk_t *f)
+{
+    /* the buffer being written must not be reused before the end of the
+     * write */
+    RETHROW(file_bulk_io_wait(f));
+    file_bulk_io_start(f, f->bufs[f->cur], f->cur_len, f->pos);
+    f->pos += f->cur_len;
+    f->cur ^= 1;
+    f->cur_len = 0;
+    return 0;
+}
+
+ssize_t file_bulk_write(file_bulk_t *f, const void *data, size_t len)
+{
+    const byte *p = data;
+    size_t left = len;
+
+    if (unlikely(!f->writing)) {
+        errno = EBADF;
+        return -1;
+    }
+
+    while (left > 0) {
+        size_t n = MIN(left, f->buf_size - f->cur_len);
+
+        memcpy(f->bufs[f->cur] + f->cur_len, p, n);
+        f->cur_len += n;
+        p += n;
+        left -= n;
+        if (f->cur_len == f->buf_size) {
+            RETHROW(file_bulk_write_block(f));
+        }
+    }
+    return len;
+}
+
+static int file_bulk_write_tail(file_bulk_t *f)
+{
+    off_t size = f->pos + f->cur_len;
+
+    RETHROW(file_bulk_io_wait(f));
+    if (f->cur_len) {
+        if (f->direct && f->cur_len % FILE_BULK_ALIGN) {
+            /* the size of the last block is not aligned, it has to be
+             * written through the page cache */
+            RETHROW(fd_unset_features(f->fd, FD_FEAT_DIRECT));
+            f->direct = false;
+            f->dropped = f->pos;
+        }
+        RETHROW(file_bulk_write_block(f));
+        RETHROW(file_bulk_io_wait(f));
+    }
+    if (!f->direct) {
+        file_bulk_drop_cache(f, size);
+    }
+
+    /* release the space reserved after the end of the file */
+    if (f->prealloc > size) {
+        RETHROW(ftruncate(f->fd, size));
+    }
+    return 0;
+}
+
+int file_bulk_close(file_bulk_t **fp)
+{
+    file_bulk_t *f = *fp;
+    int res = 0;
+
+    if (!f) {
+        return 0;
+    }
+    if (f->writing) {
+        res = file_bulk_write_tail(f);
+        if (res < 0) {
+            /* do not free the buffers while they are being written */
+            IGNORE(file_bulk_io_wait(f));
+        }
+    } else {
+        IGNORE(file_bulk_io_wait(f));
+        if (!f->direct) {
+            /* also drop what the kernel has read ahead */
+            posix_fadvise(f->fd, f->dropped, 0, POSIX_FADV_DONTNEED);
+        }
+    }
+    if (res < 0) {
+        FAIL_ERRNO(file_bulk_delete(fp), -1);
+    }
+    file_bulk_delete(fp);
+    return 0;
+}
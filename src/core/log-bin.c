@@ -0,0 +1,845 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2026 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#include <lib-common/datetime.h>
+#include <lib-common/log-bin.h>
+#include <lib-common/thr.h>
+
+/* A binary log file contains two kinds of records:
+ *
+ *  - the definitions of the format strings:
+ *      'F' | id (u32) | format string
+ *
+ *  - the logs:
+ *      'L' | level (u32) | timestamp in µs (u64) | pid (u32) | fmt id (u32)
+ *          | program name (str) | logger name (str)
+ *          | [file (str) | function (str) | line (u32)]  (traces only)
+ *          | arguments
+ *
+ * Each argument is a type tag followed by its value; the integers are
+ * little endian, and the strings are prefixed by their length (u32).
+ */
+
+enum {
+    LOG_BIN_RECORD_FORMAT = 'F',
+    LOG_BIN_RECORD_LOG    = 'L',
+};
+
+enum {
+    LOG_BIN_ARG_INT    = 'i',
+    LOG_BIN_ARG_LONG   = 'l',
+    LOG_BIN_ARG_DOUBLE = 'f',
+    LOG_BIN_ARG_STR    = 's',
+    /* Argument of an extended format, formatted when the log is written. */
+    LOG_BIN_ARG_TEXT   = 't',
+};
+
+/* Maximum number of format strings of a file. */
+#define LOG_BIN_MAX_FMTS  (1 << 20)
+
+/* The rotation of the file is checked at most once per second, unless this
+ * amount of logs (a write buffer) was written since the last check. */
+#define LOG_BIN_ROTATION_CHECK_SIZE  (64 << 10)
+
+/* Size of the per-thread cache of the identifiers of the format strings. */
+#define LOG_BIN_FMT_CACHE_SIZE  256
+
+qm_kvec_t(log_bin_fmt, lstr_t, uint32_t, qhash_lstr_hash, qhash_lstr_equal);
+
+static struct {
+    pthread_mutex_t lock;
+    log_file_t *file;
+    log_handler_f *prev_handler;
+
+    /* Identifiers of the format strings, and generation of the
+     * identifiers, bumped when they are forgotten. */
+    qm_t(log_bin_fmt) fmts;
+    uint32_t fmts_gen;
+
+    /* Whether each format string is defined in the current file. */
+    qv_t(u8) defined;
+
+    /* Position and time of the last check of the rotation. */
+    off_t  rotation_pos;
+    time_t rotation_sec;
+} log_bin_g = {
+#define _G  log_bin_g
+    .lock     = PTHREAD_MUTEX_INITIALIZER,
+    .fmts     = QM_INIT(log_bin_fmt, _G.fmts),
+    .fmts_gen = 1,
+};
+
+/* Identifier of a read-only format string, valid while fmts_gen is the
+ * generation of the identifiers. */
+typedef struct log_bin_fmt_cache_t {
+    const char *fmt;
+    uint32_t fmts_gen;
+    uint32_t id;
+} log_bin_fmt_cache_t;
+
+static __thread log_bin_fmt_cache_t *log_bin_fmt_cache_g;
+
+/* Set while the thread writes a log in the file. */
+static __thread bool log_bin_in_handler_g;
+
+/* {{{ Format strings parsing */
+
+/* A conversion specification of a format string, parsed like iprintf does.
+ */
+typedef struct log_bin_conv_t {
+    const char *start;
+    const char *end;
+
+    /* Modifier of the "%*pX" (raw) or "%pX" (pointer) extended formats. */
+    int ext;
+    bool ext_raw;
+
+    bool width_star;
+    bool prec_star;
+    bool has_prec;
+    int prec;
+    bool is_64;
+    bool is_ldouble;
+    int conv;
+} log_bin_conv_t;
+
+/* Tell whether a conversion can be an extended format; the caller decides
+ * if it really is. */
+static int log_bin_ext_candidate(const char *fmt, bool *is_raw)
+{
+    if (fmt[1] == '*' && fmt[2] == 'p' && isalnum((unsigned char)fmt[3])) {
+        *is_raw = true;
+        return fmt[3];
+    }
+    if (fmt[1] == 'p' && isalnum((unsigned char)fmt[2])) {
+        *is_raw = false;
+        return fmt[2];
+    }
+    return 0;
+}
+
+/* Parse the conversion starting at fmt (pointing on a '%'). */
+static void log_bin_parse_conv(const char *fmt, int ext, bool ext_raw,
+                               log_bin_conv_t *conv)
+{
+    p_clear(conv, 1);
+    conv->start = fmt++;
+
+    if (ext) {
+        conv->ext     = ext;
+        conv->ext_raw = ext_raw;
+        conv->end     = fmt + (ext_raw ? 3 : 2);
+        return;
+    }
+
+    fmt += strspn(fmt, "-+#' 0I");
+
+    if (*fmt == '*') {
+        conv->width_star = true;
+        fmt++;
+    } else {
+        fmt += strspn(fmt, "0123456789");
+    }
+
+    if (*fmt == '.') {
+        fmt++;
+        conv->has_prec = true;
+        if (*fmt == '*') {
+            conv->prec_star = true;
+            fmt++;
+        } else {
+            while (*fmt >= '0' && *fmt <= '9') {
+                conv->prec = conv->prec * 10 + *fmt++ - '0';
+            }
+        }
+    }
+
+    switch (*fmt) {
+      case 'l':
+        if (fmt[1] == 'l') {
+            fmt++;
+        }
+        /* fall through */
+      case 'j':
+      case 'z':
+      case 't':
+        conv->is_64 = true;
+        fmt++;
+        break;
+      case 'h':
+        if (fmt[1] == 'h') {
+            fmt++;
+        }
+        fmt++;
+        break;
+      case 'L':
+        conv->is_ldouble = true;
+        fmt++;
+        break;
+    }
+
+    conv->conv = *fmt;
+    if (*fmt) {
+        fmt++;
+    }
+    if (conv->conv == 'p' || conv->conv == 'P') {
+        /* iprintf skips the garbage after a non-extended %p. */
+        while (isalnum((unsigned char)*fmt)) {
+            fmt++;
+        }
+    }
+    conv->end = fmt;
+}
+
+/* }}} */
+/* {{{ Encoding */
+
+static void log_bin_put32(sb_t *sb, uint32_t v)
+{
+    put_unaligned_le32(sb_growlen(sb, 4), v);
+}
+
+static void log_bin_put64(sb_t *sb, uint64_t v)
+{
+    put_unaligned_le64(sb_growlen(sb, 8), v);
+}
+
+static void log_bin_put_str(sb_t *sb, const void *s, int len)
+{
+    log_bin_put32(sb, len);
+    sb_add(sb, s, len);
+}
+
+static void log_bin_put_arg_int(sb_t *sb, int tag, uint64_t v)
+{
+    sb_addc(sb, tag);
+    if (tag == LOG_BIN_ARG_INT) {
+        log_bin_put32(sb, v);
+    } else {
+        log_bin_put64(sb, v);
+    }
+}
+
+static void log_bin_put_arg_str(sb_t *sb, int tag, const void *s, int len)
+{
+    sb_addc(sb, tag);
+    log_bin_put_str(sb, s, len);
+}
+
+/* The memory formats of iprintf, whose arguments are copied. */
+static bool log_bin_is_mem_modifier(int modifier)
+{
+    switch (modifier) {
+      case 'M': case 'X': case 'x': case 'd': case 'u': case 'h': case 'H':
+        return true;
+      default:
+        return false;
+    }
+}
+
+static void log_bin_encode_ext(sb_t *sb, const log_bin_conv_t *conv,
+                               va_list *va)
+{
+    SB_1k(text);
+
+    if (conv->ext_raw) {
+        char spec[] = { '%', '*', 'p', conv->ext, '\0' };
+        int len = va_arg(*va, int);
+        const void *p = va_arg(*va, const void *);
+
+        if (log_bin_is_mem_modifier(conv->ext)) {
+            log_bin_put_arg_str(sb, LOG_BIN_ARG_STR, p, len);
+            return;
+        }
+        sb_addf(&text, spec, len, p);
+    } else {
+        char spec[] = { '%', 'p', conv->ext, '\0' };
+
+        sb_addf(&text, spec, va_arg(*va, const void *));
+    }
+    log_bin_put_arg_str(sb, LOG_BIN_ARG_TEXT, text.data, text.len);
+    sb_wipe(&text);
+}
+
+static void log_bin_encode_conv(sb_t *sb, const log_bin_conv_t *conv,
+                                int save_errno, va_list *va)
+{
+    int prec = conv->has_prec ? conv->prec : -1;
+
+    if (conv->ext) {
+        log_bin_encode_ext(sb, conv, va);
+        return;
+    }
+    if (conv->width_star) {
+        log_bin_put_arg_int(sb, LOG_BIN_ARG_INT, va_arg(*va, int));
+    }
+    if (conv->prec_star) {
+        prec = va_arg(*va, int);
+        log_bin_put_arg_int(sb, LOG_BIN_ARG_INT, prec);
+    }
+
+    switch (conv->conv) {
+      case 'd': case 'i': case 'u': case 'o': case 'x': case 'X':
+        if (conv->is_64) {
+            log_bin_put_arg_int(sb, LOG_BIN_ARG_LONG,
+                                va_arg(*va, unsigned long long));
+            break;
+        }
+        /* fall through */
+      case 'c':
+        log_bin_put_arg_int(sb, LOG_BIN_ARG_INT, va_arg(*va, unsigned));
+        break;
+
+      case 'e': case 'E': case 'f': case 'F':
+      case 'g': case 'G': case 'a': case 'A': {
+        double d;
+
+        if (conv->is_ldouble) {
+            d = va_arg(*va, long double);
+        } else {
+            d = va_arg(*va, double);
+        }
+        sb_addc(sb, LOG_BIN_ARG_DOUBLE);
+        log_bin_put64(sb, double_bits_cpu(d));
+      } break;
+
+      case 's': {
+        const char *s = va_arg(*va, const char *);
+
+        s = s ?: "(null)";
+        log_bin_put_arg_str(sb, LOG_BIN_ARG_STR, s,
+                            prec >= 0 ? strnlen(s, prec) : strlen(s));
+      } break;
+
+      case 'm': {
+        const char *s = strerror(save_errno);
+
+        log_bin_put_arg_str(sb, LOG_BIN_ARG_STR, s, strlen(s));
+      } break;
+
+      case 'p': case 'P':
+        log_bin_put_arg_int(sb, LOG_BIN_ARG_LONG,
+                            (uintptr_t)va_arg(*va, const void *));
+        break;
+
+      case 'n':
+        (void)va_arg(*va, void *);
+        break;
+
+      default:
+        /* '%' and the unknown conversions have no argument. */
+        break;
+    }
+}
+
+__attr_printf__(2, 0)
+static void log_bin_encode_args(sb_t *sb, const char *fmt, va_list va)
+{
+    int save_errno = errno;
+    va_list vc;
+
+    va_copy(vc, va);
+    while ((fmt = strchr(fmt, '%'))) {
+        log_bin_conv_t conv;
+        bool is_raw;
+        int ext = log_bin_ext_candidate(fmt, &is_raw);
+
+        if (ext && !iprintf_has_formatter(ext, is_raw)) {
+            ext = 0;
+        }
+        log_bin_parse_conv(fmt, ext, is_raw, &conv);
+        if (!conv.conv && !conv.ext) {
+            break;
+        }
+        log_bin_encode_conv(sb, &conv, save_errno, &vc);
+        fmt = conv.end;
+    }
+    va_end(vc);
+}
+
+static uint32_t log_bin_intern_fmt(const char *fmt)
+{
+    lstr_t key = LSTR(fmt);
+    uint32_t id = qm_len(log_bin_fmt, &_G.fmts);
+    int pos = qm_reserve(log_bin_fmt, &_G.fmts, &key, 0);
+
+    if (pos & QHASH_COLLISION) {
+        return _G.fmts.values[pos & ~QHASH_COLLISION];
+    }
+    /* The format strings are not always literals. */
+    _G.fmts.keys[pos]   = lstr_dup(key);
+    _G.fmts.values[pos] = id;
+    return id;
+}
+
+/* Get the identifier of a format string; the identifiers of the literal
+ * formats are cached by the thread, which saves hashing them. */
+static uint32_t log_bin_get_fmt_id(const char *fmt)
+{
+    uintptr_t addr = (uintptr_t)fmt;
+    log_bin_fmt_cache_t *entry;
+    uint32_t id;
+
+    if (unlikely(!log_bin_fmt_cache_g)) {
+        log_bin_fmt_cache_g = p_new(log_bin_fmt_cache_t,
+                                    LOG_BIN_FMT_CACHE_SIZE);
+    }
+    entry = &log_bin_fmt_cache_g[((addr >> 3) ^ (addr >> 11))
+                                 % LOG_BIN_FMT_CACHE_SIZE];
+    if (likely(entry->fmt == fmt && entry->fmts_gen == _G.fmts_gen)) {
+        return entry->id;
+    }
+
+    id = log_bin_intern_fmt(fmt);
+    if (iprintf_fmt_is_read_only(fmt)) {
+        entry->fmt      = fmt;
+        entry->fmts_gen = _G.fmts_gen;
+        entry->id       = id;
+    }
+    return id;
+}
+
+static void log_bin_fmt_cache_wipe(void)
+{
+    p_delete(&log_bin_fmt_cache_g);
+}
+thr_hooks(NULL, log_bin_fmt_cache_wipe);
+
+/* Rotate the file if needed, and forget the format strings defined in the
+ * previous file when it is rotated. The rotation is otherwise disabled,
+ * so that a definition and the logs using it are in the same file. */
+static void log_bin_check_rotation(time_t now)
+{
+    file_bin_t *bin = _G.file->_bin_internal;
+    off_t pos = bin->cur;
+
+    if (now == _G.rotation_sec
+    &&  pos - _G.rotation_pos < LOG_BIN_ROTATION_CHECK_SIZE)
+    {
+        return;
+    }
+
+    IGNORE(log_file_enable_rotation(_G.file));
+    log_file_disable_rotation(_G.file);
+
+    if (_G.file->_bin_internal != bin || _G.file->_bin_internal->cur < pos) {
+        qv_clear(&_G.defined);
+    }
+    _G.rotation_sec = now;
+    _G.rotation_pos = _G.file->_bin_internal->cur;
+}
+
+__attr_printf__(2, 0)
+static void log_bin_handler(const log_ctx_t *ctx, const char *fmt,
+                            va_list va)
+{
+    SB_1k(buf);
+    struct timeval tv;
+    int id_pos;
+
+    if (unlikely(log_bin_in_handler_g)) {
+        /* Logged while writing a log, e.g. by the rotation of the file,
+         * with the lock held: use the previous handler. */
+        log_handler_f *prev_handler = _G.prev_handler;
+
+        if (prev_handler) {
+            (*prev_handler)(ctx, fmt, va);
+        }
+        return;
+    }
+    if (ctx->is_silent) {
+        return;
+    }
+
+    lp_gettv(&tv);
+    sb_addc(&buf, LOG_BIN_RECORD_LOG);
+    log_bin_put32(&buf, ctx->level);
+    log_bin_put64(&buf, tv.tv_sec * 1000000ULL + tv.tv_usec);
+    log_bin_put32(&buf, ctx->pid);
+    id_pos = buf.len;
+    log_bin_put32(&buf, 0);
+    log_bin_put_str(&buf, ctx->prog_name.s, ctx->prog_name.len);
+    log_bin_put_str(&buf, ctx->logger_name.s, ctx->logger_name.len);
+    if (ctx->level >= LOG_TRACE) {
+        log_bin_put_str(&buf, ctx->file.s, ctx->file.len);
+        log_bin_put_str(&buf, ctx->func.s, ctx->func.len);
+        log_bin_put32(&buf, ctx->line);
+    }
+    log_bin_encode_args(&buf, fmt, va);
+
+    pthread_mutex_lock(&_G.lock);
+    log_bin_in_handler_g = true;
+    if (_G.file) {
+        uint32_t id = log_bin_get_fmt_id(fmt);
+
+        log_bin_check_rotation(tv.tv_sec);
+        if (id >= (uint32_t)_G.defined.len || !_G.defined.tab[id]) {
+            SB_1k(def);
+
+            sb_addc(&def, LOG_BIN_RECORD_FORMAT);
+            log_bin_put32(&def, id);
+            sb_adds(&def, fmt);
+            IGNORE(log_fwrite(_G.file, def.data, def.len));
+            sb_wipe(&def);
+
+            while (_G.defined.len <= (int)id) {
+                qv_append(&_G.defined, false);
+            }
+            _G.defined.tab[id] = true;
+        }
+        put_unaligned_le32(buf.data + id_pos, id);
+        IGNORE(log_fwrite(_G.file, buf.data, buf.len));
+    }
+    log_bin_in_handler_g = false;
+    pthread_mutex_unlock(&_G.lock);
+
+    sb_wipe(&buf);
+}
+
+void log_bin_start(log_file_t *file)
+{
+    assert (file->is_file_bin);
+
+    pthread_mutex_lock(&_G.lock);
+    _G.file = file;
+    qv_clear(&_G.defined);
+    _G.rotation_sec = 0;
+    log_file_disable_rotation(file);
+    pthread_mutex_unlock(&_G.lock);
+
+    _G.prev_handler = log_set_handler(&log_bin_handler);
+}
+
+void log_bin_stop(void)
+{
+    if (!_G.prev_handler) {
+        return;
+    }
+    log_set_handler(_G.prev_handler);
+    _G.prev_handler = NULL;
+
+    pthread_mutex_lock(&_G.lock);
+    IGNORE(log_file_enable_rotation(_G.file));
+    _G.file = NULL;
+    qm_deep_clear(log_bin_fmt, &_G.fmts, lstr_wipe, IGNORE);
+    _G.fmts_gen++;
+    qv_wipe(&_G.defined);
+    pthread_mutex_unlock(&_G.lock);
+}
+
+/* }}} */
+/* {{{ Decoding */
+
+typedef struct log_bin_arg_t {
+    int tag;
+    uint64_t i;
+    double d;
+    pstream_t s;
+} log_bin_arg_t;
+
+static int log_bin_get32(pstream_t *ps, uint32_t *v)
+{
+    THROW_ERR_UNLESS(ps_has(ps, 4));
+    *v = get_unaligned_le32(ps->b);
+    return ps_skip(ps, 4);
+}
+
+static int log_bin_get64(pstream_t *ps, uint64_t *v)
+{
+    THROW_ERR_UNLESS(ps_has(ps, 8));
+    *v = get_unaligned_le64(ps->b);
+    return ps_skip(ps, 8);
+}
+
+static int log_bin_get_str(pstream_t *ps, pstream_t *s)
+{
+    uint32_t len;
+
+    RETHROW(log_bin_get32(ps, &len));
+    return ps_get_ps(ps, len, s);
+}
+
+static int log_bin_get_arg(pstream_t *ps, log_bin_arg_t *arg)
+{
+    uint32_t i;
+
+    p_clear(arg, 1);
+    arg->tag = ps_getc(ps);
+    switch (arg->tag) {
+      case LOG_BIN_ARG_INT:
+        RETHROW(log_bin_get32(ps, &i));
+        arg->i = (int32_t)i;
+        return 0;
+      case LOG_BIN_ARG_LONG:
+        return log_bin_get64(ps, &arg->i);
+      case LOG_BIN_ARG_DOUBLE:
+        RETHROW(log_bin_get64(ps, &arg->i));
+        arg->d = bits_to_double_cpu(arg->i);
+        return 0;
+      case LOG_BIN_ARG_STR:
+      case LOG_BIN_ARG_TEXT:
+        return log_bin_get_str(ps, &arg->s);
+      default:
+        return -1;
+    }
+}
+
+static int log_bin_get_arg_tag(pstream_t *ps, int tag, log_bin_arg_t *arg)
+{
+    RETHROW(log_bin_get_arg(ps, arg));
+    THROW_ERR_UNLESS(arg->tag == tag);
+    return 0;
+}
+
+/* Format a value with the spec of a conversion, and the widths and
+ * precisions given as arguments. */
+#define LOG_BIN_ADDF(...)                                                    \
+    do {                                                                     \
+        if (nstars == 2) {                                                   \
+            sb_addf(out, spec, stars[0], stars[1], __VA_ARGS__);             \
+        } else                                                               \
+        if (nstars == 1) {                                                   \
+            sb_addf(out, spec, stars[0], __VA_ARGS__);                       \
+        } else {                                                             \
+            sb_addf(out, spec, __VA_ARGS__);                                 \
+        }                                                                    \
+    } while (0)
+
+static int log_bin_decode_conv(pstream_t *ps, const log_bin_conv_t *conv,
+                               sb_t *out)
+{
+    t_scope;
+    char *spec = t_dupz(conv->start, conv->end - conv->start);
+    log_bin_arg_t arg;
+    int stars[2];
+    int nstars = 0;
+
+    if (conv->ext) {
+        RETHROW(log_bin_get_arg(ps, &arg));
+        if (arg.tag == LOG_BIN_ARG_TEXT) {
+            sb_add(out, arg.s.s, ps_len(&arg.s));
+            return 0;
+        }
+        THROW_ERR_UNLESS(arg.tag == LOG_BIN_ARG_STR && conv->ext_raw);
+        sb_addf(out, spec, (int)ps_len(&arg.s), arg.s.s);
+        return 0;
+    }
+
+    if (conv->width_star) {
+        RETHROW(log_bin_get_arg_tag(ps, LOG_BIN_ARG_INT, &arg));
+        stars[nstars++] = arg.i;
+    }
+    if (conv->prec_star) {
+        RETHROW(log_bin_get_arg_tag(ps, LOG_BIN_ARG_INT, &arg));
+        stars[nstars++] = arg.i;
+    }
+
+    switch (conv->conv) {
+      case 'd': case 'i': case 'u': case 'o': case 'x': case 'X':
+        if (conv->is_64) {
+            RETHROW(log_bin_get_arg_tag(ps, LOG_BIN_ARG_LONG, &arg));
+            LOG_BIN_ADDF((unsigned long long)arg.i);
+            break;
+        }
+        /* fall through */
+      case 'c':
+        RETHROW(log_bin_get_arg_tag(ps, LOG_BIN_ARG_INT, &arg));
+        LOG_BIN_ADDF((int)arg.i);
+        break;
+
+      case 'e': case 'E': case 'f': case 'F':
+      case 'g': case 'G': case 'a': case 'A':
+        RETHROW(log_bin_get_arg_tag(ps, LOG_BIN_ARG_DOUBLE, &arg));
+        if (conv->is_ldouble) {
+            LOG_BIN_ADDF((long double)arg.d);
+        } else {
+            LOG_BIN_ADDF(arg.d);
+        }
+        break;
+
+      case 'm':
+        /* strerror() was called when the log was written. */
+        spec[conv->end - conv->start - 1] = 's';
+        /* fall through */
+      case 's':
+        RETHROW(log_bin_get_arg_tag(ps, LOG_BIN_ARG_STR, &arg));
+        LOG_BIN_ADDF(t_dupz(arg.s.s, ps_len(&arg.s)));
+        break;
+
+      case 'p': case 'P':
+        RETHROW(log_bin_get_arg_tag(ps, LOG_BIN_ARG_LONG, &arg));
+        LOG_BIN_ADDF((void *)(uintptr_t)arg.i);
+        break;
+
+      case 'n':
+        break;
+
+      default:
+        LOG_BIN_ADDF(0);
+        break;
+    }
+
+    return 0;
+}
+
+#undef LOG_BIN_ADDF
+
+static int log_bin_decode_args(pstream_t *ps, const char *fmt, sb_t *out)
+{
+    for (;;) {
+        const char *p = strchrnul(fmt, '%');
+        log_bin_conv_t conv;
+        bool is_raw;
+        int ext;
+
+        sb_add(out, fmt, p - fmt);
+        if (!*p) {
+            return 0;
+        }
+
+        /* The extended formats registered by the process which wrote the
+         * log are not always registered in the decoder: the type of the
+         * next argument tells whether this is an extended format. */
+        ext = log_bin_ext_candidate(p, &is_raw);
+        if (ext) {
+            int tag = ps_peekc(*ps);
+
+            if (tag != LOG_BIN_ARG_TEXT
+            &&  !(is_raw && tag == LOG_BIN_ARG_STR))
+            {
+                ext = 0;
+            }
+        }
+        log_bin_parse_conv(p, ext, is_raw, &conv);
+        if (!conv.conv && !conv.ext) {
+            return 0;
+        }
+        RETHROW(log_bin_decode_conv(ps, &conv, out));
+        fmt = conv.end;
+    }
+}
+
+log_bin_decoder_t *log_bin_decoder_init(log_bin_decoder_t *decoder)
+{
+    p_clear(decoder, 1);
+    qv_init(&decoder->fmts);
+    return decoder;
+}
+
+void log_bin_decoder_wipe(log_bin_decoder_t *decoder)
+{
+    qv_deep_wipe(&decoder->fmts, lstr_wipe);
+}
+
+static int log_bin_decode_format(log_bin_decoder_t *decoder, pstream_t ps)
+{
+    uint32_t id;
+
+    RETHROW(log_bin_get32(&ps, &id));
+    THROW_ERR_IF(id >= LOG_BIN_MAX_FMTS);
+
+    while (decoder->fmts.len <= (int)id) {
+        qv_append(&decoder->fmts, LSTR_NULL_V);
+    }
+    lstr_wipe(&decoder->fmts.tab[id]);
+    decoder->fmts.tab[id] = lstr_dups(ps.s, ps_len(&ps));
+    return 0;
+}
+
+static int log_bin_decode_log(log_bin_decoder_t *decoder, pstream_t ps,
+                              sb_t *out)
+{
+    static char const *prefixes[] = {
+        [LOG_EMERG]    = "fatal: ",
+        [LOG_ALERT]    = "fatal: ",
+        [LOG_CRIT]     = "fatal: ",
+        [LOG_ERR]      = "error: ",
+        [LOG_WARNING]  = "warn:  ",
+        [LOG_NOTICE]   = "note:  ",
+        [LOG_INFO]     = "info:  ",
+        [LOG_DEBUG]    = "debug: ",
+        [LOG_TRACE]    = "trace: ",
+    };
+    uint32_t level, pid, id;
+    uint64_t ts;
+    pstream_t prog, logger;
+    time_t sec;
+    struct tm tm;
+    char date[32];
+
+    RETHROW(log_bin_get32(&ps, &level));
+    RETHROW(log_bin_get64(&ps, &ts));
+    RETHROW(log_bin_get32(&ps, &pid));
+    RETHROW(log_bin_get32(&ps, &id));
+    RETHROW(log_bin_get_str(&ps, &prog));
+    RETHROW(log_bin_get_str(&ps, &logger));
+    THROW_ERR_UNLESS(id < (uint32_t)decoder->fmts.len
+                  && decoder->fmts.tab[id].s);
+
+    sec = ts / 1000000;
+    localtime_r(&sec, &tm);
+    strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", &tm);
+    sb_addf(out, "%s.%06d %*pM[%u]: ", date, (int)(ts % 1000000),
+            PS_FMT_ARG(&prog), pid);
+
+    if ((int)level >= LOG_TRACE) {
+        pstream_t file, func;
+        uint32_t line;
+
+        RETHROW(log_bin_get_str(&ps, &file));
+        RETHROW(log_bin_get_str(&ps, &func));
+        RETHROW(log_bin_get32(&ps, &line));
+        sb_addf(out, "%*pM:%u:%*pM: ", PS_FMT_ARG(&file), line,
+                PS_FMT_ARG(&func));
+    } else {
+        THROW_ERR_IF((int)level < 0);
+        sb_adds(out, prefixes[level]);
+    }
+    if (ps_len(&logger)) {
+        sb_addf(out, "{%*pM} ", PS_FMT_ARG(&logger));
+    }
+
+    RETHROW(log_bin_decode_args(&ps, decoder->fmts.tab[id].s, out));
+    sb_addc(out, '\n');
+    return 0;
+}
+
+int log_bin_decode_record(log_bin_decoder_t *decoder, lstr_t record,
+                          sb_t *out)
+{
+    pstream_t ps = ps_initlstr(&record);
+    int len = out->len;
+
+    switch (ps_getc(&ps)) {
+      case LOG_BIN_RECORD_FORMAT:
+        RETHROW(log_bin_decode_format(decoder, ps));
+        return 0;
+
+      case LOG_BIN_RECORD_LOG:
+        if (log_bin_decode_log(decoder, ps, out) < 0) {
+            sb_clip(out, len);
+            return -1;
+        }
+        return 1;
+
+      default:
+        return -1;
+    }
+}
+
+/* }}} */
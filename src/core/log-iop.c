@@ -38,6 +38,8 @@ void logger_configure(const core__log_configuration__t *conf)
     tab_for_each_ptr(l, &conf->specific) {
         logger_set_level(l->full_name, l->level,
                          LOG_MK_FLAGS(l->force_all, l->is_silent));
+        logger_set_limits(l->full_name, OPT_DEFVAL(l->rate_limit, 0),
+                          OPT_DEFVAL(l->sampling, 0));
     }
 }
 
@@ -39,6 +39,29 @@ struct level {
 };
 qm_kvec_t(level, lstr_t, struct level, qhash_lstr_hash, qhash_lstr_equal);
 
+struct limits {
+    unsigned rate;
+    unsigned sampling;
+};
+qm_kvec_t(limits, lstr_t, struct limits, qhash_lstr_hash, qhash_lstr_equal);
+
+/* Call site with suppressed logs that were not reported yet. */
+typedef struct log_site_pending_t {
+    log_site_t *site;
+    logger_t *logger;
+    int level;
+    lstr_t file;
+    lstr_t func;
+    int line;
+} log_site_pending_t;
+qvector_t(log_site_pending, log_site_pending_t);
+
+/* Period of the report of the suppressed logs of the silent call sites. */
+#define LOG_SITES_FLUSH_PERIOD  1000 /* ms */
+
+/* Generation of a call site being reset: the generations are odd. */
+#define LOG_SITE_GEN_REFRESHING  2
+
 
 typedef struct buffer_instance_t {
     qv_t(log_buffer) vec_buffer;
@@ -56,6 +79,43 @@ qvector_t(buffer_instance, buffer_instance_t);
 
 static log_handler_f log_stderr_raw_handler;
 
+/* Size of the rings of the asynchronous mode, must be a power of 2. */
+#define LOG_RING_SIZE  (256 << 10)
+
+/* Length of the records marking the end of the ring. */
+#define LOG_RING_SKIP  UINT32_MAX
+
+/* Maximum number of records written in one writev() by the writer. */
+#define LOG_ASYNC_BATCH  256
+
+typedef struct log_record_t {
+    uint32_t len;
+    uint32_t seq;
+    char data[];
+} log_record_t;
+
+/* Ring in which a thread pushes its formatted logs in the asynchronous mode.
+ *
+ * This is a bounded SPSC ring of variable-length records: the thread is the
+ * only producer, and the holder of _G.async.lock the only consumer. head and
+ * tail are free-running positions in the ring.
+ */
+typedef struct log_ring_t {
+    /* Consumer part */
+    atomic_uint head;
+    uint32_t cursor;
+    uint32_t end;
+    dlist_t list;
+    char pad_after_consumer[64 - 3 * sizeof(uint32_t) - sizeof(dlist_t)];
+
+    /* Producer part */
+    atomic_uint tail;
+    atomic_bool closed;
+    char pad_after_producer[64 - sizeof(atomic_uint) - sizeof(atomic_bool)];
+
+    byte data[LOG_RING_SIZE];
+} log_ring_t;
+
 _MODULE_ADD_DECLS(log);
 
 static struct {
@@ -66,6 +126,9 @@ static struct {
     char          *is_debug;
     qm_t(level)    pending_levels;
 
+    /* Limits of the call sites, by logger full name. */
+    qm_t(limits)   limits;
+
     bool fancy;
     char fancy_prefix[64];
     int fancy_len;
@@ -76,6 +139,23 @@ static struct {
     spinlock_t update_lock;
 
     bool log_timestamp : 1;
+
+    struct {
+        atomic_bool enabled;
+        bool writer_started;
+        log_async_overflow_t overflow;
+        atomic_bool stopping;
+        pthread_t writer;
+        thr_evc_t ec;
+
+        /* Protects the list of rings and the consumer side of the rings. */
+        pthread_mutex_t lock;
+        dlist_t rings;
+
+        atomic_uint seq;
+        atomic_uint64_t dropped;
+        uint64_t dropped_seen;
+    } async;
 } log_g = {
 #define _G  log_g
     .root_logger = {
@@ -89,7 +169,12 @@ static struct {
         .siblings      = DLIST_INIT(_G.root_logger.siblings)
     },
     .pending_levels = QM_INIT(level, _G.pending_levels),
+    .limits         = QM_INIT(limits, _G.limits),
     .handler        = &log_stderr_raw_handler,
+    .async = {
+        .lock  = PTHREAD_MUTEX_INITIALIZER,
+        .rings = DLIST_INIT(_G.async.rings),
+    },
 };
 
 static __thread struct {
@@ -105,6 +190,14 @@ static __thread struct {
     qv_t(buffer_instance) vec_buff_stack;
     mem_stack_pool_t mp_stack;
     int nb_buffer_started;
+
+    /* asynchronous mode */
+    log_ring_t *ring;
+    bool is_async_writer;
+
+    /* call sites with suppressed logs */
+    qv_t(log_site_pending) pending_sites;
+    int64_t pending_sites_flush;
 } log_thr_g;
 
 __thread log_thr_ml_t log_thr_ml_g;
@@ -217,8 +310,13 @@ static void logger_wipe_child(logger_t *logger)
     lstr_wipe(&logger->full_name);
 }
 
+static void log_sites_flush(void);
+
 void logger_wipe(logger_t *logger)
 {
+    /* The call sites of the thread may still reference the logger. */
+    log_sites_flush();
+
     log_spin_lock();
     logger_wipe_child(logger);
     log_spin_unlock();
@@ -256,6 +354,8 @@ static void logger_compute_fullname(logger_t *logger)
 
 void __logger_do_refresh(logger_t *logger)
 {
+    int pos;
+
     if (atomic_load_explicit(&logger->conf_gen, memory_order_acquire)
         == log_conf_gen_g)
     {
@@ -272,8 +372,6 @@ void __logger_do_refresh(logger_t *logger)
     }
 
     if (!logger->full_name.s) {
-        int pos = 0;
-
         logger_compute_fullname(logger);
 
         assert (logger->level >= LOG_UNDEFINED);
@@ -296,6 +394,19 @@ void __logger_do_refresh(logger_t *logger)
         }
     }
 
+    pos = qm_find(limits, &_G.limits, &logger->full_name);
+    if (pos >= 0) {
+        logger->site_rate     = _G.limits.values[pos].rate;
+        logger->site_sampling = _G.limits.values[pos].sampling;
+    } else
+    if (logger->parent) {
+        logger->site_rate     = logger->parent->site_rate;
+        logger->site_sampling = logger->parent->site_sampling;
+    } else {
+        logger->site_rate     = 0;
+        logger->site_sampling = 0;
+    }
+
     logger->level = logger->default_level;
 
     if (logger->defined_level >= 0) {
@@ -418,6 +529,28 @@ int logger_reset_level(lstr_t name)
     return logger_set_level(name, LOG_UNDEFINED, 0);
 }
 
+void logger_set_limits(lstr_t name, unsigned rate, unsigned sampling)
+{
+    log_spin_lock();
+    if (rate == 0 && sampling <= 1) {
+        int pos = qm_del_key(limits, &_G.limits, &name);
+
+        if (pos >= 0) {
+            lstr_wipe(&_G.limits.keys[pos]);
+        }
+    } else {
+        struct limits l = { .rate = rate, .sampling = sampling };
+        uint32_t pos;
+
+        pos = qm_put(limits, &_G.limits, &name, l, QHASH_OVERWRITE);
+        if (!(pos & QHASH_COLLISION)) {
+            _G.limits.keys[pos] = lstr_dup(name);
+        }
+    }
+    log_conf_gen_g += 2;
+    log_spin_unlock();
+}
+
 /* }}} */
 /* Logging {{{ */
 
@@ -708,6 +841,35 @@ void __logger_exit(logger_t *logger, lstr_t file, lstr_t func, int line,
     __logger_vexit(logger, file, func, line, fmt, va);
 }
 
+static bool log_spec_match(const log_trace_spec_t *spec, lstr_t modname,
+                           lstr_t func, lstr_t name)
+{
+    char buf[BUFSIZ];
+
+    if (spec->path) {
+        snprintf(buf, sizeof(buf), "%*pM", LSTR_FMT_ARG(modname));
+        if (fnmatch(spec->path, buf, FNM_PATHNAME) != 0) {
+            return false;
+        }
+    }
+
+    if (spec->func) {
+        snprintf(buf, sizeof(buf), "%*pM", LSTR_FMT_ARG(func));
+        if (fnmatch(spec->func, buf, 0) != 0) {
+            return false;
+        }
+    }
+
+    if (spec->name) {
+        snprintf(buf, sizeof(buf), "%*pM", LSTR_FMT_ARG(name));
+        if (fnmatch(spec->name, buf, FNM_PATHNAME | FNM_LEADING_DIR) != 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 #ifndef NDEBUG
 
 int __logger_is_traced(logger_t *logger, int lvl, lstr_t modname,
@@ -720,32 +882,12 @@ int __logger_is_traced(logger_t *logger, int lvl, lstr_t modname,
 
     for (int i = 0; i < _G.specs.len; i++) {
         log_trace_spec_t *spec = &_G.specs.tab[i];
-        char buf[BUFSIZ];
-
-        if (spec->path) {
-            snprintf(buf, sizeof(buf), "%*pM", LSTR_FMT_ARG(modname));
-            if (fnmatch(spec->path, buf, FNM_PATHNAME) != 0) {
-                continue;
-            }
-        }
 
-        if (spec->func) {
-            snprintf(buf, sizeof(buf), "%*pM", LSTR_FMT_ARG(func));
-            if (fnmatch(spec->func, buf, 0) != 0) {
-                continue;
-            }
-        }
-
-        if (spec->name) {
-            snprintf(buf, sizeof(buf), "%*pM", LSTR_FMT_ARG(name));
-            if (fnmatch(spec->name, buf,
-                        FNM_PATHNAME | FNM_LEADING_DIR) != 0)
-            {
-                continue;
-            }
+        if (spec->level != LOG_UNDEFINED
+        &&  log_spec_match(spec, modname, func, name))
+        {
+            level = spec->level;
         }
-
-        level = spec->level;
     }
 
     return lvl > level ? -1 : 1;
@@ -807,6 +949,513 @@ void __logger_end_fatal(void)
     logger_do_fatal();
 }
 
+/* }}} */
+/* Call sites limits {{{ */
+
+static void log_initialize_thread(void);
+
+static void log_site_add_pending(log_site_t *site, logger_t *logger,
+                                 int level, lstr_t file, lstr_t func,
+                                 int line)
+{
+    if (atomic_load_explicit(&site->pending, memory_order_relaxed)
+    ||  atomic_exchange_explicit(&site->pending, true, memory_order_acquire))
+    {
+        return;
+    }
+    if (!log_thr_g.inited) {
+        log_initialize_thread();
+    }
+    if (!log_thr_g.pending_sites.len) {
+        log_thr_g.pending_sites_flush = lp_getmsec() + LOG_SITES_FLUSH_PERIOD;
+    }
+    qv_append(&log_thr_g.pending_sites, ((log_site_pending_t){
+        .site   = site,
+        .logger = logger,
+        .level  = level,
+        .file   = file,
+        .func   = func,
+        .line   = line,
+    }));
+}
+
+static void log_site_flush_suppressed(log_site_t *site, logger_t *logger,
+                                      int level, lstr_t file, lstr_t func,
+                                      int line)
+{
+    unsigned suppressed;
+
+    suppressed = atomic_exchange_explicit(&site->suppressed, 0,
+                                          memory_order_relaxed);
+    if (suppressed && logger_has_level(logger, level)) {
+        __logger_log(logger, level, LSTR_NULL_V, -1, file, func, line,
+                     "%u similar logs suppressed", suppressed);
+    }
+}
+
+/* Report the suppressed logs of the call sites added by the thread. */
+static void log_sites_flush(void)
+{
+    qv_t(log_site_pending) pending = log_thr_g.pending_sites;
+
+    if (!pending.len) {
+        return;
+    }
+
+    /* Logging the reports may add call sites to the list. */
+    qv_init(&log_thr_g.pending_sites);
+    tab_for_each_ptr(p, &pending) {
+        atomic_store_explicit(&p->site->pending, false,
+                              memory_order_release);
+        log_site_flush_suppressed(p->site, p->logger, p->level, p->file,
+                                  p->func, p->line);
+    }
+    qv_wipe(&pending);
+}
+
+/* Get the limits of the call site for a logger, when some specs set limits.
+ * They are cached in the site for the last logger it was used with. */
+static void log_site_get_spec_limits(log_site_t *site, logger_t *logger,
+                                     lstr_t file, lstr_t func,
+                                     unsigned *rate, unsigned *sampling)
+{
+    uint32_t conf_gen = log_conf_gen_g;
+    bool cached;
+
+    spin_lock(&site->lock);
+    cached = site->logger == logger && site->logger_gen == conf_gen;
+    if (cached) {
+        *rate     = site->rate;
+        *sampling = site->sampling;
+    }
+    spin_unlock(&site->lock);
+    if (cached) {
+        return;
+    }
+
+    *rate     = logger->site_rate;
+    *sampling = logger->site_sampling;
+    log_spin_lock();
+    tab_for_each_ptr(spec, &_G.specs) {
+        if ((spec->rate || spec->sampling)
+        &&  log_spec_match(spec, file, func, logger->full_name))
+        {
+            *rate     = spec->rate;
+            *sampling = spec->sampling;
+        }
+    }
+    log_spin_unlock();
+
+    spin_lock(&site->lock);
+    site->logger_gen = conf_gen;
+    site->logger     = logger;
+    site->rate       = *rate;
+    site->sampling   = *sampling;
+    spin_unlock(&site->lock);
+}
+
+/* Rate limit of the call site, as a virtual scheduling: the site can emit
+ * a burst of rate logs, then one log every 1/rate second. */
+static bool log_site_take_token(log_site_t *site, unsigned rate, int64_t now)
+{
+    uint64_t now_us = now * 1000;
+    uint64_t interval = 1000000 / rate;
+    uint64_t tat = atomic_load_explicit(&site->tat, memory_order_relaxed);
+    uint64_t next;
+
+    do {
+        next = MAX(tat, now_us) + interval;
+        if (next > now_us + 1000000) {
+            return false;
+        }
+    } while (!atomic_compare_exchange_weak_explicit(&site->tat, &tat, next,
+                                                    memory_order_relaxed,
+                                                    memory_order_relaxed));
+    return true;
+}
+
+void __log_site_refresh(log_site_t *site)
+{
+    unsigned site_gen = atomic_load_explicit(&site->conf_gen,
+                                             memory_order_relaxed);
+    uint32_t conf_gen;
+    bool limited;
+    bool by_specs = false;
+
+    /* Another thread may be refreshing the site. */
+    if (site_gen == LOG_SITE_GEN_REFRESHING
+    ||  !atomic_compare_exchange_strong_explicit(&site->conf_gen, &site_gen,
+                                                 LOG_SITE_GEN_REFRESHING,
+                                                 memory_order_acquire,
+                                                 memory_order_relaxed))
+    {
+        return;
+    }
+
+    log_spin_lock();
+    conf_gen = log_conf_gen_g;
+    limited = qm_len(limits, &_G.limits) > 0;
+    tab_for_each_ptr(spec, &_G.specs) {
+        by_specs |= spec->rate || spec->sampling;
+    }
+    log_spin_unlock();
+
+    /* The suppressed logs are still reported by the thread that added the
+     * site to its pending ones. */
+    atomic_store_explicit(&site->limited, limited || by_specs,
+                          memory_order_relaxed);
+    atomic_store_explicit(&site->by_specs, by_specs, memory_order_relaxed);
+    atomic_store_explicit(&site->count, 0, memory_order_relaxed);
+    atomic_store_explicit(&site->tat, 0, memory_order_relaxed);
+    atomic_store_explicit(&site->conf_gen, conf_gen, memory_order_release);
+}
+
+bool __log_site_accept(log_site_t *site, logger_t *logger, int level,
+                       lstr_t file, lstr_t func, int line)
+{
+    unsigned rate = logger->site_rate;
+    unsigned sampling = logger->site_sampling;
+    int64_t now;
+
+    if (level <= LOG_CRIT) {
+        return true;
+    }
+
+    if (atomic_load_explicit(&site->by_specs, memory_order_relaxed)) {
+        log_site_get_spec_limits(site, logger, file, func, &rate, &sampling);
+    }
+    if (!rate && sampling <= 1) {
+        return true;
+    }
+
+    now = lp_getmsec();
+    if (log_thr_g.pending_sites.len
+    &&  now >= log_thr_g.pending_sites_flush)
+    {
+        log_sites_flush();
+    }
+
+    if (sampling > 1
+    &&  atomic_fetch_add_explicit(&site->count, 1,
+                                  memory_order_relaxed) % sampling)
+    {
+        atomic_fetch_add_explicit(&site->suppressed, 1, memory_order_relaxed);
+        log_site_add_pending(site, logger, level, file, func, line);
+        return false;
+    }
+
+    if (rate && !log_site_take_token(site, rate, now)) {
+        atomic_fetch_add_explicit(&site->suppressed, 1, memory_order_relaxed);
+        log_site_add_pending(site, logger, level, file, func, line);
+        return false;
+    }
+
+    if (atomic_load_explicit(&site->suppressed, memory_order_relaxed)) {
+        log_site_flush_suppressed(site, logger, level, file, func, line);
+    }
+    return true;
+}
+
+/* }}} */
+/* Asynchronous mode {{{ */
+
+static const log_record_t *log_ring_peek(log_ring_t *ring)
+{
+    while (ring->cursor != ring->end) {
+        uint32_t off = ring->cursor & (LOG_RING_SIZE - 1);
+        const log_record_t *rec = (const void *)&ring->data[off];
+
+        if (rec->len != LOG_RING_SKIP) {
+            return rec;
+        }
+        ring->cursor += LOG_RING_SIZE - off;
+    }
+    return NULL;
+}
+
+static bool log_ring_push(log_ring_t *ring, const char *data, uint32_t len,
+                          uint32_t size)
+{
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    uint32_t off  = tail & (LOG_RING_SIZE - 1);
+    uint32_t skip = 0;
+    log_record_t *rec;
+
+    /* The records are never split: the end of the ring is skipped when the
+     * record does not fit in it. */
+    if (off + size > LOG_RING_SIZE) {
+        skip = LOG_RING_SIZE - off;
+    }
+    if (tail + skip + size - head > LOG_RING_SIZE) {
+        return false;
+    }
+    if (skip) {
+        ((log_record_t *)&ring->data[off])->len = LOG_RING_SKIP;
+    }
+
+    rec = (log_record_t *)&ring->data[(tail + skip) & (LOG_RING_SIZE - 1)];
+    rec->len = len;
+    rec->seq = atomic_fetch_add_explicit(&_G.async.seq, 1,
+                                         memory_order_relaxed);
+    memcpy(rec->data, data, len);
+    atomic_store_explicit(&ring->tail, tail + skip + size,
+                          memory_order_release);
+    return true;
+}
+
+/* Writes a batch of records of all the rings, merged in the order of their
+ * emission, and returns the number of written records.
+ *
+ * Must be called with _G.async.lock held.
+ */
+static int log_async_drain(void)
+{
+    struct iovec iov[LOG_ASYNC_BATCH + 1];
+    int iovcnt = 0;
+    int count = 0;
+    uint64_t dropped;
+    char notice[64];
+
+    dropped = atomic_load_explicit(&_G.async.dropped, memory_order_relaxed);
+    if (dropped != _G.async.dropped_seen) {
+        int len = snprintf(notice, sizeof(notice),
+                           "log: %ju messages dropped\n",
+                           (uintmax_t)(dropped - _G.async.dropped_seen));
+
+        iov[iovcnt++] = MAKE_IOVEC(notice, len);
+        _G.async.dropped_seen = dropped;
+    }
+
+    dlist_for_each_entry(log_ring_t, ring, &_G.async.rings, list) {
+        ring->cursor = atomic_load_explicit(&ring->head,
+                                            memory_order_relaxed);
+        ring->end    = atomic_load_explicit(&ring->tail,
+                                            memory_order_acquire);
+    }
+
+    while (count < LOG_ASYNC_BATCH) {
+        log_ring_t *best = NULL;
+        const log_record_t *best_rec = NULL;
+
+        dlist_for_each_entry(log_ring_t, ring, &_G.async.rings, list) {
+            const log_record_t *rec = log_ring_peek(ring);
+
+            if (rec && (!best_rec || (int32_t)(rec->seq - best_rec->seq) < 0))
+            {
+                best     = ring;
+                best_rec = rec;
+            }
+        }
+        if (!best) {
+            break;
+        }
+        iov[iovcnt++] = MAKE_IOVEC(best_rec->data, best_rec->len);
+        best->cursor += ROUND_UP(sizeof(log_record_t) + best_rec->len, 8);
+        count++;
+    }
+
+    if (iovcnt) {
+        if (log_stderr_handler_teefd_g >= 0) {
+            struct iovec tee_iov[LOG_ASYNC_BATCH + 1];
+
+            p_copy(tee_iov, iov, iovcnt);
+            IGNORE(xwritev(log_stderr_handler_teefd_g, tee_iov, iovcnt));
+        }
+        IGNORE(xwritev(STDERR_FILENO, iov, iovcnt));
+    }
+
+    dlist_for_each_entry(log_ring_t, ring, &_G.async.rings, list) {
+        atomic_store_explicit(&ring->head, ring->cursor,
+                              memory_order_release);
+
+        /* The rings of the exited threads are freed once they are empty. */
+        if (atomic_load_explicit(&ring->closed, memory_order_acquire)
+        &&  ring->cursor == atomic_load(&ring->tail))
+        {
+            dlist_remove(&ring->list);
+            p_delete(&ring);
+        }
+    }
+
+    return count;
+}
+
+static void log_async_drain_all(void)
+{
+    while (log_async_drain() > 0) {
+    }
+}
+
+void log_async_flush(void)
+{
+    /* Do not wait forever for the lock: this is also called before dying
+     * on a fatal error, which may happen while it is held. */
+    for (int i = 0; pthread_mutex_trylock(&_G.async.lock); i++) {
+        if (i >= 1000) {
+            return;
+        }
+        usleep(1000);
+    }
+    log_async_drain_all();
+    pthread_mutex_unlock(&_G.async.lock);
+}
+
+static void *log_async_writer(void *arg)
+{
+    log_thr_g.is_async_writer = true;
+
+    for (;;) {
+        uint64_t key;
+        int count;
+
+        pthread_mutex_lock(&_G.async.lock);
+        count = log_async_drain();
+        pthread_mutex_unlock(&_G.async.lock);
+        if (count) {
+            continue;
+        }
+
+        key = thr_ec_get(&_G.async.ec);
+        pthread_mutex_lock(&_G.async.lock);
+        count = log_async_drain();
+        pthread_mutex_unlock(&_G.async.lock);
+        if (count) {
+            continue;
+        }
+        if (atomic_load(&_G.async.stopping)) {
+            break;
+        }
+        thr_ec_timedwait(&_G.async.ec, key, 100);
+    }
+
+    return NULL;
+}
+
+/* Pushes a formatted log in the ring of the current thread; returns false if
+ * it must be written synchronously. */
+static bool log_async_push(const char *data, int len)
+{
+    log_ring_t *ring = log_thr_g.ring;
+    uint32_t size = ROUND_UP(sizeof(log_record_t) + len, 8);
+
+    if (size > LOG_RING_SIZE / 4) {
+        return false;
+    }
+    if (unlikely(!ring)) {
+        ring = p_new(log_ring_t, 1);
+        pthread_mutex_lock(&_G.async.lock);
+        dlist_add_tail(&_G.async.rings, &ring->list);
+        pthread_mutex_unlock(&_G.async.lock);
+        log_thr_g.ring = ring;
+    }
+
+    while (!log_ring_push(ring, data, len, size)) {
+        if (_G.async.overflow == LOG_ASYNC_DROP) {
+            atomic_fetch_add_explicit(&_G.async.dropped, 1,
+                                      memory_order_relaxed);
+            break;
+        }
+        if (!atomic_load_explicit(&_G.async.enabled, memory_order_relaxed))
+        {
+            return false;
+        }
+        thr_ec_signal(&_G.async.ec);
+        sched_yield();
+    }
+    thr_ec_signal_relaxed(&_G.async.ec);
+    return true;
+}
+
+static void log_async_close_thread(void)
+{
+    if (log_thr_g.ring) {
+        atomic_store_explicit(&log_thr_g.ring->closed, true,
+                              memory_order_release);
+        log_thr_g.ring = NULL;
+        thr_ec_signal_relaxed(&_G.async.ec);
+    }
+}
+
+static void log_async_wipe_rings(void)
+{
+    dlist_for_each_entry(log_ring_t, ring, &_G.async.rings, list) {
+        dlist_remove(&ring->list);
+        p_delete(&ring);
+    }
+    log_thr_g.ring = NULL;
+}
+
+int log_start_async(log_async_overflow_t overflow)
+{
+    static bool atexit_registered;
+
+    if (atomic_load(&_G.async.enabled)) {
+        _G.async.overflow = overflow;
+        return 0;
+    }
+
+    thr_ec_init(&_G.async.ec);
+    _G.async.overflow = overflow;
+    atomic_store(&_G.async.stopping, false);
+    if (pthread_create(&_G.async.writer, NULL, &log_async_writer, NULL)) {
+        thr_ec_wipe(&_G.async.ec);
+        return -1;
+    }
+    _G.async.writer_started = true;
+
+    /* What was written through stdio must be output before the records. */
+    fflush(stderr);
+    atomic_store(&_G.async.enabled, true);
+
+    if (!atexit_registered) {
+        atexit(&log_async_flush);
+        atexit_registered = true;
+    }
+    return 0;
+}
+
+void log_stop_async(void)
+{
+    if (!_G.async.writer_started) {
+        return;
+    }
+
+    atomic_store(&_G.async.enabled, false);
+    atomic_store(&_G.async.stopping, true);
+    thr_ec_broadcast(&_G.async.ec);
+    pthread_join(_G.async.writer, NULL);
+    _G.async.writer_started = false;
+    thr_ec_wipe(&_G.async.ec);
+
+    log_async_flush();
+}
+
+uint64_t log_async_get_dropped(void)
+{
+    return atomic_load(&_G.async.dropped);
+}
+
+/* Writes a log formatted by the stderr handlers. */
+static void log_stderr_write(const log_ctx_t *ctx, const sb_t *sb)
+{
+    if (atomic_load_explicit(&_G.async.enabled, memory_order_relaxed)
+    &&  !log_thr_g.is_async_writer)
+    {
+        /* The critical logs are written synchronously, after all the
+         * pending records, since the process is probably about to die. */
+        if (ctx->level > LOG_CRIT && log_async_push(sb->data, sb->len)) {
+            return;
+        }
+        log_async_flush();
+    }
+
+    fputs(sb->data, stderr);
+    if (log_stderr_handler_teefd_g >= 0) {
+        IGNORE(xwrite(log_stderr_handler_teefd_g, sb->data, sb->len));
+    }
+}
+
 /* }}} */
 /* Handlers {{{ */
 
@@ -932,20 +1581,17 @@ static void log_stderr_fancy_handler(const log_ctx_t *ctx, const char *fmt,
     sb_addvf(sb, fmt, va);
     sb_adds(sb, TERM_COLOR_RESET "\n");
 
-    fputs(sb->data, stderr);
-    if (log_stderr_handler_teefd_g >= 0) {
-        IGNORE(xwrite(log_stderr_handler_teefd_g, sb->data, sb->len));
-    }
+    log_stderr_write(ctx, sb);
     sb_reset(sb);
 }
 
-static void log_initialize_thread(void);
-
 __attr_printf__(2, 0)
 static void log_stderr_raw_handler(const log_ctx_t *ctx, const char *fmt,
                                    va_list va)
 {
     static char const *prefixes[] = {
+        [LOG_EMERG]    = "fatal: ",
+        [LOG_ALERT]    = "fatal: ",
         [LOG_CRIT]     = "fatal: ",
         [LOG_ERR]      = "error: ",
         [LOG_WARNING]  = "warn:  ",
@@ -978,10 +1624,7 @@ static void log_stderr_raw_handler(const log_ctx_t *ctx, const char *fmt,
     sb_addvf(sb, fmt, va);
     sb_addc(sb, '\n');
 
-    fputs(sb->data, stderr);
-    if (log_stderr_handler_teefd_g >= 0) {
-        IGNORE(xwrite(log_stderr_handler_teefd_g, sb->data, sb->len));
-    }
+    log_stderr_write(ctx, sb);
     sb_reset(sb);
 }
 
@@ -1142,6 +1785,7 @@ static void log_initialize_thread(void)
                             MEM_DISABLE_POOL_LEAK_DETECTION);
 
         qv_init(&log_thr_g.vec_buff_stack);
+        qv_init(&log_thr_g.pending_sites);
 
         log_thr_g.inited = true;
     }
@@ -1149,11 +1793,16 @@ static void log_initialize_thread(void)
 
 static void log_shutdown_thread(void)
 {
+    if (log_thr_g.inited) {
+        log_sites_flush();
+    }
+    log_async_close_thread();
     if (log_thr_g.inited) {
         sb_wipe(&log_thr_g.buf);
         sb_wipe(&log_thr_g.log);
 
         qv_deep_wipe(&log_thr_g.vec_buff_stack, buffer_instance_wipe);
+        qv_wipe(&log_thr_g.pending_sites);
         mem_stack_pool_wipe(&log_thr_g.mp_stack);
 
         log_thr_g.inited = false;
@@ -1164,6 +1813,15 @@ thr_hooks(log_initialize_thread, log_shutdown_thread);
 static void log_atfork(void)
 {
     _G.pid = getpid();
+
+    /* The writer thread does not exist in the child, and the records of the
+     * parent are written by the parent. */
+    if (_G.async.writer_started) {
+        atomic_store(&_G.async.enabled, false);
+        _G.async.writer_started = false;
+        pthread_mutex_init(&_G.async.lock, NULL);
+        log_async_wipe_rings();
+    }
 }
 
 /** Parse the content of the IS_DEBUG environment variable.
@@ -1171,6 +1829,11 @@ static void log_atfork(void)
  * It is composed of a series of blank separated <specs>:
  *
  *  <specs> ::= [<path-pattern>][@<funcname>][+<featurename>][:<level>]
+ *              [%<sampling>][#<rate>]
+ *
+ * The sampling and rate set the limits of the matching call sites (see
+ * logger_set_limits()); a spec that only sets limits does not change the
+ * levels.
  */
 void log_parse_specs(char *p, qv_t(spec) *out)
 {
@@ -1179,7 +1842,7 @@ void log_parse_specs(char *p, qv_t(spec) *out)
 
     ps_trim(&ps);
 
-    ctype_desc_build(&ctype, "@+:");
+    ctype_desc_build(&ctype, "@+:%#");
 
     while (!ps_done(&ps)) {
         log_trace_spec_t spec = {
@@ -1188,6 +1851,7 @@ void log_parse_specs(char *p, qv_t(spec) *out)
             .name = NULL,
             .level = INT_MAX,
         };
+        bool has_level = false;
         pstream_t spec_ps;
         int c = '\0';
 
@@ -1220,9 +1884,31 @@ void log_parse_specs(char *p, qv_t(spec) *out)
             if (level) {
                 spec.level = LOG_TRACE + atoi(level);
             }
+            has_level = true;
+        }
+        if (c == '%') {
+            const char *sampling = NULL;
+
+            GET_ELEM(sampling);
+            if (sampling) {
+                spec.sampling = MAX(atoi(sampling), 0);
+            }
+        }
+        if (c == '#') {
+            const char *rate = NULL;
+
+            GET_ELEM(rate);
+            if (rate) {
+                spec.rate = MAX(atoi(rate), 0);
+            }
         }
 #undef GET_ELEM
 
+        if (!has_level && (spec.rate || spec.sampling)) {
+            /* The spec only sets limits. */
+            spec.level = LOG_UNDEFINED;
+        }
+
         qv_append(out, spec);
     }
 }
@@ -1254,10 +1940,12 @@ static int log_initialize(void* args)
 
     if ((env = getenv("IS_DEBUG"))) {
         _G.is_debug = p_strdup(env);
+        log_spin_lock();
         log_parse_specs(_G.is_debug, &_G.specs);
+        log_spin_unlock();
 
         tab_for_each_ptr(spec, &_G.specs) {
-            if (!spec->func && !spec->path) {
+            if (!spec->func && !spec->path && spec->level != LOG_UNDEFINED) {
                 logger_set_level(LSTR_OPT(spec->name), spec->level, 0);
             }
         }
@@ -1267,14 +1955,28 @@ static int log_initialize(void* args)
         _G.log_timestamp = *env && atoi(env) > 0;
     }
 
+    if ((env = getenv("IS_LOG_ASYNC")) && *env) {
+        if (strequal(env, "block")) {
+            log_start_async(LOG_ASYNC_BLOCK);
+        } else
+        if (strequal(env, "drop") || atoi(env) > 0) {
+            log_start_async(LOG_ASYNC_DROP);
+        }
+    }
+
     return 0;
 }
 
 static int log_shutdown(void)
 {
+    log_stop_async();
+    log_async_wipe_rings();
     logger_wipe(&_G.root_logger);
     qm_deep_wipe(level, &_G.pending_levels, lstr_wipe, IGNORE);
+    qm_deep_wipe(limits, &_G.limits, lstr_wipe, IGNORE);
+    log_spin_lock();
     qv_wipe(&_G.specs);
+    log_spin_unlock();
     p_delete(&_G.is_debug);
     return 0;
 }
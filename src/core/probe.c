@@ -0,0 +1,470 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2026 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#include <math.h>
+
+#include <lib-common/el.h>
+#include <lib-common/log.h>
+#include <lib-common/probe.h>
+#include <lib-common/str-buf-pp.h>
+#include <lib-common/thr.h>
+
+/* {{{ Types */
+
+/* Maximum number of probes; the probes observed once it is reached are
+ * ignored. */
+#define PROBE_MAX  256
+
+/* Histogram of a probe in a thread.
+ *
+ * It is only written by its thread, so the counters are updated with
+ * relaxed loads and stores instead of atomic read-modify-writes: they are
+ * atomic only so that they can be read by the other threads.
+ */
+typedef struct probe_thr_histo_t {
+    atomic_uint_least64_t count;
+    atomic_uint_least64_t sum;
+    atomic_uint_least64_t max;
+    atomic_uint_least64_t buckets[PROBE_NB_BUCKETS];
+} probe_thr_histo_t;
+typedef _Atomic(probe_thr_histo_t *) probe_thr_histo_ptr_t;
+
+typedef struct probe_shard_t {
+    dlist_t link;
+
+    /* Histograms of the thread, indexed by probe id, allocated at the first
+     * observation of the probe in the thread. */
+    probe_thr_histo_ptr_t histos[PROBE_MAX];
+} probe_shard_t;
+
+bool probes_enabled_g;
+static __thread probe_shard_t *probe_shard_g;
+
+static struct {
+    logger_t logger;
+
+    /* Protects probes, retired and shards. */
+    spinlock_t lock;
+
+    /* Registered probes, indexed by id (the id 0 is not used). The probes
+     * are static objects, so they stay registered when the module is
+     * reloaded. */
+    probe_t *probes[PROBE_MAX];
+    int nb_probes;
+
+    /* Histograms of the threads that exited. */
+    probe_histo_t *retired[PROBE_MAX];
+
+    dlist_t shards;
+
+    /* Calibration of the timestamp counter. */
+    uint64_t ref_tsc;
+    int64_t  ref_ns;
+    double   ns_per_tick;
+} probe_g = {
+#define _G  probe_g
+    .logger = LOGGER_INIT_INHERITS(NULL, "probe"),
+    .nb_probes = 1,
+    .shards = DLIST_INIT(probe_g.shards),
+};
+
+/* }}} */
+/* {{{ Histograms */
+
+uint64_t probe_histo_bucket_max(int bucket)
+{
+    int shift;
+    uint64_t sub;
+
+    if (bucket < PROBE_SUB_BUCKETS) {
+        return bucket;
+    }
+    if (bucket == PROBE_NB_BUCKETS - 1) {
+        return UINT64_MAX;
+    }
+    shift = bucket / PROBE_SUB_BUCKETS - 1;
+    sub   = bucket % PROBE_SUB_BUCKETS + PROBE_SUB_BUCKETS;
+    return ((sub + 1) << shift) - 1;
+}
+
+uint64_t probe_histo_percentile(const probe_histo_t *histo, double q)
+{
+    uint64_t rank;
+    uint64_t seen = 0;
+
+    if (!histo->count) {
+        return 0;
+    }
+    rank = MAX(ceil(q * histo->count), 1);
+    carray_for_each_pos(i, histo->buckets) {
+        seen += histo->buckets[i];
+        if (seen >= rank) {
+            return MIN(probe_histo_bucket_max(i), histo->max);
+        }
+    }
+    return histo->max;
+}
+
+static ALWAYS_INLINE void probe_counter_add(atomic_uint_least64_t *counter,
+                                            uint64_t value)
+{
+    atomic_store_explicit(counter,
+                          atomic_load_explicit(counter, memory_order_relaxed)
+                          + value, memory_order_relaxed);
+}
+
+static ALWAYS_INLINE void
+probe_thr_histo_observe(probe_thr_histo_t *histo, uint64_t ticks)
+{
+    probe_counter_add(&histo->count, 1);
+    probe_counter_add(&histo->sum, ticks);
+    probe_counter_add(&histo->buckets[probe_histo_bucket(ticks)], 1);
+    if (ticks > atomic_load_explicit(&histo->max, memory_order_relaxed)) {
+        atomic_store_explicit(&histo->max, ticks, memory_order_relaxed);
+    }
+}
+
+static void probe_histo_add(probe_histo_t *dst, const probe_histo_t *src)
+{
+    dst->count += src->count;
+    dst->sum   += src->sum;
+    dst->max    = MAX(dst->max, src->max);
+    carray_for_each_pos(i, dst->buckets) {
+        dst->buckets[i] += src->buckets[i];
+    }
+}
+
+static void probe_histo_add_thr(probe_histo_t *dst,
+                                const probe_thr_histo_t *src)
+{
+#define LOAD(_counter)  \
+    atomic_load_explicit(&(_counter), memory_order_relaxed)
+    dst->count += LOAD(src->count);
+    dst->sum   += LOAD(src->sum);
+    dst->max    = MAX(dst->max, LOAD(src->max));
+    carray_for_each_pos(i, dst->buckets) {
+        dst->buckets[i] += LOAD(src->buckets[i]);
+    }
+#undef LOAD
+}
+
+static void probe_thr_histo_reset(probe_thr_histo_t *histo)
+{
+#define RESET(_counter)  \
+    atomic_store_explicit(&(_counter), 0, memory_order_relaxed)
+    RESET(histo->count);
+    RESET(histo->sum);
+    RESET(histo->max);
+    carray_for_each_pos(i, histo->buckets) {
+        RESET(histo->buckets[i]);
+    }
+#undef RESET
+}
+
+static int64_t probe_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+double probe_ns_per_tick(void)
+{
+    int64_t ns;
+    uint64_t tsc;
+
+    if (_G.ns_per_tick) {
+        return _G.ns_per_tick;
+    }
+
+    /* Measure the frequency of the counter against the monotonic clock
+     * since the loading of the module: it is precise enough after 10ms, and
+     * frozen after one second. */
+    do {
+        ns  = probe_now_ns();
+        tsc = probe_tsc();
+    } while (ns - _G.ref_ns < 10 * 1000 * 1000);
+
+    if (ns - _G.ref_ns >= 1000 * 1000 * 1000) {
+        _G.ns_per_tick = (double)(ns - _G.ref_ns) / (tsc - _G.ref_tsc);
+        return _G.ns_per_tick;
+    }
+    return (double)(ns - _G.ref_ns) / (tsc - _G.ref_tsc);
+}
+
+/* }}} */
+/* {{{ Recording */
+
+static probe_shard_t *probe_shard_get(void)
+{
+    probe_shard_t *shard = probe_shard_g;
+
+    if (likely(shard)) {
+        return shard;
+    }
+
+    shard = p_new(probe_shard_t, 1);
+
+    spin_lock(&_G.lock);
+    dlist_add_tail(&_G.shards, &shard->link);
+    spin_unlock(&_G.lock);
+
+    return probe_shard_g = shard;
+}
+
+static void probe_thr_exit(void)
+{
+    probe_shard_t *shard = probe_shard_g;
+
+    if (!shard) {
+        return;
+    }
+
+    /* Keep the histograms of the thread, so that they are not lost for the
+     * next readings. */
+    spin_lock(&_G.lock);
+    carray_for_each_pos(id, shard->histos) {
+        probe_thr_histo_t *histo;
+
+        histo = atomic_load_explicit(&shard->histos[id],
+                                     memory_order_relaxed);
+        if (!histo) {
+            continue;
+        }
+        if (!_G.retired[id]) {
+            _G.retired[id] = p_new(probe_histo_t, 1);
+        }
+        probe_histo_add_thr(_G.retired[id], histo);
+        p_delete(&histo);
+    }
+    dlist_remove(&shard->link);
+    spin_unlock(&_G.lock);
+
+    p_delete(&probe_shard_g);
+}
+thr_hooks(NULL, probe_thr_exit);
+
+static int probe_register(probe_t *probe)
+{
+    int id;
+
+    spin_lock(&_G.lock);
+    id = atomic_load_explicit(&probe->id, memory_order_relaxed);
+    if (!id) {
+        if (_G.nb_probes < PROBE_MAX) {
+            id = _G.nb_probes++;
+            _G.probes[id] = probe;
+        } else {
+            logger_warning(&_G.logger, "too many probes, probe `%s` is "
+                           "ignored", probe->name);
+            id = PROBE_MAX;
+        }
+        atomic_store_explicit(&probe->id, id, memory_order_relaxed);
+    }
+    spin_unlock(&_G.lock);
+
+    return id;
+}
+
+void __probe_observe(probe_t *probe, uint64_t ticks)
+{
+    int id = atomic_load_explicit(&probe->id, memory_order_relaxed);
+    probe_shard_t *shard;
+    probe_thr_histo_t *histo;
+
+    if (unlikely(!probes_enabled_g)) {
+        /* The module was released since the start of the probe. */
+        return;
+    }
+    if (unlikely(!id)) {
+        id = probe_register(probe);
+    }
+    if (unlikely(id >= PROBE_MAX)) {
+        return;
+    }
+
+    shard = probe_shard_get();
+    histo = atomic_load_explicit(&shard->histos[id], memory_order_relaxed);
+    if (unlikely(!histo)) {
+        histo = p_new(probe_thr_histo_t, 1);
+        atomic_store_explicit(&shard->histos[id], histo,
+                              memory_order_release);
+    }
+    probe_thr_histo_observe(histo, ticks);
+}
+
+/* }}} */
+/* {{{ Reading */
+
+void probes_get_stats(qv_t(probe_stats) *stats)
+{
+    int start = stats->len;
+
+    spin_lock(&_G.lock);
+
+    for (int id = 1; id < _G.nb_probes; id++) {
+        probe_stats_t *st = qv_growlen0(stats, 1);
+
+        st->probe = _G.probes[id];
+        if (_G.retired[id]) {
+            probe_histo_add(&st->histo, _G.retired[id]);
+        }
+        dlist_for_each_entry(probe_shard_t, shard, &_G.shards, link) {
+            probe_thr_histo_t *histo;
+
+            histo = atomic_load_explicit(&shard->histos[id],
+                                         memory_order_acquire);
+            if (histo) {
+                probe_histo_add_thr(&st->histo, histo);
+            }
+        }
+        if (!st->histo.count) {
+            qv_shrink(stats, 1);
+        }
+    }
+
+    spin_unlock(&_G.lock);
+
+    /* The histograms are read while being written, so the total count can
+     * be slightly off the sum of the buckets: fix it. */
+    for (int i = start; i < stats->len; i++) {
+        probe_histo_t *histo = &stats->tab[i].histo;
+
+        histo->count = 0;
+        carray_for_each_entry(nb, histo->buckets) {
+            histo->count += nb;
+        }
+    }
+}
+
+void probes_get_state(sb_t *buf)
+{
+    t_scope;
+    qv_t(probe_stats) stats;
+    qv_t(table_hdr) hdr;
+    qv_t(table_data) rows;
+    table_hdr_t hdr_data[] = { {
+            .title = LSTR_IMMED("PROBE"),
+        }, {
+            .title = LSTR_IMMED("COUNT"),
+            .align = ALIGN_RIGHT,
+        }, {
+            .title = LSTR_IMMED("MEAN (us)"),
+            .align = ALIGN_RIGHT,
+        }, {
+            .title = LSTR_IMMED("P50 (us)"),
+            .align = ALIGN_RIGHT,
+        }, {
+            .title = LSTR_IMMED("P90 (us)"),
+            .align = ALIGN_RIGHT,
+        }, {
+            .title = LSTR_IMMED("P99 (us)"),
+            .align = ALIGN_RIGHT,
+        }, {
+            .title = LSTR_IMMED("P99.9 (us)"),
+            .align = ALIGN_RIGHT,
+        }, {
+            .title = LSTR_IMMED("MAX (us)"),
+            .align = ALIGN_RIGHT,
+        }
+    };
+    uint32_t hdr_size = countof(hdr_data);
+    double us_per_tick = probe_ns_per_tick() / 1000.;
+
+    qv_init(&stats);
+    probes_get_stats(&stats);
+
+    qv_init_static(&hdr, hdr_data, hdr_size);
+    t_qv_init(&rows, stats.len);
+
+#define ADD_TICKS_FIELD(_ticks)  \
+    qv_append(tab, t_lstr_fmt("%.1f", (_ticks) * us_per_tick))
+
+    tab_for_each_ptr(st, &stats) {
+        const probe_histo_t *histo = &st->histo;
+        qv_t(lstr) *tab = qv_growlen(&rows, 1);
+
+        t_qv_init(tab, hdr_size);
+        qv_append(tab, LSTR(st->probe->name));
+        qv_append(tab, t_lstr_fmt("%ju", histo->count));
+        ADD_TICKS_FIELD((double)histo->sum / histo->count);
+        ADD_TICKS_FIELD(probe_histo_percentile(histo, .5));
+        ADD_TICKS_FIELD(probe_histo_percentile(histo, .9));
+        ADD_TICKS_FIELD(probe_histo_percentile(histo, .99));
+        ADD_TICKS_FIELD(probe_histo_percentile(histo, .999));
+        ADD_TICKS_FIELD(histo->max);
+    }
+#undef ADD_TICKS_FIELD
+
+    sb_add_table(buf, &hdr, &rows);
+    sb_shrink(buf, 1);
+    qv_wipe(&stats);
+}
+
+static void probe_print_state(void)
+{
+    SB_1k(buf);
+
+    probes_get_state(&buf);
+    logger_notice(&_G.logger, "probes summary:\n%*pM", SB_FMT_ARG(&buf));
+}
+
+/* }}} */
+/* {{{ Module */
+
+static int probe_initialize(void *arg)
+{
+    _G.ref_ns  = probe_now_ns();
+    _G.ref_tsc = probe_tsc();
+    _G.ns_per_tick = 0;
+    probes_enabled_g = true;
+    return 0;
+}
+
+static int probe_shutdown(void)
+{
+    probes_enabled_g = false;
+
+    /* The histograms of the threads belong to them and are only released
+     * when they exit, so just reset them. */
+    spin_lock(&_G.lock);
+    dlist_for_each_entry(probe_shard_t, shard, &_G.shards, link) {
+        carray_for_each_pos(id, shard->histos) {
+            probe_thr_histo_t *histo;
+
+            histo = atomic_load_explicit(&shard->histos[id],
+                                         memory_order_relaxed);
+            if (histo) {
+                probe_thr_histo_reset(histo);
+            }
+        }
+    }
+    carray_for_each_pos(id, _G.retired) {
+        p_delete(&_G.retired[id]);
+    }
+    spin_unlock(&_G.lock);
+
+    return 0;
+}
+
+MODULE_BEGIN(probe)
+    MODULE_IMPLEMENTS_VOID(print_state, &probe_print_state);
+MODULE_END()
+
+/* }}} */
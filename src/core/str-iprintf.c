@@ -17,7 +17,9 @@
 /***************************************************************************/
 
 #include <endian.h>
+#include <link.h>
 #include <lib-common/core.h>
+#include <lib-common/thr.h>
 
 /* This code only works on regular architectures: we assume
  *  - integer types are either 32 bit or 64 bit long.
@@ -43,6 +45,8 @@
 
 #define FLAG_WIDTH      0x0080
 #define FLAG_PREC       0x0100
+#define FLAG_WIDTH_ARG  0x0200
+#define FLAG_PREC_ARG   0x0400
 
 #define TYPE_int        0
 #define TYPE_char       1
@@ -163,17 +167,43 @@ static ALWAYS_INLINE void do_alpha_shift(char *lp, const char *end, int flags)
     }
 }
 
+/* The decimal conversions emit two digits per division. */
+static const char digit_pairs_g[200] = {
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899"
+};
+
+static ALWAYS_INLINE char *convert_digit_pair(char *p, unsigned int value)
+{
+    p -= 2;
+    memcpy(p, &digit_pairs_g[2 * value], 2);
+    return p;
+}
+
+/* Always emit at least one digit, even for 0. */
+static ALWAYS_INLINE char *convert_uint10(char *p, unsigned int value)
+{
+    while (value >= 100) {
+        p = convert_digit_pair(p, value % 100);
+        value /= 100;
+    }
+    if (value >= 10) {
+        return convert_digit_pair(p, value);
+    }
+    *--p = '0' + value;
+    return p;
+}
+
 static ALWAYS_INLINE char *convert_int10(char *p, int value)
 {
     /* compute absolute value without tests */
     unsigned int bits = value >> (bitsizeof(int) - 1);
     unsigned int num = (value ^ bits) + (bits & 1);
 
-    while (num >= 10) {
-        *--p = '0' + (num % 10);
-        num = num / 10;
-    }
-    *--p = '0' + num;
+    p = convert_uint10(p, num);
     if (value < 0) {
         *--p = '-';
     }
@@ -184,10 +214,7 @@ static ALWAYS_INLINE
 char *convert_uint(char *p, unsigned int value, int base)
 {
     if (base == 10) {
-        while (value > 0) {
-            *--p = '0' + (value % 10);
-            value = value / 10;
-        }
+        return value ? convert_uint10(p, value) : p;
     } else
     if (base == 16) {
         while (value > 0) {
@@ -206,13 +233,10 @@ char *convert_uint(char *p, unsigned int value, int base)
 static ALWAYS_INLINE char *
 convert_uint_10_8_0(char *p, unsigned int value)
 {
-    int i;
-
-    for (i = 7; i-- > 0; ) {
-        *--p = '0' + (value % 10);
-        value /= 10;
+    for (int i = 0; i < 4; i++) {
+        p = convert_digit_pair(p, value % 100);
+        value /= 100;
     }
-    *--p = '0' + value;
     return p;
 }
 
@@ -515,12 +539,17 @@ static struct formatter_t put_memory_fmt_g[256] = {
     ['H'] = { { .raw_formatter = &fmt_output_uint_hex_up }, .is_raw = true },
 };
 
+/* Number of formatters being run by the thread: the formats they output
+ * must not replace the compiled formats still used by the callers. */
+static __thread int fmt_formatter_depth_g;
+
 static ALWAYS_INLINE
 ssize_t fmt_output_chunk(FILE *stream, char *str, size_t size,
                          size_t count, const char *lp, size_t len,
                          int modifier)
 {
     const struct formatter_t *format;
+    ssize_t res;
     size_t out_len;
 
     size = count >= size ? 0 : size - count - 1;
@@ -531,25 +560,413 @@ ssize_t fmt_output_chunk(FILE *stream, char *str, size_t size,
     } else {
         format = &put_memory_fmt_g[(unsigned char)modifier];
 
+        fmt_formatter_depth_g++;
         if (format->is_raw) {
             if (!expect(format->raw_formatter)) {
-                return -1;
+                res = -1;
+            } else {
+                res = (*format->raw_formatter)(modifier, lp, len, stream,
+                                               str, size);
             }
-
-            out_len = RETHROW((*format->raw_formatter)(modifier, lp, len,
-                                                       stream, str, size));
         } else {
             if (!expect(format->ptr_formatter)) {
-                return -1;
+                res = -1;
+            } else {
+                res = (*format->ptr_formatter)(modifier, lp, stream, str,
+                                               size);
             }
-            out_len = RETHROW((*format->ptr_formatter)(modifier, lp, stream,
-                                                       str, size));
         }
+        fmt_formatter_depth_g--;
+        out_len = RETHROW(res);
     }
 
     return count + out_len;
 }
 
+/*---------------- conversions parsing ----------------*/
+
+enum {
+    FMT_OP_END,         /* end of a compiled format */
+    FMT_OP_ERROR,       /* truncated conversion */
+    FMT_OP_INT10,       /* naked %d */
+    FMT_OP_STR,         /* naked %s */
+    FMT_OP_STRN,        /* %.*s */
+    FMT_OP_RAW,         /* %*p? with a registered formatter */
+    FMT_OP_PTR,         /* %p? with a registered pointer formatter */
+    FMT_OP_CONV,        /* general case */
+};
+
+/* A conversion of a format, with the length of the literal text that
+ * precedes it.
+ */
+typedef struct fmt_op_t {
+    int      lit_len;
+    uint16_t spec_len;      /* length of the conversion, '%' excluded */
+    uint8_t  kind;
+    uint8_t  c;             /* conversion character, or modifier */
+    uint16_t flags;
+    uint8_t  type_flags;
+    int      width;
+    int      prec;
+} fmt_op_t;
+
+/* Parse the conversion that starts after a '%', and return the end of the
+ * conversion. The widths and precisions given as arguments are flagged
+ * with FLAG_WIDTH_ARG and FLAG_PREC_ARG, as the arguments are only fetched
+ * by fmt_output.
+ */
+static ALWAYS_INLINE
+const char *fmt_parse_op(const char *format, fmt_op_t *op)
+{
+    op->flags = 0;
+    op->type_flags = 0;
+    op->width = 0;
+    op->prec = 1;
+
+    /* special case naked %d and %s formats */
+    if (*format == 'd') {
+        op->kind = FMT_OP_INT10;
+        return format + 1;
+    }
+    if (*format == 's') {
+        op->kind = FMT_OP_STR;
+        return format + 1;
+    }
+    /* also special case %.*s */
+    if (format[0] == '.' && format[1] == '*' && format[2] == 's') {
+        op->kind = FMT_OP_STRN;
+        return format + 3;
+    }
+
+    /* also special case %*p?, where '?' is a registered modifier. We
+     * natively support %*pM for "put memory content here"
+     * and %*pX for "put hexadecimal content here".
+     */
+    if (format[0] == '*' && format[1] == 'p'
+    &&  put_memory_fmt_g[(unsigned char)format[2]].is_raw
+    &&  put_memory_fmt_g[(unsigned char)format[2]].raw_formatter)
+    {
+        /* XXX No "trailing garbage" consumption: we support only single
+         *     character modifiers for now.
+         */
+        op->kind = FMT_OP_RAW;
+        op->c = format[2];
+        return format + 3;
+    } else
+    if (format[0] == 'p'
+    &&  !put_memory_fmt_g[(unsigned char)format[1]].is_raw
+    &&  put_memory_fmt_g[(unsigned char)format[1]].ptr_formatter)
+    {
+        op->kind = FMT_OP_PTR;
+        op->c = format[1];
+        return format + 2;
+    }
+
+    /* general case: parse complete format syntax */
+    op->kind = FMT_OP_CONV;
+
+    /* parse optional flags */
+    for (;; format++) {
+        switch (*format) {
+        case '\0': goto error;
+        case '-':  op->flags |= FLAG_MINUS;  continue;
+        case '+':  op->flags |= FLAG_PLUS;   continue;
+        case '#':  op->flags |= FLAG_ALT;    continue;
+        case '\'': op->flags |= FLAG_QUOTE;  continue;
+        case ' ':  op->flags |= FLAG_SPACE;  continue;
+        case '0':  op->flags |= FLAG_ZERO;   continue;
+                   /* locale's alternative output digits */
+        case 'I':  /* ignore this shit */;   continue;
+        }
+        break;
+    }
+
+    /* parse optional width */
+    if (*format == '*') {
+        format++;
+        op->flags |= FLAG_WIDTH | FLAG_WIDTH_ARG;
+    } else
+    if (*format >= '1' && *format <= '9') {
+        op->flags |= FLAG_WIDTH;
+        op->width = *format++ - '0';
+        while (*format >= '0' && *format <= '9') {
+            op->width = op->width * 10 + *format++ - '0';
+        }
+    }
+
+    /* parse optional precision */
+    if (*format == '.') {
+        format++;
+        op->prec = 0;
+        //op->flags &= ~FLAG_ZERO;
+        op->flags |= FLAG_PREC;
+        if (*format == '*') {
+            format++;
+            op->flags |= FLAG_PREC_ARG;
+        } else
+        if (*format >= '0' && *format <= '9') {
+            op->prec = *format++ - '0';
+            while (*format >= '0' && *format <= '9') {
+                op->prec = op->prec * 10 + *format++ - '0';
+            }
+        }
+    }
+
+    /* parse optional format modifiers */
+    switch (*format) {
+    case '\0':
+        goto error;
+    case 'l':
+        if (format[1] == 'l') {
+            format++;
+            op->type_flags |= TYPE_llong;
+        } else {
+            op->type_flags |= TYPE_long;
+        }
+        format++;
+        break;
+    case 'h':
+        if (format[1] == 'h') {
+            format++;
+            op->type_flags |= TYPE_char;
+        } else {
+            op->type_flags |= TYPE_short;
+        }
+        format++;
+        break;
+    case 'j':
+        op->type_flags |= TYPE_intmax_t;
+        format++;
+        break;
+    case 'z':
+        op->type_flags |= TYPE_size_t;
+        format++;
+        break;
+    case 't':
+        op->type_flags |= TYPE_ptrdiff_t;
+        format++;
+        break;
+    case 'L':
+        op->type_flags |= TYPE_ldouble;
+        format++;
+        break;
+    }
+
+    /* actual format character */
+    switch (op->c = *format) {
+    case '\0':
+        goto error;
+
+    case 'p':
+    case 'P':
+        format++;
+        if (unlikely(isalnum((unsigned char)*format))) {
+            /* XXX Reserve each %[*]p[0-9a-zA-Z]+ format for our own usage
+             */
+            e_trace(0, "trailing garbage after %%p format");
+            do { format++; } while (isalnum((unsigned char)*format));
+        }
+        return format;
+
+    default:
+        return format + 1;
+    }
+
+  error:
+    op->kind = FMT_OP_ERROR;
+    return format;
+}
+
+
+/*---------------- compiled formats ----------------*/
+
+/* Parsing the conversions is a large part of the cost of the short
+ * formats, so the formats are compiled into their list of conversions on
+ * their first use, and the lists are kept in a small per-thread cache keyed
+ * by the address of the format.
+ *
+ * The address is only a sound key if the format cannot change: only the
+ * formats located in the read-only segments of the objects loaded at
+ * startup (that is the string literals) are compiled. The other formats are
+ * parsed at each call.
+ */
+
+#define FMT_CACHE_SIZE     64
+#define FMT_CACHE_MAX_OPS  32
+#define FMT_RO_RANGES_MAX  128
+
+typedef struct fmt_cache_entry_t {
+    const char *format;
+    int gen;
+    fmt_op_t *ops;
+} fmt_cache_entry_t;
+
+static struct {
+    uintptr_t start;
+    uintptr_t end;
+} fmt_ro_ranges_g[FMT_RO_RANGES_MAX];
+static int fmt_ro_ranges_len_g;
+
+/* Bumped when a formatter is registered, as it changes the parsing of the
+ * formats.
+ */
+static atomic_int fmt_gen_g = 1;
+
+static __thread fmt_cache_entry_t *fmt_cache_g;
+
+static int fmt_ro_ranges_add(struct dl_phdr_info *info, size_t size,
+                             void *priv)
+{
+    for (int i = 0; i < info->dlpi_phnum; i++) {
+        const ElfW(Phdr) *phdr = &info->dlpi_phdr[i];
+        uintptr_t start;
+        int pos;
+
+        if (phdr->p_type != PT_LOAD || (phdr->p_flags & PF_W)) {
+            continue;
+        }
+        if (fmt_ro_ranges_len_g >= FMT_RO_RANGES_MAX) {
+            return 1;
+        }
+
+        /* keep the ranges sorted */
+        start = info->dlpi_addr + phdr->p_vaddr;
+        for (pos = fmt_ro_ranges_len_g;
+             pos > 0 && fmt_ro_ranges_g[pos - 1].start > start; pos--)
+        {
+            fmt_ro_ranges_g[pos] = fmt_ro_ranges_g[pos - 1];
+        }
+        fmt_ro_ranges_g[pos].start = start;
+        fmt_ro_ranges_g[pos].end = start + phdr->p_memsz;
+        fmt_ro_ranges_len_g++;
+    }
+    return 0;
+}
+
+__attribute__((constructor))
+static void fmt_ro_ranges_initialize(void)
+{
+    dl_iterate_phdr(&fmt_ro_ranges_add, NULL);
+}
+
+static bool fmt_is_read_only(const char *format)
+{
+    uintptr_t addr = (uintptr_t)format;
+    int l = 0;
+    int r = fmt_ro_ranges_len_g;
+
+    /* fast path for the formats built on the stack */
+    if (r == 0 || addr >= fmt_ro_ranges_g[r - 1].end) {
+        return false;
+    }
+    while (l < r) {
+        int i = (l + r) / 2;
+
+        if (addr < fmt_ro_ranges_g[i].start) {
+            r = i;
+        } else
+        if (addr >= fmt_ro_ranges_g[i].end) {
+            l = i + 1;
+        } else {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool iprintf_fmt_is_read_only(const char *fmt)
+{
+    return fmt_is_read_only(fmt);
+}
+
+/* Compile a format in at most FMT_CACHE_MAX_OPS ops, the last one being a
+ * FMT_OP_END holding the trailing literal text.
+ */
+static int fmt_compile(const char *format, fmt_op_t *ops)
+{
+    for (int i = 0; i < FMT_CACHE_MAX_OPS; i++) {
+        fmt_op_t *op = &ops[i];
+        const char *lp = format;
+        const char *spec;
+
+        while (*format && *format != '%') {
+            format++;
+        }
+        op->lit_len = format - lp;
+        if (!*format) {
+            op->kind = FMT_OP_END;
+            return 0;
+        }
+
+        spec = ++format;
+        format = fmt_parse_op(format, op);
+        if (op->kind == FMT_OP_ERROR || format - spec > UINT16_MAX) {
+            return -1;
+        }
+        op->spec_len = format - spec;
+    }
+    return -1;
+}
+
+static ALWAYS_INLINE fmt_cache_entry_t *fmt_cache_slot(const char *format)
+{
+    uintptr_t addr = (uintptr_t)format;
+
+    return &fmt_cache_g[((addr >> 3) ^ (addr >> 9)) % FMT_CACHE_SIZE];
+}
+
+static NEVER_INLINE const fmt_op_t *fmt_cache_fill(const char *format,
+                                                   int gen)
+{
+    fmt_cache_entry_t *entry;
+
+    /* The formats output by a formatter are parsed at each call, as they
+     * could replace the compiled format of a caller. */
+    if (fmt_formatter_depth_g || !fmt_is_read_only(format)) {
+        return NULL;
+    }
+    if (!fmt_cache_g) {
+        fmt_cache_g = p_new(fmt_cache_entry_t, FMT_CACHE_SIZE);
+    }
+    entry = fmt_cache_slot(format);
+    if (!entry->ops) {
+        entry->ops = p_new(fmt_op_t, FMT_CACHE_MAX_OPS);
+    }
+    if (fmt_compile(format, entry->ops) < 0) {
+        entry->format = NULL;
+        return NULL;
+    }
+    entry->format = format;
+    entry->gen = gen;
+    return entry->ops;
+}
+
+/* Get the compiled version of a format, NULL if it cannot be compiled. */
+static ALWAYS_INLINE const fmt_op_t *fmt_cache_get(const char *format)
+{
+    int gen = atomic_load_explicit(&fmt_gen_g, memory_order_relaxed);
+
+    if (likely(fmt_cache_g)) {
+        const fmt_cache_entry_t *entry = fmt_cache_slot(format);
+
+        if (likely(entry->format == format && entry->gen == gen)) {
+            return entry->ops;
+        }
+    }
+    return fmt_cache_fill(format, gen);
+}
+
+static void fmt_cache_wipe(void)
+{
+    if (fmt_cache_g) {
+        for (int i = 0; i < FMT_CACHE_SIZE; i++) {
+            p_delete(&fmt_cache_g[i].ops);
+        }
+        p_delete(&fmt_cache_g);
+    }
+}
+thr_hooks(NULL, fmt_cache_wipe);
+
 static int fmt_output(FILE *stream, char *str, size_t size,
                       const char *format, va_list ap)
 {
@@ -557,6 +974,9 @@ static int fmt_output(FILE *stream, char *str, size_t size,
     int c, count, len, width, prec, base, flags, type_flags;
     int left_pad, prefix_len, zero_pad, right_pad;
     const char *lp;
+    const fmt_op_t *ops;
+    const fmt_op_t *op;
+    fmt_op_t op_buf;
     int sign;
     int save_errno = errno;
 
@@ -584,14 +1004,23 @@ static int fmt_output(FILE *stream, char *str, size_t size,
     _IO_flockfile (s);
 #endif
 
+    /* compiled version of the format, if any */
+    ops = fmt_cache_get(format);
+
     for (;;) {
         /* Modifier 'M' is for 'put memory', this is the modifier to use to
          * put raw data in the output stream/buffer */
         int modifier = 'M';
 
-        for (lp = format; *format && *format != '%'; format++)
-            continue;
-        len = format - lp;
+        if (ops) {
+            lp = format;
+            len = ops->lit_len;
+            format += len;
+        } else {
+            for (lp = format; *format && *format != '%'; format++)
+                continue;
+            len = format - lp;
+        }
       haslp:
         count = fmt_output_chunk(stream, str, size, count, lp, len, modifier);
         modifier  = 'M';
@@ -609,24 +1038,28 @@ static int fmt_output(FILE *stream, char *str, size_t size,
 
         format++;
 
-        /* special case naked %d and %s formats */
-        if (*format == 'd') {
-            format++;
+        if (ops) {
+            op = ops++;
+            format += op->spec_len;
+        } else {
+            format = fmt_parse_op(format, &op_buf);
+            op = &op_buf;
+        }
+
+        switch (op->kind) {
+          case FMT_OP_INT10:
             lp = convert_int10(buf + sizeof(buf), va_arg(ap, int));
             len = buf + sizeof(buf) - lp;
             goto haslp;
-        }
-        if (*format == 's') {
-            format++;
+
+          case FMT_OP_STR:
             lp = va_arg(ap, const char *);
             if (lp == NULL)
                 lp = "(null)";
             len = strlen(lp);
             goto haslp;
-        }
-        /* also special case %.*s */
-        if (format[0] == '.' && format[1] == '*' && format[2] == 's') {
-            format += 3;
+
+          case FMT_OP_STRN:
             len = va_arg(ap, int);
             lp = va_arg(ap, const char *);
             if (lp == NULL) {
@@ -635,148 +1068,50 @@ static int fmt_output(FILE *stream, char *str, size_t size,
             }
             len = strnlen(lp, len);
             goto haslp;
-        }
 
-        /* also special case %*p?, where '?' is a registered modifier. We
-         * natively support %*pM for "put memory content here"
-         * and %*pX for "put hexadecimal content here".
-         */
-        if (format[0] == '*' && format[1] == 'p'
-        &&  put_memory_fmt_g[(unsigned char)format[2]].is_raw
-        &&  put_memory_fmt_g[(unsigned char)format[2]].raw_formatter)
-        {
-            modifier = format[2];
-            format += 3;
+          case FMT_OP_RAW:
+            modifier = op->c;
             len = va_arg(ap, int);
             lp  = va_arg(ap, const char *);
-
-            /* XXX No "trailing garbage" consumption: we support only single
-             *     character modifiers for now.
-             */
             goto haslp;
-        } else
-        if (format[0] == 'p'
-        &&  !put_memory_fmt_g[(unsigned char)format[1]].is_raw
-        &&  put_memory_fmt_g[(unsigned char)format[1]].ptr_formatter)
-        {
-            modifier = format[1];
-            format += 2;
+
+          case FMT_OP_PTR:
+            modifier = op->c;
             len = 0;
             lp  = va_arg(ap, const char *);
-
             goto haslp;
-        }
 
-        /* general case: parse complete format syntax */
-        flags = 0;
-
-        /* parse optional flags */
-        for (;; format++) {
-            switch (*format) {
-            case '\0': goto error;
-            case '-':  flags |= FLAG_MINUS;  continue;
-            case '+':  flags |= FLAG_PLUS;   continue;
-            case '#':  flags |= FLAG_ALT;    continue;
-            case '\'': flags |= FLAG_QUOTE;  continue;
-            case ' ':  flags |= FLAG_SPACE;  continue;
-            case '0':  flags |= FLAG_ZERO;   continue;
-                       /* locale's alternative output digits */
-            case 'I':  /* ignore this shit */;   continue;
-            }
+          case FMT_OP_ERROR:
+            goto error;
+
+          default:
             break;
         }
 
-        /* parse optional width */
-        width = 0;
-        if (*format == '*') {
-            format++;
-            flags |= FLAG_WIDTH;
+        flags = op->flags;
+        width = op->width;
+        prec = op->prec;
+        type_flags = op->type_flags;
+
+        if (flags & FLAG_WIDTH_ARG) {
             width = va_arg(ap, int);
             if (width < 0) {
                 flags |= FLAG_MINUS;
                 width = -width;
             }
-        } else
-        if (*format >= '1' && *format <= '9') {
-            flags |= FLAG_WIDTH;
-            width = *format++ - '0';
-            while (*format >= '0' && *format <= '9') {
-                width = width * 10 + *format++ - '0';
-            }
-        }
-
-        /* parse optional precision */
-        prec = 1;
-        if (*format == '.') {
-            format++;
-            prec = 0;
-            //flags &= ~FLAG_ZERO;
-            flags |= FLAG_PREC;
-            if (*format == '*') {
-                format++;
-                prec = va_arg(ap, int);
-                if (prec < 0) {
-                    /* OG: should be treated as if precision were
-                     * omitted, ie: prec = 1, flags &= ~FLAG_PREC
-                     */
-                    prec = 0;
-                }
-            } else
-            if (*format >= '0' && *format <= '9') {
-                prec = *format++ - '0';
-                while (*format >= '0' && *format <= '9') {
-                    prec = prec * 10 + *format++ - '0';
-                }
-            }
         }
-
-        /* parse optional format modifiers */
-        type_flags = 0;
-        switch (*format) {
-        case '\0':
-            goto error;
-        case 'l':
-            if (format[1] == 'l') {
-                format++;
-                type_flags |= TYPE_llong;
-            } else {
-                type_flags |= TYPE_long;
-            }
-            format++;
-            break;
-        case 'h':
-            if (format[1] == 'h') {
-                format++;
-                type_flags |= TYPE_char;
-            } else {
-                type_flags |= TYPE_short;
+        if (flags & FLAG_PREC_ARG) {
+            prec = va_arg(ap, int);
+            if (prec < 0) {
+                /* OG: should be treated as if precision were
+                 * omitted, ie: prec = 1, flags &= ~FLAG_PREC
+                 */
+                prec = 0;
             }
-            format++;
-            break;
-        case 'j':
-            type_flags |= TYPE_intmax_t;
-            format++;
-            break;
-        case 'z':
-            type_flags |= TYPE_size_t;
-            format++;
-            break;
-        case 't':
-            type_flags |= TYPE_ptrdiff_t;
-            format++;
-            break;
-        case 'L':
-            type_flags |= TYPE_ldouble;
-            format++;
-            break;
         }
 
         /* dispatch on actual format character */
-        switch (c = *format++) {
-        case '\0':
-            format--;
-            goto error;
-
+        switch (c = op->c) {
         case 'n':
 #if 0
             /* Consume pointer to int from argument list, but ignore it */
@@ -1002,12 +1337,6 @@ static int fmt_output(FILE *stream, char *str, size_t size,
         case 'p':
             flags |= FLAG_ALT;
             base = 16;
-            if (unlikely(isalnum((unsigned char)*format))) {
-                /* XXX Reserve each %[*]p[0-9a-zA-Z]+ format for our own usage
-                 */
-                e_trace(0, "trailing garbage after %%p format");
-                do { format++; } while (isalnum((unsigned char)*format));
-            }
             {
                 void *vp = va_arg(ap, void *);
 
@@ -1684,6 +2013,7 @@ void iprintf_register_formatter(int modifier, formatter_f *formatter)
 
     old->is_raw = true;
     old->raw_formatter = formatter;
+    atomic_fetch_add(&fmt_gen_g, 1);
 }
 
 void iprintf_register_pointer_formatter(int modifier,
@@ -1701,6 +2031,19 @@ void iprintf_register_pointer_formatter(int modifier,
 
     old->is_raw = false;
     old->ptr_formatter = formatter;
+    atomic_fetch_add(&fmt_gen_g, 1);
+}
+
+bool iprintf_has_formatter(int modifier, bool is_raw)
+{
+    const struct formatter_t *fmt;
+
+    fmt = &put_memory_fmt_g[(unsigned char)modifier];
+
+    if (is_raw) {
+        return fmt->is_raw && fmt->raw_formatter;
+    }
+    return !fmt->is_raw && fmt->ptr_formatter;
 }
 
 ssize_t formatter_writef(FILE *stream, char *buf, size_t buf_len,
@@ -33,6 +33,10 @@
 #define PRIx128_FMT_ARG  PRIu128_FMT_ARG
 #define PRIX128_FMT_ARG  PRIu128_FMT_ARG
 
+/* The formats located in read-only memory (the string literals) are parsed
+ * on their first use and their parsed version is kept in a per-thread
+ * cache; the other formats are parsed at each call.
+ */
 int iprintf(const char * nonnull format, ...)
         __attr_leaf__ __attr_printf__(1, 2);
 int ifprintf(FILE * nonnull stream, const char * nonnull format, ...)
@@ -189,6 +193,22 @@ void
 iprintf_register_pointer_formatter(int modifier,
                                    pointer_formatter_f * nonnull formatter);
 
+/** Tell whether a formatter is registered for the provided modifier.
+ *
+ * \param[in] is_raw  Look for a formatter registered with \ref
+ *                    iprintf_register_formatter ("%*pf") if true, with \ref
+ *                    iprintf_register_pointer_formatter ("%pf") otherwise.
+ */
+bool iprintf_has_formatter(int modifier, bool is_raw);
+
+/** Tell whether a format string is in the read-only data of the objects
+ * loaded at startup, like the string literals.
+ *
+ * The content of such a format cannot change, so it can be identified by
+ * its address.
+ */
+bool iprintf_fmt_is_read_only(const char *fmt);
+
 /* Formatter helpers. */
 
 /** Write data to file or buffer following a given format.
@@ -476,8 +476,15 @@ int strtoull_ext(const char *s, uint64_t *out, const char **tail, int base)
 double strtod_allow_subnormal(const char *nptr, char **endptr)
 {
     double res = 0.;
+    int len;
 
     errno = 0;
+    if ((len = memtod_fast(nptr, -1, &res)) >= 0) {
+        if (endptr) {
+            *endptr = (char *)nptr + len;
+        }
+        return res;
+    }
     res = strtod(nptr, endptr);
 
     if (errno) {
@@ -156,10 +156,45 @@ int strtoull_ext(const char * nonnull s, uint64_t * nonnull out,
 double strtod_allow_subnormal(const char * nonnull nptr,
                               char * nullable * nullable endptr);
 
+/** Size of the buffer needed by dtoa_shortest. */
+#define DTOA_SHORTEST_BUFSIZ  25
+
+/** Format a double with the shortest representation that parses back to it.
+ *
+ * The output has the same layout as "%.17g" (scientific notation when the
+ * decimal exponent is less than -4 or greater than 16), but with as few
+ * digits as possible: 0.1 is formatted as "0.1" instead of
+ * "0.10000000000000001".
+ *
+ * \return the length of the formatted string, excluding the '\0'.
+ */
+int dtoa_shortest(char buf[static DTOA_SHORTEST_BUFSIZ], double d);
+
+/** Parse a double, fast path.
+ *
+ * Parses the common decimal forms ("-12.5e3", ".5", "1e-7", ...) having at
+ * most 19 significant digits, with correct rounding. The hexadecimal
+ * numbers, the infinites and NaNs, the subnormal numbers, the overflows, the
+ * numbers with more digits, the leading spaces and the few numbers that are
+ * too close to the middle of two doubles are not handled, and must be
+ * parsed with strtod.
+ *
+ * errno is never modified.
+ *
+ * \param[in]  len  the length of \p s, or a negative value if it is
+ *                  NUL-terminated.
+ * \return the number of bytes parsed, or -1 if the number must be parsed by
+ *         strtod.
+ */
+int memtod_fast(const void * nonnull s, int len, double * nonnull out);
+
 __attr_nonnull__((1))
 static inline double memtod(const void * nonnull s, int len,
                             const byte * nullable * nullable endptr)
 {
+    double res;
+    int ret;
+
     if (!len) {
         errno = EINVAL;
         if (endptr) {
@@ -167,13 +202,22 @@ static inline double memtod(const void * nonnull s, int len,
         }
         return 0;
     }
+    if ((ret = memtod_fast(s, len, &res)) >= 0) {
+        if (len > 0) {
+            errno = 0;
+        }
+        if (endptr) {
+            *endptr = (const byte *)s + ret;
+        }
+        return res;
+    }
     if (len > 0) {
         t_scope;
 
         /* Ensure we have a '\0' */
         const char *duped = (const char *)t_dupz(s, len);
-        double res = strtod_allow_subnormal(duped, (char **)endptr);
 
+        res = strtod_allow_subnormal(duped, (char **)endptr);
         if (endptr) {
             *(char **)endptr = (char *)s + (*(char **)endptr - duped);
         }
@@ -16,9 +16,20 @@
 /*                                                                         */
 /***************************************************************************/
 
+#include <sys/sendfile.h>
+#include <linux/errqueue.h>
+
 #include <lib-common/unix.h>
+#include <lib-common/container-dlist.h>
 #include <lib-common/str-outbuf.h>
 
+#ifndef SO_ZEROCOPY
+#  define SO_ZEROCOPY   60
+#endif
+#ifndef MSG_ZEROCOPY
+#  define MSG_ZEROCOPY  0x4000000
+#endif
+
 void ob_check_invariants(outbuf_t *ob)
 {
     int len = ob->length, sb_len = ob->sb.len;
@@ -44,7 +55,111 @@ void ob_chunk_wipe(outbuf_chunk_t *obc)
       case OUTBUF_DO_MUNMAP:
         munmap(obc->u.vp, obc->length);
         break;
+      case OUTBUF_DO_CLOSE:
+        p_close(&obc->fd);
+        break;
+      case OUTBUF_DO_RELEASE:
+        ob_shared_release(&obc->shared);
+        break;
+    }
+}
+
+void ob_shared_wipe(outbuf_shared_t *obs)
+{
+    switch (obs->on_wipe) {
+      case OUTBUF_DO_FREE:
+        ifree(obs->u.vp, MEM_LIBC);
+        break;
+      case OUTBUF_DO_MUNMAP:
+        munmap(obs->u.vp, obs->length);
+        break;
+    }
+}
+
+static bool ob_zc_chunk_is_done(const outbuf_t *ob,
+                                const outbuf_chunk_t *obc);
+
+/* The zero-copy chunks of the outbufs wiped before the completion of their
+ * sends, see ob_enable_zerocopy(). */
+typedef struct ob_zc_orphan_t {
+    dlist_t  link;
+    int      fd;
+    outbuf_t ob;
+} ob_zc_orphan_t;
+
+static struct {
+    spinlock_t lock;
+    dlist_t    orphans;
+} ob_zc_g = {
+    .orphans = DLIST_INIT(ob_zc_g.orphans),
+};
+
+static void ob_zc_orphan_delete(ob_zc_orphan_t **orphanp)
+{
+    if (*orphanp) {
+        p_close(&(*orphanp)->fd);
+        qv_wipe(&(*orphanp)->ob.zc_done_ranges);
+        p_delete(orphanp);
+    }
+}
+
+/* Release the orphan chunks whose sends are completed. */
+static void ob_zc_reap_orphans(void)
+{
+    spin_lock(&ob_zc_g.lock);
+    dlist_for_each_entry(ob_zc_orphan_t, orphan, &ob_zc_g.orphans, link) {
+        if (ob_reap_zerocopy(&orphan->ob, orphan->fd) < 0) {
+            /* The completions cannot be read anymore: never release the
+             * chunks, so that their memory is never reused. */
+            htlist_init(&orphan->ob.zc_chunks);
+        }
+        if (!ob_has_zerocopy_pending(&orphan->ob)) {
+            dlist_remove(&orphan->link);
+            ob_zc_orphan_delete(&orphan);
+        }
+    }
+    spin_unlock(&ob_zc_g.lock);
+}
+
+/* Keep the chunks of the zero-copy sends in flight of ob, which is wiped,
+ * until their completion: the kernel reads their memory until then. */
+static void ob_zc_orphan_chunks(outbuf_t *ob)
+{
+    ob_zc_orphan_t *orphan = p_new(ob_zc_orphan_t, 1);
+
+    orphan->fd = dup(ob->zc_fd);
+    if (orphan->fd < 0) {
+        htlist_init(&ob->zc_chunks);
+        p_delete(&orphan);
+        return;
     }
+    /* The owner of the socket closes it after wiping ob: only the data in
+     * flight must still be sent. */
+    shutdown(orphan->fd, SHUT_WR);
+
+    ob_init(&orphan->ob);
+    orphan->ob.zc_seq         = ob->zc_seq;
+    orphan->ob.zc_done        = ob->zc_done;
+    orphan->ob.zc_done_ranges = ob->zc_done_ranges;
+    qv_init(&ob->zc_done_ranges);
+    htlist_move(&orphan->ob.zc_chunks, &ob->zc_chunks);
+
+    spin_lock(&ob_zc_g.lock);
+    dlist_add_tail(&ob_zc_g.orphans, &orphan->link);
+    spin_unlock(&ob_zc_g.lock);
+}
+
+static void ob_wipe_zc_chunks(outbuf_t *ob)
+{
+    if (ob->zc_fd < 0) {
+        return;
+    }
+    if (ob_has_zerocopy_pending(ob)) {
+        ob_zc_orphan_chunks(ob);
+    }
+    qv_wipe(&ob->zc_done_ranges);
+    ob->zc_fd = -1;
+    ob_zc_reap_orphans();
 }
 
 static void ob_merge_(outbuf_t *dst, outbuf_t *src, bool wipe)
@@ -66,6 +181,7 @@ static void ob_merge_(outbuf_t *dst, outbuf_t *src, bool wipe)
 
     if (wipe) {
         sb_wipe(&src->sb);
+        ob_wipe_zc_chunks(src);
     } else {
         src->length      = 0;
         src->sb_trailing = 0;
@@ -98,8 +214,14 @@ void ob_wipe(outbuf_t *ob)
         outbuf_chunk_t *obc;
 
         obc = htlist_pop_entry(&ob->chunks_list, outbuf_chunk_t, chunks_link);
-        ob_chunk_delete(&obc);
+        if (obc->zc_sent && !ob_zc_chunk_is_done(ob, obc)) {
+            /* Partially sent with MSG_ZEROCOPY. */
+            htlist_add_tail(&ob->zc_chunks, &obc->chunks_link);
+        } else {
+            ob_chunk_delete(&obc);
+        }
     }
+    ob_wipe_zc_chunks(ob);
     sb_wipe(&ob->sb);
 }
 
@@ -119,6 +241,25 @@ int ob_xread(outbuf_t *ob, int fd, int size)
     return 0;
 }
 
+void ob_add_shared(outbuf_t *ob, outbuf_shared_t *obs, int offset, int len)
+{
+    outbuf_chunk_t *obc;
+
+    assert (offset >= 0 && len >= 0 && offset + len <= obs->length);
+
+    if (len <= OUTBUF_SHARED_MIN_SIZE) {
+        ob_add(ob, obs->u.b + offset, len);
+        return;
+    }
+
+    obc = p_new(outbuf_chunk_t, 1);
+    obc->u.p     = obs->u.b + offset;
+    obc->length  = len;
+    obc->shared  = ob_shared_retain(obs);
+    obc->on_wipe = OUTBUF_DO_RELEASE;
+    ob_add_chunk(ob, obc);
+}
+
 int ob_add_file(outbuf_t *ob, const char *file, int size)
 {
     int fd = RETHROW(open(file, O_RDONLY));
@@ -151,6 +292,42 @@ int ob_add_file(outbuf_t *ob, const char *file, int size)
     return 0;
 }
 
+int ob_add_file_range(outbuf_t *ob, int fd, off_t offset, int len,
+                      bool do_close)
+{
+    outbuf_chunk_t *obc;
+
+    if (len <= OUTBUF_CHUNK_MIN_SIZE) {
+        void *p = sb_grow(&ob->sb, len);
+        ssize_t res = pread(fd, p, len, offset);
+
+        if (do_close) {
+            PROTECT_ERRNO(close(fd));
+        }
+        if (res != len) {
+            if (res >= 0) {
+                errno = EIO;
+            }
+            return -1;
+        }
+        __sb_fixlen(&ob->sb, ob->sb.len + len);
+        ob->sb_trailing += len;
+        ob->length      += len;
+        return 0;
+    }
+
+    obc = p_new(outbuf_chunk_t, 1);
+    obc->is_file     = true;
+    obc->fd          = fd;
+    obc->file_offset = offset;
+    obc->length      = len;
+    if (do_close) {
+        obc->on_wipe = OUTBUF_DO_CLOSE;
+    }
+    ob_add_chunk(ob, obc);
+    return 0;
+}
+
 static int ob_consume(outbuf_t *ob, int len)
 {
     ob->length -= len;
@@ -177,7 +354,12 @@ static int ob_consume(outbuf_t *ob, int len)
         len -= (obc->length - obc->offset);
 
         htlist_pop(&ob->chunks_list);
-        ob_chunk_delete(&obc);
+        if (obc->zc_sent && !ob_zc_chunk_is_done(ob, obc)) {
+            /* Kept until the completion of its zero-copy sends. */
+            htlist_add_tail(&ob->zc_chunks, &obc->chunks_link);
+        } else {
+            ob_chunk_delete(&obc);
+        }
     }
 
     assert (len <= ob->sb_trailing);
@@ -186,14 +368,232 @@ static int ob_consume(outbuf_t *ob, int len)
     return 0;
 }
 
+/* Send a file chunk with sendfile(2), returns -1 with errno set to EINVAL
+ * or ENOSYS if it is not supported for these file descriptors. */
+static ssize_t ob_chunk_sendfile(outbuf_chunk_t *obc, int fd)
+{
+    off_t off = obc->file_offset + obc->offset;
+    ssize_t res;
+
+    res = sendfile(fd, obc->fd, &off, obc->length - obc->offset);
+    if (res == 0) {
+        /* The file was truncated */
+        errno = EIO;
+        return -1;
+    }
+    return res;
+}
+
+/* Read up to len bytes of a file chunk in buf. */
+static ssize_t ob_chunk_pread(outbuf_chunk_t *obc, void *buf, size_t len)
+{
+    ssize_t res;
+
+    len = MIN(len, (size_t)(obc->length - obc->offset));
+    res = pread(obc->fd, buf, len, obc->file_offset + obc->offset);
+    if (res == 0) {
+        /* The file was truncated */
+        errno = EIO;
+        return -1;
+    }
+    return res;
+}
+
+/****************************************************************************/
+/* Zero-copy                                                                */
+/****************************************************************************/
+
+int ob_enable_zerocopy(outbuf_t *ob, int fd)
+{
+    int one = 1;
+
+    RETHROW(setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)));
+    ob_zc_reap_orphans();
+    ob->zerocopy = true;
+    ob->zc_fd    = fd;
+    ob->zc_seq   = 0;
+    ob->zc_done  = 0;
+    qv_clear(&ob->zc_done_ranges);
+    return 0;
+}
+
+/* Record the completion of the sends [first, last]. */
+static void ob_zc_add_done(outbuf_t *ob, uint32_t first, uint32_t last)
+{
+    qv_t(u32) *ranges = &ob->zc_done_ranges;
+
+    if ((int32_t)(first - ob->zc_done) > 0) {
+        /* Completed out of order. */
+        qv_append(ranges, first);
+        qv_append(ranges, last);
+        return;
+    }
+    if ((int32_t)(last + 1 - ob->zc_done) > 0) {
+        ob->zc_done = last + 1;
+    }
+
+    /* Merge the ranges that now follow the completed sends. */
+    for (int i = 0; i < ranges->len; ) {
+        if ((int32_t)(ranges->tab[i] - ob->zc_done) > 0) {
+            i += 2;
+            continue;
+        }
+        if ((int32_t)(ranges->tab[i + 1] + 1 - ob->zc_done) > 0) {
+            ob->zc_done = ranges->tab[i + 1] + 1;
+        }
+        qv_splice(ranges, i, 2, NULL, 0);
+        i = 0;
+    }
+}
+
+static bool ob_zc_is_done(const outbuf_t *ob, uint32_t seq)
+{
+    if ((int32_t)(seq - ob->zc_done) < 0) {
+        return true;
+    }
+    for (int i = 0; i < ob->zc_done_ranges.len; i += 2) {
+        uint32_t first = ob->zc_done_ranges.tab[i];
+        uint32_t last  = ob->zc_done_ranges.tab[i + 1];
+
+        if (seq - first <= last - first) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool ob_zc_chunk_is_done(const outbuf_t *ob,
+                                const outbuf_chunk_t *obc)
+{
+    for (uint32_t seq = obc->zc_first; ; seq++) {
+        if (!ob_zc_is_done(ob, seq)) {
+            return false;
+        }
+        if (seq == obc->zc_seq) {
+            return true;
+        }
+    }
+}
+
+/* Release the chunks whose zero-copy sends are all completed, given that
+ * the sends [first, last] just completed. */
+static void ob_zc_complete(outbuf_t *ob, uint32_t first, uint32_t last)
+{
+    htlist_t chunks;
+
+    ob_zc_add_done(ob, first, last);
+
+    htlist_move(&chunks, &ob->zc_chunks);
+    while (!htlist_is_empty(&chunks)) {
+        outbuf_chunk_t *obc;
+
+        obc = htlist_pop_entry(&chunks, outbuf_chunk_t, chunks_link);
+        if (ob_zc_chunk_is_done(ob, obc)) {
+            ob_chunk_delete(&obc);
+        } else {
+            htlist_add_tail(&ob->zc_chunks, &obc->chunks_link);
+        }
+    }
+}
+
+int ob_reap_zerocopy(outbuf_t *ob, int fd)
+{
+    while (!htlist_is_empty(&ob->zc_chunks)) {
+        char control[CMSG_SPACE(sizeof(struct sock_extended_err)) + 64];
+        struct msghdr msg = {
+            .msg_control    = control,
+            .msg_controllen = sizeof(control),
+        };
+        struct sock_extended_err *serr;
+        struct cmsghdr *cm;
+
+        if (recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+            return ERR_RW_RETRIABLE(errno) ? 0 : -1;
+        }
+        cm = CMSG_FIRSTHDR(&msg);
+        if (!cm) {
+            continue;
+        }
+        serr = (struct sock_extended_err *)CMSG_DATA(cm);
+        if (serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+            continue;
+        }
+        if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+            /* The kernel had to copy the data anyway (e.g. on loopback):
+             * zero-copy only costs the completions on this socket. */
+            ob->zerocopy = false;
+        }
+        /* Sends [ee_info, ee_data] are completed. */
+        ob_zc_complete(ob, serr->ee_info, serr->ee_data);
+    }
+    return 0;
+}
+
+/* Send the shared chunks starting at the chunk first that are not separated
+ * by data of the buffer, with MSG_ZEROCOPY. */
+static ssize_t ob_send_zerocopy(outbuf_t *ob, int fd, htnode_t *first)
+{
+    struct iovec iov[IOV_MAX];
+    struct msghdr msg = { .msg_iov = iov };
+    ssize_t res;
+    ssize_t left;
+
+    htlist_for_each_start(first, it, &ob->chunks_list) {
+        outbuf_chunk_t *obc = htlist_entry(it, outbuf_chunk_t, chunks_link);
+
+        if (!obc->shared || (it != first && obc->sb_leading)
+        ||  msg.msg_iovlen >= IOV_MAX)
+        {
+            break;
+        }
+        iov[msg.msg_iovlen++] = MAKE_IOVEC(obc->u.b + obc->offset,
+                                           obc->length - obc->offset);
+    }
+
+    res = sendmsg(fd, &msg, MSG_ZEROCOPY);
+    if (res < 0) {
+        if (errno == ENOBUFS) {
+            /* Too many zero-copy sends in flight for the socket. */
+            return writev(fd, iov, msg.msg_iovlen);
+        }
+        return -1;
+    }
+
+    /* Keep the chunks referenced by this send until its completion. */
+    left = res;
+    htlist_for_each_start(first, it, &ob->chunks_list) {
+        outbuf_chunk_t *obc = htlist_entry(it, outbuf_chunk_t, chunks_link);
+
+        if (left <= 0) {
+            break;
+        }
+        if (!obc->zc_sent) {
+            obc->zc_sent  = true;
+            obc->zc_first = ob->zc_seq;
+        }
+        obc->zc_seq = ob->zc_seq;
+        left -= obc->length - obc->offset;
+    }
+    ob->zc_seq++;
+    return res;
+}
+
+/****************************************************************************/
+/* Writing                                                                  */
+/****************************************************************************/
+
 int ob_write_with(outbuf_t *ob, int fd,
                   ssize_t (*writerv)(int, const struct iovec *, int, void *),
                   void *priv)
 {
 #define PREPARE_AT_LEAST  (64U << 10)
+    t_scope;
     struct iovec iov[IOV_MAX];
     size_t iovcnt = 0, sb_pos = 0, iov_size = 0;
 
+    if (!writerv && ob_has_zerocopy_pending(ob)) {
+        RETHROW(ob_reap_zerocopy(ob, fd));
+    }
     if (!ob->length)
         return 0;
 
@@ -209,9 +609,45 @@ int ob_write_with(outbuf_t *ob, int fd,
         }
 
         len = obc->length - obc->offset;
+        if (obc->is_file) {
+            void *buf;
+            ssize_t res;
+
+            if (!writerv) {
+                /* Flush what precedes the file first, so that it can be
+                 * sent without copy. */
+                if (iovcnt) {
+                    goto doit;
+                }
+                res = ob_chunk_sendfile(obc, fd);
+                if (res >= 0) {
+                    return ob_consume(ob, res);
+                }
+                if (errno != EINVAL && errno != ENOSYS) {
+                    return -1;
+                }
+            }
+
+            /* Copy the beginning of the file in memory, and stop there. */
+            len = MIN(len, PREPARE_AT_LEAST);
+            buf = t_new_raw(char, len);
+            res = RETHROW(ob_chunk_pread(obc, buf, len));
+            iov[iovcnt++] = MAKE_IOVEC(buf, res);
+            goto doit;
+        }
+        if (ob->zerocopy && !writerv && obc->shared
+        &&  len >= OUTBUF_ZEROCOPY_MIN_SIZE)
+        {
+            /* Flush what precedes the shared chunks first, as only them
+             * can be sent without copy. */
+            if (iovcnt) {
+                goto doit;
+            }
+            return ob_consume(ob, RETHROW(ob_send_zerocopy(ob, fd, it)));
+        }
         iov[iovcnt++] = MAKE_IOVEC(obc->u.b + obc->offset, len);
         iov_size += len;
-        if (iov_size > PREPARE_AT_LEAST || iovcnt + 2 >= sizeof(iov))
+        if (iov_size > PREPARE_AT_LEAST || iovcnt + 2 >= IOV_MAX)
             goto doit;
     }
 
@@ -225,3 +661,65 @@ int ob_write_with(outbuf_t *ob, int fd,
                                   (*writerv)(fd, iov, iovcnt, priv) :
                                   writev(fd, iov, iovcnt)));
 }
+
+/****************************************************************************/
+/* Tests                                                                    */
+/****************************************************************************/
+
+#include <lib-common/z.h>
+
+Z_GROUP_EXPORT(str_outbuf)
+{
+    Z_TEST(zc_completions, "out of order zero-copy completions") {
+        outbuf_shared_t *obs;
+        outbuf_t ob;
+        uint32_t seqs[][2] = { { 0, 0 }, { 1, 2 }, { 3, 3 }, { 4, 4 } };
+        int pos = 0;
+
+        obs = ob_shared_new_memchunk(p_new(char, 4 * 2048), 4 * 2048,
+                                     false);
+        ob_init(&ob);
+        carray_for_each_pos(i, seqs) {
+            ob_add_shared(&ob, obs, i * 2048, 2048);
+        }
+        Z_ASSERT_EQ(obs->refcnt, 5);
+
+        /* The second chunk was sent in two parts, the last one was partly
+         * sent with MSG_ZEROCOPY. */
+        htlist_for_each(it, &ob.chunks_list) {
+            outbuf_chunk_t *obc = htlist_entry(it, outbuf_chunk_t,
+                                               chunks_link);
+
+            obc->zc_sent  = true;
+            obc->zc_first = seqs[pos][0];
+            obc->zc_seq   = seqs[pos][1];
+            pos++;
+        }
+        ob.zc_seq = 5;
+
+        /* A chunk whose sends completed before it is consumed is released
+         * at once. */
+        ob_zc_complete(&ob, 3, 3);
+        Z_ASSERT_N(ob_consume(&ob, ob.length));
+        Z_ASSERT_EQ(obs->refcnt, 4);
+        Z_ASSERT(ob_has_zerocopy_pending(&ob));
+
+        /* A chunk is kept until all of its sends complete. */
+        ob_zc_complete(&ob, 1, 1);
+        Z_ASSERT_EQ(obs->refcnt, 4);
+        ob_zc_complete(&ob, 0, 0);
+        Z_ASSERT_EQ(obs->refcnt, 3);
+        Z_ASSERT_EQ(ob.zc_done, 2U);
+        ob_zc_complete(&ob, 2, 2);
+        Z_ASSERT_EQ(obs->refcnt, 2);
+        Z_ASSERT_EQ(ob.zc_done, 4U);
+        Z_ASSERT_EQ(ob.zc_done_ranges.len, 0);
+
+        ob_zc_complete(&ob, 4, 4);
+        Z_ASSERT_EQ(obs->refcnt, 1);
+        Z_ASSERT(!ob_has_zerocopy_pending(&ob));
+
+        ob_wipe(&ob);
+        ob_shared_release(&obs);
+    } Z_TEST_END;
+} Z_GROUP_END;
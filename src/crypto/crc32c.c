@@ -0,0 +1,106 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2026 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#include <lib-common/arith.h>
+#include <lib-common/hash.h>
+
+/* CRC32C (Castagnoli polynomial), as used by iSCSI, ext4 or SCTP.
+ *
+ * It is computed with the crc32 instruction of SSE4.2 when the CPU has it,
+ * and with a table otherwise.
+ */
+
+#define CRC32C_POLY  0x82f63b78
+
+static uint32_t crc32c_table_g[256];
+
+static uint32_t naive_icrc32c(uint32_t crc, const void *data, ssize_t len)
+{
+    const uint8_t *buf = data;
+
+    while (len-- > 0) {
+        crc = crc32c_table_g[(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+static uint32_t icrc32c_resolve(uint32_t crc, const void *data,
+                                ssize_t len);
+static uint32_t (*icrc32c_impl)(uint32_t crc, const void *data, ssize_t len)
+    = &icrc32c_resolve;
+
+#ifdef __HAS_CPUID
+#pragma push_macro("__attr_leaf__")
+#undef __attr_leaf__
+#include <cpuid.h>
+#pragma pop_macro("__attr_leaf__")
+
+__attribute__((target("sse4.2")))
+static uint32_t sse42_icrc32c(uint32_t crc, const void *data, ssize_t len)
+{
+    const uint8_t *buf = data;
+
+    for (; len > 0 && ((uintptr_t)buf & 7); len--) {
+        crc = __builtin_ia32_crc32qi(crc, *buf++);
+    }
+#ifdef __x86_64__
+    for (; len >= 8; len -= 8, buf += 8) {
+        crc = __builtin_ia32_crc32di(crc, get_unaligned_cpu64(buf));
+    }
+#endif
+    for (; len >= 4; len -= 4, buf += 4) {
+        crc = __builtin_ia32_crc32si(crc, get_unaligned_cpu32(buf));
+    }
+    for (; len > 0; len--) {
+        crc = __builtin_ia32_crc32qi(crc, *buf++);
+    }
+    return crc;
+}
+
+#endif
+
+static uint32_t icrc32c_resolve(uint32_t crc, const void *data, ssize_t len)
+{
+    for (uint32_t i = 0; i < countof(crc32c_table_g); i++) {
+        uint32_t v = i;
+
+        for (int bit = 0; bit < 8; bit++) {
+            v = (v >> 1) ^ (CRC32C_POLY & -(v & 1));
+        }
+        crc32c_table_g[i] = v;
+    }
+    icrc32c_impl = &naive_icrc32c;
+
+#ifdef __HAS_CPUID
+    {
+        int eax, ebx, ecx, edx;
+
+        __cpuid(1, eax, ebx, ecx, edx);
+        if (ecx & bit_SSE4_2) {
+            icrc32c_impl = &sse42_icrc32c;
+        }
+    }
+#endif
+
+    return (*icrc32c_impl)(crc, data, len);
+}
+
+uint32_t icrc32c(uint32_t crc, const void *data, ssize_t len)
+{
+    return ~(*icrc32c_impl)(~crc, data, len);
+}
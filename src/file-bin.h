@@ -58,6 +58,14 @@
  *
  *  SS --> Slot Size, in little endian (here 30).
  *  SH --> Slot Header
+ *
+ * In version 2 (see \ref file_bin_create_v2), the signature is
+ * "IS_binary/v02.0", each record length is followed by the CRC32C of the
+ * length and of the record, and each slot header is followed by the number
+ * of the record it points to, by the date at which it was written and by the
+ * CRC32C of the slot header, so that the readers can skip the corrupted
+ * records and find a record by its number or its date without reading the
+ * whole file.
  */
 
 #include <lib-common/container-qvector.h>
@@ -74,10 +82,18 @@ typedef struct file_bin_t {
     uint32_t  slot_size;
     uint16_t  version;
 
-    /* Read mode fields. */
-    uint32_t  length;
+    /* Read mode fields (the mapping is also used by the mmap writers). */
+    off_t     length;
     byte     *map;
     sb_t      record_buf;
+
+    /* Write mode fields. */
+    uint64_t  rec_no;
+    bool      use_mmap;
+    off_t     synced_pos;
+    uint64_t  synced_msec;
+    uint32_t  commit_max_bytes;
+    uint32_t  commit_max_delay;
 } file_bin_t;
 static inline file_bin_t *file_bin_init(file_bin_t *var)
 {
@@ -110,6 +126,51 @@ GENERIC_DELETE(file_bin_t, file_bin);
  */
 file_bin_t *file_bin_create(lstr_t path, uint32_t slot_size, bool truncate);
 
+enum {
+    /* Truncate the file if it already exists. */
+    FILE_BIN_TRUNCATE = 1 << 0,
+
+    /* Write the file through a shared mapping instead of stdio. The file is
+     * extended by chunks of 8MB filled with zeros, that are ignored by the
+     * readers and dropped when the file is reopened for writing in stdio
+     * mode. */
+    FILE_BIN_MMAP     = 1 << 1,
+};
+
+/** Open a binary file in version 2 for writing.
+ *
+ * Same as \ref file_bin_create, but the created files are in version 2,
+ * whose records are checksummed and can be found by number or date (see
+ * \ref file_bin_seek_record and \ref file_bin_seek_date). The slot size must
+ * be at least 52.
+ *
+ * When the file already exists in a previous version, it is appended in
+ * that version, and \ref FILE_BIN_MMAP is ignored.
+ *
+ * \param[in] path       The path to the binary file to write.
+ * \param[in] slot_size  The slot size to use for this file. Use 0 to use
+ *                       FILE_BIN_DEFAULT_SLOT_SIZE.
+ * \param[in] flags      A combination of FILE_BIN_TRUNCATE and
+ *                       FILE_BIN_MMAP.
+ */
+file_bin_t *file_bin_create_v2(lstr_t path, uint32_t slot_size,
+                               unsigned flags);
+
+/** Sync a binary file automatically when records are put.
+ *
+ * The file is synced (see \ref file_bin_sync) when a record is put and at
+ * least \p max_bytes were written since the last sync, or the last sync is
+ * older than \p max_delay milliseconds, so that the cost of the syncs is
+ * shared by several records.
+ *
+ * \param[in] max_bytes  Maximum number of bytes written between two syncs,
+ *                       0 for no limit.
+ * \param[in] max_delay  Maximum delay between two syncs (in milliseconds),
+ *                       0 for no limit.
+ */
+void file_bin_set_group_commit(file_bin_t *file, uint32_t max_bytes,
+                               uint32_t max_delay);
+
 /** Put a record in a binary file.
  *
  * \param[in]  file  The file to put the binary data in.
@@ -225,7 +286,7 @@ static inline bool file_bin_is_finished(file_bin_t *file)
 
 /** Tell if the file_bin has at least \p len bytes from the current position.
  */
-static inline bool file_bin_has(file_bin_t *file, off_t len)
+static inline bool file_bin_has(const file_bin_t *file, off_t len)
 {
     return file->cur + len <= file->length;
 }
@@ -246,6 +307,82 @@ static inline bool file_bin_has(file_bin_t *file, off_t len)
 __must_check__
 int _file_bin_seek(file_bin_t *file, off_t pos);
 
+/** Move the reading position to a record given by its number.
+ *
+ * Only available for files in version 2. The records are numbered from 0,
+ * in writing order. The records are found from the closest slot header, so
+ * if corrupted records are skipped between that slot header and the
+ * requested record, the position is after the requested record.
+ *
+ * \return  0 on success, a negative value if the file has less than
+ *          \p rec_no records (the position is not changed).
+ */
+__must_check__
+int file_bin_seek_record(file_bin_t *file, uint64_t rec_no);
+
+/** Move the reading position before the records written at a date.
+ *
+ * Only available for files in version 2. The dates are the ones of the slot
+ * headers, so the position is the first record of the last slot started
+ * before \p msec: the records read from there may be a little older than
+ * \p msec.
+ *
+ * \param[in]  msec  The date, in milliseconds since the epoch.
+ */
+__must_check__
+int file_bin_seek_date(file_bin_t *file, uint64_t msec);
+
+/* }}} */
+/* {{{ Parallel reading */
+
+/** Callback receiving the records of a file.
+ *
+ * \param[in]  priv    The private data given to the reading function.
+ * \param[in]  chunk   The number of the chunk of the file the record is in.
+ * \param[in]  record  The record; the memory it points to is only valid
+ *                     during the call.
+ *
+ * \return  0 to continue reading, a negative value to stop.
+ */
+typedef int (file_bin_record_f)(void *priv, int chunk, lstr_t record);
+
+/** Read the records of a binary file in parallel.
+ *
+ * The file is split, from its current reading position, in chunks of
+ * consecutive slots that are read concurrently by thread jobs (when the thr
+ * module is loaded). The slot headers give the first record of each chunk,
+ * so the chunks can be read independently.
+ *
+ * The records of a chunk are given in order, but the callback is called
+ * concurrently for the different chunks, so it must be thread-safe.
+ *
+ * On success, the reading position of the file is set after the last record
+ * read, so that the file can be refreshed and read again when it grows.
+ *
+ * \param[in]  file       The binary file, opened with \ref file_bin_open.
+ * \param[in]  nb_chunks  The number of chunks, 0 for the number of threads.
+ * \param[in]  cb         The callback called on each record.
+ * \param[in]  priv       Private data for the callback.
+ *
+ * \return  0 on success, a negative value if the callback stopped the
+ *          reading.
+ */
+__must_check__
+int file_bin_read_parallel(file_bin_t *file, int nb_chunks,
+                           file_bin_record_f *cb, void *priv);
+
+/** Replay the records of a binary file in order.
+ *
+ * Same as \ref file_bin_read_parallel, but the callback is called in the
+ * calling thread, on all the records in the order of the file: the chunks
+ * are read in advance by thread jobs, and their records are kept until the
+ * previous chunks were replayed. On large files, this is faster than \ref
+ * file_bin_get_next_record, as the reading of the records (and the checking
+ * of their CRC in version 2) is done concurrently with the callback.
+ */
+__must_check__
+int file_bin_replay(file_bin_t *file, file_bin_record_f *cb, void *priv);
+
 /* }}} */
 
 /** Close a previously opened or created file_bin.
@@ -36,7 +36,7 @@
 
 enum log_file_flags {
     LOG_FILE_USE_LAST  = (1U << 0),
-    LOG_FILE_COMPRESS  = (1U << 1), /* Use gzip on results */
+    LOG_FILE_COMPRESS  = (1U << 1), /* Compress the rotated files */
     LOG_FILE_UTCSTAMP  = (1U << 2),
     LOG_FILE_NOSYMLINK = (1U << 3),
 
@@ -81,6 +81,10 @@ typedef struct log_file_t {
     char     prefix[PATH_MAX];
     char     ext[8];
 
+    /* Compression of the rotated files (LOG_FILE_COMPRESS). */
+    core__log_file_compression__t compression;
+    int      compression_level;
+
     /* Flags. */
     bool disable_rotation : 1;
     bool is_file_bin      : 1;
@@ -127,6 +131,37 @@ log_file_set_file_cb(log_file_t *file, log_file_cb_f *on_event,
                      void *priv);
 void log_file_set_mode(log_file_t *file, uint32_t mode);
 
+/** Set the codec used to compress the rotated files.
+ *
+ * The rotated files of the log files created with the LOG_FILE_COMPRESS flag
+ * are compressed in background threads (jobs of the thr module when it is
+ * loaded), into "<name>.gz" files with the gzip codec and "<name>.qlz" files
+ * with the LZO codec. The default is gzip with level 6.
+ *
+ * \param[in]  codec  The compression codec.
+ * \param[in]  level  The compression level (1 to 9), only used by gzip.
+ */
+void log_file_set_compression(log_file_t *file,
+                              core__log_file_compression__t codec,
+                              int level);
+
+/** Set the maximum number of files compressed at the same time.
+ *
+ * This limit is global to the process, the other rotated files are queued.
+ * The default is 2.
+ */
+void log_file_set_max_compression_jobs(int max_jobs);
+
+/** Read a rotated log file compressed by a log file.
+ *
+ * \param[in]  path  The path of the ".gz" or ".qlz" file.
+ * \param[out] out   The buffer in which the uncompressed content is
+ *                   appended.
+ *
+ * \return 0 on success, a negative value on failure.
+ */
+int log_file_read_compressed(const char *path, sb_t *out);
+
 int log_fwrite(log_file_t *log_file, const void *data, size_t len);
 int log_fwritev(log_file_t *log_file, struct iovec *iov, size_t iovlen);
 int log_fprintf(log_file_t *log_file, const char *format, ...)
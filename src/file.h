@@ -102,4 +102,67 @@ static inline ssize_t file_writef(file_t *f, const char *fmt, ...) {
 int write_in_tmp_file(char *file_path, const char *data, int len, sb_t *err);
 int file_truncate(file_t *f, off_t len);
 
+/*----- bulk I/O -----*/
+
+/* The bulk files stream large files sequentially by large blocks, without
+ * filling the page cache with their content: the blocks are read or written
+ * with O_DIRECT when it is asked for and supported by the file system, and
+ * the pages behind the current position are dropped from the cache with
+ * posix_fadvise() otherwise.
+ *
+ * The I/O of the next block (read ahead, or write of the previous block) is
+ * done in a thread job while the current block is processed when the thr
+ * module is loaded, and synchronously otherwise.
+ */
+
+enum file_bulk_flags {
+    /* Bypass the page cache with O_DIRECT when the file system supports
+     * it. */
+    FILE_BULK_DIRECT = 1 << 0,
+};
+
+/* Alignment of the blocks buffers, sizes and offsets. */
+#define FILE_BULK_ALIGN  4096
+
+typedef struct file_bulk_t file_bulk_t;
+
+/** Open a file to read it sequentially.
+ *
+ * \param[in] flags     combination of enum file_bulk_flags.
+ * \param[in] buf_size  size of the blocks, rounded up to a multiple of
+ *                      FILE_BULK_ALIGN (1MB when 0).
+ */
+__must_check__ file_bulk_t *file_bulk_open_read(const char *path,
+                                                unsigned flags,
+                                                size_t buf_size);
+
+/** Read the next block of a file.
+ *
+ * \param[out] block  the data, valid until the next call or the closing of
+ *                    the file.
+ *
+ * \return the length of the block (which is buf_size but for the last
+ *         block), 0 at the end of the file, -1 on error.
+ */
+__must_check__ ssize_t file_bulk_read(file_bulk_t *f, lstr_t *block);
+
+/** Create (or truncate) a file to write it sequentially.
+ *
+ * \param[in] prealloc  expected size of the file, reserved with fallocate()
+ *                      to avoid fragmentation and fail early when the disk
+ *                      is full; 0 to reserve nothing. The reserved space not
+ *                      written is released at the closing of the file.
+ */
+__must_check__ file_bulk_t *file_bulk_open_write(const char *path,
+                                                 unsigned flags, mode_t mode,
+                                                 size_t buf_size,
+                                                 off_t prealloc);
+
+/** Write data in a file; the data is buffered until a block is full. */
+__must_check__ ssize_t file_bulk_write(file_bulk_t *f, const void *data,
+                                       size_t len);
+
+/** Close a bulk file; the buffered data of a written file is written. */
+int file_bulk_close(file_bulk_t **f);
+
 #endif /* IS_LIB_COMMON_FILE_H */
@@ -170,6 +170,14 @@ uint32_t icrc32(uint32_t crc, const void * nonnull data, ssize_t len)
 uint64_t icrc64(uint64_t crc, const void * nonnull data, ssize_t len)
     __attr_leaf__;
 
+/** CRC32C (Castagnoli), hardware accelerated when SSE4.2 is available.
+ *
+ * Like for icrc32, \p crc is 0 for the first chunk of data, or the result
+ * of the previous call to compute the CRC of data given in several chunks.
+ */
+uint32_t icrc32c(uint32_t crc, const void * nonnull data, ssize_t len)
+    __attr_leaf__;
+
 uint32_t hsieh_hash(const void * nonnull s, ssize_t len) __attr_leaf__;
 uint32_t jenkins_hash(const void * nonnull s, ssize_t len) __attr_leaf__;
 
@@ -770,6 +770,67 @@ void httpd_reply_file(httpd_query_t * nonnull q, int dirfd,
 httpd_trigger_t * nonnull
 httpd_trigger__static_dir_new(const char * nonnull path);
 
+/*---- http-srv-cache.c ----*/
+
+/** Cache of reply bodies.
+ *
+ * This cache is meant for the triggers serving documents that are costly to
+ * generate and/or compress but rarely change (IOP schemas, OpenAPI
+ * documents, ...). The bodies are stored already compressed with the
+ * content-coding negotiated with the client (gzip, deflate or identity), so
+ * that serving them again does neither call the handler nor deflate.
+ *
+ * The entries are keyed on the trigger path, the rest of the query path,
+ * the URL variables and the content-coding, and are evicted in LRU order
+ * when the cache exceeds its memory budget. The replies carry a strong ETag
+ * and If-None-Match queries are answered with a 304.
+ *
+ * A trigger typically does:
+ *
+ * \code
+ * static void my_trigger_cb(httpd_trigger_t *cb, httpd_query_t *q,
+ *                           const httpd_qinfo_t *info)
+ * {
+ *     if (httpd_reply_from_cache(q, my_cache_g)) {
+ *         return;
+ *     }
+ *     ...
+ *     httpd_reply_cacheable(q, my_cache_g, LSTR("application/json"), doc);
+ * }
+ * \endcode
+ *
+ * and calls httpd_cache_clear() whenever the documents change.
+ */
+typedef struct httpd_cache_t httpd_cache_t;
+
+httpd_cache_t * nonnull httpd_cache_new(size_t max_size);
+void httpd_cache_delete(httpd_cache_t * nullable * nonnull cache);
+void httpd_cache_clear(httpd_cache_t * nonnull cache);
+
+/** Reply to a GET (or HEAD) query from the cache.
+ *
+ * The qinfo of the query must be available (it is during the trigger
+ * callback, see httpd_qinfo_dup() to keep it afterwards).
+ *
+ * \return true if the query was answered, false if there is no matching
+ *         entry in the cache.
+ */
+bool httpd_reply_from_cache(httpd_query_t * nonnull q,
+                            httpd_cache_t * nonnull cache);
+
+/** Reply to a query with a body, and store it in the cache.
+ *
+ * The body is compressed with the content-coding accepted by the client.
+ * Only the replies to GET and HEAD queries are stored, and bodies larger
+ * than the memory budget of the cache are not.
+ *
+ * \param[in]  ctype  the Content-Type of the body.
+ * \param[in]  body   the (uncompressed) body.
+ */
+void httpd_reply_cacheable(httpd_query_t * nonnull q,
+                           httpd_cache_t * nonnull cache,
+                           lstr_t ctype, lstr_t body);
+
 
 /* }}} */
 /* {{{ HTTP Client */
@@ -34,6 +34,7 @@ typedef enum http2_header_info_flags_t {
     HTTP2_HDR_FLAG_HAS_REGULAR_HEADERS      =  1 << 6,
     HTTP2_HDR_FLAG_HAS_CONTENT_LENGTH       =  1 << 7,
     HTTP2_HDR_FLAG_HAS_HOST                 =  1 << 8,
+    HTTP2_HDR_FLAG_HAS_PRIORITY             =  1 << 9,
 } http2_header_info_flags_t;
 
 typedef struct http2_header_info_t {
@@ -45,6 +46,9 @@ typedef struct http2_header_info_t {
     lstr_t status;
     lstr_t content_length;
     lstr_t host;
+    /* Priority parameters of the request (cf. RFC9218 §4) */
+    uint8_t urgency;
+    bool incremental;
 } http2_header_info_t;
 
 /* }}} */
@@ -333,6 +333,65 @@ int t_iop_junpack_ptr_file(const iop_env_t * nonnull iop_env,
                            qv_t(iop_json_subfile) * nullable subfiles,
                            sb_t * nullable errb);
 
+/** Result of a parallel unpacking of JSon values. */
+typedef struct iop_junpack_par_res_t {
+    /** The unpacked values, in the order of the input. */
+    qv_t(void) values;
+
+    /** The memory pools in which the values are allocated; they are deleted
+     * by iop_junpack_par_res_wipe(). */
+    mem_pool_t * nonnull * nullable pools;
+    int pools_len;
+} iop_junpack_par_res_t;
+
+/** Release the values unpacked by iop_junpack_par(). */
+void iop_junpack_par_res_wipe(iop_junpack_par_res_t * nonnull res);
+
+/** Unpack a collection of IOP-JSon values in parallel.
+ *
+ * This function is made for the bulk imports: the input is either a JSon
+ * array of values (`[ { ... }, { ... } ]`) or a stream of values separated
+ * by whitespaces (like NDJSon, one value per line). It is quickly scanned to
+ * find the boundaries of the values, which are then unpacked in chunks by
+ * the thr-job workers (when the thr module is loaded), each chunk in its own
+ * memory pool.
+ *
+ * The values are unpacked with iop_junpack_ptr(), so classes are supported.
+ * Including subfiles with the `@include` syntax is not.
+ *
+ * \param[in]  iop_env The IOP environment.
+ * \param[in]  ps      The JSon to parse; the values do not reference it.
+ * \param[in]  st      The IOP type of the values.
+ * \param[in]  flags   Unpacker flags to use (see iop_jlex_set_flags).
+ * \param[out] res     The unpacked values; it must be wiped with
+ *                     iop_junpack_par_res_wipe(), even on error.
+ * \param[out] errb    NULL or the buffer to use to write the textual error
+ *                     of the first invalid value of the input.
+ *
+ * \return 0 on success, the iop_junpack() error of the first invalid value
+ *         otherwise.
+ */
+__must_check__
+int iop_junpack_par(const iop_env_t * nonnull iop_env, pstream_t ps,
+                    const iop_struct_t * nonnull st, int flags,
+                    iop_junpack_par_res_t * nonnull res,
+                    sb_t * nullable errb);
+
+/** Unpack a file containing a collection of IOP-JSon values in parallel.
+ *
+ * This function acts exactly as `iop_junpack_par` on the content of the
+ * file.
+ *
+ * \return the iop_junpack_par() result, or IOP_JERR_INVALID_FILE in case of
+ *         invalid file.
+ */
+__must_check__
+int iop_junpack_par_file(const iop_env_t * nonnull iop_env,
+                         const char * nonnull filename,
+                         const iop_struct_t * nonnull st, int flags,
+                         iop_junpack_par_res_t * nonnull res,
+                         sb_t * nullable errb);
+
 /** Print a textual error after iop_junpack() failure.
  *
  * When iop_junpack() fails, you can print the error textual description in
@@ -81,6 +81,7 @@ static inline const char * nonnull ic_status_to_string(ic_status_t s)
 
 #include "iop/rpc-channel.h"
 #include "iop/rpc-http.h"
+#include "iop/rpc-metrics.h"
 
 
 /** \brief get the description of the currently unpacked RPC.
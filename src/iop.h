@@ -1321,6 +1321,79 @@ void iop_filter_bitmap_apply(const iop_struct_t * nonnull st,
                              void * nonnull vec, int * nonnull len,
                              const byte * nonnull bitmap);
 
+/** Compiled IOP filter.
+ *
+ * The filters of \ref iop_filter and \ref iop_filter_opt can be compiled
+ * once into a program, to be applied on several vectors or objects without
+ * parsing the field path again. The values are sorted at compilation so that
+ * they are looked for with a bisection (except for doubles and SQL-like
+ * patterns), and the mandatory integer, enum and boolean fields are read by
+ * loops specialized for their type.
+ *
+ * \code
+ * iop_filter_prog_t *prog;
+ *
+ * prog = mp_iop_filter_prog_compile(t_pool(), iop_env, &user__s,
+ *                                   LSTR("status"), values, values_len, 0,
+ *                                   &err);
+ * if (!prog) {
+ *     return -1;
+ * }
+ * iop_filter_prog_run(prog, users, users_len, BITMAP_OP_AND, bitmap);
+ * \endcode
+ */
+typedef struct iop_filter_prog_t iop_filter_prog_t;
+
+/** Compile a filter on the values of a field.
+ *
+ * See \ref iop_filter for the meaning of the arguments. The values are
+ * not copied and must outlive the program.
+ *
+ * \return the program, or NULL if the field path is invalid or cannot be
+ *         filtered on.
+ */
+iop_filter_prog_t * nullable
+mp_iop_filter_prog_compile(mem_pool_t * nullable mp,
+                           const iop_env_t * nonnull iop_env,
+                           const iop_struct_t * nonnull st,
+                           lstr_t field_path,
+                           void * const nonnull * nullable values,
+                           int values_len, unsigned flags,
+                           sb_t * nullable err);
+
+/** Compile a filter on the presence of an optional or repeated field.
+ *
+ * See \ref iop_filter_opt.
+ */
+iop_filter_prog_t * nullable
+mp_iop_filter_opt_prog_compile(mem_pool_t * nullable mp,
+                               const iop_env_t * nonnull iop_env,
+                               const iop_struct_t * nonnull st,
+                               lstr_t field_path, bool is_set,
+                               sb_t * nullable err);
+
+/** Delete a filter program allocated on \p mp. */
+void mp_iop_filter_prog_delete(mem_pool_t * nullable mp,
+                               iop_filter_prog_t * nullable * nonnull prog);
+
+/** Check if an object matches a filter program.
+ *
+ * \param[in] obj  The object (and not a pointer on it for classes).
+ */
+bool iop_filter_prog_matches(const iop_filter_prog_t * nonnull prog,
+                             const void * nonnull obj);
+
+/** Apply a filter program on a vector of objects, and update a bitmap.
+ *
+ * Same as \ref t_iop_filter_bitmap, but the bitmap must have been allocated
+ * by the caller. The large vectors are filtered in parallel when the thr
+ * module is loaded.
+ */
+void iop_filter_prog_run(const iop_filter_prog_t * nonnull prog,
+                         const void * nonnull vec, int len,
+                         iop_filter_bitmap_op_t bitmap_op,
+                         byte * nonnull bitmap);
+
 /* Remove fields tagged with the `gen_attr` generic attribute.
  *
  * Walk recursively through the IOP object.
@@ -1522,6 +1595,53 @@ mp_iop_copy_desc_sz(mem_pool_t * nullable mp, const iop_struct_t * nonnull st,
 #define iop_shallow_copy_v(pfx, out, v)                                      \
     mp_iop_copy_v_flags(NULL, pfx, (out), (v), IOP_COPY_SHALLOW)
 
+/** Duplicate an IOP value into a relocatable image.
+ *
+ * The image is a single block containing a copy of the value in which the
+ * pointers are replaced by offsets, so that it can be written as-is to a
+ * file or a shared memory segment, and loaded back without unpacking with
+ * \ref iop_image_load_desc. The image is only valid on the same
+ * architecture and for the same version of the IOP description.
+ *
+ * \param[in] mp The memory pool to use for the image. If mp is NULL the
+ *               libc malloc() will be used.
+ * \param[in] st The IOP structure definition (__s).
+ * \param[in] v  The IOP value to duplicate.
+ */
+lstr_t mp_iop_image_dup_desc(mem_pool_t * nullable mp,
+                             const iop_struct_t * nonnull st,
+                             const void * nonnull v);
+
+/** Load an image created by \ref mp_iop_image_dup_desc.
+ *
+ * The image is loaded in place: the offsets are converted back into
+ * pointers, so the returned value points into \p data, which must be 8-bytes
+ * aligned and cannot be loaded twice. The offsets, strings, union tags and
+ * class ids are checked against the image.
+ *
+ * \param[in] iop_env The IOP environment, used to find the classes.
+ * \param[in] st      The IOP structure definition (__s).
+ * \param[in] data    The image.
+ * \param[in] len     The length of the image.
+ *
+ * \return the loaded value, or NULL if the image is invalid, in which case
+ *         the error can be retrieved with iop_get_err().
+ */
+void * nullable iop_image_load_desc(const iop_env_t * nonnull iop_env,
+                                    const iop_struct_t * nonnull st,
+                                    void * nonnull data, size_t len);
+
+#define mp_iop_image_dup(mp, pfx, v)  ({                                     \
+        const pfx##__t *_ii_v = (v);                                         \
+                                                                             \
+        mp_iop_image_dup_desc((mp), &pfx##__s, (const void *)_ii_v);         \
+    })
+#define iop_image_dup(pfx, v)    mp_iop_image_dup(NULL, pfx, (v))
+#define t_iop_image_dup(pfx, v)  mp_iop_image_dup(t_pool(), pfx, (v))
+
+#define iop_image_load(iop_env, pfx, data, len)                              \
+    ((pfx##__t *)iop_image_load_desc((iop_env), &pfx##__s, (data), (len)))
+
 /** Find a generic attribute value for an IOP structure.
  *
  * See \ref iop_field_get_gen_attr for the description of exp_type and
@@ -2728,6 +2848,103 @@ static inline int iop_bunpack_ptr(mem_pool_t * nonnull mp,
                                  copy ? IOP_UNPACK_COPY_STRINGS : 0);
 }
 
+/** Streaming binary unpacker.
+ *
+ * A streaming unpacker unpacks a bpacked IOP struct received in several
+ * chunks (from a socket, a file, ...), without having to buffer the whole
+ * packed value: the fields are unpacked as soon as they are complete, and
+ * only the bytes of the field being received are kept between two chunks.
+ * The nested structs are unpacked field by field too, so the memory needed
+ * does not depend on the size of the struct fields.
+ *
+ * The elements of a repeated field can also be handed to a callback as soon
+ * as they are unpacked, instead of being stored in the unpacked value; this
+ * allows to process huge arrays with a bounded amount of memory.
+ *
+ * \code
+ * iop_bunpack_stream_t *stream;
+ * const iop_field_t *rows;
+ *
+ * iop_field_find_by_name(&reply__s, LSTR("rows"), NULL, &rows);
+ * stream = iop_bunpack_stream_new(mp, iop_env, &reply__s, &reply, 0);
+ * iop_bunpack_stream_set_cb(stream, rows, &on_row, ctx);
+ * while ((chunk = read_chunk(...)).len) {
+ *     if (iop_bunpack_stream_feed(stream, ps_initlstr(&chunk)) < 0) {
+ *         goto error;
+ *     }
+ * }
+ * if (iop_bunpack_stream_finish(stream) < 0) {
+ *     goto error;
+ * }
+ * iop_bunpack_stream_delete(&stream);
+ * \endcode
+ *
+ * The functions returning an int return a negative value on error, in which
+ * case the error can be retrieved with iop_get_err().
+ */
+typedef struct iop_bunpack_stream_t iop_bunpack_stream_t;
+
+/** Callback called on each element of a repeated field.
+ *
+ * \param[in] priv   The private data given to iop_bunpack_stream_set_cb.
+ * \param[in] fdesc  The descriptor of the repeated field.
+ * \param[in] elem   The unpacked element, as it would have been stored in
+ *                   the array (so a pointer on the pointer for classes); it
+ *                   is allocated on the t_pool() and is only valid during the
+ *                   call.
+ *
+ * \return a negative value to abort the unpacking.
+ */
+typedef int (iop_bunpack_stream_cb_f)(void * nullable priv,
+                                      const iop_field_t * nonnull fdesc,
+                                      void * nonnull elem);
+
+/** Create a streaming unpacker.
+ *
+ * \param[in] mp      The frame based memory pool used to allocate the
+ *                    unpacked value; the strings are always copied.
+ * \param[in] iop_env The current IOP environment.
+ * \param[in] st      The IOP structure definition (__s); classes and unions
+ *                    are not supported.
+ * \param[in] value   Pointer on the destination structure.
+ * \param[in] flags   A combination of \ref iop_unpack_flags.
+ */
+iop_bunpack_stream_t * nonnull
+iop_bunpack_stream_new(mem_pool_t * nonnull mp,
+                       const iop_env_t * nonnull iop_env,
+                       const iop_struct_t * nonnull st,
+                       void * nonnull value, unsigned flags);
+
+/** Hand the elements of a repeated field to a callback.
+ *
+ * The field can belong to any of the structs unpacked by the stream; its
+ * elements are not stored in the unpacked value, the array is left empty.
+ * This must be called before the first call to iop_bunpack_stream_feed.
+ */
+void iop_bunpack_stream_set_cb(iop_bunpack_stream_t * nonnull stream,
+                               const iop_field_t * nonnull fdesc,
+                               iop_bunpack_stream_cb_f * nonnull cb,
+                               void * nullable priv);
+
+/** Unpack a chunk of the packed value.
+ *
+ * The chunk does not have to be kept by the caller once the call returns.
+ * Once an error is returned, the stream cannot be used anymore.
+ */
+__must_check__
+int iop_bunpack_stream_feed(iop_bunpack_stream_t * nonnull stream,
+                            pstream_t chunk);
+
+/** Signal the end of the packed value.
+ *
+ * This fails if the packed value is truncated.
+ */
+__must_check__
+int iop_bunpack_stream_finish(iop_bunpack_stream_t * nonnull stream);
+
+void iop_bunpack_stream_delete(iop_bunpack_stream_t * nullable * nonnull
+                               stream);
+
 /** Unpack a packed IOP union.
  *
  * This function act like `iop_bunpack` but consume the pstream and doesn't
@@ -2984,6 +3201,8 @@ void iop_module_register(void);
 #include "iop/xml.h"
 #include "iop/dso.h"
 #include "iop/core-obj.h"
+#include "iop/bview.h"
+#include "iop/columns.h"
 
 #if __has_feature(nullability)
 #pragma GCC diagnostic pop
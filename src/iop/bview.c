@@ -0,0 +1,478 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2026 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#include <lib-common/iop.h>
+#include <lib-common/iop/codec.h>
+
+struct iop_bview_field_t {
+    /* First value of the field (after its tag), NULL if it is absent. For
+     * the raw arrays, first byte of the array. */
+    const uint8_t * nullable p;
+    iop_wire_type_t wt;
+    bool            raw;
+    uint32_t        n;
+
+    /* Last accessed value of a repeated field. */
+    uint32_t        cur_i;
+    iop_wire_type_t cur_wt;
+    const uint8_t * nullable cur_p;
+};
+
+/* {{{ Helpers */
+
+static const iop_struct_t *iop_bview_parent(const iop_struct_t *st)
+{
+    return iop_struct_is_class(st) ? st->class_attrs->parent : NULL;
+}
+
+static int iop_bview_invalid(const iop_bview_t *view,
+                             const iop_field_t * nullable fdesc)
+{
+    if (fdesc) {
+        return iop_set_err("invalid binary encoding for field `%*pM` of "
+                           "`%*pM`", LSTR_FMT_ARG(fdesc->name),
+                           LSTR_FMT_ARG(view->st->fullname));
+    }
+    return iop_set_err("invalid binary encoding for value of type `%*pM`",
+                       LSTR_FMT_ARG(view->st->fullname));
+}
+
+static int iop_bview_bad_type(const iop_bview_t *view,
+                              const iop_field_t *fdesc)
+{
+    return iop_set_err("field `%*pM` of `%*pM` is not of the requested type",
+                       LSTR_FMT_ARG(fdesc->name),
+                       LSTR_FMT_ARG(view->st->fullname));
+}
+
+static int iop_bview_check_int(const iop_field_t *fdesc, int64_t i64)
+{
+#define CHECK_RANGE(_min, _max)  \
+    THROW_ERR_IF(i64 < (_min) || i64 > (_max))
+
+    switch (fdesc->type) {
+      case IOP_T_I8:   CHECK_RANGE(INT8_MIN, INT8_MAX);   break;
+      case IOP_T_U8:   CHECK_RANGE(0, UINT8_MAX);         break;
+      case IOP_T_I16:  CHECK_RANGE(INT16_MIN, INT16_MAX); break;
+      case IOP_T_U16:  CHECK_RANGE(0, UINT16_MAX);        break;
+      case IOP_T_ENUM:
+      case IOP_T_I32:  CHECK_RANGE(INT32_MIN, INT32_MAX); break;
+      case IOP_T_U32:  CHECK_RANGE(0, UINT32_MAX);        break;
+      case IOP_T_BOOL: CHECK_RANGE(0, 1);                 break;
+      default:
+        break;
+    }
+    return 0;
+
+#undef CHECK_RANGE
+}
+
+/* }}} */
+/* {{{ Fields index */
+
+static int iop_bview_index_field(iop_bview_field_t *f,
+                                 const iop_field_t *fdesc, pstream_t *ps,
+                                 iop_wire_type_t wt)
+{
+    if (wt == IOP_WIRE_REPEAT) {
+        PS_WANT(fdesc->repeat == IOP_R_REPEATED);
+        PS_CHECK(get_uint32(ps, 4, &f->n));
+        PS_WANT(f->n >= 1 && ps_has(ps, 1) && IOP_TAG(ps->b[0]) == 0);
+        wt = IOP_WIRE_FMT(__ps_getc(ps));
+        f->wt = wt;
+        f->p  = ps->b;
+        for (uint32_t i = 1; i < f->n; i++) {
+            PS_CHECK(iop_skip_field(ps, wt));
+            PS_WANT(ps_has(ps, 1) && IOP_TAG(ps->b[0]) == 0);
+            wt = IOP_WIRE_FMT(__ps_getc(ps));
+        }
+        PS_CHECK(iop_skip_field(ps, wt));
+    } else
+    if (fdesc->repeat == IOP_R_REPEATED
+    &&  (1 << fdesc->type) & IOP_REPEATED_OPTIMIZE_OK
+    &&  wt <= IOP_WIRE_BLK4)
+    {
+        pstream_t blk;
+
+        /* array of small integers packed as a raw array */
+        PS_CHECK(iop_wire_get_blk(ps, wt, &blk));
+        PS_WANT(ps_len(&blk) % fdesc->size == 0);
+        f->raw = true;
+        f->wt  = wt;
+        f->p   = blk.b;
+        f->n   = ps_len(&blk) / fdesc->size;
+    } else {
+        f->wt = wt;
+        f->p  = ps->b;
+        f->n  = 1;
+        PS_CHECK(iop_skip_field(ps, wt));
+    }
+    f->cur_i  = 0;
+    f->cur_wt = f->wt;
+    f->cur_p  = f->p;
+    return 0;
+}
+
+/* Find where the fields are, by skipping all of them once. */
+static int iop_bview_index(iop_bview_t *view)
+{
+    const iop_struct_t *st = view->st;
+    const iop_field_t *fdesc = st->fields;
+    const iop_field_t *end = fdesc + st->fields_len;
+    iop_bview_field_t *fields;
+    iop_bview_field_t *level_fields;
+    pstream_t ps = view->ps;
+
+    fields = mp_new(view->mp, iop_bview_field_t, MAX(view->fields_len, 1));
+    level_fields = fields;
+
+    while (!ps_done(&ps)) {
+        iop_wire_type_t wt;
+        uint32_t tag;
+
+        PS_CHECK(__get_tag_wt(&ps, &tag, &wt));
+        if (tag == 0) {
+            uint16_t class_id = 0;
+
+            /* change of level in a class; the skipped levels only have
+             * absent fields */
+            PS_WANT(iop_struct_is_class(st));
+            PS_CHECK(__get_class_id(&ps, wt, &class_id));
+            do {
+                level_fields += st->fields_len;
+                PS_WANT((st = st->class_attrs->parent));
+            } while (st->class_attrs->class_id != class_id);
+            fdesc = st->fields;
+            end   = fdesc + st->fields_len;
+            continue;
+        }
+
+        while (fdesc < end && fdesc->tag < tag) {
+            fdesc++;
+        }
+        if (fdesc == end || fdesc->tag != tag) {
+            /* unknown field */
+            PS_CHECK(iop_skip_field(&ps, wt));
+            continue;
+        }
+        PS_CHECK(iop_bview_index_field(&level_fields[fdesc - st->fields],
+                                       fdesc, &ps, wt));
+        fdesc++;
+    }
+
+    view->fields = fields;
+    return 0;
+}
+
+static iop_bview_field_t * nullable
+iop_bview_get_entry(iop_bview_t *view, const iop_field_t *fdesc)
+{
+    int pos = 0;
+
+    for (const iop_struct_t *st = view->st; st; st = iop_bview_parent(st)) {
+        if (fdesc >= st->fields && fdesc < st->fields + st->fields_len) {
+            pos += fdesc - st->fields;
+            break;
+        }
+        pos += st->fields_len;
+    }
+    if (pos >= view->fields_len) {
+        iop_set_err("field `%*pM` does not belong to `%*pM`",
+                    LSTR_FMT_ARG(fdesc->name),
+                    LSTR_FMT_ARG(view->st->fullname));
+        return NULL;
+    }
+    if (!view->fields && iop_bview_index(view) < 0) {
+        iop_bview_invalid(view, NULL);
+        return NULL;
+    }
+    return &view->fields[pos];
+}
+
+/* Get the nth value of a field.
+ *
+ * Returns 1 if the field is absent, 0 when the value was found. The raw
+ * arrays must be handled by the caller.
+ */
+static int iop_bview_seek(iop_bview_t *view, iop_bview_field_t *f, int n,
+                          pstream_t *ps, iop_wire_type_t *wt)
+{
+    if (!f->p) {
+        return 1;
+    }
+    PS_WANT(n >= 0 && (uint32_t)n < f->n);
+    assert (!f->raw);
+
+    if ((uint32_t)n < f->cur_i) {
+        f->cur_i  = 0;
+        f->cur_wt = f->wt;
+        f->cur_p  = f->p;
+    }
+    *ps = ps_initptr(f->cur_p, view->ps.s_end);
+    *wt = f->cur_wt;
+    while (f->cur_i < (uint32_t)n) {
+        PS_CHECK(iop_skip_field(ps, *wt));
+        PS_WANT(ps_has(ps, 1) && IOP_TAG(ps->b[0]) == 0);
+        *wt = IOP_WIRE_FMT(__ps_getc(ps));
+        f->cur_i++;
+        f->cur_wt = *wt;
+        f->cur_p  = ps->b;
+    }
+    return 0;
+}
+
+/* }}} */
+/* {{{ Public API */
+
+int iop_bview_init(iop_bview_t *view, mem_pool_t *mp,
+                   const iop_env_t *iop_env, const iop_struct_t *st,
+                   pstream_t ps)
+{
+    p_clear(view, 1);
+    view->mp      = mp;
+    view->iop_env = iop_env;
+    view->st      = st;
+
+    if (iop_struct_is_class(st)) {
+        const iop_struct_t *real_st;
+        pstream_t saved_ps = ps;
+        iop_wire_type_t wt = 0;
+        uint32_t tag = 1;
+        uint16_t class_id = 0;
+
+        if (!ps_done(&ps) && __get_tag_wt(&ps, &tag, &wt) < 0) {
+            return iop_bview_invalid(view, NULL);
+        }
+        if (tag != 0) {
+            /* struct -> class backward compat, see unpack_class() */
+            if (st->class_attrs->parent) {
+                return iop_bview_invalid(view, NULL);
+            }
+            ps = saved_ps;
+        } else {
+            if (__get_class_id(&ps, wt, &class_id) < 0) {
+                return iop_bview_invalid(view, NULL);
+            }
+            real_st = iop_get_class_by_id(iop_env, st, class_id);
+            if (!real_st) {
+                return iop_set_err("cannot find child %d of class `%*pM`",
+                                   class_id, LSTR_FMT_ARG(st->fullname));
+            }
+            if (!iop_class_is_a(real_st, st)) {
+                return iop_set_err("class `%*pM` (id %d) is not a child of "
+                                   "`%*pM`", LSTR_FMT_ARG(real_st->fullname),
+                                   class_id, LSTR_FMT_ARG(st->fullname));
+            }
+            view->st = real_st;
+        }
+    }
+
+    view->ps = ps;
+    for (st = view->st; st; st = iop_bview_parent(st)) {
+        view->fields_len += st->fields_len;
+    }
+    return 0;
+}
+
+const iop_field_t *iop_bview_get_field(const iop_bview_t *view, lstr_t name)
+{
+    const iop_field_t *fdesc = NULL;
+
+    if (iop_field_find_by_name(view->st, name, NULL, &fdesc) < 0) {
+        return NULL;
+    }
+    return fdesc;
+}
+
+int iop_bview_get_len(iop_bview_t *view, const iop_field_t *fdesc)
+{
+    iop_bview_field_t *f = RETHROW_PN(iop_bview_get_entry(view, fdesc));
+
+    if (f->p) {
+        return f->n;
+    }
+    switch (fdesc->repeat) {
+      case IOP_R_DEFVAL:
+        return 1;
+      case IOP_R_REQUIRED:
+        /* required void fields are not packed */
+        return fdesc->type == IOP_T_VOID;
+      default:
+        return 0;
+    }
+}
+
+int iop_bview_get_int(iop_bview_t *view, const iop_field_t *fdesc, int n,
+                      int64_t *out)
+{
+    iop_bview_field_t *f;
+    pstream_t ps;
+    iop_wire_type_t wt;
+    int res;
+
+    if (fdesc->type == IOP_T_VOID || !((1 << fdesc->type) & IOP_INT_OK)) {
+        return iop_bview_bad_type(view, fdesc);
+    }
+    f = RETHROW_PN(iop_bview_get_entry(view, fdesc));
+
+    if (f->raw) {
+        if (n < 0 || (uint32_t)n >= f->n) {
+            return iop_bview_invalid(view, fdesc);
+        }
+        switch (fdesc->type) {
+          case IOP_T_I8:  *out = ((const int8_t *)f->p)[n];              break;
+          case IOP_T_I16: *out = (int16_t)get_unaligned_le16(f->p + 2 * n);
+                          break;
+          case IOP_T_U16: *out = get_unaligned_le16(f->p + 2 * n);       break;
+          default:        *out = f->p[n];                                break;
+        }
+        if (iop_bview_check_int(fdesc, *out) < 0) {
+            return iop_bview_invalid(view, fdesc);
+        }
+        return 0;
+    }
+
+    res = iop_bview_seek(view, f, n, &ps, &wt);
+    if (res > 0 && n == 0 && fdesc->repeat == IOP_R_DEFVAL) {
+        if (fdesc->type == IOP_T_ENUM) {
+            *out = fdesc->u0.defval_enum;
+        } else
+        if (fdesc->type == IOP_T_BOOL) {
+            *out = !!fdesc->u1.defval_u64;
+        } else {
+            *out = fdesc->u1.defval_u64;
+        }
+        return 0;
+    }
+    if (res != 0 || iop_wire_get_int(&ps, wt, out) < 0
+    ||  iop_bview_check_int(fdesc, *out) < 0)
+    {
+        return iop_bview_invalid(view, fdesc);
+    }
+    return 0;
+}
+
+int iop_bview_get_double(iop_bview_t *view, const iop_field_t *fdesc, int n,
+                         double *out)
+{
+    iop_bview_field_t *f;
+    pstream_t ps;
+    iop_wire_type_t wt;
+    int64_t i64;
+    int res;
+
+    if (fdesc->type != IOP_T_DOUBLE) {
+        return iop_bview_bad_type(view, fdesc);
+    }
+    f = RETHROW_PN(iop_bview_get_entry(view, fdesc));
+
+    res = iop_bview_seek(view, f, n, &ps, &wt);
+    if (res > 0 && n == 0 && fdesc->repeat == IOP_R_DEFVAL) {
+        *out = fdesc->u1.defval_d;
+        return 0;
+    }
+    if (res != 0) {
+        return iop_bview_invalid(view, fdesc);
+    }
+    if (wt == IOP_WIRE_QUAD) {
+        if (ps_get_double_le(&ps, out) < 0) {
+            return iop_bview_invalid(view, fdesc);
+        }
+        return 0;
+    }
+    /* doubles having an integer value may be packed as integers */
+    if (iop_wire_get_int(&ps, wt, &i64) < 0) {
+        return iop_bview_invalid(view, fdesc);
+    }
+    *out = i64;
+    return 0;
+}
+
+int iop_bview_get_lstr(iop_bview_t *view, const iop_field_t *fdesc, int n,
+                       lstr_t *out)
+{
+    iop_bview_field_t *f;
+    pstream_t ps;
+    iop_wire_type_t wt;
+    int res;
+
+    if (fdesc->type != IOP_T_STRING && fdesc->type != IOP_T_DATA
+    &&  fdesc->type != IOP_T_XML)
+    {
+        return iop_bview_bad_type(view, fdesc);
+    }
+    f = RETHROW_PN(iop_bview_get_entry(view, fdesc));
+
+    res = iop_bview_seek(view, f, n, &ps, &wt);
+    if (res > 0 && n == 0 && fdesc->repeat == IOP_R_DEFVAL) {
+        *out = LSTR_INIT_V(fdesc->u1.defval_data, fdesc->u0.defval_len);
+        return 0;
+    }
+    if (res != 0 || iop_wire_get_lstr(NULL, &ps, wt, 0, out) < 0) {
+        return iop_bview_invalid(view, fdesc);
+    }
+    return 0;
+}
+
+int iop_bview_get_view(iop_bview_t *view, const iop_field_t *fdesc, int n,
+                       iop_bview_t *out)
+{
+    iop_bview_field_t *f;
+    pstream_t ps;
+    pstream_t blk;
+    iop_wire_type_t wt;
+
+    if (!((1 << fdesc->type) & IOP_STRUCTS_OK)) {
+        return iop_bview_bad_type(view, fdesc);
+    }
+    f = RETHROW_PN(iop_bview_get_entry(view, fdesc));
+
+    if (iop_bview_seek(view, f, n, &ps, &wt) != 0
+    ||  iop_wire_get_blk(&ps, wt, &blk) < 0)
+    {
+        return iop_bview_invalid(view, fdesc);
+    }
+    return iop_bview_init(out, view->mp, view->iop_env, fdesc->u1.st_desc,
+                          blk);
+}
+
+int iop_bview_get_raw_array(iop_bview_t *view, const iop_field_t *fdesc,
+                            iop_array_void_t *out)
+{
+    iop_bview_field_t *f;
+
+    if (fdesc->repeat != IOP_R_REPEATED) {
+        return iop_bview_bad_type(view, fdesc);
+    }
+    f = RETHROW_PN(iop_bview_get_entry(view, fdesc));
+
+    if (!f->p) {
+        *out = (iop_array_void_t){ .tab = NULL, .len = 0 };
+        return 1;
+    }
+    if (!f->raw) {
+        return 0;
+    }
+    *out = (iop_array_void_t){
+        .tab = (void *)f->p,
+        .len = f->n,
+    };
+    return 1;
+}
+
+/* }}} */
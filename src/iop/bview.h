@@ -0,0 +1,159 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2026 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#if !defined(IS_LIB_COMMON_IOP_H) || defined(IS_LIB_COMMON_IOP_BVIEW_H)
+#  error "you must include <lib-common/iop.h> instead"
+#else
+#define IS_LIB_COMMON_IOP_BVIEW_H
+
+/** IOP binary views.
+ *
+ * A binary view gives a read-only access to the fields of a bpacked IOP
+ * struct, union or class, without unpacking it: the buffer is scanned once,
+ * on the first access to one of the fields, to find where each field is, and
+ * the values are then decoded on demand. Strings and packed arrays of small
+ * integers are returned as pointers into the buffer, and the nested structs,
+ * unions and classes are themselves accessed through views.
+ *
+ * The buffer must outlive the view (and the views derived from it). Only the
+ * accessed values are validated: a view can be created on an invalid buffer
+ * and the values that are not accessed are never checked. Accessing the
+ * elements of a repeated field in sequence is O(1) per element, but a random
+ * access to the nth element of an array of non-scalar values is O(n).
+ *
+ * \code
+ * iop_bview_t view;
+ * const iop_field_t *fdesc;
+ * lstr_t login;
+ *
+ * if (iop_bview_init(&view, t_pool(), iop_env, &user__s, ps) < 0
+ * ||  !(fdesc = iop_bview_get_field(&view, LSTR("login")))
+ * ||  iop_bview_get_lstr(&view, fdesc, 0, &login) < 0)
+ * {
+ *     return -1;
+ * }
+ * \endcode
+ *
+ * All the functions returning an int return a negative value on error, in
+ * which case the error can be retrieved with iop_get_err().
+ */
+
+typedef struct iop_bview_field_t iop_bview_field_t;
+
+typedef struct iop_bview_t {
+    mem_pool_t         * nonnull mp;
+    const iop_env_t    * nonnull iop_env;
+
+    /** Real type of the viewed value (a child of the expected type for
+     * classes). */
+    const iop_struct_t * nonnull st;
+
+    /** Packed fields of the value (after the class id for classes). */
+    pstream_t ps;
+
+    /** Number of fields of the value (including the fields of the parents
+     * for classes). */
+    int fields_len;
+
+    /** Where the fields are in the buffer; built on the first access. */
+    iop_bview_field_t * nullable fields;
+} iop_bview_t;
+
+/** Create a view on a bpacked IOP struct, union or class.
+ *
+ * \param[in] mp      The memory pool used to allocate the index of the
+ *                    fields.
+ * \param[in] iop_env The IOP environment, used to find the real type of
+ *                    the classes.
+ * \param[in] st      The expected type of the packed value.
+ * \param[in] ps      The packed value; it is not copied.
+ */
+__must_check__
+int iop_bview_init(iop_bview_t * nonnull view, mem_pool_t * nonnull mp,
+                   const iop_env_t * nonnull iop_env,
+                   const iop_struct_t * nonnull st, pstream_t ps);
+
+/** Get the descriptor of a field of the viewed value, from its name.
+ *
+ * For classes, the fields of the parents are looked for too.
+ */
+const iop_field_t * nullable
+iop_bview_get_field(const iop_bview_t * nonnull view, lstr_t name);
+
+/** Get the number of values of a field.
+ *
+ * \return 0 or 1 for a non-repeated field depending on its presence (the
+ *         absent fields having a default value count as present), the
+ *         number of elements for a repeated field, or a negative value if
+ *         the packed value is invalid.
+ */
+__must_check__
+int iop_bview_get_len(iop_bview_t * nonnull view,
+                      const iop_field_t * nonnull fdesc);
+
+/** Get the nth value of an integer, boolean or enum field.
+ *
+ * The value is checked against the range of the type of the field. The
+ * default value is returned for the absent fields having one.
+ *
+ * \param[in]  n  The index of the value: 0 for non-repeated fields.
+ */
+__must_check__
+int iop_bview_get_int(iop_bview_t * nonnull view,
+                      const iop_field_t * nonnull fdesc, int n,
+                      int64_t * nonnull out);
+
+/** Get the nth value of a double field. */
+__must_check__
+int iop_bview_get_double(iop_bview_t * nonnull view,
+                         const iop_field_t * nonnull fdesc, int n,
+                         double * nonnull out);
+
+/** Get the nth value of a string, bytes or xml field.
+ *
+ * The returned string points into the packed buffer, and is followed by a
+ * '\0'.
+ */
+__must_check__
+int iop_bview_get_lstr(iop_bview_t * nonnull view,
+                       const iop_field_t * nonnull fdesc, int n,
+                       lstr_t * nonnull out);
+
+/** Get a view on the nth value of a struct, union or class field. */
+__must_check__
+int iop_bview_get_view(iop_bview_t * nonnull view,
+                       const iop_field_t * nonnull fdesc, int n,
+                       iop_bview_t * nonnull out);
+
+/** Get the elements of a repeated field packed as a raw array.
+ *
+ * The arrays of int8, uint8, int16, uint16 and bool values are usually
+ * packed as a raw little endian array, in which case this function returns
+ * the array without copying it, as an iop_array_void_t; its `flags` member
+ * is 0.
+ *
+ * \return 1 if the array was packed as a raw array, 0 if it was not (the
+ *         elements must then be retrieved one by one), or a negative value
+ *         on error.
+ */
+__must_check__
+int iop_bview_get_raw_array(iop_bview_t * nonnull view,
+                            const iop_field_t * nonnull fdesc,
+                            iop_array_void_t * nonnull out);
+
+#endif
@@ -0,0 +1,410 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2026 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#ifndef IS_LIB_COMMON_IOP_CODEC_H
+#define IS_LIB_COMMON_IOP_CODEC_H
+
+#include <lib-common/arith.h>
+#include <lib-common/iop.h>
+
+/* Primitives of the IOP binary wire format.
+ *
+ * They are shared by the generic binary (un)packer and by the specialized
+ * codecs generated by iopc for the structs having the
+ * @(c:specialize, true) attribute (see iop_struct_codec_t). This header is
+ * not part of the public API of the IOP library.
+ */
+
+#define IOP_WIRE_FMT(o)          ((uint8_t)(o) >> 5)
+#define IOP_WIRE_MASK(m)         (IOP_WIRE_##m << 5)
+#define IOP_TAG(o)               ((o) & ((1 << 5) - 1))
+#define IOP_LONG_TAG(n)          ((1 << 5) - 3 + (n))
+
+#define IOP_MAKE_U32(a, b, c, d) \
+    ((a) | ((unsigned)(b) << 8) | ((unsigned)(c) << 16) | ((unsigned)(d) << 24))
+
+/* Types of the fields accepting each kind of wire type */
+#define TO_BIT(type)  (1 << (IOP_T_##type))
+#define IOP_INT_OK    0x103ff
+#define IOP_QUAD_OK   (TO_BIT(I64) | TO_BIT(U64) | TO_BIT(DOUBLE))
+#define IOP_BLK_OK    (TO_BIT(STRING) | TO_BIT(DATA) | TO_BIT(STRUCT) \
+                       | TO_BIT(UNION) | TO_BIT(XML))
+#define IOP_STRUCTS_OK    (TO_BIT(STRUCT) | TO_BIT(UNION))
+#define IOP_REPEATED_OPTIMIZE_OK  (TO_BIT(I8) | TO_BIT(U8) | TO_BIT(I16) \
+                                   | TO_BIT(U16) | TO_BIT(BOOL))
+
+/* {{{ Packing */
+
+static ALWAYS_INLINE uint8_t get_len_len(uint32_t u)
+{
+    uint8_t bits = bsr32(u | 1);
+    return 0x04040201 >> (bits & -8);
+}
+
+static ALWAYS_INLINE uint8_t get_vint32_len(int32_t i)
+{
+    const uint8_t zzbits = bsr32(((i >> 31) ^ (i << 1)) | 1);
+    return 0x04040201 >> (zzbits & -8);
+}
+
+static ALWAYS_INLINE unsigned get_vint64_len(int64_t i)
+{
+    static uint8_t const sizes[8] = { 1, 2, 4, 4, 8, 8, 8, 8 };
+    return sizes[bsr64(((i >> 63) ^ (i << 1)) | 1) / 8];
+}
+
+static ALWAYS_INLINE uint8_t *
+pack_tag(uint8_t *dst, uint32_t tag, uint32_t taglen, uint8_t wt)
+{
+    if (likely(taglen < 1)) {
+        *dst++ = wt | tag;
+        return dst;
+    }
+    if (likely(taglen == 1)) {
+        *dst++ = wt | IOP_LONG_TAG(1);
+        *dst++ = tag;
+        return dst;
+    }
+    *dst++ = wt | IOP_LONG_TAG(2);
+    return (uint8_t *)put_unaligned_le16((void *)dst, tag);
+}
+
+static ALWAYS_INLINE uint8_t *
+pack_len(uint8_t *dst, uint32_t tag, uint32_t taglen, uint32_t i)
+{
+    const uint32_t tags  =
+        IOP_MAKE_U32(IOP_WIRE_MASK(BLK1), IOP_WIRE_MASK(BLK2),
+                     IOP_WIRE_MASK(BLK4), IOP_WIRE_MASK(BLK4));
+    const uint8_t  bits = bsr32(i | 1) & -8;
+
+    dst = pack_tag(dst, tag, taglen, tags >> bits);
+    if (likely(bits < 8)) {
+        *dst++ = i;
+        return dst;
+    }
+    if (likely(bits == 8))
+        return (uint8_t *)put_unaligned_le16((void *)dst, i);
+    return (uint8_t *)put_unaligned_le32((void *)dst, i);
+}
+
+static ALWAYS_INLINE uint8_t *
+pack_int32(uint8_t *dst, uint32_t tag, uint32_t taglen, int32_t i)
+{
+    const uint32_t tags  =
+        IOP_MAKE_U32(IOP_WIRE_MASK(INT1), IOP_WIRE_MASK(INT2),
+                     IOP_WIRE_MASK(INT4), IOP_WIRE_MASK(INT4));
+    const uint8_t zzbits = (bsr32(((i >> 31) ^ (i << 1)) | 1)) & -8;
+
+    dst = pack_tag(dst, tag, taglen, tags >> zzbits);
+
+    if (likely(zzbits < 8)) {
+        *dst++ = i;
+        return dst;
+    }
+    if (likely(zzbits == 8))
+        return (uint8_t *)put_unaligned_le16((void *)dst, i);
+    return (uint8_t *)put_unaligned_le32((void *)dst, i);
+}
+
+static ALWAYS_INLINE uint8_t *
+pack_int64(uint8_t *dst, uint32_t tag, uint32_t taglen, int64_t i)
+{
+    if ((int64_t)(int32_t)i == i)
+        return pack_int32(dst, tag, taglen, i);
+    dst = pack_tag(dst, tag, taglen, IOP_WIRE_MASK(QUAD));
+    return (uint8_t *)put_unaligned_le64((uint8_t *)dst, i);
+}
+
+/* }}} */
+/* {{{ Unpacking */
+
+static inline int get_uint32(pstream_t *ps, int ilen, uint32_t *u32)
+{
+    switch (ilen) {
+      case 1:
+        *u32 = RETHROW(ps_getc(ps));
+        return 0;
+
+      case 2: {
+        uint16_t u16 = 0;
+        RETHROW(ps_get_le16(ps, &u16));
+        *u32 = u16;
+      } return 0;
+
+      case 4:
+        return ps_get_le32(ps, u32);
+    }
+    e_panic("this should not happen");
+}
+
+static ALWAYS_INLINE int
+__get_tag_wt(pstream_t *ps, uint32_t *tag, iop_wire_type_t *wt)
+{
+    *wt  = IOP_WIRE_FMT(ps->b[0]);
+    *tag = IOP_TAG(__ps_getc(ps));
+    if (likely(*tag < IOP_LONG_TAG(1)))
+        return 0;
+    if (likely(*tag == IOP_LONG_TAG(1)))
+        return get_uint32(ps, 1, tag);
+    return get_uint32(ps, 2, tag);
+}
+
+static ALWAYS_INLINE int
+__get_class_id(pstream_t *ps, iop_wire_type_t wt, uint16_t *class_id)
+{
+    switch (wt) {
+      case IOP_WIRE_INT1:
+        PS_WANT(ps_has(ps, 1));
+        *class_id = (int8_t)__ps_getc(ps);
+        return 0;
+
+      case IOP_WIRE_INT2:
+        PS_WANT(ps_has(ps, 2));
+        *class_id = (int16_t)__ps_get_le16(ps);
+        return 0;
+
+      case IOP_WIRE_INT4:
+        PS_WANT(ps_has(ps, 4));
+        *class_id = (int16_t)__ps_get_le32(ps);
+        return 0;
+
+      default:
+        return -1;
+    }
+}
+
+static inline int iop_skip_field(pstream_t *ps, iop_wire_type_t wt)
+{
+    uint32_t u32 = 0;
+
+    switch (wt) {
+      case IOP_WIRE_BLK1: PS_CHECK(get_uint32(ps, 1, &u32)); break;
+      case IOP_WIRE_BLK2: PS_CHECK(get_uint32(ps, 2, &u32)); break;
+      case IOP_WIRE_BLK4: PS_CHECK(get_uint32(ps, 4, &u32)); break;
+
+      case IOP_WIRE_INT1:
+      case IOP_WIRE_INT2:
+      case IOP_WIRE_INT4:
+        u32 = 1 << (wt - IOP_WIRE_INT1);
+        break;
+      case IOP_WIRE_QUAD:
+        u32 = 8;
+        break;
+
+      case IOP_WIRE_REPEAT: {
+        uint32_t n = 0;
+
+        PS_CHECK(get_uint32(ps, 4, &n));
+        PS_WANT(n >= 1);
+
+        while (n--) {
+            PS_WANT(ps_has(ps, 1) && IOP_TAG(ps->b[0]) == 0);
+            wt = IOP_WIRE_FMT(__ps_getc(ps));
+            RETHROW(iop_skip_field(ps, wt));
+        }
+      } break;
+
+      default:
+        return -1;
+    }
+
+    return ps_skip(ps, u32);
+}
+
+/* Read an integer of wire type `wt`; the range of the value is not checked
+ * against the type of the field. */
+static ALWAYS_INLINE int
+iop_wire_get_int(pstream_t *ps, iop_wire_type_t wt, int64_t *i64)
+{
+    switch (wt) {
+      case IOP_WIRE_INT1:
+        PS_WANT(ps_has(ps, 1));
+        *i64 = (int8_t)__ps_getc(ps);
+        return 0;
+
+      case IOP_WIRE_INT2:
+        PS_WANT(ps_has(ps, 2));
+        *i64 = (int16_t)__ps_get_le16(ps);
+        return 0;
+
+      case IOP_WIRE_INT4:
+        PS_WANT(ps_has(ps, 4));
+        *i64 = (int32_t)__ps_get_le32(ps);
+        return 0;
+
+      case IOP_WIRE_QUAD:
+        PS_WANT(ps_has(ps, 8));
+        *i64 = __ps_get_le64(ps);
+        return 0;
+
+      default:
+        return -1;
+    }
+}
+
+/* Read a block (string, struct, ...) of wire type `wt`. */
+static ALWAYS_INLINE int
+iop_wire_get_blk(pstream_t *ps, iop_wire_type_t wt, pstream_t *out)
+{
+    uint32_t len = 0;
+
+    switch (wt) {
+      case IOP_WIRE_BLK1: PS_CHECK(get_uint32(ps, 1, &len)); break;
+      case IOP_WIRE_BLK2: PS_CHECK(get_uint32(ps, 2, &len)); break;
+      case IOP_WIRE_BLK4: PS_CHECK(get_uint32(ps, 4, &len)); break;
+      default:
+        return -1;
+    }
+    return ps_get_ps(ps, len, out);
+}
+
+/* Read a string/bytes/xml value of wire type `wt`. */
+static ALWAYS_INLINE int
+iop_wire_get_lstr(mem_pool_t *mp, pstream_t *ps, iop_wire_type_t wt,
+                  unsigned flags, lstr_t *out)
+{
+    pstream_t blk;
+
+    RETHROW(iop_wire_get_blk(ps, wt, &blk));
+    /* The packed value contains the trailing '\0' */
+    PS_WANT(!ps_done(&blk));
+    if (flags & IOP_UNPACK_COPY_STRINGS) {
+        *out = mp_lstr_dups(mp, blk.s, ps_len(&blk) - 1);
+    } else {
+        *out = LSTR_INIT_V(blk.s, ps_len(&blk) - 1);
+    }
+    return 0;
+}
+
+/* }}} */
+/* {{{ Default values */
+
+static inline bool
+iop_field_is_defval(const iop_field_t *fdesc, const void *ptr, bool deep)
+{
+    assert (fdesc->repeat == IOP_R_DEFVAL);
+
+    switch (fdesc->type) {
+      case IOP_T_I8: case IOP_T_U8:
+        return *(uint8_t *)ptr == (uint8_t)fdesc->u1.defval_u64;
+      case IOP_T_I16: case IOP_T_U16:
+        return *(uint16_t *)ptr == (uint16_t)fdesc->u1.defval_u64;
+      case IOP_T_ENUM:
+        return *(int *)ptr == fdesc->u0.defval_enum;
+      case IOP_T_I32: case IOP_T_U32:
+        return *(uint32_t *)ptr == (uint32_t)fdesc->u1.defval_u64;
+      case IOP_T_I64: case IOP_T_U64:
+      case IOP_T_DOUBLE:
+        /* XXX double is handled like U64 because we want to compare them as
+         * bit to bit */
+        return *(uint64_t *)ptr == fdesc->u1.defval_u64;
+      case IOP_T_BOOL:
+        return fdesc->u1.defval_u64 ? *(bool *)ptr : !*(bool *)ptr;
+      case IOP_T_STRING:
+      case IOP_T_XML:
+      case IOP_T_DATA:
+        if (!fdesc->u0.defval_len) {
+            /* In this case we don't care about the string pointer. An empty
+             * string is an empty string whatever its pointer is. */
+            return !((lstr_t *)ptr)->len;
+        } else {
+            /* We consider a NULL string as “take the default value please”;
+             * otherwise we first check for the pointer equality and finally
+             * for the string equality. */
+            if (!((lstr_t *)ptr)->data) {
+                return true;
+            }
+            if (((lstr_t *)ptr)->len != fdesc->u0.defval_len) {
+                return false;
+            }
+            if (((lstr_t *)ptr)->data == fdesc->u1.defval_data) {
+                return true;
+            }
+            if (deep) {
+                return memcmp(((lstr_t *)ptr)->s, fdesc->u1.defval_data,
+                              fdesc->u0.defval_len) == 0;
+            }
+            return false;
+        }
+      default:
+        e_panic("unsupported");
+    }
+}
+
+static inline int
+iop_field_set_defval(const iop_field_t *fdesc, void *ptr)
+{
+    assert (fdesc->repeat == IOP_R_DEFVAL);
+    switch (fdesc->type) {
+      case IOP_T_I8: case IOP_T_U8:
+        *(uint8_t *)ptr  = fdesc->u1.defval_u64;
+        break;
+      case IOP_T_I16: case IOP_T_U16:
+        *(uint16_t *)ptr = fdesc->u1.defval_u64;
+        break;
+      case IOP_T_ENUM:
+        *(uint32_t *)ptr = fdesc->u0.defval_enum;
+        break;
+      case IOP_T_I32: case IOP_T_U32:
+        *(uint32_t *)ptr = fdesc->u1.defval_u64;
+        break;
+      case IOP_T_I64: case IOP_T_U64:
+        *(uint64_t *)ptr = fdesc->u1.defval_u64;
+        break;
+      case IOP_T_BOOL:
+        *(bool *)ptr     = !!fdesc->u1.defval_u64; /* Map to 0/1 */
+        break;
+      case IOP_T_DOUBLE:
+        *(double *)ptr   = fdesc->u1.defval_d;
+        break;
+      case IOP_T_STRING:
+      case IOP_T_XML:
+      case IOP_T_DATA:
+        *(lstr_t *)ptr = LSTR_INIT_V(fdesc->u1.defval_data,
+                                     fdesc->u0.defval_len);
+        break;
+      case IOP_T_UNION:
+      case IOP_T_STRUCT:
+        return -1;
+
+      case IOP_T_VOID:
+        assert (false);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* }}} */
+/* {{{ Specialized codecs */
+
+/** Get the specialized codec of a struct, if any. */
+static ALWAYS_INLINE const iop_struct_codec_t * nullable
+iop_struct_get_codec(const iop_struct_t * nonnull st)
+{
+    unsigned st_flags = st->flags;
+
+    if (likely(!TST_BIT(&st_flags, IOP_STRUCT_HAS_CODEC))) {
+        return NULL;
+    }
+    return st->st_attrs->codec;
+}
+
+/* }}} */
+
+#endif
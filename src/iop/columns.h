@@ -0,0 +1,146 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2026 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#if !defined(IS_LIB_COMMON_IOP_H) || defined(IS_LIB_COMMON_IOP_COLUMNS_H)
+#  error "you must include <lib-common/iop.h> instead"
+#else
+#define IS_LIB_COMMON_IOP_COLUMNS_H
+
+/** IOP columnar batches.
+ *
+ * A columnar batch holds the values of the scalar fields of a vector of IOP
+ * structures as one contiguous array per field (struct-of-arrays), so that
+ * the passes over large vectors that only need a few fields (sorting,
+ * filtering, aggregating) do not have to load whole objects in the cache.
+ *
+ * The columns are the non-repeated scalar fields of the structure and of its
+ * mandatory sub-structures, named by their field path ("a", "sub.b", ...).
+ * Repeated fields, unions, classes, optional or referenced sub-structures
+ * cannot be put in columns.
+ *
+ * \code
+ * iop_columns_t cols;
+ * lstr_t paths[] = { LSTR("status"), LSTR("date") };
+ * int *perm = t_new_raw(int, len);
+ *
+ * if (iop_columns_init(&cols, t_pool(), &user__s, users, len, paths,
+ *                      countof(paths), &err) < 0
+ * ||  iop_columns_sort(&cols, &sorts, perm, &err) < 0)
+ * {
+ *     return -1;
+ * }
+ * \endcode
+ */
+
+typedef struct iop_column_t {
+    /** Path of the field in the structure. */
+    lstr_t field_path;
+
+    const iop_field_t * nonnull fdesc;
+
+    /** Offset of the field in the objects. */
+    uint32_t offset;
+
+    /** Size of the values (sizeof(lstr_t) for strings, bytes and xml). */
+    uint16_t value_size;
+
+    /** The values; the values of the absent optional fields are zeroed.
+     *
+     * The strings point to the strings of the objects, they are not
+     * copied.
+     */
+    void * nonnull values;
+
+    /** Bitmap of the present values, NULL for mandatory fields. */
+    byte * nullable is_set;
+} iop_column_t;
+
+typedef struct iop_columns_t {
+    mem_pool_t         * nullable mp;
+    const iop_struct_t * nonnull st;
+    int len;
+
+    iop_column_t * nullable columns;
+    int columns_len;
+} iop_columns_t;
+
+/** Convert a vector of IOP structures into a columnar batch.
+ *
+ * \param[in] mp        The memory pool of the columns.
+ * \param[in] st        The IOP structure definition (__s); it cannot be a
+ *                      class or a union.
+ * \param[in] vec       Array of objects (of \p len elements).
+ * \param[in] paths     The field paths of the columns to create. When NULL,
+ *                      all the fields that can be put in columns are.
+ * \param[out] err      In case of error, the error description.
+ */
+int iop_columns_init(iop_columns_t * nonnull cols, mem_pool_t * nullable mp,
+                     const iop_struct_t * nonnull st,
+                     const void * nonnull vec, int len,
+                     const lstr_t * nullable paths, int paths_len,
+                     sb_t * nullable err);
+
+void iop_columns_wipe(iop_columns_t * nonnull cols);
+
+/** Get a column from the path of its field. */
+const iop_column_t * nullable
+iop_columns_get(const iop_columns_t * nonnull cols, lstr_t field_path);
+
+/** Write the values of the columns back into a vector of objects.
+ *
+ * \p vec must contain cols->len initialized objects; only the fields of the
+ * columns are set.
+ */
+void iop_columns_to_vec(const iop_columns_t * nonnull cols,
+                        void * nonnull vec);
+
+/** Sort the rows of a batch.
+ *
+ * Same as \ref iop_msort_desc, but on columns: all the sorting fields must
+ * be columns of the batch. The rows are not moved: the sorted order is
+ * written in \p perm, and can be applied with \ref iop_columns_permute.
+ * The sort is stable.
+ *
+ * \param[out] perm  The indexes of the rows in sorted order (cols->len
+ *                   elements).
+ */
+int iop_columns_sort(const iop_columns_t * nonnull cols,
+                     const qv_t(iop_sort) * nonnull params,
+                     int * nonnull perm, sb_t * nullable err);
+
+/** Reorder the rows of a batch: row i becomes the row perm[i]. */
+void iop_columns_permute(iop_columns_t * nonnull cols,
+                         const int * nonnull perm);
+
+/** Filter the rows of a batch, and update a bitmap.
+ *
+ * Same as \ref t_iop_filter_bitmap, but on a column of the batch, and the
+ * bitmap must have been allocated by the caller.
+ */
+int iop_columns_filter_bitmap(const iop_columns_t * nonnull cols,
+                              lstr_t field_path,
+                              void * const nonnull * nullable values,
+                              int values_len, unsigned flags,
+                              iop_filter_bitmap_op_t bitmap_op,
+                              byte * nonnull bitmap, sb_t * nullable err);
+
+/** Only keep the rows of a batch that are marked in a bitmap. */
+void iop_columns_filter_apply(iop_columns_t * nonnull cols,
+                              const byte * nonnull bitmap);
+
+#endif
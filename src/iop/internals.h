@@ -368,12 +368,43 @@ typedef struct iop_struct_attr_t {
     const iop_struct_attr_arg_t * nonnull args;
 } iop_struct_attr_t;
 
+/** Binary codec of a struct, specialized by iopc.
+ *
+ * It is generated for the structs having the @(c:specialize, true) generic
+ * attribute, and only having scalar, enum and string fields that are not
+ * repeated, private or constrained. The binary packer and unpacker and
+ * iop_equals() use it in place of their descriptor-driven implementation;
+ * the wire format is the same.
+ */
+typedef int (iop_codec_bpack_size_f)(const void * nonnull val,
+                                     unsigned flags);
+typedef uint8_t * nonnull (iop_codec_bpack_f)(uint8_t * nonnull dst,
+                                              const void * nonnull val,
+                                              unsigned flags);
+/* Returns a negative value for any input that is not the exact encoding of
+ * a value by the packer, in which case the generic unpacker is used. */
+typedef int (iop_codec_bunpack_f)(mem_pool_t * nonnull mp, pstream_t ps,
+                                  void * nonnull val, unsigned flags);
+typedef bool (iop_codec_equals_f)(const void * nonnull v1,
+                                  const void * nonnull v2);
+
+typedef struct iop_struct_codec_t {
+    iop_codec_bpack_size_f * nonnull bpack_size;
+    iop_codec_bpack_f      * nonnull bpack;
+    iop_codec_bunpack_f    * nonnull bunpack;
+    iop_codec_equals_f     * nonnull equals;
+} iop_struct_codec_t;
+
 typedef struct iop_struct_attrs_t {
     unsigned                 flags; /**< bitfield of iop_struct_attr_type_t */
     uint16_t                 attrs_len;
-    uint8_t                  version;   /**< version 0 */
+    uint8_t                  version;   /**< version 0 or 1 */
     uint8_t                  padding;
     const iop_struct_attr_t * nonnull attrs;
+
+    /* XXX do not dereference the following members without checking
+     * version >= 1 first (or IOP_STRUCT_HAS_CODEC for the codec) */
+    const iop_struct_codec_t * nullable codec;
 } iop_struct_attrs_t;
 
 typedef struct iop_static_field_t {
@@ -435,6 +466,7 @@ enum iop_struct_flags_t {
     IOP_STRUCT_IS_SNMP_OBJ,     /**< is it a snmpObj? */
     IOP_STRUCT_IS_SNMP_TBL,     /**< is it a snmpTbl? */
     IOP_STRUCT_IS_SNMP_PARAM,   /**< does it have @snmpParam? */
+    IOP_STRUCT_HAS_CODEC,       /**< st_attrs->codec exists */
 };
 
 /*}}}*/
@@ -20,6 +20,7 @@
 #define IS_LIB_COMMON_IOP_PRIV_H
 
 #include <lib-common/iop.h>
+#include <lib-common/sort.h>
 
 /* {{{ IOP environment */
 
@@ -67,6 +68,104 @@ static inline size_t iop_int_type_size(iop_type_t type)
     return 1 << (type >> 1);
 }
 
+/* }}} */
+/* {{{ Filters
+ *
+ * Helpers shared by the filters of the IOP objects (iop_filter_prog_t) and
+ * of the columns (iop_columns_filter_bitmap()).
+ */
+
+/** Comparison function used to sort and filter the values of a field. */
+cmp_f iop_get_cmp_fun(iop_type_t type);
+
+/** Equality function of the SQL LIKE patterns on strings. */
+int iop_string_sql_like(const void *s1, const void *s2);
+
+/** Compare a value to an element of an array of value pointers; \p arg is
+ * a pointer on the cmp_f of the values. */
+int iop_filter_value_cmp(const void *val, const void *elem, void *arg);
+
+static inline bool iop_filter_type_is_int(iop_type_t type)
+{
+    switch (type) {
+      case IOP_T_I8:  case IOP_T_U8:
+      case IOP_T_I16: case IOP_T_U16:
+      case IOP_T_I32: case IOP_T_U32:
+      case IOP_T_I64: case IOP_T_U64:
+      case IOP_T_ENUM:
+      case IOP_T_BOOL:
+        return true;
+      default:
+        return false;
+    }
+}
+
+/* The unsigned 64-bit integers are stored as they are: the keys can be
+ * compared for equality, but not ordered. */
+static ALWAYS_INLINE int64_t iop_filter_int_key(iop_type_t type,
+                                                const void *v)
+{
+    switch (type) {
+      case IOP_T_I8:   return *(const int8_t *)v;
+      case IOP_T_U8:   return *(const uint8_t *)v;
+      case IOP_T_I16:  return *(const int16_t *)v;
+      case IOP_T_U16:  return *(const uint16_t *)v;
+      case IOP_T_ENUM:
+      case IOP_T_I32:  return *(const int32_t *)v;
+      case IOP_T_U32:  return *(const uint32_t *)v;
+      case IOP_T_I64:
+      case IOP_T_U64:  return *(const int64_t *)v;
+      case IOP_T_BOOL: return *(const bool *)v;
+      default:         e_panic("iop_type unsupported");
+    }
+}
+
+/* Merge the matches of (up to) 8 objects into the bitmap; `from` is a
+ * multiple of 8. */
+static ALWAYS_INLINE void
+iop_filter_bitmap_merge(byte *bitmap, int from, int n, byte matches,
+                        iop_filter_bitmap_op_t op)
+{
+    byte mask = n >= 8 ? 0xff : (1U << n) - 1;
+
+    if (op == BITMAP_OP_AND) {
+        bitmap[from / 8] &= matches | ~mask;
+    } else {
+        bitmap[from / 8] |= matches & mask;
+    }
+}
+
+/* Filter the integer keys of the objects [_from, _to[ against the sorted
+ * _keys, 8 objects at a time; `_from` is a multiple of 8.
+ *
+ * _key is an expression giving the key of the object of index _pos, and
+ * _valid an expression giving the mask of the objects of the block starting
+ * at the index _blk that can match (before the inversion).
+ */
+#define IOP_FILTER_INT_LOOP(_blk, _pos, _from, _to, _key, _valid,           \
+                            _keys, _keys_len, _invert, _op, _bitmap)        \
+    for (int _blk = (_from); _blk < (_to); _blk += 8) {                      \
+        int __n = MIN(8, (_to) - _blk);                                      \
+        byte __matches = 0;                                                  \
+                                                                             \
+        for (int _pos = _blk; _pos < _blk + __n; _pos++) {                   \
+            int64_t __key = (_key);                                          \
+            bool __match;                                                    \
+                                                                             \
+            if ((_keys_len) == 1) {                                          \
+                __match = __key == (_keys)[0];                               \
+            } else {                                                         \
+                __match = contains_i64(__key, (_keys), (_keys_len));         \
+            }                                                                \
+            __matches |= __match << (_pos - _blk);                           \
+        }                                                                    \
+        __matches &= (_valid);                                               \
+        iop_filter_bitmap_merge((_bitmap), _blk, __n,                        \
+                                __matches ^ (_invert), (_op));               \
+    }
+
+/* }}} */
+/* {{{ Tests */
 
 /** Rough equivalent of memcmp() for IOP objects.
  *
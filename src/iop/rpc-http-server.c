@@ -188,6 +188,16 @@ int __t_ichttp_query_on_done_stage1(httpd_query_t *q, ichttp_cb_t **cbe,
     return 0;
 }
 
+/* Time spent by the query since the end of its reception. */
+static int64_t ichttp_query_get_queue_ns(const httpd_query_t *q)
+{
+    struct timeval now;
+
+    lp_gettv(&now);
+    return ((int64_t)(now.tv_sec - q->query_sec) * 1000000
+          + now.tv_usec - q->query_usec) * 1000;
+}
+
 void __t_ichttp_query_on_done_stage2(httpd_query_t *q, ichttp_cb_t *cbe,
                                      void *value)
 {
@@ -241,6 +251,11 @@ void __t_ichttp_query_on_done_stage2(httpd_query_t *q, ichttp_cb_t *cbe,
         return;
     }
 
+    ic_rpc_metrics_on_query(slot, IC_RPC_TRANSPORT_HTTP,
+                            tcb->mod->iface->fullname, cbe->fun,
+                            ichttp_query_get_queue_ns(q),
+                            q->received_body_length);
+
     switch (e->cb_type) {
       case IC_CB_NORMAL:
       case IC_CB_WS_SHARED:
@@ -251,8 +266,10 @@ void __t_ichttp_query_on_done_stage2(httpd_query_t *q, ichttp_cb_t *cbe,
         } else {
             (*e->u.iws_cb.cb)(NULL, slot, value, hdr);
         }
-        if (cbe->fun->async)
+        if (cbe->fun->async) {
             httpd_reply_202accepted(q);
+            ic_rpc_metrics_on_reply(slot, IC_MSG_OK, 0);
+        }
 
         t_unseal();
         return;
@@ -321,6 +338,7 @@ void __t_ichttp_query_on_done_stage2(httpd_query_t *q, ichttp_cb_t *cbe,
     __ic_query(pxy, msg);
     if (msg->async) {
         httpd_reply_202accepted(q);
+        ic_rpc_metrics_on_reply(slot, IC_MSG_OK, 0);
     }
 }
 
@@ -611,6 +629,7 @@ __ichttp_reply(uint64_t slot, int cmd, const iop_struct_t *st, const void *v)
     outbuf_sb_end(ob, oldlen);
 
     oblen = ob->length - oblen;
+    ic_rpc_metrics_on_reply(slot, cmd, oblen);
     if (tcb->on_reply) {
         (*tcb->on_reply)(tcb, iq, oblen, code);
     }
@@ -702,6 +721,7 @@ void __ichttp_reply_err(uint64_t slot, int err, const lstr_t *err_str)
     ichttp_query_t *iq = ichttp_slot_to_query(slot);
 
     ic_query_do_post_hook(NULL, err, slot, NULL, NULL);
+    ic_rpc_metrics_on_reply(slot, err, -1);
 
     switch (err) {
       case IC_MSG_OK:
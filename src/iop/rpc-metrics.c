@@ -0,0 +1,555 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2026 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#include <lib-common/iop-rpc.h>
+#include <lib-common/prometheus-client.h>
+#include <lib-common/thr.h>
+
+/* {{{ Types */
+
+/* Time buckets: 100us, 200us, 400us, ..., ~13s */
+#define IC_RPC_TIME_BUCKETS_START  100000
+#define IC_RPC_TIME_NB_BUCKETS         18
+
+/* Size buckets: 64B, 256B, 1kB, ..., 1GB */
+#define IC_RPC_SIZE_BUCKETS_START      64
+#define IC_RPC_SIZE_NB_BUCKETS         13
+
+#define IC_RPC_MAX_NB_BUCKETS  MAX(IC_RPC_TIME_NB_BUCKETS,                   \
+                                   IC_RPC_SIZE_NB_BUCKETS)
+#define IC_RPC_NB_STATUS       (IC_MSG_CANCELED + 1)
+
+/* Non-cumulative histogram. The last bucket counts the observations greater
+ * than the last upper bound. */
+typedef struct ic_rpc_histo_t {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t buckets[IC_RPC_MAX_NB_BUCKETS + 1];
+} ic_rpc_histo_t;
+
+typedef struct ic_rpc_stats_t {
+    ic_rpc_histo_t queue_time;
+    ic_rpc_histo_t server_time;
+    ic_rpc_histo_t req_size;
+    ic_rpc_histo_t res_size;
+    uint64_t       replies[IC_RPC_NB_STATUS];
+} ic_rpc_stats_t;
+qvector_t(ic_rpc_stats, ic_rpc_stats_t);
+
+/* An accounted RPC, on a given transport. */
+typedef struct ic_rpc_site_t {
+    uint32_t id;
+    ic_rpc_transport_t transport;
+    char *iface;
+    char *rpc;
+
+    /* Stats of the threads that exited. */
+    ic_rpc_stats_t retired;
+
+    /* Stats already flushed in the prometheus metrics. */
+    ic_rpc_stats_t exported;
+} ic_rpc_site_t;
+qvector_t(ic_rpc_site, ic_rpc_site_t *);
+qm_k64_t(ic_rpc_site, uint32_t);
+
+typedef struct ic_rpc_inflight_t {
+    uint32_t site;
+    int64_t  start_ns;
+} ic_rpc_inflight_t;
+qm_k64_t(ic_rpc_inflight, ic_rpc_inflight_t);
+
+/* Queries being served, by slot.
+ *
+ * A query can be replied from another thread than the one it was
+ * dispatched in, so they are shared by all the threads. They are split in
+ * buckets by slot, with a lock each, to avoid contention.
+ */
+#define IC_RPC_INFLIGHT_NB_BUCKETS  64
+
+typedef struct ic_rpc_inflight_bucket_t {
+    spinlock_t lock;
+    qm_t(ic_rpc_inflight) queries;
+} __attribute__((aligned(CACHE_LINE_SIZE))) ic_rpc_inflight_bucket_t;
+
+/* Per-thread stats.
+ *
+ * The lock of the shard is only shared between its thread, the scraper and
+ * the module shutdown, so it is almost never contended. When both are
+ * needed, the global lock is taken first.
+ */
+typedef struct ic_rpc_shard_t {
+    dlist_t link;
+    spinlock_t lock;
+    qv_t(ic_rpc_stats) stats;
+    qm_t(ic_rpc_site) site_ids;
+} ic_rpc_shard_t;
+
+bool ic_rpc_metrics_enabled_g;
+static __thread ic_rpc_shard_t *ic_rpc_shard_g;
+
+static struct {
+    logger_t logger;
+
+    /* Protects sites, site_ids and shards. */
+    spinlock_t lock;
+    qv_t(ic_rpc_site) sites;
+    qm_t(ic_rpc_site) site_ids;
+    dlist_t shards;
+
+    ic_rpc_inflight_bucket_t inflight[IC_RPC_INFLIGHT_NB_BUCKETS];
+
+    prom_histogram_t *queue_time;
+    prom_histogram_t *server_time;
+    prom_histogram_t *req_size;
+    prom_histogram_t *res_size;
+    prom_counter_t *replies;
+} ic_rpc_metrics_g = {
+#define _G  ic_rpc_metrics_g
+    .logger = LOGGER_INIT_INHERITS(NULL, "ic-rpc-metrics"),
+    .shards = DLIST_INIT(ic_rpc_metrics_g.shards),
+};
+
+/* }}} */
+/* {{{ Histograms */
+
+static ALWAYS_INLINE int ic_rpc_bucket_time(uint64_t ns)
+{
+    int bucket;
+
+    if (ns <= IC_RPC_TIME_BUCKETS_START) {
+        return 0;
+    }
+    /* Buckets grow by a factor 2 */
+    bucket = bsr64((ns - 1) / IC_RPC_TIME_BUCKETS_START) + 1;
+    return MIN(bucket, IC_RPC_TIME_NB_BUCKETS);
+}
+
+static ALWAYS_INLINE int ic_rpc_bucket_size(uint64_t size)
+{
+    int bucket;
+
+    if (size <= IC_RPC_SIZE_BUCKETS_START) {
+        return 0;
+    }
+    /* Buckets grow by a factor 4 */
+    bucket = bsr64((size - 1) / IC_RPC_SIZE_BUCKETS_START) / 2 + 1;
+    return MIN(bucket, IC_RPC_SIZE_NB_BUCKETS);
+}
+
+static ALWAYS_INLINE void
+ic_rpc_histo_observe(ic_rpc_histo_t *histo, int bucket, uint64_t value)
+{
+    histo->count++;
+    histo->sum += value;
+    histo->buckets[bucket]++;
+}
+
+static void ic_rpc_histo_add(ic_rpc_histo_t *dst, const ic_rpc_histo_t *src)
+{
+    dst->count += src->count;
+    dst->sum   += src->sum;
+    carray_for_each_pos(i, dst->buckets) {
+        dst->buckets[i] += src->buckets[i];
+    }
+}
+
+static void ic_rpc_stats_add(ic_rpc_stats_t *dst, const ic_rpc_stats_t *src)
+{
+    ic_rpc_histo_add(&dst->queue_time, &src->queue_time);
+    ic_rpc_histo_add(&dst->server_time, &src->server_time);
+    ic_rpc_histo_add(&dst->req_size, &src->req_size);
+    ic_rpc_histo_add(&dst->res_size, &src->res_size);
+    carray_for_each_pos(i, dst->replies) {
+        dst->replies[i] += src->replies[i];
+    }
+}
+
+/* }}} */
+/* {{{ Shards */
+
+static ic_rpc_shard_t *ic_rpc_shard_get(void)
+{
+    ic_rpc_shard_t *shard = ic_rpc_shard_g;
+
+    if (likely(shard)) {
+        return shard;
+    }
+
+    shard = p_new(ic_rpc_shard_t, 1);
+    qm_init(ic_rpc_site, &shard->site_ids);
+
+    spin_lock(&_G.lock);
+    dlist_add_tail(&_G.shards, &shard->link);
+    spin_unlock(&_G.lock);
+
+    return ic_rpc_shard_g = shard;
+}
+
+static void ic_rpc_metrics_thr_exit(void)
+{
+    ic_rpc_shard_t *shard = ic_rpc_shard_g;
+
+    if (!shard) {
+        return;
+    }
+
+    spin_lock(&_G.lock);
+    spin_lock(&shard->lock);
+
+    /* Keep the stats of the shard, so that they are not lost for the next
+     * scrapings. */
+    tab_for_each_pos(id, &shard->stats) {
+        ic_rpc_stats_add(&_G.sites.tab[id]->retired, &shard->stats.tab[id]);
+    }
+    dlist_remove(&shard->link);
+
+    spin_unlock(&shard->lock);
+    spin_unlock(&_G.lock);
+
+    qv_wipe(&shard->stats);
+    qm_wipe(ic_rpc_site, &shard->site_ids);
+    p_delete(&ic_rpc_shard_g);
+}
+thr_hooks(NULL, ic_rpc_metrics_thr_exit);
+
+/* Must be called without the lock of the shard held: the global lock is
+ * always taken before the locks of the shards. */
+static uint32_t ic_rpc_site_get_id(ic_rpc_shard_t *shard,
+                                   ic_rpc_transport_t transport,
+                                   lstr_t iface, const iop_rpc_t *rpc)
+{
+    /* RPC descriptions are aligned, so the transport fits in the lowest
+     * bits of their address. */
+    uint64_t key = (uintptr_t)rpc | transport;
+    int32_t pos;
+    uint32_t id;
+
+    spin_lock(&shard->lock);
+    pos = qm_find(ic_rpc_site, &shard->site_ids, key);
+    if (likely(pos >= 0)) {
+        id = shard->site_ids.values[pos];
+        spin_unlock(&shard->lock);
+        return id;
+    }
+    spin_unlock(&shard->lock);
+
+    spin_lock(&_G.lock);
+    pos = qm_reserve(ic_rpc_site, &_G.site_ids, key, 0);
+    if (pos & QHASH_COLLISION) {
+        id = _G.site_ids.values[pos & ~QHASH_COLLISION];
+    } else {
+        ic_rpc_site_t *site = p_new(ic_rpc_site_t, 1);
+
+        site->id = _G.sites.len;
+        site->transport = transport;
+        site->iface = p_dupz(iface.s, iface.len);
+        site->rpc = p_dupz(rpc->name.s, rpc->name.len);
+        qv_append(&_G.sites, site);
+        _G.site_ids.values[pos] = id = site->id;
+    }
+    spin_unlock(&_G.lock);
+
+    spin_lock(&shard->lock);
+    qm_replace(ic_rpc_site, &shard->site_ids, key, id);
+    spin_unlock(&shard->lock);
+    return id;
+}
+
+/* Must be called with the lock of the shard held. */
+static ic_rpc_stats_t *ic_rpc_shard_get_stats(ic_rpc_shard_t *shard,
+                                              uint32_t id)
+{
+    if (unlikely((int)id >= shard->stats.len)) {
+        int len = shard->stats.len;
+
+        qv_growlen0(&shard->stats, id + 1 - len);
+    }
+    return &shard->stats.tab[id];
+}
+
+static ic_rpc_inflight_bucket_t *ic_rpc_inflight_bucket(uint64_t slot)
+{
+    return &_G.inflight[u64_hash32(slot) % IC_RPC_INFLIGHT_NB_BUCKETS];
+}
+
+/* }}} */
+/* {{{ Hooks */
+
+int64_t ic_rpc_metrics_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void __ic_rpc_metrics_on_query(uint64_t slot, ic_rpc_transport_t transport,
+                               lstr_t iface, const iop_rpc_t *rpc,
+                               int64_t queue_ns, ssize_t size)
+{
+    ic_rpc_shard_t *shard = ic_rpc_shard_get();
+    ic_rpc_inflight_bucket_t *bucket = ic_rpc_inflight_bucket(slot);
+    ic_rpc_inflight_t inflight;
+    ic_rpc_stats_t *stats;
+
+    inflight.site = ic_rpc_site_get_id(shard, transport, iface, rpc);
+
+    spin_lock(&shard->lock);
+    stats = ic_rpc_shard_get_stats(shard, inflight.site);
+    if (queue_ns >= 0) {
+        ic_rpc_histo_observe(&stats->queue_time,
+                             ic_rpc_bucket_time(queue_ns), queue_ns);
+    }
+    if (size >= 0) {
+        ic_rpc_histo_observe(&stats->req_size, ic_rpc_bucket_size(size),
+                             size);
+    }
+    spin_unlock(&shard->lock);
+
+    inflight.start_ns = ic_rpc_metrics_now();
+    spin_lock(&bucket->lock);
+    qm_replace(ic_rpc_inflight, &bucket->queries, slot, inflight);
+    spin_unlock(&bucket->lock);
+}
+
+void __ic_rpc_metrics_on_reply(uint64_t slot, ic_status_t status,
+                               ssize_t size)
+{
+    ic_rpc_inflight_bucket_t *bucket = ic_rpc_inflight_bucket(slot);
+    ic_rpc_shard_t *shard;
+    ic_rpc_inflight_t inflight;
+    ic_rpc_stats_t *stats;
+    int64_t duration;
+    int32_t pos;
+
+    spin_lock(&bucket->lock);
+    pos = qm_find(ic_rpc_inflight, &bucket->queries, slot);
+    if (pos < 0) {
+        spin_unlock(&bucket->lock);
+        return;
+    }
+    inflight = bucket->queries.values[pos];
+    qm_del_at(ic_rpc_inflight, &bucket->queries, pos);
+    spin_unlock(&bucket->lock);
+
+    duration = MAX(ic_rpc_metrics_now() - inflight.start_ns, 0);
+
+    /* The reply is accounted in the shard of the replying thread. */
+    shard = ic_rpc_shard_get();
+    spin_lock(&shard->lock);
+    stats = ic_rpc_shard_get_stats(shard, inflight.site);
+    ic_rpc_histo_observe(&stats->server_time, ic_rpc_bucket_time(duration),
+                         duration);
+    if (size >= 0) {
+        ic_rpc_histo_observe(&stats->res_size, ic_rpc_bucket_size(size),
+                             size);
+    }
+    if ((unsigned)status < IC_RPC_NB_STATUS) {
+        stats->replies[status]++;
+    }
+    spin_unlock(&shard->lock);
+}
+
+/* }}} */
+/* {{{ Prometheus export */
+
+static const char *ic_rpc_transport_to_str(ic_rpc_transport_t transport)
+{
+    switch (transport) {
+      case IC_RPC_TRANSPORT_IC:   return "ic";
+      case IC_RPC_TRANSPORT_HTTP: return "http";
+      default:                    return "unknown";
+    }
+}
+
+static void ic_rpc_histo_export(prom_histogram_t *histo,
+                                const ic_rpc_site_t *site,
+                                const ic_rpc_histo_t *total,
+                                const ic_rpc_histo_t *exported,
+                                double unit)
+{
+    double buckets[IC_RPC_MAX_NB_BUCKETS + 1];
+    prom_histogram_t *child;
+
+    if (total->count == exported->count) {
+        return;
+    }
+    carray_for_each_pos(i, buckets) {
+        buckets[i] = total->buckets[i] - exported->buckets[i];
+    }
+
+    child = prom_histogram_labels(histo, site->iface, site->rpc,
+                                  ic_rpc_transport_to_str(site->transport));
+    obj_vcall(child, observe_many, total->count - exported->count,
+              (total->sum - exported->sum) * unit, buckets);
+}
+
+static void ic_rpc_site_export(ic_rpc_site_t *site,
+                               const ic_rpc_stats_t *total)
+{
+    const char *transport = ic_rpc_transport_to_str(site->transport);
+
+    ic_rpc_histo_export(_G.queue_time, site, &total->queue_time,
+                        &site->exported.queue_time, 1e-9);
+    ic_rpc_histo_export(_G.server_time, site, &total->server_time,
+                        &site->exported.server_time, 1e-9);
+    ic_rpc_histo_export(_G.req_size, site, &total->req_size,
+                        &site->exported.req_size, 1);
+    ic_rpc_histo_export(_G.res_size, site, &total->res_size,
+                        &site->exported.res_size, 1);
+
+    carray_for_each_pos(status, total->replies) {
+        uint64_t delta;
+        prom_counter_t *child;
+
+        delta = total->replies[status] - site->exported.replies[status];
+        if (!delta) {
+            continue;
+        }
+        child = prom_counter_labels(_G.replies, site->iface, site->rpc,
+                                    transport,
+                                    ic_status_to_string(status));
+        obj_vcall(child, add, delta);
+    }
+
+    site->exported = *total;
+}
+
+static void ic_rpc_metrics_on_scrape(void)
+{
+    qv_t(ic_rpc_stats) totals;
+
+    qv_init(&totals);
+
+    spin_lock(&_G.lock);
+
+    qv_growlen(&totals, _G.sites.len);
+    tab_for_each_pos(id, &_G.sites) {
+        totals.tab[id] = _G.sites.tab[id]->retired;
+    }
+
+    dlist_for_each_entry(ic_rpc_shard_t, shard, &_G.shards, link) {
+        spin_lock(&shard->lock);
+        tab_for_each_pos(id, &shard->stats) {
+            ic_rpc_stats_add(&totals.tab[id], &shard->stats.tab[id]);
+        }
+        spin_unlock(&shard->lock);
+    }
+
+    spin_unlock(&_G.lock);
+
+    /* Sites are never removed, so they can be used unlocked (the scraper
+     * is the only one accessing their exported stats). */
+    tab_for_each_pos(id, &totals) {
+        ic_rpc_site_export(_G.sites.tab[id], &totals.tab[id]);
+    }
+
+    qv_wipe(&totals);
+}
+
+/* }}} */
+/* {{{ Module */
+
+static int ic_rpc_metrics_initialize(void *arg)
+{
+    qv_init(&_G.sites);
+    qm_init(ic_rpc_site, &_G.site_ids);
+    carray_for_each_ptr(bucket, _G.inflight) {
+        qm_init(ic_rpc_inflight, &bucket->queries);
+    }
+
+    _G.queue_time = prom_histogram_new("ic_rpc_queue_seconds",
+        "Time spent by RPC queries before being dispatched",
+        "iface", "rpc", "transport");
+    prom_histogram_set_exponential_buckets(_G.queue_time,
+        IC_RPC_TIME_BUCKETS_START * 1e-9, 2, IC_RPC_TIME_NB_BUCKETS);
+
+    _G.server_time = prom_histogram_new("ic_rpc_server_seconds",
+        "Time spent between the dispatch of RPC queries and their reply",
+        "iface", "rpc", "transport");
+    prom_histogram_set_exponential_buckets(_G.server_time,
+        IC_RPC_TIME_BUCKETS_START * 1e-9, 2, IC_RPC_TIME_NB_BUCKETS);
+
+    _G.req_size = prom_histogram_new("ic_rpc_request_bytes",
+        "Size of the RPC queries payloads",
+        "iface", "rpc", "transport");
+    prom_histogram_set_exponential_buckets(_G.req_size,
+        IC_RPC_SIZE_BUCKETS_START, 4, IC_RPC_SIZE_NB_BUCKETS);
+
+    _G.res_size = prom_histogram_new("ic_rpc_response_bytes",
+        "Size of the RPC replies payloads",
+        "iface", "rpc", "transport");
+    prom_histogram_set_exponential_buckets(_G.res_size,
+        IC_RPC_SIZE_BUCKETS_START, 4, IC_RPC_SIZE_NB_BUCKETS);
+
+    _G.replies = prom_counter_new("ic_rpc_replies_total",
+        "Number of RPC replies, by status",
+        "iface", "rpc", "transport", "status");
+
+    prom_collector_add_scrape_hook(&ic_rpc_metrics_on_scrape);
+    ic_rpc_metrics_enabled_g = true;
+
+    return 0;
+}
+
+static int ic_rpc_metrics_shutdown(void)
+{
+    ic_rpc_metrics_enabled_g = false;
+    prom_collector_remove_scrape_hook(&ic_rpc_metrics_on_scrape);
+
+    /* The shards belong to their threads and are only released when the
+     * threads exit, so just reset them: the sites are about to be
+     * destroyed. */
+    spin_lock(&_G.lock);
+    dlist_for_each_entry(ic_rpc_shard_t, shard, &_G.shards, link) {
+        spin_lock(&shard->lock);
+        qv_clear(&shard->stats);
+        qm_clear(ic_rpc_site, &shard->site_ids);
+        spin_unlock(&shard->lock);
+    }
+    spin_unlock(&_G.lock);
+
+    carray_for_each_ptr(bucket, _G.inflight) {
+        spin_lock(&bucket->lock);
+        qm_wipe(ic_rpc_inflight, &bucket->queries);
+        spin_unlock(&bucket->lock);
+    }
+
+    tab_for_each_entry(site, &_G.sites) {
+        p_delete(&site->iface);
+        p_delete(&site->rpc);
+        p_delete(&site);
+    }
+    qv_wipe(&_G.sites);
+    qm_wipe(ic_rpc_site, &_G.site_ids);
+
+    obj_delete(&_G.queue_time);
+    obj_delete(&_G.server_time);
+    obj_delete(&_G.req_size);
+    obj_delete(&_G.res_size);
+    obj_delete(&_G.replies);
+
+    return 0;
+}
+
+MODULE_BEGIN(ic_rpc_metrics)
+    MODULE_DEPENDS_ON(prometheus_client);
+    MODULE_DEPENDS_ON(ic);
+MODULE_END()
+
+/* }}} */
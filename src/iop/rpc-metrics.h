@@ -0,0 +1,122 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2026 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#if !defined(IS_LIB_COMMON_IOP_RPC_H) \
+ || defined(IS_LIB_COMMON_IOP_RPC_METRICS_H)
+#  error "you must include <lib-common/iop-rpc.h> instead"
+#else
+#define IS_LIB_COMMON_IOP_RPC_METRICS_H
+
+/* Per-RPC prometheus metrics.
+ *
+ * When the ic_rpc_metrics module is loaded, every RPC served through an
+ * ichannel or through IOP-over-HTTP is accounted in the following
+ * prometheus metrics, labelled by interface, RPC and transport:
+ *
+ *  - ic_rpc_queue_seconds: time spent between the reception of the query and
+ *    its dispatch to its implementation (for ichannels, time spent behind the
+ *    queries that were received in the same read batch; for HTTP, time spent
+ *    between the end of the reception of the query and its dispatch).
+ *  - ic_rpc_server_seconds: time spent between the dispatch of the query and
+ *    its reply.
+ *  - ic_rpc_request_bytes: size of the packed (or HTTP) query payloads.
+ *  - ic_rpc_response_bytes: size of the packed (or HTTP) answer payloads.
+ *  - ic_rpc_replies_total: number of replies, by status.
+ *
+ * Observations are recorded without any lock shared between threads: each
+ * thread accounts in its own shard, and the shards are merged in the
+ * prometheus metrics only when they are scraped (see
+ * prom_collector_add_scrape_hook). Only the queries being served are in a
+ * table shared by the threads, split in buckets with their own lock. The
+ * cost for an RPC is three hash lookups and two monotonic clock reads when
+ * the module is loaded, and a single predictable test when it is not.
+ *
+ * Only the server side of the RPCs is accounted.
+ */
+
+typedef enum ic_rpc_transport_t {
+    IC_RPC_TRANSPORT_IC,
+    IC_RPC_TRANSPORT_HTTP,
+
+    IC_RPC_TRANSPORT_count,
+} ic_rpc_transport_t;
+
+/** Whether the RPC metrics are being collected. */
+extern bool ic_rpc_metrics_enabled_g;
+
+/** Return a monotonic timestamp, in nanoseconds.
+ *
+ * This is the clock used for the RPC metrics timings.
+ */
+int64_t ic_rpc_metrics_now(void);
+
+void __ic_rpc_metrics_on_query(uint64_t slot, ic_rpc_transport_t transport,
+                               lstr_t iface, const iop_rpc_t * nonnull rpc,
+                               int64_t queue_ns, ssize_t size);
+void __ic_rpc_metrics_on_reply(uint64_t slot, ic_status_t status,
+                               ssize_t size);
+
+/** Account the dispatch of a query to its implementation.
+ *
+ * \param[in]  slot       the slot of the query, as given to the
+ *                        implementation.
+ * \param[in]  transport  the transport on which the query was received.
+ * \param[in]  iface      the full name of the interface of the RPC.
+ * \param[in]  rpc        the RPC description.
+ * \param[in]  queue_ns   the time the query waited before being dispatched,
+ *                        in nanoseconds, or a negative value if unknown.
+ * \param[in]  size       the size of the query payload, or a negative value
+ *                        if unknown (for example for local ichannels).
+ */
+#define ic_rpc_metrics_on_query(slot, transport, iface, rpc, queue_ns, size) \
+    do {                                                                     \
+        if (unlikely(ic_rpc_metrics_enabled_g)) {                            \
+            __ic_rpc_metrics_on_query((slot), (transport), (iface), (rpc),   \
+                                      (queue_ns), (size));                   \
+        }                                                                    \
+    } while (0)
+
+/** Account the reply to a query.
+ *
+ * The reply is ignored if the query was not accounted by
+ * \ref ic_rpc_metrics_on_query, so it is safe to call it for every reply,
+ * including the replies to queries that were rejected before being
+ * dispatched. The reply can be sent from another thread than the query was
+ * dispatched in.
+ *
+ * \param[in]  slot    the slot of the query.
+ * \param[in]  status  the status of the reply.
+ * \param[in]  size    the size of the answer payload, or a negative value if
+ *                     unknown.
+ */
+#define ic_rpc_metrics_on_reply(slot, status, size)                          \
+    do {                                                                     \
+        if (unlikely(ic_rpc_metrics_enabled_g)) {                            \
+            __ic_rpc_metrics_on_reply((slot), (status), (size));             \
+        }                                                                    \
+    } while (0)
+
+/** RPC metrics module.
+ *
+ * The RPC metrics are collected while this module is loaded. It depends on
+ * the prometheus_client module; the metrics are exposed by the scraping
+ * server of the prometheus client (see prom_http_start_server).
+ */
+MODULE_DECLARE(ic_rpc_metrics);
+
+#endif
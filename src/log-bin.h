@@ -0,0 +1,81 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2026 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#ifndef IS_LIB_COMMON_LOG_BIN_H
+#define IS_LIB_COMMON_LOG_BIN_H
+
+#include <lib-common/file-log.h>
+#include <lib-common/log.h>
+
+/* This module provides a binary mode for the logs: instead of being
+ * formatted, the accepted logs are written in a log file as the identifier
+ * of their format string followed by the raw bytes of their arguments, and
+ * are only formatted when the file is decoded, with the log-bin-decode tool
+ * or \ref log_bin_decode_record.
+ *
+ * The strings are copied, as well as the memory printed with the "%*pM",
+ * "%*pX", "%*px", "%*pd", "%*pu", "%*ph" and "%*pH" formats. The arguments
+ * printed with the other extended formats (like "%pL") and with "%m" are
+ * formatted when the log is written, as their formatters may not be
+ * available to the decoder. The "long double" values are recorded as
+ * "double".
+ *
+ * The log file must have been opened with the file bin library; each log is
+ * a record of the file. The format strings are defined in each file before
+ * their first use.
+ */
+
+/** Start writing the accepted logs in binary form in a log file.
+ *
+ * The handler of the logs is replaced until \ref log_bin_stop is called.
+ * The file is used from all the threads emitting logs, and its rotation is
+ * handled by the binary log handler; it must not be written by the caller
+ * until \ref log_bin_stop is called.
+ *
+ * \param[in]  file  The log file, opened with log_file_open(file, true).
+ */
+void log_bin_start(log_file_t *file);
+
+/** Stop the binary mode, and restore the previous handler. */
+void log_bin_stop(void);
+
+/** State of the decoding of a binary log file. */
+typedef struct log_bin_decoder_t {
+    /* Format strings, indexed by their identifier. */
+    qv_t(lstr) fmts;
+} log_bin_decoder_t;
+
+log_bin_decoder_t *log_bin_decoder_init(log_bin_decoder_t *decoder);
+void log_bin_decoder_wipe(log_bin_decoder_t *decoder);
+
+/** Decode a record of a binary log file.
+ *
+ * The records must be decoded in the order of the file.
+ *
+ * \param[in]  decoder  The state of the decoding.
+ * \param[in]  record   The record.
+ * \param[out] out      The buffer in which the log is appended, as a line of
+ *                      text.
+ *
+ * \return 1 if a log was appended to \p out, 0 if the record is a format
+ *         definition, and -1 if the record is invalid.
+ */
+int log_bin_decode_record(log_bin_decoder_t *decoder, lstr_t record,
+                          sb_t *out);
+
+#endif
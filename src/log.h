@@ -144,6 +144,11 @@ typedef struct logger_t {
     unsigned level_flags;
     unsigned default_level_flags;
 
+    /* Limits of the call sites using the logger, inherited from the
+     * closest ancestor that has some (see \ref logger_set_limits). */
+    unsigned site_rate;
+    unsigned site_sampling;
+
     lstr_t name;
     lstr_t full_name;
     struct logger_t * nullable parent;
@@ -266,6 +271,11 @@ typedef struct log_trace_spec_t {
     const char * nullable func;
     const char * nullable name;
     int level;
+
+    /* Limits of the matching call sites (see \ref logger_set_limits), 0 for
+     * none. */
+    unsigned rate;
+    unsigned sampling;
 } log_trace_spec_t;
 qvector_t(spec, log_trace_spec_t);
 
@@ -330,6 +340,71 @@ int __logger_is_traced(logger_t * nonnull logger, int level,
 
 #endif
 
+/** State of a call site of the simple logging API.
+ *
+ * It implements the limits of the call site (see \ref logger_set_limits),
+ * and is shared by all the threads. The state is reset when the
+ * configuration of the loggers changes. The limits are the ones of the
+ * logger the call site is used with, unless some specs set limits: they are
+ * then cached for the last logger used.
+ */
+typedef struct log_site_t {
+    /* Generation of the configuration of the state, even before its first
+     * use and while it is reset. */
+    atomic_uint conf_gen;
+
+    /* Some limits are configured, for any logger. */
+    atomic_bool limited;
+    /* Some specs set limits. */
+    atomic_bool by_specs;
+    /* The suppressed logs of the site are to be reported by a thread. */
+    atomic_bool pending;
+
+    /* Number of logs since the last sampled one. */
+    atomic_uint count;
+
+    /* Theoretical time of the next log of the rate limit, in µs. */
+    atomic_uint64_t tat;
+
+    /* Number of logs suppressed since the last accepted one. */
+    atomic_uint suppressed;
+
+    /* Limits set by the specs for a logger, protected by the lock. */
+    spinlock_t lock;
+    uint32_t logger_gen;
+    const logger_t * nullable logger;
+    unsigned rate;
+    unsigned sampling;
+} log_site_t;
+
+void __log_site_refresh(log_site_t * nonnull site) __attr_cold__;
+bool __log_site_accept(log_site_t * nonnull site, logger_t * nonnull logger,
+                       int level, lstr_t file, lstr_t func, int line);
+
+static ALWAYS_INLINE
+bool log_site_accept(log_site_t * nonnull site, logger_t * nonnull logger,
+                     int level, lstr_t file, lstr_t func, int line)
+{
+    if (unlikely(atomic_load_explicit(&site->conf_gen, memory_order_acquire)
+                 != log_conf_gen_g))
+    {
+        __log_site_refresh(site);
+    }
+    if (likely(!atomic_load_explicit(&site->limited, memory_order_relaxed)))
+    {
+        return true;
+    }
+    return __log_site_accept(site, logger, level, file, func, line);
+}
+
+/* Check the limits of the call site, before the formatting of the log. */
+#define __LOGGER_SITE_ACCEPT(__logger, __level)  ({                          \
+        static log_site_t __logger_site;                                     \
+                                                                             \
+        log_site_accept(&__logger_site, __logger, __level, LSTR(__FILE__),   \
+                        LSTR(__func__), __LINE__);                           \
+    })
+
 __attr_printf__(8, 0)
 int logger_vlog(logger_t * nonnull logger, int level, lstr_t prog, int pid,
                 lstr_t file, lstr_t func, int line,
@@ -413,14 +488,18 @@ static inline void __logger_exits(logger_t * nonnull logger,
         if (unlikely(!__builtin_constant_p(Level))) {                        \
             const int __logger_level = (Level);                              \
                                                                              \
-            if (__LOGGER_HAS_LEVEL(__logger, __logger_level)) {              \
+            if (__LOGGER_HAS_LEVEL(__logger, __logger_level)                 \
+            &&  __LOGGER_SITE_ACCEPT(__logger, __logger_level))              \
+            {                                                                \
                 __logger_log(__logger, __logger_level, LSTR_NULL_V, -1,      \
                              LSTR(__FILE__), LSTR(__func__), __LINE__,       \
                              Fmt, ##__VA_ARGS__);                            \
             }                                                                \
             __logger_res = __logger_level <= LOG_WARNING ? -1 : 0;           \
         } else {                                                             \
-            if (__LOGGER_HAS_LEVEL(__logger, (Level))) {                     \
+            if (__LOGGER_HAS_LEVEL(__logger, (Level))                        \
+            &&  __LOGGER_SITE_ACCEPT(__logger, (Level)))                     \
+            {                                                                \
                 __logger_log(__logger, (Level), LSTR_NULL_V, -1,             \
                              LSTR(__FILE__), LSTR(__func__), __LINE__,       \
                              Fmt, ##__VA_ARGS__);                            \
@@ -645,6 +724,33 @@ int logger_set_level(lstr_t name, int level, unsigned flags) __attr_leaf__;
  */
 int logger_reset_level(lstr_t name) __attr_leaf__;
 
+/** Limit the number of logs emitted by each call site of a logger.
+ *
+ * The limits apply to each call site of the simple logging API (\ref
+ * logger_warning, \ref logger_trace, ...) using the logger or one of its
+ * children that has no limits of its own, for all the threads together.
+ * They are checked before the formatting of the logs, which is skipped for
+ * the suppressed logs. When a log is accepted after some logs of its call
+ * site were suppressed, it is preceded by a line giving the number of
+ * suppressed logs. The numbers of suppressed logs that are still pending are
+ * also emitted every second by the thread that suppressed the first of them,
+ * while it logs through limited call sites, when a logger is wiped and when
+ * the thread exits.
+ *
+ * The logs of level LOG_CRIT and below are never suppressed. The limits can
+ * also be set on the call sites matching an IS_DEBUG spec, with the "%"
+ * (sampling) and "#" (rate) suffixes, e.g. "+http/server%100#10".
+ *
+ * \param[in] name      The full name of the logger.
+ * \param[in] rate      Maximum number of logs per second of each call site
+ *                      (which can emit up to \p rate logs in a burst), 0 for
+ *                      no limit.
+ * \param[in] sampling  Only emit 1 log out of \p sampling of each call
+ *                      site, 0 or 1 for all the logs.
+ */
+void logger_set_limits(lstr_t name, unsigned rate, unsigned sampling)
+    __attr_leaf__;
+
 /* }}} */
 /* Handlers {{{ */
 
@@ -685,6 +791,45 @@ extern int log_stderr_handler_teefd_g;
  */
 log_handler_f * nonnull log_set_handler(log_handler_f * nonnull handler);
 
+/** Policy of the asynchronous mode when the ring of a thread is full. */
+typedef enum log_async_overflow_t {
+    /** Drop the log, and count it in \ref log_async_get_dropped. */
+    LOG_ASYNC_DROP,
+    /** Wait for the writer thread to make room in the ring. */
+    LOG_ASYNC_BLOCK,
+} log_async_overflow_t;
+
+/** Start the asynchronous mode of the default handlers.
+ *
+ * In this mode, the default handlers still format the logs in the calling
+ * thread, but instead of writing them, they push them in a lock-free ring
+ * owned by the thread. A dedicated writer thread drains the rings of all the
+ * threads, and writes the logs in batches (one writev() for up to 256 logs),
+ * in the order of their emission.
+ *
+ * The critical logs, and the logs too big for the rings, are written
+ * synchronously after the pending logs, so the logs emitted before a
+ * fatal error or a panic are never lost.
+ *
+ * The asynchronous mode can also be enabled by setting the IS_LOG_ASYNC
+ * environment variable to "drop" (or to 1) or "block". It is disabled in
+ * the children after a fork.
+ *
+ * Custom handlers set with \ref log_set_handler are not affected.
+ *
+ * \return -1 if the writer thread could not be created.
+ */
+int log_start_async(log_async_overflow_t overflow);
+
+/** Stop the asynchronous mode, after writing all the pending logs. */
+void log_stop_async(void);
+
+/** Write all the pending logs of the asynchronous mode. */
+void log_async_flush(void);
+
+/** Get the number of logs dropped because of a full ring. */
+uint64_t log_async_get_dropped(void);
+
 /* }}} */
 /* Log buffer {{{ */
 
@@ -0,0 +1,304 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2026 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#include <lib-common/hash.h>
+#include <lib-common/http.h>
+
+/* Cache of the (compressed) bodies of the replies to GET queries.
+ *
+ * The entries are indexed by trigger path, remaining path, URL variables
+ * and content-coding, and kept in a LRU list (most recently used
+ * entries first) used to enforce the memory budget of the cache.
+ */
+
+typedef struct httpd_cache_entry_t {
+    dlist_t lru_link;
+    int     enc;
+    lstr_t  key;
+    lstr_t  ctype;
+    lstr_t  etag;
+    lstr_t  body;
+    char    data[];
+} httpd_cache_entry_t;
+
+qm_kvec_t(httpd_cache, lstr_t, httpd_cache_entry_t * nonnull,
+          qhash_lstr_hash, qhash_lstr_equal);
+
+struct httpd_cache_t {
+    size_t  max_size;
+    size_t  size;
+    dlist_t lru;
+    qm_t(httpd_cache) entries;
+};
+
+httpd_cache_t *httpd_cache_new(size_t max_size)
+{
+    httpd_cache_t *cache = p_new(httpd_cache_t, 1);
+
+    cache->max_size = max_size;
+    dlist_init(&cache->lru);
+    qm_init(httpd_cache, &cache->entries);
+    return cache;
+}
+
+static size_t httpd_cache_entry_size(const httpd_cache_entry_t *e)
+{
+    return sizeof(*e) + e->key.len + e->ctype.len + e->etag.len
+         + e->body.len;
+}
+
+static void httpd_cache_entry_remove(httpd_cache_t *cache,
+                                     httpd_cache_entry_t *e)
+{
+    qm_del_key(httpd_cache, &cache->entries, &e->key);
+    dlist_remove(&e->lru_link);
+    cache->size -= httpd_cache_entry_size(e);
+    p_delete(&e);
+}
+
+void httpd_cache_clear(httpd_cache_t *cache)
+{
+    dlist_for_each_entry(httpd_cache_entry_t, e, &cache->lru, lru_link) {
+        p_delete(&e);
+    }
+    dlist_init(&cache->lru);
+    qm_clear(httpd_cache, &cache->entries);
+    cache->size = 0;
+}
+
+void httpd_cache_delete(httpd_cache_t **cachep)
+{
+    if (*cachep) {
+        httpd_cache_clear(*cachep);
+        qm_wipe(httpd_cache, &(*cachep)->entries);
+        p_delete(cachep);
+    }
+}
+
+/* Select the content-coding of the reply among the ones accepted by the
+ * client; compress is not supported. */
+static int httpd_cache_select_enc(const httpd_qinfo_t *info)
+{
+    int accepted = httpd_qinfo_accept_enc_get(info);
+
+    if (accepted & HTTPD_ACCEPT_ENC_GZIP) {
+        return HTTPD_ACCEPT_ENC_GZIP;
+    }
+    if (accepted & HTTPD_ACCEPT_ENC_DEFLATE) {
+        return HTTPD_ACCEPT_ENC_DEFLATE;
+    }
+    return 0;
+}
+
+static lstr_t t_httpd_cache_key(const httpd_qinfo_t *info, int enc)
+{
+    return t_lstr_fmt("%d %*pM%*pM?%*pM", enc,
+                      PS_FMT_ARG(&info->prefix), PS_FMT_ARG(&info->query),
+                      PS_FMT_ARG(&info->vars));
+}
+
+/* Whether the If-None-Match list of entity-tags matches etag, using the weak
+ * comparison function (rfc 7232: §3.2). */
+static bool httpd_etag_list_match(pstream_t ps, lstr_t etag)
+{
+    ps_skipspaces(&ps);
+    if (ps_startswithstr(&ps, "*")) {
+        return true;
+    }
+    while (!ps_done(&ps)) {
+        pstream_t tag;
+
+        if (ps_get_ps_chr_and_skip(&ps, ',', &tag) < 0) {
+            tag = ps;
+            ps  = ps_initptr(ps.s_end, ps.s_end);
+        }
+        ps_trim(&tag);
+        ps_skipstr(&tag, "W/");
+        if (ps_memequal(&tag, etag.s, etag.len)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void httpd_cache_entry_reply(httpd_query_t *q,
+                                    const httpd_cache_entry_t *e)
+{
+    const httpd_qinfo_t *info = q->qinfo;
+    const http_qhdr_t *inm = NULL;
+    outbuf_t *ob;
+
+    if (info) {
+        inm = http_qhdr_find(info->hdrs, info->hdrs_len,
+                             HTTP_WKHDR_IF_NONE_MATCH);
+    }
+    if (inm && httpd_etag_list_match(inm->val, e->etag)) {
+        ob = httpd_reply_hdrs_start(q, HTTP_CODE_NOT_MODIFIED, false);
+        ob_addf(ob, "ETag: %*pM\r\n", LSTR_FMT_ARG(e->etag));
+        ob_adds(ob, "Vary: Accept-Encoding\r\n");
+        httpd_reply_hdrs_done(q, 0, false);
+        httpd_reply_done(q);
+        return;
+    }
+
+    ob = httpd_reply_hdrs_start(q, HTTP_CODE_OK, false);
+    ob_addf(ob, "Content-Type: %*pM\r\n", LSTR_FMT_ARG(e->ctype));
+    if (e->enc == HTTPD_ACCEPT_ENC_GZIP) {
+        ob_adds(ob, "Content-Encoding: gzip\r\n");
+    } else
+    if (e->enc == HTTPD_ACCEPT_ENC_DEFLATE) {
+        ob_adds(ob, "Content-Encoding: deflate\r\n");
+    }
+    ob_addf(ob, "ETag: %*pM\r\n", LSTR_FMT_ARG(e->etag));
+    ob_adds(ob, "Vary: Accept-Encoding\r\n");
+    httpd_reply_hdrs_done(q, e->body.len, false);
+    if (!info || info->method != HTTP_METHOD_HEAD) {
+        ob_add(ob, e->body.s, e->body.len);
+    }
+    httpd_reply_done(q);
+}
+
+bool httpd_reply_from_cache(httpd_query_t *q, httpd_cache_t *cache)
+{
+    t_scope;
+    const httpd_qinfo_t *info = q->qinfo;
+    lstr_t key;
+    int pos;
+    httpd_cache_entry_t *e;
+
+    if (q->answered || q->hdrs_started || !info
+    ||  (info->method != HTTP_METHOD_GET
+    &&   info->method != HTTP_METHOD_HEAD))
+    {
+        return false;
+    }
+
+    key = t_httpd_cache_key(info, httpd_cache_select_enc(info));
+    pos = qm_find(httpd_cache, &cache->entries, &key);
+    if (pos < 0) {
+        return false;
+    }
+
+    e = cache->entries.values[pos];
+    dlist_move(&cache->lru, &e->lru_link);
+    httpd_cache_entry_reply(q, e);
+    return true;
+}
+
+static httpd_cache_entry_t *
+httpd_cache_entry_new(lstr_t key, lstr_t ctype, lstr_t etag, lstr_t body,
+                      int enc)
+{
+    httpd_cache_entry_t *e;
+    char *p;
+
+    e = p_new_extra(httpd_cache_entry_t,
+                    key.len + ctype.len + etag.len + body.len);
+    e->enc = enc;
+    p = e->data;
+    e->key   = LSTR_INIT_V(p, key.len);
+    p = mempcpy(p, key.s, key.len);
+    e->ctype = LSTR_INIT_V(p, ctype.len);
+    p = mempcpy(p, ctype.s, ctype.len);
+    e->etag  = LSTR_INIT_V(p, etag.len);
+    p = mempcpy(p, etag.s, etag.len);
+    e->body  = LSTR_INIT_V(p, body.len);
+    memcpy(p, body.s, body.len);
+    return e;
+}
+
+void httpd_reply_cacheable(httpd_query_t *q, httpd_cache_t *cache,
+                           lstr_t ctype, lstr_t body)
+{
+    t_scope;
+    const httpd_qinfo_t *info = q->qinfo;
+    int enc = info ? httpd_cache_select_enc(info) : 0;
+    uint64_t hash = murmur3_128_hash_64(body.s, body.len);
+    sb_t zbody;
+    lstr_t etag;
+    lstr_t key;
+    httpd_cache_entry_t *e;
+    size_t size;
+    int pos;
+
+    if (q->answered || q->hdrs_started) {
+        return;
+    }
+
+    /* The entity-tags of the encoded representations must differ from the
+     * one of the identity representation (rfc 7232: §2.3.3). */
+    switch (enc) {
+      case HTTPD_ACCEPT_ENC_GZIP:
+        etag = t_lstr_fmt("\"%016jx-gzip\"", hash);
+        t_sb_init(&zbody, body.len / 4 + 64);
+        sb_add_compressed(&zbody, body.s, body.len, Z_BEST_COMPRESSION, true);
+        body = LSTR_SB_V(&zbody);
+        break;
+
+      case HTTPD_ACCEPT_ENC_DEFLATE:
+        etag = t_lstr_fmt("\"%016jx-deflate\"", hash);
+        t_sb_init(&zbody, body.len / 4 + 64);
+        sb_add_compressed(&zbody, body.s, body.len, Z_BEST_COMPRESSION,
+                          false);
+        body = LSTR_SB_V(&zbody);
+        break;
+
+      default:
+        etag = t_lstr_fmt("\"%016jx\"", hash);
+        break;
+    }
+
+    if (!info || (info->method != HTTP_METHOD_GET
+              &&  info->method != HTTP_METHOD_HEAD))
+    {
+        httpd_cache_entry_t tmp = {
+            .enc   = enc,
+            .ctype = ctype,
+            .etag  = etag,
+            .body  = body,
+        };
+
+        httpd_cache_entry_reply(q, &tmp);
+        return;
+    }
+
+    key  = t_httpd_cache_key(info, enc);
+    e    = httpd_cache_entry_new(key, ctype, etag, body, enc);
+    size = httpd_cache_entry_size(e);
+
+    pos = qm_find(httpd_cache, &cache->entries, &key);
+    if (pos >= 0) {
+        httpd_cache_entry_remove(cache, cache->entries.values[pos]);
+    }
+    if (size <= cache->max_size) {
+        while (cache->size + size > cache->max_size) {
+            httpd_cache_entry_remove(cache,
+                                     dlist_last_entry(&cache->lru,
+                                                      httpd_cache_entry_t,
+                                                      lru_link));
+        }
+        qm_add(httpd_cache, &cache->entries, &e->key, e);
+        dlist_add(&cache->lru, &e->lru_link);
+        cache->size += size;
+    }
+
+    httpd_cache_entry_reply(q, e);
+    if (size > cache->max_size) {
+        p_delete(&e);
+    }
+}
@@ -18,6 +18,7 @@
 
 #include <lib-common/datetime.h>
 #include <lib-common/http.h>
+#include <lib-common/unix.h>
 
 static void mime_put_http_ctype(outbuf_t *ob, const char *path)
 {
@@ -151,12 +152,82 @@ void httpd_reply_make_index(httpd_query_t *q, int dfd, bool head)
     }
 }
 
+/* Parse the Range header of a query (rfc 7233, §2.1).
+ *
+ * Only single byte ranges are supported: the other ones (multiple ranges,
+ * other units, invalid ranges) are ignored, as allowed by the RFC.
+ *
+ * Returns 0 if [*start, *end[ must be sent, 1 if the whole file must be
+ * sent, and -1 if the range is not satisfiable.
+ */
+static int httpd_parse_range(pstream_t ps, off_t size,
+                             off_t *start, off_t *end)
+{
+    uint64_t first, last;
+
+    ps_trim(&ps);
+    if (ps_skipcasestr(&ps, "bytes=") < 0 || memchr(ps.s, ',', ps_len(&ps))) {
+        return 1;
+    }
+    ps_trim(&ps);
+
+    if (ps_skipc(&ps, '-') == 0) {
+        /* Suffix range: the last bytes of the file */
+        if (ps_done(&ps) || !isdigit(ps.b[0])) {
+            return 1;
+        }
+        errno = 0;
+        last = ps_get_ull_ext(&ps, 10);
+        if (errno || !ps_done(&ps)) {
+            return 1;
+        }
+        if (!last || !size) {
+            return -1;
+        }
+        *start = size - MIN(last, (uint64_t)size);
+        *end   = size;
+        return 0;
+    }
+
+    if (ps_done(&ps) || !isdigit(ps.b[0])) {
+        return 1;
+    }
+    errno = 0;
+    first = ps_get_ull_ext(&ps, 10);
+    if (errno || ps_skipc(&ps, '-') < 0) {
+        return 1;
+    }
+    if (ps_done(&ps)) {
+        last = UINT64_MAX;
+    } else {
+        if (!isdigit(ps.b[0])) {
+            return 1;
+        }
+        last = ps_get_ull_ext(&ps, 10);
+        if (errno || !ps_done(&ps) || last < first) {
+            return 1;
+        }
+    }
+    if (first >= (uint64_t)size) {
+        return -1;
+    }
+    *start = first;
+    *end   = MIN(last, (uint64_t)size - 1) + 1;
+    return 0;
+}
+
 void httpd_reply_file(httpd_query_t *q, int dfd, const char *file, bool head)
 {
+    t_scope;
     int fd = openat(dfd, file, O_RDONLY);
+    http_code_t code = HTTP_CODE_OK;
     struct stat st;
+    const char *etag;
+    bool weak;
+    off_t start, end;
+    char *body = NULL;
+    bool copy = false;
     outbuf_t *ob;
-    void *map = NULL;
 
     if (fd < 0)
         goto ret404;
@@ -171,41 +242,116 @@ void httpd_reply_file(httpd_query_t *q, int dfd, const char *file, bool head)
     }
     if (!S_ISREG(st.st_mode))
         goto ret404;
-    if (!head && st.st_size > (16 << 10)) {
-        map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
-        if (map == MAP_FAILED) {
-            httpd_reject(q, INTERNAL_SERVER_ERROR, "mmap failed: %m");
+
+    weak = st.st_mtime >= lp_getsec() - 10;
+    etag = t_fmt("%s\"%jx-%jxx-%lx\"", weak ? "W/" : "",
+                 (int64_t)st.st_ino, st.st_size, st.st_mtime);
+
+    start = 0;
+    end   = st.st_size;
+    if (q->qinfo) {
+        const httpd_qinfo_t *info = q->qinfo;
+        const http_qhdr_t *range;
+        const http_qhdr_t *if_range;
+
+        range    = http_qhdr_find(info->hdrs, info->hdrs_len,
+                                  HTTP_WKHDR_RANGE);
+        if_range = http_qhdr_find(info->hdrs, info->hdrs_len,
+                                  HTTP_WKHDR_IF_RANGE);
+
+        /* If-Range requires a strong comparison of the validators, and
+         * dates are not supported: send the whole file in doubt. */
+        if (range && (!if_range || (!weak && ps_strequal(&if_range->val,
+                                                          etag))))
+        {
+            switch (httpd_parse_range(range->val, st.st_size,
+                                      &start, &end))
+            {
+              case 0:
+                code = HTTP_CODE_PARTIAL_CONTENT;
+                break;
+
+              case -1:
+                ob = httpd_reply_hdrs_start(q, HTTP_CODE_REQUEST_RANGE_UNSAT,
+                                            false);
+                ob_addf(ob, "Content-Range: bytes */%jd\r\n",
+                        (intmax_t)st.st_size);
+                httpd_reply_hdrs_done(q, 0, false);
+                httpd_reply_done(q);
+                close(fd);
+                return;
+
+              default:
+                break;
+            }
+        }
+    }
+
+    /* The length of the replies is an int. */
+    if (end - start > INT_MAX) {
+        close(fd);
+        httpd_reject(q, INTERNAL_SERVER_ERROR, "file or range too large");
+        return;
+    }
+
+    /* Read the small ranges before the headers, so that a read error can
+     * still be reported; the other ones are sent from the file.
+     *
+     * HTTP/2 streams only send the data of the buffer of their outbuf (and
+     * not its chunks), so the large ranges are copied in it for them, after
+     * the headers. */
+    if (!head && end > start && end - start <= OUTBUF_CHUNK_MIN_SIZE) {
+        body = t_new_raw(char, end - start);
+        if (xpread(fd, body, end - start, start) < 0) {
             close(fd);
+            httpd_reject(q, INTERNAL_SERVER_ERROR, "cannot read file");
+            return;
+        }
+    } else if (!head && end > start && q->owner && q->owner->use_http2) {
+        copy = true;
+        if (lseek(fd, start, SEEK_SET) < 0) {
+            close(fd);
+            httpd_reject(q, INTERNAL_SERVER_ERROR, "cannot read file");
             return;
         }
-        madvise(map, st.st_size, MADV_SEQUENTIAL);
     }
 
-    ob = httpd_reply_hdrs_start(q, HTTP_CODE_OK, false);
+    ob = httpd_reply_hdrs_start(q, code, false);
     httpd_put_date_hdr(ob, "Last-Modified", st.st_mtime);
-    if (st.st_mtime >= lp_getsec() - 10) {
-        ob_addf(ob, "ETag: W/\"%jx-%jxx-%lx\"\r\n",
-                (int64_t)st.st_ino, st.st_size, st.st_mtime);
-    } else {
-        ob_addf(ob, "ETag: \"%jx-%jxx-%lx\"\r\n",
-                (int64_t)st.st_ino, st.st_size, st.st_mtime);
+    ob_addf(ob, "ETag: %s\r\n", etag);
+    ob_adds(ob, "Accept-Ranges: bytes\r\n");
+    if (code == HTTP_CODE_PARTIAL_CONTENT) {
+        ob_addf(ob, "Content-Range: bytes %jd-%jd/%jd\r\n",
+                (intmax_t)start, (intmax_t)end - 1, (intmax_t)st.st_size);
     }
     mime_put_http_ctype(ob, file);
-    httpd_reply_hdrs_done(q, st.st_size, false);
-    if (!head) {
-        if (map) {
-            ob_add_memmap(ob, map, st.st_size);
+    httpd_reply_hdrs_done(q, end - start, false);
+    if (body) {
+        ob_add(ob, body, end - start);
+    } else if (!head && end > start) {
+        int res;
+
+        if (copy) {
+            res = ob_xread(ob, fd, end - start);
         } else {
-            ob_xread(ob, fd, st.st_size);
+            /* The file is not loaded in memory, but sent from the file
+             * descriptor (using sendfile(2) on plaintext connections); the
+             * outbuf takes its ownership. */
+            res = ob_add_file_range(ob, fd, start, end - start, true);
+            fd = -1;
+        }
+        if (res < 0 && q->owner) {
+            /* The Content-Length is already sent: close the connection,
+             * so that the client sees that the body is truncated. */
+            httpd_close_gently(q->owner);
         }
     }
     httpd_reply_done(q);
-    close(fd);
+    p_close(&fd);
     return;
 
   ret404:
-    if (fd >= 0)
-        close(fd);
+    p_close(&fd);
     httpd_reject(q, NOT_FOUND, "");
 }
 
@@ -241,3 +387,51 @@ httpd_trigger_t *httpd_trigger__static_dir_new(const char *path)
     memcpy(cbdir->dirpath, path, len + 1);
     return &cbdir->cb;
 }
+
+/* Tests {{{ */
+
+#include <lib-common/z.h>
+
+static int z_parse_range(const char *range, off_t size, int exp_res,
+                         off_t exp_start, off_t exp_end)
+{
+    off_t start = -1, end = -1;
+
+    Z_ASSERT_EQ(httpd_parse_range(ps_initstr(range), size, &start, &end),
+                exp_res, "range `%s`", range);
+    if (exp_res == 0) {
+        Z_ASSERT_EQ(start, exp_start, "range `%s`", range);
+        Z_ASSERT_EQ(end, exp_end, "range `%s`", range);
+    }
+    Z_HELPER_END;
+}
+
+Z_GROUP_EXPORT(httpd_static) {
+    Z_TEST(parse_range, "test the parsing of the Range header") {
+        /* Satisfiable byte ranges */
+        Z_HELPER_RUN(z_parse_range("bytes=0-4", 19, 0, 0, 5));
+        Z_HELPER_RUN(z_parse_range(" Bytes=5-100 ", 19, 0, 5, 19));
+        Z_HELPER_RUN(z_parse_range("bytes=10-", 19, 0, 10, 19));
+        Z_HELPER_RUN(z_parse_range("bytes=18-18", 19, 0, 18, 19));
+        Z_HELPER_RUN(z_parse_range("bytes=-9", 19, 0, 10, 19));
+        Z_HELPER_RUN(z_parse_range("bytes=-100", 19, 0, 0, 19));
+
+        /* Not satisfiable */
+        Z_HELPER_RUN(z_parse_range("bytes=19-", 19, -1, 0, 0));
+        Z_HELPER_RUN(z_parse_range("bytes=100-200", 19, -1, 0, 0));
+        Z_HELPER_RUN(z_parse_range("bytes=-0", 19, -1, 0, 0));
+        Z_HELPER_RUN(z_parse_range("bytes=0-", 0, -1, 0, 0));
+
+        /* Ignored: the whole file is sent */
+        Z_HELPER_RUN(z_parse_range("items=0-4", 19, 1, 0, 0));
+        Z_HELPER_RUN(z_parse_range("bytes=0-1,3-4", 19, 1, 0, 0));
+        Z_HELPER_RUN(z_parse_range("bytes=4-2", 19, 1, 0, 0));
+        Z_HELPER_RUN(z_parse_range("bytes=a-", 19, 1, 0, 0));
+        Z_HELPER_RUN(z_parse_range("bytes=1-a", 19, 1, 0, 0));
+        Z_HELPER_RUN(z_parse_range("bytes=-", 19, 1, 0, 0));
+        Z_HELPER_RUN(z_parse_range("bytes=99999999999999999999-", 19, 1,
+                                   0, 0));
+    } Z_TEST_END;
+} Z_GROUP_END;
+
+/* }}} */
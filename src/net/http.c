@@ -17,6 +17,7 @@
 /***************************************************************************/
 
 #include <sys/file.h>
+#include <lib-common/arith.h>
 #include <lib-common/unix.h>
 #include <lib-common/datetime.h>
 
@@ -28,6 +29,7 @@
 #include <lib-common/core/core.iop.h>
 
 #include <lib-common/file.h>
+#include <lib-common/probe.h>
 
 #include <openssl/ssl.h>
 
@@ -46,6 +48,8 @@ static struct {
     .ssl_keylog_file_path = NULL,
 };
 
+static probe_t httpd_trigger_probe_g = PROBE_INIT("httpd_trigger");
+
 /*
  * rfc 2616 TODO list:
  *
@@ -221,7 +225,7 @@ static inline void http_skipspaces(pstream_t *ps)
 static inline int http_getline(pstream_t *ps, unsigned max_len,
                                pstream_t *out)
 {
-    const char *p = memmem(ps->s, ps_len(ps), "\r\n", 2);
+    const char *p = scan_crlf(ps->s, ps_len(ps));
 
     if (unlikely(!p)) {
         *out = ps_initptr(NULL, NULL);
@@ -750,13 +754,18 @@ void httpd_reply_hdrs_done(httpd_query_t *q, int clen, bool chunked)
     assert (!q->hdrs_done);
     q->hdrs_done = true;
 
-    if (q->answer_code == HTTP_CODE_NO_CONTENT || (q->answer_code >= 100 &&
-                                                   q->answer_code < 199))
+    if (q->answer_code == HTTP_CODE_NO_CONTENT
+    ||  q->answer_code == HTTP_CODE_NOT_MODIFIED
+    ||  (q->answer_code >= 100 && q->answer_code < 199))
     {
         /* rfc 7230: §3.3.2
          * A server MUST NOT send a Content-Length header field in any
          * response with a status code of 1xx (Informational) or 204 (No
          * Content).
+         *
+         * 304 (Not Modified) responses have no body either, and may only
+         * advertise the length of the selected representation: just omit
+         * it.
          */
         assert (clen <= 0);
         ob_adds(ob, "\r\n");
@@ -1240,7 +1249,8 @@ static int httpd_parse_idle(httpd_t *w, pstream_t *ps)
     httpd_trigger_t *cb = NULL;
     struct timeval now;
 
-    if ((p = memmem(ps->s + start, ps_len(ps) - start, "\r\n\r\n", 4)) == NULL) {
+    p = (const uint8_t *)scan_crlfcrlf(ps->s + start, ps_len(ps) - start);
+    if (!p) {
         if (ps_len(ps) > w->cfg->header_size_max) {
             q = httpd_query_create(w, NULL);
             httpd_reject(q, FORBIDDEN, "Headers exceed %d octets",
@@ -1302,7 +1312,7 @@ static int httpd_parse_idle(httpd_t *w, pstream_t *ps)
         http_qhdr_t *qhdr = qv_growlen(&hdrs, 1);
 
         /* TODO: normalize, make "lists" */
-        qhdr->key = ps_get_cspan(&buf, &http_non_token);
+        qhdr->key = __ps_get_ps(&buf, scan_http_token(buf.s, ps_len(&buf)));
         if (ps_len(&qhdr->key) == 0 || __ps_getc(&buf) != ':') {
             httpd_reject(q, BAD_REQUEST,
                          "Header name is empty or not followed by a colon");
@@ -2102,7 +2112,10 @@ static void httpd_do_any(httpd_t *w, httpd_query_t *q, httpd_qinfo_t *req)
 
         /* Execute cb->cb if parsing and credentials are ok so far. */
         if (likely(!q->answered)) {
+            uint64_t start = probe_start();
+
             (*cb->cb)(cb, q, req);
+            probe_end(&httpd_trigger_probe_g, start);
         } else {
             /* Checking credentials failed, so return now and give no chance
              * to execute code at the end of this function. */
@@ -2490,7 +2503,8 @@ static int httpc_parse_idle(httpc_t *w, pstream_t *ps)
         return PARSE_ERROR;
     }
 
-    if ((p = memmem(ps->s + start, ps_len(ps) - start, "\r\n\r\n", 4)) == NULL) {
+    p = (const uint8_t *)scan_crlfcrlf(ps->s + start, ps_len(ps) - start);
+    if (!p) {
         if (ps_len(ps) > w->cfg->header_size_max) {
             return PARSE_ERROR;
         }
@@ -2515,7 +2529,7 @@ static int httpc_parse_idle(httpc_t *w, pstream_t *ps)
         http_qhdr_t *qhdr = qv_growlen(&hdrs, 1);
 
         /* TODO: normalize, make "lists" */
-        qhdr->key = ps_get_cspan(&buf, &http_non_token);
+        qhdr->key = __ps_get_ps(&buf, scan_http_token(buf.s, ps_len(&buf)));
         if (ps_len(&qhdr->key) == 0 || __ps_getc(&buf) != ':') {
             return PARSE_ERROR;
         }
@@ -2600,7 +2614,11 @@ static int httpc_parse_idle(httpc_t *w, pstream_t *ps)
         w->chunk_length = 0;
         w->state = HTTP_PARSER_CHUNK_HDR;
     } else {
-        if (clen < 0 && req.code == HTTP_CODE_NO_CONTENT) {
+        if (req.code == HTTP_CODE_NOT_MODIFIED) {
+            /* rfc 7230: §3.3.3: a 304 response never has a body, even
+             * with a Content-Length */
+            w->chunk_length = 0;
+        } else if (clen < 0 && req.code == HTTP_CODE_NO_CONTENT) {
             /* rfc 2616: §4.4: support no Content-Length */
             w->chunk_length = 0;
         } else if (clen < 0 && req.code == HTTP_CODE_OK && q->is_connect) {
@@ -4802,6 +4820,44 @@ static struct {
 #undef PSEUDO_HDR
 };
 
+#define HTTP2_DEFAULT_URGENCY  3
+
+/** Parse the value of a priority header (cf. RFC9218 §4 and §5).
+ *
+ * This is a structured field dictionary: only the urgency (u=0..7) and
+ * incremental (i, i=?0, i=?1) parameters are extracted, unknown or invalid
+ * members are ignored.
+ */
+static void http2_parse_priority(lstr_t val, http2_header_info_t *info)
+{
+    pstream_t ps = ps_initlstr(&val);
+
+    info->urgency = HTTP2_DEFAULT_URGENCY;
+    info->incremental = false;
+    while (!ps_done(&ps)) {
+        pstream_t member;
+
+        if (ps_get_ps_chr_and_skip(&ps, ',', &member) < 0) {
+            member = ps;
+            ps = ps_initptr(ps.s_end, ps.s_end);
+        }
+        ps_trim(&member);
+        if (ps_skipstr(&member, "u=") == 0) {
+            if (ps_len(&member) == 1 && member.s[0] >= '0'
+            &&  member.s[0] <= '7')
+            {
+                info->urgency = member.s[0] - '0';
+            }
+        } else
+        if (ps_strequal(&member, "i") || ps_strequal(&member, "i=?1")) {
+            info->incremental = true;
+        } else
+        if (ps_strequal(&member, "i=?0")) {
+            info->incremental = false;
+        }
+    }
+}
+
 /** Decode a header block.
  *
  * \param res: decoded headers info.
@@ -4868,6 +4924,9 @@ t_http2_conn_decode_header_block(http2_conn_t *w, pstream_t in,
             } else if (lstr_ascii_iequal(key, LSTR_IMMED_V("host"))) {
                 info.flags |= HTTP2_HDR_FLAG_HAS_HOST;
                 info.host = val;
+            } else if (lstr_ascii_iequal(key, LSTR_IMMED_V("priority"))) {
+                info.flags |= HTTP2_HDR_FLAG_HAS_PRIORITY;
+                http2_parse_priority(val, &info);
             }
             buf->len += len;
         }
@@ -5069,12 +5128,13 @@ http2_stream_send_response_headers(http2_conn_t *w, http2_stream_t *stream,
         http2_conn_pack_single_hdr(w, key, val, &out);
     }
     lstr_to_int(status, &code);
-    if (code == HTTP_CODE_NO_CONTENT || (code >= 100 && code < 199))
+    if (code == HTTP_CODE_NO_CONTENT || code == HTTP_CODE_NOT_MODIFIED
+    ||  (code >= 100 && code < 199))
     {
         /* rfc 7230: §3.3.2
          * A server MUST NOT send a Content-Length header field in any
          * response with a status code of 1xx (Informational) or 204 (No
-         * Content).
+         * Content). 304 (Not Modified) responses have no body either.
          */
         *clen = 0;
     }
@@ -6762,6 +6822,10 @@ typedef struct httpd_http2_ctx_t {
     /* offset into httpd's ob */
     int http2_sync_mark;
     uint32_t http2_stream_id : 31;
+
+    /* Priority of the response (cf. RFC9218 §4) */
+    uint8_t urgency;
+    bool incremental;
 } httpd_http2_ctx_t;
 
 static httpd_http2_ctx_t *httpd_http2_ctx_init(httpd_http2_ctx_t *ctx)
@@ -6819,6 +6883,11 @@ httpd_spawn_as_http2_stream(http2_server_t *server, uint32_t stream_id)
     http2_ctx->httpd = w;
     http2_ctx->server = server;
     http2_ctx->http2_stream_id = stream_id;
+    http2_ctx->urgency = HTTP2_DEFAULT_URGENCY;
+    /* Unlike the default of RFC9218 §4.2, responses without priority
+     * header are interleaved, so that a large download does not starve the
+     * other streams of the connection. */
+    http2_ctx->incremental = true;
     dlist_add_tail(&server->idle_httpds, &http2_ctx->http2_link);
     return w;
 }
@@ -6913,6 +6982,10 @@ http2_stream_on_headers_server(http2_conn_t *conn, http2_stream_t *stream,
     pstream_t ps;
     int res;
 
+    if (info->flags & HTTP2_HDR_FLAG_HAS_PRIORITY) {
+        stream->http2d_ctx->urgency = info->urgency;
+        stream->http2d_ctx->incremental = info->incremental;
+    }
     if (httpd_unpack_http2_headers(httpd, info, headerlines, eos) < 0) {
         goto malformed_err;
     }
@@ -7175,52 +7248,82 @@ http2_conn_stream_active_httpd(http2_conn_t *w, httpd_t *httpd, int max_sz)
     }
 }
 
+/* Size of the DATA quantum given to a stream per scheduling round. */
+#define HTTP2_SCHED_QUANTUM     (16 << 10)
+/* Max amount of data buffered in the conn ob by the scheduler. */
+#define HTTP2_SCHED_HIGH_MARK   (256 << 10)
+
+/** Pick the next active httpd allowed to send DATA.
+ *
+ * This follows the extensible prioritization scheme of RFC9218 §10: the
+ * streams with the lowest urgency that can progress (i.e. that have data to
+ * send and some room in their flow-control window) are served first. Among
+ * them, the first one in the active list is picked: non-incremental streams
+ * are left at their place by the caller so that they are sent one after the
+ * other, while incremental ones are moved at the end of the list after each
+ * quantum so that they are interleaved in a round-robin fashion.
+ */
+static httpd_http2_ctx_t *http2_server_sched_pick(http2_conn_t *w)
+{
+    http2_server_t *ctx = w->server_ctx;
+    httpd_http2_ctx_t *res = NULL;
+
+    dlist_for_each_entry(httpd_http2_ctx_t, httpd, &ctx->active_httpds,
+                         http2_link)
+    {
+        http2_stream_t *stream;
+
+        if (res && res->urgency <= httpd->urgency) {
+            continue;
+        }
+        if (httpd->http2_sync_mark <= 0) {
+            continue;
+        }
+        stream = http2_stream_get(w, httpd->http2_stream_id);
+        if (stream->send_window <= 0) {
+            continue;
+        }
+        res = httpd;
+    }
+    return res;
+}
+
 static void http2_conn_on_streams_can_write_server(http2_conn_t *w)
 {
     http2_server_t *ctx = w->server_ctx;
     dlist_t *httpds;
-    bool can_progress;
 
     httpds = &ctx->idle_httpds;
     dlist_for_each_entry(httpd_http2_ctx_t, httpd, httpds, http2_link) {
         http2_conn_stream_idle_httpd(w, httpd->httpd);
     }
-    httpds = &ctx->active_httpds;
-    do {
-#define OB_SEND_ALLOC   (8 << 10)
-#define OB_HIGH_MARK    (1 << 20)
-        /* A simple DATA send "scheduling" algorithm for active streams as we
-         * don't have a sophisticated frame-aware scheduler:
-         *  - To be fair, we allow each stream to send (i.e., output) up to
-         *    OB_SEND_ALLOC per each opportunity.
-         *  - We iterate over streams and continue this as long as one of
-         *    them can progress.
-         *  - However, we stop this once we have exceeded the OB_HIGH_MARK in
-         *    the conn buffer.
-         *  - This done because we don't want to delay too much the writing of
-         *    generated responses to the underlying socket (e.g., acks to
-         *    PING or SETTINGS in subsequent event callbacks to
-         *    http2_conn_on_event().
-         */
-        can_progress = false;
 
-        dlist_for_each_entry(httpd_http2_ctx_t, httpd, httpds, http2_link) {
-            int ob_len = w->ob.length;
-            int len;
+    /* DATA frames are sent by quanta of HTTP2_SCHED_QUANTUM bytes at most,
+     * chosen by priority (see http2_server_sched_pick()), within the
+     * connection and stream flow-control windows.
+     *
+     * We stop once HTTP2_SCHED_HIGH_MARK bytes are pending in the conn
+     * buffer: this bounds the delay for the responses that become ready
+     * later (and for our acks to PING or SETTINGS in subsequent event
+     * callbacks to http2_conn_on_event()) to the time needed to flush this
+     * amount of data, instead of queuing them behind large downloads.
+     */
+    while (w->ob.length < HTTP2_SCHED_HIGH_MARK && w->send_window > 0) {
+        httpd_http2_ctx_t *httpd = http2_server_sched_pick(w);
+        int len = MIN(w->send_window, HTTP2_SCHED_QUANTUM);
+        bool rotate;
 
-            if (ob_len >= OB_HIGH_MARK || w->send_window <= 0) {
-                can_progress = false;
-                break;
-            }
-            len = MIN(w->send_window, OB_SEND_ALLOC);
-            http2_conn_stream_active_httpd(w, httpd->httpd, len);
-            if (w->ob.length - ob_len >= len) {
-                can_progress = true;
-            }
+        if (!httpd) {
+            break;
         }
-#undef OB_HIGH_MARK
-#undef OB_SEND_ALLOC
-    } while (can_progress);
+        /* The httpd is closed when its last DATA frame is sent: only rotate
+         * the incremental ones that still have data to send afterwards. */
+        rotate = httpd->incremental && httpd->http2_sync_mark > len;
+        http2_conn_stream_active_httpd(w, httpd->httpd, len);
+        if (rotate) {
+            dlist_move_tail(&ctx->active_httpds, &httpd->http2_link);
+        }
+    }
 }
 
 static void http2_conn_on_close_server(http2_conn_t *w)
@@ -8007,7 +8110,10 @@ static void http2_conn_on_streams_can_write_client(http2_conn_t *w)
     do {
 #define OB_SEND_ALLOC   (8 << 10)
 #define OB_HIGH_MARK    (1 << 20)
-        /* XXX: see http2_conn_on_streams_can_write_server() */
+        /* XXX: requests are simply sent in a round-robin fashion, up to
+         * OB_SEND_ALLOC per stream and per round, as long as one of them
+         * can progress and until OB_HIGH_MARK is buffered (unlike responses,
+         * see http2_conn_on_streams_can_write_server()). */
         can_progress = false;
 
         dlist_for_each_entry(http2c_ctx_t, ctx, httpcs, link) {
@@ -8612,6 +8718,8 @@ enum zhttpd_flags {
     ZHTTPD_BASIC_AUTH      = (1 << 2),
     ZHTTPD_BEARER_AUTH     = (1 << 3),
     ZHTTPD_REDUCE_NODELAY  = (1 << 4),
+    ZHTTPD_CACHE           = (1 << 5),
+    ZHTTPD_FILE            = (1 << 6),
 };
 
 static struct {
@@ -8625,6 +8733,9 @@ static struct {
     bool got_io_error;
     bool cleanup_needed;
     sb_t auth_read;
+    httpd_cache_t *cache;
+    const char *file;
+    int nb_handled;
 } zhttpd_g;
 
 static void zhttpd_query_quit(void)
@@ -8658,6 +8769,17 @@ static void zhttpd_query_on_done(httpd_query_t *q)
         return;
     }
 
+    zhttpd_g.nb_handled++;
+    if (zhttpd_g.flags & ZHTTPD_FILE) {
+        httpd_reply_file(q, AT_FDCWD, zhttpd_g.file, false);
+        return;
+    }
+    if (zhttpd_g.flags & ZHTTPD_CACHE) {
+        httpd_reply_cacheable(q, zhttpd_g.cache, LSTR("text/plain"),
+                              LSTR("ZHTTPD OK"));
+        return;
+    }
+
     ob = httpd_reply_hdrs_start(q, HTTP_CODE_OK, false);
     ob_adds(ob, "Content-Type: text/plain\r\n");
     httpd_reply_hdrs_done(q, -1, false);
@@ -8670,6 +8792,11 @@ static void
 zhttpd_query_hook(httpd_trigger_t *tcb, struct httpd_query_t *q,
                    const httpd_qinfo_t *qi)
 {
+    if ((zhttpd_g.flags & ZHTTPD_CACHE)
+    &&  httpd_reply_from_cache(q, zhttpd_g.cache))
+    {
+        return;
+    }
     q->on_done = &zhttpd_query_on_done;
     q->qinfo = httpd_qinfo_dup(qi);
     httpd_bufferize(q, 1 << 20);
@@ -8990,6 +9117,207 @@ Z_GROUP_EXPORT(httpd) {
 
     } Z_TEST_END;
 
+    Z_TEST(cache, "test the cache of reply bodies")
+    {
+        t_scope;
+        lstr_t query = LSTR(
+            "GET /zchk/doc?v=1 HTTP/1.1\r\n"
+            "Host: 127.0.0.1\r\n"
+            "Content-Length: 0\r\n"
+            "\r\n");
+        lstr_t gz_query = LSTR(
+            "GET /zchk/doc?v=1 HTTP/1.1\r\n"
+            "Host: 127.0.0.1\r\n"
+            "Accept-Encoding: gzip\r\n"
+            "Content-Length: 0\r\n"
+            "\r\n");
+        lstr_t inm_query;
+        pstream_t ps;
+        pstream_t etag;
+
+        zhttpd_g.cache = httpd_cache_new(1 << 20);
+        zhttpd_g.nb_handled = 0;
+
+        /* First query: the handler is called */
+        Z_HELPER_RUN(zhttpd_setup(&query, ZHTTPD_CACHE));
+        Z_ASSERT(lstr_startswith(LSTR_SB_V(&zhttpd_g.read_buf),
+                                 LSTR("HTTP/1.1 200 OK")));
+        Z_ASSERT(lstr_endswith(LSTR_SB_V(&zhttpd_g.read_buf),
+                               LSTR("ZHTTPD OK")));
+        Z_ASSERT_EQ(zhttpd_g.nb_handled, 1);
+
+        ps = ps_initsb(&zhttpd_g.read_buf);
+        Z_ASSERT_N(ps_skip_after_str(&ps, "ETag: "));
+        Z_ASSERT_N(ps_get_ps_chr(&ps, '\r', &etag));
+        inm_query = t_lstr_fmt("GET /zchk/doc?v=1 HTTP/1.1\r\n"
+                               "Host: 127.0.0.1\r\n"
+                               "If-None-Match: \"foo\", W/%*pM\r\n"
+                               "Content-Length: 0\r\n"
+                               "\r\n", PS_FMT_ARG(&etag));
+        zhttpd_cleanup();
+
+        /* Second query: served from the cache */
+        Z_HELPER_RUN(zhttpd_setup(&query, ZHTTPD_CACHE));
+        Z_ASSERT(lstr_startswith(LSTR_SB_V(&zhttpd_g.read_buf),
+                                 LSTR("HTTP/1.1 200 OK")));
+        Z_ASSERT(lstr_endswith(LSTR_SB_V(&zhttpd_g.read_buf),
+                               LSTR("ZHTTPD OK")));
+        Z_ASSERT_EQ(zhttpd_g.nb_handled, 1);
+        zhttpd_cleanup();
+
+        /* Conditional query: not modified */
+        Z_HELPER_RUN(zhttpd_setup(&inm_query, ZHTTPD_CACHE |
+                                  ZHTTPD_QUERY_DONT_QUIT |
+                                  ZHTTPD_REDUCE_NODELAY));
+        Z_ASSERT(lstr_startswith(LSTR_SB_V(&zhttpd_g.read_buf),
+                                 LSTR("HTTP/1.1 304 Not Modified")));
+        Z_ASSERT(lstr_endswith(LSTR_SB_V(&zhttpd_g.read_buf),
+                               LSTR("\r\n\r\n")));
+        Z_ASSERT_EQ(zhttpd_g.nb_handled, 1);
+        zhttpd_cleanup();
+
+        /* Other content-coding: cached separately */
+        Z_HELPER_RUN(zhttpd_setup(&gz_query, ZHTTPD_CACHE |
+                                  ZHTTPD_QUERY_DONT_QUIT |
+                                  ZHTTPD_REDUCE_NODELAY));
+        Z_ASSERT(lstr_startswith(LSTR_SB_V(&zhttpd_g.read_buf),
+                                 LSTR("HTTP/1.1 200 OK")));
+        Z_ASSERT(lstr_contains(LSTR_SB_V(&zhttpd_g.read_buf),
+                               LSTR("Content-Encoding: gzip\r\n")));
+        Z_ASSERT_EQ(zhttpd_g.nb_handled, 2);
+        zhttpd_cleanup();
+
+        /* Clearing the cache */
+        httpd_cache_clear(zhttpd_g.cache);
+        Z_HELPER_RUN(zhttpd_setup(&query, ZHTTPD_CACHE));
+        Z_ASSERT(lstr_endswith(LSTR_SB_V(&zhttpd_g.read_buf),
+                               LSTR("ZHTTPD OK")));
+        Z_ASSERT_EQ(zhttpd_g.nb_handled, 3);
+        zhttpd_cleanup();
+
+        httpd_cache_delete(&zhttpd_g.cache);
+    } Z_TEST_END;
+
+    Z_TEST(file_range, "test the byte ranges of static files")
+    {
+        t_scope;
+        SB_1k(buf);
+        lstr_t content;
+        const struct timeval old_times[2] = { { .tv_sec = 1 },
+                                              { .tv_sec = 1 } };
+        lstr_t range_query = LSTR(
+            "GET /zchk HTTP/1.1\r\n"
+            "Host: 127.0.0.1\r\n"
+            "Range: bytes=-20009\r\n"
+            "Content-Length: 0\r\n"
+            "\r\n");
+        lstr_t small_range_query = LSTR(
+            "GET /zchk HTTP/1.1\r\n"
+            "Host: 127.0.0.1\r\n"
+            "Range: bytes=-9\r\n"
+            "Content-Length: 0\r\n"
+            "\r\n");
+        lstr_t unsat_query = LSTR(
+            "GET /zchk HTTP/1.1\r\n"
+            "Host: 127.0.0.1\r\n"
+            "Range: bytes=40000-\r\n"
+            "Content-Length: 0\r\n"
+            "\r\n");
+        lstr_t if_range_query;
+        pstream_t ps;
+        pstream_t etag_ps;
+        lstr_t etag;
+        int fd;
+
+        /* Larger than OUTBUF_CHUNK_MIN_SIZE, so that the whole file and the
+         * large ranges are sent from the file, and the small ones are
+         * copied. */
+        for (int i = 0; i < 3000; i++) {
+            sb_adds(&buf, "0123456789");
+        }
+        sb_adds(&buf, "ZHTTPD OK");
+        content = LSTR_SB_V(&buf);
+        Z_ASSERT_GT(content.len, OUTBUF_CHUNK_MIN_SIZE);
+
+        zhttpd_g.file = t_fmt("%*pM/file", LSTR_FMT_ARG(z_tmpdir_g));
+        fd = open(zhttpd_g.file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        Z_ASSERT_N(fd);
+        Z_ASSERT_N(xwrite(fd, content.s, content.len));
+        /* Old enough to have a strong ETag */
+        Z_ASSERT_N(futimes(fd, old_times));
+        close(fd);
+
+        /* Large range: the end of the file is sent from the file */
+        Z_HELPER_RUN(zhttpd_setup(&range_query, ZHTTPD_FILE));
+        Z_ASSERT(lstr_startswith(LSTR_SB_V(&zhttpd_g.read_buf),
+                                 LSTR("HTTP/1.1 206 Partial Content")));
+        Z_ASSERT(lstr_contains(LSTR_SB_V(&zhttpd_g.read_buf),
+                               LSTR("Content-Range: bytes "
+                                    "10000-30008/30009\r\n")));
+        ps = ps_initsb(&zhttpd_g.read_buf);
+        Z_ASSERT_N(ps_skip_after_str(&ps, "\r\n\r\n"));
+        Z_ASSERT_LSTREQUAL(LSTR_PS_V(&ps),
+                           LSTR_INIT_V(content.s + 10000,
+                                       content.len - 10000));
+
+        ps = ps_initsb(&zhttpd_g.read_buf);
+        Z_ASSERT_N(ps_skip_after_str(&ps, "ETag: "));
+        Z_ASSERT_N(ps_get_ps_chr(&ps, '\r', &etag_ps));
+        Z_ASSERT(!ps_startswithstr(&etag_ps, "W/"));
+        etag = t_lstr_dup(LSTR_PS_V(&etag_ps));
+        zhttpd_cleanup();
+
+        /* Small range: the end of the file is copied */
+        Z_HELPER_RUN(zhttpd_setup(&small_range_query, ZHTTPD_FILE));
+        Z_ASSERT(lstr_startswith(LSTR_SB_V(&zhttpd_g.read_buf),
+                                 LSTR("HTTP/1.1 206 Partial Content")));
+        Z_ASSERT(lstr_contains(LSTR_SB_V(&zhttpd_g.read_buf),
+                               LSTR("Content-Range: bytes "
+                                    "30000-30008/30009\r\n")));
+        Z_ASSERT(lstr_endswith(LSTR_SB_V(&zhttpd_g.read_buf),
+                               LSTR("\r\n\r\nZHTTPD OK")));
+        zhttpd_cleanup();
+
+        /* If-Range matching the ETag: the range is sent */
+        if_range_query = t_lstr_fmt("GET /zchk HTTP/1.1\r\n"
+                                    "Host: 127.0.0.1\r\n"
+                                    "Range: bytes=-9\r\n"
+                                    "If-Range: %*pM\r\n"
+                                    "Content-Length: 0\r\n"
+                                    "\r\n", LSTR_FMT_ARG(etag));
+        Z_HELPER_RUN(zhttpd_setup(&if_range_query, ZHTTPD_FILE));
+        Z_ASSERT(lstr_startswith(LSTR_SB_V(&zhttpd_g.read_buf),
+                                 LSTR("HTTP/1.1 206 Partial Content")));
+        zhttpd_cleanup();
+
+        /* If-Range not matching: the whole file is sent from the file */
+        if_range_query = LSTR("GET /zchk HTTP/1.1\r\n"
+                              "Host: 127.0.0.1\r\n"
+                              "Range: bytes=-9\r\n"
+                              "If-Range: \"foo\"\r\n"
+                              "Content-Length: 0\r\n"
+                              "\r\n");
+        Z_HELPER_RUN(zhttpd_setup(&if_range_query, ZHTTPD_FILE));
+        Z_ASSERT(lstr_startswith(LSTR_SB_V(&zhttpd_g.read_buf),
+                                 LSTR("HTTP/1.1 200 OK")));
+        Z_ASSERT(lstr_contains(LSTR_SB_V(&zhttpd_g.read_buf),
+                               LSTR("Content-Length: 30009\r\n")));
+        ps = ps_initsb(&zhttpd_g.read_buf);
+        Z_ASSERT_N(ps_skip_after_str(&ps, "\r\n\r\n"));
+        Z_ASSERT_LSTREQUAL(LSTR_PS_V(&ps), content);
+        zhttpd_cleanup();
+
+        /* Range out of the file */
+        Z_HELPER_RUN(zhttpd_setup(&unsat_query, ZHTTPD_FILE |
+                                  ZHTTPD_QUERY_DONT_QUIT |
+                                  ZHTTPD_REDUCE_NODELAY));
+        Z_ASSERT(lstr_startswith(LSTR_SB_V(&zhttpd_g.read_buf),
+                                 LSTR("HTTP/1.1 416 ")));
+        Z_ASSERT(lstr_contains(LSTR_SB_V(&zhttpd_g.read_buf),
+                               LSTR("Content-Range: bytes */30009\r\n")));
+        zhttpd_cleanup();
+    } Z_TEST_END;
+
     zhttpd_cleanup();
 } Z_GROUP_END;
 
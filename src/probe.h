@@ -0,0 +1,194 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2026 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#ifndef IS_LIB_COMMON_PROBE_H
+#define IS_LIB_COMMON_PROBE_H
+
+#include <lib-common/core.h>
+#include <lib-common/container-qvector.h>
+
+/* Latency probes.
+ *
+ * A probe is a named point of the code whose duration is recorded in a
+ * latency histogram, to find where the tail latencies come from without
+ * adding timings by hand:
+ *
+ *  static probe_t my_probe_g = PROBE_INIT("my_probe");
+ *
+ *  {
+ *      probe_scope(&my_probe_g);
+ *
+ *      ...
+ *  }
+ *
+ * The probes are recorded while the probe module is loaded. The callbacks of
+ * the event loop (probes el_fd, el_timer and el_proxy), the thread jobs
+ * (thr_job), the ichannel queries implementations (ic_query) and the httpd
+ * triggers (httpd_trigger) are instrumented.
+ *
+ * The durations are measured in CPU timestamp counter ticks, and recorded
+ * without any lock shared between threads: each thread owns an HDR
+ * histogram per probe (log-linear buckets, with a relative precision of
+ * 1/16), and the histograms of the threads are merged when they are read.
+ * When the module is not loaded, a probe costs a single predictable test.
+ *
+ * The histograms are dumped with the state of the modules (see the
+ * print_state module method, run on SIGPWR), or with probes_get_state(), and
+ * exported through the prometheus client by the probe_metrics module.
+ */
+
+typedef struct probe_t {
+    const char * nonnull name;
+
+    /* Index of the probe in the histograms of the threads, assigned at its
+     * first observation. */
+    atomic_int id;
+} probe_t;
+
+#define PROBE_INIT(_name)  { .name = (_name) }
+
+/** Whether the probes are being recorded. */
+extern bool probes_enabled_g;
+
+/** Read the CPU timestamp counter. */
+static ALWAYS_INLINE uint64_t probe_tsc(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+void __probe_observe(probe_t * nonnull probe, uint64_t ticks);
+
+/** Start measuring a probe.
+ *
+ * \return the start timestamp, to give to \ref probe_end, or 0 if the probes
+ *         are not recorded.
+ */
+static ALWAYS_INLINE uint64_t probe_start(void)
+{
+    return unlikely(probes_enabled_g) ? probe_tsc() : 0;
+}
+
+/** Record the duration of a probe since \ref probe_start. */
+static ALWAYS_INLINE void probe_end(probe_t * nonnull probe, uint64_t start)
+{
+    if (unlikely(start)) {
+        __probe_observe(probe, probe_tsc() - start);
+    }
+}
+
+typedef struct probe_ctx_t {
+    probe_t * nonnull probe;
+    uint64_t start;
+} probe_ctx_t;
+
+static inline void probe_ctx_end(probe_ctx_t * nonnull ctx)
+{
+    probe_end(ctx->probe, ctx->start);
+}
+
+/** Record the execution time of a block of code in a probe. */
+#define probe_scope(_probe)  \
+    __attribute__((unused,cleanup(probe_ctx_end)))                           \
+    probe_ctx_t PFX_LINE(probe_ctx_) = {                                     \
+        .probe = (_probe),                                                   \
+        .start = probe_start(),                                              \
+    }
+
+/* {{{ Histograms */
+
+/* Values below 2^PROBE_SUB_BITS ticks have their own bucket, the other ones
+ * are split in 2^PROBE_SUB_BITS buckets per power of two. The values of
+ * 2^PROBE_MAX_BITS ticks or more are accounted in the last bucket. */
+#define PROBE_SUB_BITS    4
+#define PROBE_SUB_BUCKETS (1 << PROBE_SUB_BITS)
+#define PROBE_MAX_BITS    48
+#define PROBE_NB_BUCKETS  \
+    ((PROBE_MAX_BITS - PROBE_SUB_BITS + 1) * PROBE_SUB_BUCKETS)
+
+typedef struct probe_histo_t {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+    uint64_t buckets[PROBE_NB_BUCKETS];
+} probe_histo_t;
+
+/** Return the bucket of a duration, in ticks. */
+static ALWAYS_INLINE int probe_histo_bucket(uint64_t ticks)
+{
+    int shift;
+
+    if (ticks < PROBE_SUB_BUCKETS) {
+        return ticks;
+    }
+    if (unlikely(ticks >> PROBE_MAX_BITS)) {
+        return PROBE_NB_BUCKETS - 1;
+    }
+    shift = bsr64(ticks) - PROBE_SUB_BITS;
+    return shift * PROBE_SUB_BUCKETS + (ticks >> shift);
+}
+
+/** Return the greatest duration, in ticks, accounted in a bucket. */
+uint64_t probe_histo_bucket_max(int bucket);
+
+/** Return the duration, in ticks, under which a ratio \p q of the
+ * observations of an histogram are (for example 0.99 for the 99th
+ * percentile), within the precision of the buckets.
+ */
+uint64_t probe_histo_percentile(const probe_histo_t * nonnull histo,
+                                double q);
+
+/** Return the duration of a tick, in nanoseconds. */
+double probe_ns_per_tick(void);
+
+/* }}} */
+/* {{{ Reading */
+
+typedef struct probe_stats_t {
+    const probe_t * nonnull probe;
+    probe_histo_t histo;
+} probe_stats_t;
+qvector_t(probe_stats, probe_stats_t);
+
+/** Get the histograms of the probes.
+ *
+ * \param[out] stats  filled with the histogram of every probe observed
+ *                    since the loading of the module, merged from all the
+ *                    threads, in the order of their first observation.
+ */
+void probes_get_stats(qv_t(probe_stats) * nonnull stats);
+
+/** Dump the count, mean, percentiles and max durations of the probes in a
+ * table. */
+void probes_get_state(sb_t * nonnull buf);
+
+/* }}} */
+
+/** Latency probes module.
+ *
+ * The probes are recorded while this module is loaded.
+ */
+MODULE_DECLARE(probe);
+
+#endif /* IS_LIB_COMMON_PROBE_H */
@@ -387,6 +387,20 @@ OBJ_CLASS(prom_gauge, prom_simple_value_metric,
                                                                              \
     /** Observe the given value. */                                          \
     void (*observe)(type_t *self, double value);                             \
+                                                                             \
+    /** Merge pre-aggregated observations.                                   \
+     *                                                                       \
+     * This is meant for code that aggregates observations on its own (for   \
+     * example in per-thread shards, to avoid taking the lock of the metric  \
+     * on hot paths) and periodically flushes them into the histogram.       \
+     *                                                                       \
+     * \p bucket_counts contains the number of observations that fell in     \
+     * each bucket (NOT cumulative), and MUST have \ref nb_buckets entries.  \
+     * Observations above the last upper bound are only accounted in \p      \
+     * count.                                                                \
+     */                                                                      \
+    void (*observe_many)(type_t *self, double count, double sum,             \
+                         const double *bucket_counts);                       \
 
 
 OBJ_CLASS(prom_histogram, prom_metric,
@@ -520,6 +534,31 @@ void prom_histogram_timer_finish(prom_histogram_timer_ctx_t *ctx);
     prom_histogram_timer_ctx_t PFX_LINE(rom_histogram_timer_ctx_) =          \
         prom_histogram_timer_start(_histogram)
 
+/* }}} */
+/* {{{ Scrape hooks */
+
+/** Callback run before the metrics are exposed. */
+typedef void (prom_scrape_hook_f)(void);
+
+/** Register a hook to be run before each scraping of the metrics.
+ *
+ * This allows code that aggregates its data outside of the prometheus
+ * metrics (for example per-thread) to flush it into the metrics only when
+ * somebody actually needs them.
+ *
+ * Hooks are run in the main thread, in their order of registration.
+ *
+ * This operation is NOT thread-safe.
+ */
+void prom_collector_add_scrape_hook(prom_scrape_hook_f *hook);
+
+/** Unregister a hook previously registered with
+ *  \ref prom_collector_add_scrape_hook.
+ *
+ * This operation is NOT thread-safe.
+ */
+void prom_collector_remove_scrape_hook(prom_scrape_hook_f *hook);
+
 /* }}} */
 /* {{{ HTTP server for scraping */
 
@@ -555,6 +594,14 @@ void prom_http_get_infos(lstr_t * nullable host, in_port_t * nullable port,
  */
 MODULE_DECLARE(prometheus_client);
 
+/** Latency probes export module.
+ *
+ * While this module is loaded, the histograms of the latency probes (see
+ * lib-common/probe.h) are exported in the probe_duration_seconds histogram
+ * metric, labelled by probe name.
+ */
+MODULE_DECLARE(probe_metrics);
+
 /* }}} */
 
 #endif /* IS_LIB_COMMON_PROMETHEUS_CLIENT_H */
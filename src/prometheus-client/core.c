@@ -22,10 +22,39 @@ logger_t prom_logger_g = LOGGER_INIT_INHERITS(NULL, "prometheus");
 
 dlist_t prom_collector_g;
 
+qv_t(prom_scrape_hook) prom_scrape_hooks_g;
+
+/* {{{ Scrape hooks */
+
+void prom_collector_add_scrape_hook(prom_scrape_hook_f *hook)
+{
+    qv_append(&prom_scrape_hooks_g, hook);
+}
+
+void prom_collector_remove_scrape_hook(prom_scrape_hook_f *hook)
+{
+    tab_for_each_pos(pos, &prom_scrape_hooks_g) {
+        if (prom_scrape_hooks_g.tab[pos] == hook) {
+            qv_remove(&prom_scrape_hooks_g, pos);
+            return;
+        }
+    }
+}
+
+void prom_collector_run_scrape_hooks(void)
+{
+    tab_for_each_entry(hook, &prom_scrape_hooks_g) {
+        (*hook)();
+    }
+}
+
+/* }}} */
+/* {{{ Module */
 
 static int prometheus_client_initialize(void *arg)
 {
     dlist_init(&prom_collector_g);
+    qv_init(&prom_scrape_hooks_g);
     return 0;
 }
 
@@ -36,6 +65,7 @@ static int prometheus_client_shutdown(void)
     {
         obj_delete(&metric);
     }
+    qv_wipe(&prom_scrape_hooks_g);
 
     return 0;
 }
@@ -43,3 +73,5 @@ static int prometheus_client_shutdown(void)
 MODULE_BEGIN(prometheus_client)
     MODULE_DEPENDS_ON(prometheus_client_http);
 MODULE_END()
+
+/* }}} */
@@ -46,6 +46,7 @@ static void metrics_query_on_done(httpd_query_t *q)
     httpd_reply_hdrs_done(q, -1, false);
 
     /* Reply with metrics data */
+    prom_collector_run_scrape_hooks();
     prom_collector_bridge(&prom_collector_g, &buf);
     ob_addsb(ob, &buf);
 
@@ -587,12 +587,42 @@ static void prom_histogram_observe(prom_histogram_t *self, double value)
     spin_unlock(&self->lock);
 }
 
+static void prom_histogram_observe_many(prom_histogram_t *self,
+                                        double count, double sum,
+                                        const double *bucket_counts)
+{
+    double cumulated = 0;
+
+    if (!is_metric_observable(obj_ccast(prom_metric, self))) {
+        prom_metric_panic(obj_vcast(prom_metric, self), "observe_many",
+                          "histogram is not observable");
+    }
+    if (!self->nb_buckets) {
+        prom_metric_panic(obj_vcast(prom_metric, self), "observe_many",
+                          "histogram buckets were not initialized");
+    }
+
+    spin_lock(&self->lock);
+
+    self->count += count;
+    self->sum += sum;
+
+    /* Buckets are cumulative in the histogram, but not in the input */
+    for (int i = 0; i < self->nb_buckets; i++) {
+        cumulated += bucket_counts[i];
+        self->bucket_counts[i] += cumulated;
+    }
+
+    spin_unlock(&self->lock);
+}
+
 OBJ_VTABLE(prom_histogram)
-    prom_histogram.wipe        = prom_histogram_wipe;
-    prom_histogram.do_register = prom_histogram_register;
-    prom_histogram.set_buckets = prom_histogram_set_buckets;
-    prom_histogram.labels      = prom_histogram_labels;
-    prom_histogram.observe     = prom_histogram_observe;
+    prom_histogram.wipe         = prom_histogram_wipe;
+    prom_histogram.do_register  = prom_histogram_register;
+    prom_histogram.set_buckets  = prom_histogram_set_buckets;
+    prom_histogram.labels       = prom_histogram_labels;
+    prom_histogram.observe      = prom_histogram_observe;
+    prom_histogram.observe_many = prom_histogram_observe_many;
 OBJ_VTABLE_END()
 
 
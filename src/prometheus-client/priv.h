@@ -35,6 +35,21 @@ extern logger_t prom_logger_g;
  */
 extern dlist_t prom_collector_g;
 
+qvector_t(prom_scrape_hook, prom_scrape_hook_f *);
+
+/** Hooks to run before scraping the collector.
+ *
+ * \see prom_collector_add_scrape_hook
+ */
+extern qv_t(prom_scrape_hook) prom_scrape_hooks_g;
+
+/** Run the hooks registered with \ref prom_collector_add_scrape_hook.
+ *
+ * It must be called before \ref prom_collector_bridge when the metrics are
+ * scraped.
+ */
+void prom_collector_run_scrape_hooks(void);
+
 /** Validate the name of a metric.
  *
  * Exposed for tests.
@@ -0,0 +1,136 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2026 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#include <math.h>
+
+#include <lib-common/probe.h>
+#include <lib-common/prometheus-client.h>
+
+/* Time buckets: 1us, 2us, 4us, ..., ~16s */
+#define PROBE_TIME_BUCKETS_START  1e-6
+#define PROBE_TIME_NB_BUCKETS       25
+
+qvector_t(probe_histo, probe_histo_t *);
+
+static struct {
+    prom_histogram_t *duration;
+
+    /* Histograms already flushed in the prometheus metric, indexed by probe
+     * id. */
+    qv_t(probe_histo) exported;
+} probe_metrics_g;
+#define _G  probe_metrics_g
+
+/* Map each HDR bucket to a prometheus bucket: an HDR bucket is accounted
+ * by its upper bound, which is at most 1/16 above the durations it holds. */
+static void probe_metrics_map_buckets(int map[static PROBE_NB_BUCKETS])
+{
+    double s_per_tick = probe_ns_per_tick() * 1e-9;
+
+    for (int i = 0; i < PROBE_NB_BUCKETS; i++) {
+        double s = probe_histo_bucket_max(i) * s_per_tick;
+
+        if (s <= PROBE_TIME_BUCKETS_START) {
+            map[i] = 0;
+        } else {
+            double k = ceil(log2(s / PROBE_TIME_BUCKETS_START));
+
+            map[i] = MIN((int)k, PROBE_TIME_NB_BUCKETS);
+        }
+    }
+}
+
+static probe_histo_t *probe_metrics_exported(const probe_t *probe)
+{
+    int id = atomic_load_explicit(&probe->id, memory_order_relaxed);
+
+    if (id >= _G.exported.len) {
+        int len = _G.exported.len;
+
+        qv_growlen0(&_G.exported, id + 1 - len);
+    }
+    if (!_G.exported.tab[id]) {
+        _G.exported.tab[id] = p_new(probe_histo_t, 1);
+    }
+    return _G.exported.tab[id];
+}
+
+static void probe_metrics_on_scrape(void)
+{
+    qv_t(probe_stats) stats;
+    int map[PROBE_NB_BUCKETS];
+    double ns_per_tick = probe_ns_per_tick();
+
+    qv_init(&stats);
+    probes_get_stats(&stats);
+    probe_metrics_map_buckets(map);
+
+    tab_for_each_ptr(st, &stats) {
+        probe_histo_t *exported = probe_metrics_exported(st->probe);
+        double buckets[PROBE_TIME_NB_BUCKETS + 1] = { 0 };
+        prom_histogram_t *child;
+
+        if (st->histo.count == exported->count) {
+            continue;
+        }
+        carray_for_each_pos(i, st->histo.buckets) {
+            buckets[map[i]] += st->histo.buckets[i] - exported->buckets[i];
+        }
+
+        child = prom_histogram_labels(_G.duration, st->probe->name);
+        obj_vcall(child, observe_many, st->histo.count - exported->count,
+                  (st->histo.sum - exported->sum) * ns_per_tick * 1e-9,
+                  buckets);
+        *exported = st->histo;
+    }
+
+    qv_wipe(&stats);
+}
+
+static int probe_metrics_initialize(void *arg)
+{
+    qv_init(&_G.exported);
+
+    _G.duration = prom_histogram_new("probe_duration_seconds",
+        "Execution time of the instrumented code paths",
+        "probe");
+    prom_histogram_set_exponential_buckets(_G.duration,
+        PROBE_TIME_BUCKETS_START, 2, PROBE_TIME_NB_BUCKETS);
+
+    prom_collector_add_scrape_hook(&probe_metrics_on_scrape);
+
+    return 0;
+}
+
+static int probe_metrics_shutdown(void)
+{
+    prom_collector_remove_scrape_hook(&probe_metrics_on_scrape);
+
+    tab_for_each_ptr(histo, &_G.exported) {
+        p_delete(histo);
+    }
+    qv_wipe(&_G.exported);
+    obj_delete(&_G.duration);
+
+    return 0;
+}
+
+MODULE_BEGIN(probe_metrics)
+    MODULE_DEPENDS_ON(prometheus_client);
+    MODULE_DEPENDS_ON(probe);
+MODULE_END()
@@ -21,6 +21,7 @@
 
 #include <lib-common/core.h>
 #include <lib-common/container-htlist.h>
+#include <lib-common/container-qvector.h>
 
 #if __has_feature(nullability)
 #pragma GCC diagnostic push
@@ -39,6 +40,17 @@ typedef struct outbuf_t {
     int      sb_trailing;
     sb_t     sb;
     htlist_t chunks_list;
+
+    /* MSG_ZEROCOPY state, see ob_enable_zerocopy(). The sends before
+     * zc_done are completed, as well as the [first, last] ranges of sends
+     * of zc_done_ranges, completed out of order. zc_fd is the socket, or -1
+     * if zero-copy was never enabled. */
+    bool     zerocopy;
+    int      zc_fd;
+    uint32_t zc_seq;
+    uint32_t zc_done;
+    qv_t(u32) zc_done_ranges;
+    htlist_t zc_chunks;
 } outbuf_t;
 
 void ob_check_invariants(outbuf_t * nonnull ob) __attr_leaf__;
@@ -49,6 +61,12 @@ static inline outbuf_t * nonnull ob_init(outbuf_t * nonnull ob)
     ob->sb_trailing = 0;
     htlist_init(&ob->chunks_list);
     sb_init(&ob->sb);
+    ob->zerocopy    = false;
+    ob->zc_fd       = -1;
+    ob->zc_seq      = 0;
+    ob->zc_done     = 0;
+    qv_init(&ob->zc_done_ranges);
+    htlist_init(&ob->zc_chunks);
     return ob;
 }
 
@@ -76,6 +94,42 @@ static inline int ob_write(outbuf_t * nonnull ob, int fd) {
 }
 int ob_xread(outbuf_t * nonnull ob, int fd, int size) __attr_leaf__;
 
+/** sends the large shared chunks of \p ob with MSG_ZEROCOPY.
+ *
+ * Once enabled, ob_write() sends the shared chunks (see ob_add_shared()) of
+ * at least OUTBUF_ZEROCOPY_MIN_SIZE bytes with sendmsg(MSG_ZEROCOPY): their
+ * pages are sent without being copied in the socket buffer, and the chunks
+ * are kept (and their shared buffer retained) until the kernel notifies
+ * their completion on the error queue of the socket.
+ *
+ * Reading the error queue is done by ob_reap_zerocopy(), which must be
+ * called when \p fd is notified with POLLERR (this is not an error of the
+ * connection when zero-copy is enabled); ob_write() also reaps the
+ * completions available when it is called.
+ *
+ * \p fd must be a TCP socket on which nothing was sent yet with
+ * MSG_ZEROCOPY, and \p ob must be the only outbuf written on it.
+ *
+ * \p ob must be wiped before \p fd is closed. If it is wiped while some
+ * zero-copy sends are in flight, the connection is shut down after them,
+ * and their chunks are kept, with a duplicate of \p fd, until the kernel
+ * notifies their completion: their memory cannot be reused before. These
+ * completions are read when the outbufs using zero-copy are enabled or
+ * wiped.
+ *
+ * \return -1 if the socket does not support zero-copy.
+ */
+int ob_enable_zerocopy(outbuf_t * nonnull ob, int fd) __attr_leaf__;
+
+/** releases the chunks of \p ob whose zero-copy send completed. */
+int ob_reap_zerocopy(outbuf_t * nonnull ob, int fd) __attr_leaf__;
+
+/** tells whether some zero-copy sends of \p ob are not completed yet. */
+static inline bool ob_has_zerocopy_pending(const outbuf_t * nonnull ob)
+{
+    return !htlist_is_empty(&ob->zc_chunks);
+}
+
 
 /****************************************************************************/
 /* Chunks                                                                   */
@@ -83,22 +137,99 @@ int ob_xread(outbuf_t * nonnull ob, int fd, int size) __attr_leaf__;
 
 #define OUTBUF_CHUNK_MIN_SIZE    (16 << 10)
 
+/* Shared slices up to this size are copied: it is cheaper than a chunk. */
+#define OUTBUF_SHARED_MIN_SIZE   (1 << 10)
+
+/* Below this size, MSG_ZEROCOPY costs more than the copy it saves. */
+#define OUTBUF_ZEROCOPY_MIN_SIZE (16 << 10)
+
 enum outbuf_on_wipe {
     OUTBUF_DO_NOTHING,
     OUTBUF_DO_FREE,
     OUTBUF_DO_MUNMAP,
+    OUTBUF_DO_CLOSE,
+    OUTBUF_DO_RELEASE,
 };
 
+/* Shared buffers are refcounted memory blocks whose slices can be added to
+ * many outbufs without being copied, e.g. to broadcast a message to many
+ * connections. The buffer is released when the last outbuf referencing it
+ * has consumed its slices.
+ *
+ * XXX: the refcount is not atomic, the outbufs sharing a buffer must be used
+ * from the same thread, and the data must not be modified once shared.
+ */
+typedef struct outbuf_shared_t {
+    int       refcnt;
+    int       length;
+    int       on_wipe;
+
+    union {
+        const void    * nullable p;
+        const uint8_t * nullable b;
+        void          * nullable vp;
+    } u;
+} outbuf_shared_t;
+
+static inline outbuf_shared_t * nonnull
+ob_shared_init(outbuf_shared_t * nonnull obs)
+{
+    return p_clear(obs, 1);
+}
+void ob_shared_wipe(outbuf_shared_t * nonnull obs) __attr_leaf__;
+DO_REFCNT(outbuf_shared_t, ob_shared);
+
+/** creates a shared buffer for the memory block (\p ptr, \p len).
+ *
+ * \param is_const: if false memory ownership is transfered to the shared
+ *                  buffer, otherwise the memory must outlive it.
+ */
+static inline outbuf_shared_t * nonnull
+ob_shared_new_memchunk(const void * nonnull ptr, int len, bool is_const)
+{
+    outbuf_shared_t *obs = ob_shared_new();
+
+    obs->u.p    = ptr;
+    obs->length = len;
+    if (!is_const) {
+        obs->on_wipe = OUTBUF_DO_FREE;
+    }
+    return obs;
+}
+
+/** creates a shared buffer holding a copy of (\p data, \p len). */
+static inline outbuf_shared_t * nonnull
+ob_shared_new_dup(const void * nonnull data, int len)
+{
+    return ob_shared_new_memchunk(p_dup((const char *)data, len), len, false);
+}
+
 typedef struct outbuf_chunk_t {
     htnode_t  chunks_link;
     int       length;
     int       offset;
     int       sb_leading;
     int       on_wipe;
+
+    /* File chunks are not loaded in memory: their data is read from the
+     * [file_offset, file_offset + length[ range of the file descriptor fd
+     * when the outbuf is written. */
+    bool      is_file;
+    int       fd;
+    off_t     file_offset;
+
+    /* Shared chunks reference a slice of a shared buffer. If zc_sent is
+     * true, the chunk was sent with MSG_ZEROCOPY and must be kept until the
+     * completion of the sends zc_first to zc_seq. */
+    bool      zc_sent;
+    uint32_t  zc_first;
+    uint32_t  zc_seq;
+    outbuf_shared_t * nullable shared;
+
     union {
-        const void    * nonnull p;
-        const uint8_t * nonnull b;
-        void          * nonnull vp;
+        const void    * nullable p;
+        const uint8_t * nullable b;
+        void          * nullable vp;
     } u;
 } outbuf_chunk_t;
 void ob_chunk_wipe(outbuf_chunk_t * nonnull obc) __attr_leaf__;
@@ -197,9 +328,34 @@ static inline void ob_add_memmap(outbuf_t * nonnull ob, void * nonnull map,
     }
 }
 
+/** adds the slice [\p offset, \p offset + \p len[ of the shared buffer
+ * \p obs to \p ob.
+ *
+ * Unless the slice is small, the data is not copied: \p obs is retained by
+ * \p ob until the slice is consumed.
+ */
+void ob_add_shared(outbuf_t * nonnull ob, outbuf_shared_t * nonnull obs,
+                   int offset, int len) __attr_leaf__;
+
 int ob_add_file(outbuf_t * nonnull ob, const char * nonnull file, int size)
     __attr_leaf__;
 
+/** adds the range [\p offset, \p offset + \p len[ of the file \p fd to
+ * \p ob.
+ *
+ * Unless the range is small, the data is not loaded in memory: it is sent
+ * from the file with sendfile(2) by ob_write(), and read chunk by chunk when
+ * a custom writer is used with ob_write_with() (e.g. for TLS connections).
+ *
+ * \param do_close: if true, the ownership of \p fd is transfered to \p ob,
+ *                  which closes it once the range has been consumed (and
+ *                  also when this function fails).
+ *
+ * XXX: the file must not be truncated before the range is consumed.
+ */
+int ob_add_file_range(outbuf_t * nonnull ob, int fd, off_t offset, int len,
+                      bool do_close) __attr_leaf__;
+
 #if __has_feature(nullability)
 #pragma GCC diagnostic pop
 #endif
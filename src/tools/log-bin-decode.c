@@ -0,0 +1,92 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2026 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#include <lib-common/file-bin.h>
+#include <lib-common/log-bin.h>
+#include <lib-common/parseopt.h>
+#include <lib-common/unix.h>
+
+static struct {
+    bool help;
+} opts_g;
+
+static const char *description[] = {
+    "Decode binary log files, and print their logs on the standard output.",
+    "",
+    NULL
+};
+
+static int decode_file(log_bin_decoder_t *decoder, const char *path)
+{
+    file_bin_t *file = file_bin_open(LSTR(path));
+    SB_8k(out);
+    int ret = 0;
+
+    if (!file) {
+        fprintf(stderr, "cannot open `%s`: %m\n", path);
+        return -1;
+    }
+
+    file_bin_for_each_entry(file, entry) {
+        if (log_bin_decode_record(decoder, entry, &out) < 0) {
+            fprintf(stderr, "%s: invalid record at offset %jd\n", path,
+                    (intmax_t)file->cur);
+            ret = -1;
+            continue;
+        }
+        if (out.len >= 4096) {
+            IGNORE(xwrite(STDOUT_FILENO, out.data, out.len));
+            sb_reset(&out);
+        }
+    }
+    IGNORE(xwrite(STDOUT_FILENO, out.data, out.len));
+
+    sb_wipe(&out);
+    file_bin_close(&file);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    const char *arg0;
+    popt_t options[] = {
+        OPT_FLAG('h', "help", &opts_g.help, "show help"),
+        OPT_END(),
+    };
+    int ret = EXIT_SUCCESS;
+
+    arg0 = NEXTARG(argc, argv);
+    argc = parseopt(argc, argv, options, 0);
+    if (argc < 1 || opts_g.help) {
+        makeusage(!opts_g.help, arg0, "<file>...", description, options);
+    }
+
+    /* The format strings are defined again at the beginning of each file, a
+     * single decoder can be used for a sequence of rotated files. */
+    while (argc > 0) {
+        log_bin_decoder_t decoder;
+
+        log_bin_decoder_init(&decoder);
+        if (decode_file(&decoder, NEXTARG(argc, argv)) < 0) {
+            ret = EXIT_FAILURE;
+        }
+        log_bin_decoder_wipe(&decoder);
+    }
+
+    return ret;
+}
@@ -927,6 +927,30 @@ class IopcTest(z.TestCase):
         self.run_iopc('reference_invalid_9.iop', False,
                       'circular dependency')
 
+    # }}}
+    # {{{ Specialized codecs
+
+    def test_specialize_valid(self) -> None:
+        b = 'specialize'
+        self.run_iopc_pass(b + '.iop')
+        self.run_gcc(b + '.iop')
+        self.check_file(b + '.iop.c', [
+            '#include <lib-common/iop/codec.h>',
+            'static const iop_struct_codec_t specialize__my_struct__codec',
+            '.codec     = &specialize__my_struct__codec,',
+            'case 300:'])
+        self.check_file(b + '.iop.c', [
+            'specialize__my_struct_bis__codec =',
+            'specialize__not_specialized__codec'], wanted=False)
+
+    def test_specialize_invalid(self) -> None:
+        self.run_iopc('specialize_invalid_struct_field.iop', False,
+                      'field `b` is not of a scalar, enum or string type')
+        self.run_iopc('specialize_invalid_repeated.iop', False,
+                      'field `a` cannot be repeated or a reference')
+        self.run_iopc('specialize_invalid_union.iop', False,
+                      '@(c:specialize) only applies to structs')
+
     # }}}
     # {{{ Code generation
 
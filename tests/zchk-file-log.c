@@ -20,7 +20,9 @@
 
 #include <lib-common/datetime.h>
 #include <lib-common/el.h>
+#include <lib-common/file-bin.h>
 #include <lib-common/file-log.h>
+#include <lib-common/log-bin.h>
 #include <lib-common/z.h>
 
 struct {
@@ -56,6 +58,25 @@ static int z_check_file_permission(const char *prefix, uint32_t mode)
     Z_HELPER_END;
 }
 
+/* Log with a handler directly: logging at the critical levels through a
+ * logger also sends the logs to syslog. */
+__attr_printf__(3, 4)
+static void z_log_with_handler(log_handler_f *handler, int level,
+                               const char *fmt, ...)
+{
+    log_ctx_t ctx = {
+        .level       = level,
+        .logger_name = LSTR("z_log_bin"),
+        .pid         = getpid(),
+        .prog_name   = LSTR("zchk"),
+    };
+    va_list va;
+
+    va_start(va, fmt);
+    (*handler)(&ctx, fmt, va);
+    va_end(va);
+}
+
 Z_GROUP_EXPORT(file_log)
 {
 #define RANDOM_DATA_SIZE  (2 << 20)
@@ -138,7 +159,7 @@ Z_GROUP_EXPORT(file_log)
         /* last file may be reused */
         Z_ASSERT_EQ(_G.events[LOG_FILE_DELETE], NB_FILES - 1);
 
-        /* Properly wait for gzip children termination. */
+        /* Properly wait for the end of the compressions. */
         el_loop();
     } Z_TEST_END;
 
@@ -226,7 +247,7 @@ Z_GROUP_EXPORT(file_log)
         /* All 1.5 years old log files should have been deleted. */
         Z_ASSERT_EQ(_G.events[LOG_FILE_DELETE], NB_FILES);
 
-        /* Properly wait for gzip children termination. */
+        /* Properly wait for the end of the compressions. */
         el_loop();
     } Z_TEST_END;
 #undef NB_RECENT_FILES
@@ -256,4 +277,102 @@ Z_GROUP_EXPORT(file_log)
 
         Z_HELPER_RUN(z_check_file_permission(path.s, 0640u));
     } Z_TEST_END;
+
+    Z_TEST(file_log_compression_lzo) {
+        t_scope;
+        lstr_t path = t_lstr_fmt("%*pMtmp_log_lzo",
+                                 LSTR_FMT_ARG(z_tmpdir_g));
+        lstr_t old_path = t_lstr_fmt("%s_19700101_000000.log", path.s);
+        lstr_t data = t_lstr_fmt("%*pX", 100 << 10,
+                                 t_new(char, 100 << 10));
+        log_file_t *cfg;
+        file_t *file;
+        SB_1k(out);
+
+        file = file_open(old_path.s, FILE_WRONLY | FILE_CREATE, 0640);
+        Z_ASSERT_P(file);
+        Z_ASSERT_N(file_write(file, data.s, data.len));
+        Z_ASSERT_N(file_close(&file));
+
+        cfg = log_file_new(path.s, LOG_FILE_COMPRESS);
+        log_file_set_compression(cfg, LOG_FILE_COMPRESSION_LZO, 1);
+        Z_ASSERT_EQ(log_file_open(cfg, false), 0);
+        Z_ASSERT_EQ(log_file_close(&cfg), 0);
+        el_loop();
+
+        /* The rotated file is replaced by its compressed version. */
+        Z_ASSERT_NEG(access(old_path.s, F_OK));
+        Z_ASSERT_N(log_file_read_compressed(t_fmt("%s.qlz", old_path.s),
+                                            &out));
+        Z_ASSERT_LSTREQUAL(LSTR_SB_V(&out), data);
+        sb_wipe(&out);
+    } Z_TEST_END;
+
+    Z_TEST(file_log_bin) {
+        t_scope;
+        logger_t logger = LOGGER_INIT_INHERITS(NULL, "z_log_bin");
+        lstr_t path = t_lstr_fmt("%*pMtmp_log_bin",
+                                 LSTR_FMT_ARG(z_tmpdir_g));
+        const char *expected[] = {
+            "note:  {z_log_bin} int 42, str foo, bytes bar",
+            "note:  {z_log_bin} lstr baz, double  3.14, "
+                "size 18446744073709551615",
+            "note:  {z_log_bin} int -1, str (null), bytes ",
+            "note:  {z_log_bin} padded [   12|ab   ]",
+            "fatal: {z_log_bin} emerg 0",
+            "fatal: {z_log_bin} alert 1",
+        };
+        log_handler_f *handler;
+        log_bin_decoder_t decoder;
+        log_file_t *log_file;
+        file_bin_t *file;
+        lstr_t bin_path;
+        lstr_t baz = LSTR("baz");
+        int pos = 0;
+        SB_1k(out);
+
+        log_file = log_file_new(path.s, 0);
+        Z_ASSERT_N(log_file_open(log_file, true));
+        bin_path = t_lstr_dup(log_file->_bin_internal->path);
+
+        log_bin_start(log_file);
+        logger_notice(&logger, "int %d, str %s, bytes %*pM", 42, "foo", 3,
+                      "bar");
+        logger_notice(&logger, "lstr %pL, double %5.2f, size %zu", &baz,
+                      3.14159, SIZE_MAX);
+        logger_notice(&logger, "int %d, str %s, bytes %*pM", -1,
+                      (const char *)NULL, 0, "");
+        logger_notice(&logger, "padded [%*d|%-*.*s]", 5, 12, 5, 2, "abc");
+        handler = log_set_handler(log_stderr_handler_g);
+        log_set_handler(handler);
+        z_log_with_handler(handler, LOG_EMERG, "emerg %d", LOG_EMERG);
+        z_log_with_handler(handler, LOG_ALERT, "alert %d", LOG_ALERT);
+        log_bin_stop();
+        Z_ASSERT_N(log_file_close(&log_file));
+
+        file = file_bin_open(bin_path);
+        Z_ASSERT_P(file);
+        log_bin_decoder_init(&decoder);
+        file_bin_for_each_entry(file, entry) {
+            pstream_t ps;
+            int res = log_bin_decode_record(&decoder, entry, &out);
+
+            Z_ASSERT_N(res);
+            if (!res) {
+                continue;
+            }
+            Z_ASSERT_LT(pos, countof(expected));
+            ps = ps_initsb(&out);
+            Z_ASSERT_N(ps_skip_after_str(&ps, "]: "),
+                       "%*pM", SB_FMT_ARG(&out));
+            Z_ASSERT_STREQUAL(t_fmt("%*pM", PS_FMT_ARG(&ps)),
+                              t_fmt("%s\n", expected[pos]));
+            sb_reset(&out);
+            pos++;
+        }
+        Z_ASSERT_EQ(pos, countof(expected));
+        log_bin_decoder_wipe(&decoder);
+        file_bin_close(&file);
+        sb_wipe(&out);
+    } Z_TEST_END;
 } Z_GROUP_END
@@ -65,6 +65,26 @@ Z_GROUP_EXPORT(hash) {
                     0xb536a6ee);
     } Z_TEST_END;
 
+    Z_TEST(crc32c) {
+        lstr_t s = LSTR("123456789");
+        byte buf[1024];
+        uint32_t crc;
+
+        Z_ASSERT_EQ(icrc32c(0, s.s, s.len), 0xe3069283u);
+
+        /* Unaligned data given in several chunks. */
+        for (int i = 0; i < countof(buf); i++) {
+            buf[i] = i * 7;
+        }
+        crc = icrc32c(0, buf + 1, 997);
+        for (int i = 0; i < 997; i += 13) {
+            uint32_t chunks = icrc32c(0, buf + 1, i);
+
+            chunks = icrc32c(chunks, buf + 1 + i, 997 - i);
+            Z_ASSERT_EQ(chunks, crc, "split at %d", i);
+        }
+    } Z_TEST_END;
+
     Z_TEST(murmur_hash3_x86_32) {
         lstr_t s = LSTR("Est-ce que vous voulez etre ma femme ? "
                         "Et apres on boira un cafe.");
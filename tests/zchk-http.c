@@ -17,9 +17,13 @@
 /***************************************************************************/
 
 #include <lib-common/z.h>
+#include <lib-common/datetime.h>
 #include <lib-common/unix.h>
 #include <lib-common/http.h>
 
+/* Number of streams of the streams scheduling tests. */
+#define Z_HTTP2_STREAMS  5
+
 static struct {
     http_mode_t http_mode;
 
@@ -30,9 +34,12 @@ static struct {
     httpc_t *client;
 
     httpd_trigger_t *hello;
+    httpd_trigger_t *small;
     httpd_trigger_t *post;
+    httpd_trigger_t *file;
     int response_time;
     lstr_t hello_response;
+    const char *file_path;
 
     httpc_query_t query;
     bool query_sent;
@@ -40,6 +47,16 @@ static struct {
     httpc_status_t query_status;
     int query_code;
     bool query_has_clen;
+    lstr_t query_body;
+
+    /* for the streams scheduling tests */
+    httpc_t *prio_clients[Z_HTTP2_STREAMS];
+    httpc_query_t prio_queries[Z_HTTP2_STREAMS];
+    httpc_status_t prio_status[Z_HTTP2_STREAMS];
+    struct timeval prio_sent[Z_HTTP2_STREAMS];
+    long long prio_latencies[Z_HTTP2_STREAMS]; /* µs */
+    int prio_ranks[Z_HTTP2_STREAMS];
+    int prio_answered;
 
     /* for el_wait_until */
     bool el_wait_timed_out;
@@ -128,6 +145,42 @@ z_http_hello_query_hook(httpd_trigger_t *tcb, struct httpd_query_t *q,
     httpd_bufferize(q, 1 << 20);
 }
 
+static void z_http_small_query_on_done(httpd_query_t *q)
+{
+    outbuf_t *ob;
+
+    ob = httpd_reply_hdrs_start(q, HTTP_CODE_OK, true);
+    ob_adds(ob, "Content-Type: text/plain\r\n");
+    httpd_reply_hdrs_done(q, -1, false);
+
+    ob_adds(ob, "small");
+
+    httpd_reply_done(q);
+}
+
+static void
+z_http_small_query_hook(httpd_trigger_t *tcb, struct httpd_query_t *q,
+                        const httpd_qinfo_t *qi)
+{
+    q->on_done = z_http_small_query_on_done;
+    q->qinfo = httpd_qinfo_dup(qi);
+    httpd_bufferize(q, 1 << 20);
+}
+
+static void z_http_file_query_on_done(httpd_query_t *q)
+{
+    httpd_reply_file(q, AT_FDCWD, _G.file_path, false);
+}
+
+static void
+z_http_file_query_hook(httpd_trigger_t *tcb, struct httpd_query_t *q,
+                       const httpd_qinfo_t *qi)
+{
+    q->on_done = z_http_file_query_on_done;
+    q->qinfo = httpd_qinfo_dup(qi);
+    httpd_bufferize(q, 1 << 20);
+}
+
 static void z_http_post_query_on_done(httpd_query_t *q)
 {
     /* Send response headers */
@@ -160,6 +213,14 @@ static void z_http_default_httpd_cfg(unsigned max_queries)
     _G.hello->cb = z_http_hello_query_hook;
     httpd_trigger_register(cfg, GET, "hello", _G.hello);
 
+    _G.small = httpd_trigger_new();
+    _G.small->cb = z_http_small_query_hook;
+    httpd_trigger_register(cfg, GET, "small", _G.small);
+
+    _G.file = httpd_trigger_new();
+    _G.file->cb = z_http_file_query_hook;
+    httpd_trigger_register(cfg, GET, "file", _G.file);
+
     _G.post = httpd_trigger_new();
     _G.post->cb = z_http_post_query_hook;
     httpd_trigger_register(cfg, POST, "post", _G.post);
@@ -228,6 +289,34 @@ static void z_http_post_query_send(void)
     _G.query_answered = false;
 }
 
+static void
+z_http_file_query_on_done_client(httpc_query_t *q, httpc_status_t st)
+{
+    lstr_wipe(&_G.query_body);
+    _G.query_body = lstr_dup(LSTR_SB_V(&q->payload));
+    z_http_hello_query_on_done_client(q, st);
+}
+
+static void z_http_file_query_send(lstr_t range)
+{
+    httpc_query_t *q = &_G.query;
+
+    httpc_query_init(q);
+    httpc_bufferize(q, 1 << 20);
+    q->on_done = &z_http_file_query_on_done_client;
+
+    httpc_query_attach(q, _G.client);
+    httpc_query_start(q, HTTP_METHOD_GET, LSTR("localhost"), LSTR("/file"));
+    if (range.len) {
+        httpc_query_hdrs_add(q, range);
+    }
+    httpc_query_hdrs_done(q, -1, false);
+    httpc_query_done(q);
+
+    _G.query_sent = true;
+    _G.query_answered = false;
+}
+
 static int z_http_connect_client(unsigned max_queries)
 {
     sockunion_t su;
@@ -324,6 +413,185 @@ z_http_do_simple_query(bool delayed, unsigned delay, unsigned repeat)
     Z_HELPER_END;
 }
 
+/* The whole file and its large ranges are larger than OUTBUF_CHUNK_MIN_SIZE:
+ * they are sent from the file over HTTP/1.x, and copied over HTTP/2. */
+static int z_http_do_file(void)
+{
+    t_scope;
+    SB_1k(content);
+    int fd;
+
+    for (int i = 0; i < 3000; i++) {
+        sb_adds(&content, "0123456789");
+    }
+    Z_ASSERT_GT(content.len, OUTBUF_CHUNK_MIN_SIZE);
+
+    _G.file_path = t_fmt("%*pM/file", LSTR_FMT_ARG(z_tmpdir_g));
+    fd = open(_G.file_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    Z_ASSERT_N(fd);
+    Z_ASSERT_N(xwrite(fd, content.data, content.len));
+    close(fd);
+
+    Z_HELPER_RUN(z_http_connect_client(2));
+
+    z_http_file_query_send(LSTR_NULL_V);
+    el_wait_until(_G.query_answered, 1000);
+    Z_ASSERT(_G.query_answered);
+    Z_ASSERT_EQ(_G.query_status, HTTPC_STATUS_OK);
+    Z_ASSERT_EQ(_G.query_code, HTTP_CODE_OK);
+    Z_ASSERT_LSTREQUAL(_G.query_body, LSTR_SB_V(&content));
+
+    z_http_file_query_send(LSTR("Range: bytes=10000-"));
+    el_wait_until(_G.query_answered, 1000);
+    Z_ASSERT(_G.query_answered);
+    Z_ASSERT_EQ(_G.query_status, HTTPC_STATUS_OK);
+    Z_ASSERT_EQ(_G.query_code, HTTP_CODE_PARTIAL_CONTENT);
+    Z_ASSERT_LSTREQUAL(_G.query_body,
+                       LSTR_INIT_V(content.data + 10000,
+                                   content.len - 10000));
+
+    lstr_wipe(&_G.query_body);
+    httpc_cfg_delete(&_G.client_cfg);
+    httpd_unlisten(&_G.server);
+
+    el_wait_until(false, 100);
+    Z_ASSERT(!el_has_pending_events());
+
+    Z_HELPER_END;
+}
+
+static void
+z_http_prio_query_on_done_client(httpc_query_t *q, httpc_status_t st)
+{
+    int i = q - _G.prio_queries;
+    struct timeval now;
+
+    lp_gettv(&now);
+    _G.prio_status[i] = st;
+    _G.prio_latencies[i] = timeval_diff64(&now, &_G.prio_sent[i]);
+    _G.prio_ranks[i] = ++_G.prio_answered;
+
+    httpc_query_wipe(q);
+}
+
+static void z_http_prio_query_send(int i, lstr_t path, lstr_t priority)
+{
+    httpc_query_t *q = &_G.prio_queries[i];
+
+    httpc_query_init(q);
+    httpc_bufferize(q, 4 << 20);
+    q->on_done = &z_http_prio_query_on_done_client;
+
+    httpc_query_attach(q, _G.prio_clients[i]);
+    httpc_query_start(q, HTTP_METHOD_GET, LSTR("localhost"), path);
+    if (priority.len) {
+        httpc_query_hdrs_add(q, priority);
+    }
+    httpc_query_hdrs_done(q, -1, false);
+    httpc_query_done(q);
+    lp_gettv(&_G.prio_sent[i]);
+}
+
+/* Connect the clients of the streams scheduling tests: they share the
+ * HTTP/2 connection of the first one. */
+static int z_http2_connect_prio_clients(int nb_clients)
+{
+    sockunion_t su;
+
+    Z_HELPER_RUN(z_http_connect_client(1));
+
+    Z_ASSERT_N(addr_resolve("test", LSTR("127.0.0.1:1"), &su));
+    sockunion_setport(&su, getsockport(el_fd_get_fd(_G.server), AF_INET));
+    _G.prio_clients[0] = _G.client;
+    for (int i = 1; i < nb_clients; i++) {
+        _G.prio_clients[i] = httpc_connect(&su, _G.client_cfg, NULL);
+        Z_ASSERT_P(_G.prio_clients[i]);
+        el_wait_until(!_G.prio_clients[i]->busy, 100);
+        Z_ASSERT(!_G.prio_clients[i]->busy);
+    }
+    _G.prio_answered = 0;
+
+    Z_HELPER_END;
+}
+
+static int z_http2_prio_clients_close(void)
+{
+    httpc_cfg_delete(&_G.client_cfg);
+    httpd_unlisten(&_G.server);
+
+    lstr_wipe(&_G.hello_response);
+
+    el_wait_until(false, 100);
+    Z_ASSERT(!el_has_pending_events());
+
+    Z_HELPER_END;
+}
+
+/* Two large responses are multiplexed on the same HTTP/2 connection: the one
+ * with the highest priority must be completed first, even if it was
+ * requested last. */
+static int z_http2_do_priority(void)
+{
+    Z_HELPER_RUN(z_http2_connect_prio_clients(2));
+
+    z_http_hello_generate_response(2 << 20);
+    _G.response_time = -1;
+
+    z_http_prio_query_send(0, LSTR("/hello"), LSTR("priority: u=7"));
+    z_http_prio_query_send(1, LSTR("/hello"), LSTR("priority: u=0"));
+
+    el_wait_until(_G.prio_answered == 2, 2000);
+    Z_ASSERT_EQ(_G.prio_answered, 2);
+    Z_ASSERT_EQ(_G.prio_status[0], HTTPC_STATUS_OK);
+    Z_ASSERT_EQ(_G.prio_status[1], HTTPC_STATUS_OK);
+    Z_ASSERT_EQ(_G.prio_ranks[1], 1, "the urgent response was not first");
+    Z_ASSERT_EQ(_G.prio_ranks[0], 2);
+
+    Z_HELPER_RUN(z_http2_prio_clients_close());
+
+    Z_HELPER_END;
+}
+
+/* Small responses are requested while a large download, without priority,
+ * runs on the same HTTP/2 connection: they must not wait for the download,
+ * and their latency is traced. */
+static int z_http2_do_mixed_latency(void)
+{
+    long long small_max = 0;
+    long long small_sum = 0;
+
+    Z_HELPER_RUN(z_http2_connect_prio_clients(Z_HTTP2_STREAMS));
+
+    z_http_hello_generate_response(3 << 20);
+    _G.response_time = -1;
+
+    z_http_prio_query_send(0, LSTR("/hello"), LSTR_NULL_V);
+    for (int i = 1; i < Z_HTTP2_STREAMS; i++) {
+        z_http_prio_query_send(i, LSTR("/small"), LSTR_NULL_V);
+    }
+
+    el_wait_until(_G.prio_answered == Z_HTTP2_STREAMS, 2000);
+    Z_ASSERT_EQ(_G.prio_answered, Z_HTTP2_STREAMS);
+    for (int i = 0; i < Z_HTTP2_STREAMS; i++) {
+        Z_ASSERT_EQ(_G.prio_status[i], HTTPC_STATUS_OK, "stream %d", i);
+    }
+    Z_ASSERT_EQ(_G.prio_ranks[0], Z_HTTP2_STREAMS,
+                "a small response waited for the download");
+
+    for (int i = 1; i < Z_HTTP2_STREAMS; i++) {
+        small_max = MAX(small_max, _G.prio_latencies[i]);
+        small_sum += _G.prio_latencies[i];
+    }
+    e_trace(0, "small responses: %lldus on average, %lldus at most; "
+            "download: %lldus", small_sum / (Z_HTTP2_STREAMS - 1),
+            small_max, _G.prio_latencies[0]);
+    Z_ASSERT_LT(small_max, _G.prio_latencies[0]);
+
+    Z_HELPER_RUN(z_http2_prio_clients_close());
+
+    Z_HELPER_END;
+}
+
 static void z_http_tests(http_mode_t http_mode)
 {
     _G.http_mode = http_mode;
@@ -356,6 +624,10 @@ static void z_http_tests(http_mode_t http_mode)
     Z_TEST(simple_post) {
         Z_HELPER_RUN(z_http_do_simple_post());
     } Z_TEST_END;
+
+    Z_TEST(file, "static file and byte range larger than a chunk") {
+        Z_HELPER_RUN(z_http_do_file());
+    } Z_TEST_END;
 }
 
 Z_GROUP_EXPORT(http) {
@@ -364,6 +636,14 @@ Z_GROUP_EXPORT(http) {
 
 Z_GROUP_EXPORT(http2) {
     z_http_tests(HTTP_MODE_USE_HTTP2_ONLY);
+
+    Z_TEST(priority, "responses are scheduled by priority (RFC9218)") {
+        Z_HELPER_RUN(z_http2_do_priority());
+    } Z_TEST_END;
+
+    Z_TEST(mixed_latency, "latency of small responses during a download") {
+        Z_HELPER_RUN(z_http2_do_mixed_latency());
+    } Z_TEST_END;
 } Z_GROUP_END;
 
 /* }}} */
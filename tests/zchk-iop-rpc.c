@@ -23,6 +23,8 @@
 #include <lib-common/core/core.iop.h>
 #include <lib-common/datetime.h>
 #include <lib-common/thr.h>
+#include <lib-common/prometheus-client.h>
+#include <lib-common/prometheus-client/priv.h>
 
 #include "iop/tstiop_rpc.iop.h"
 
@@ -201,6 +203,40 @@ static void dummy_on_event(ichannel_t *ic, ic_event_t evt)
     return;
 }
 
+/* Get the value of a sample of the prometheus text exposition, given its
+ * name and the end of its labels. */
+static void *z_ic_rpc_metrics_reply_thread(void *arg)
+{
+    ic_rpc_metrics_on_reply((uintptr_t)arg, IC_MSG_OK, -1);
+    return NULL;
+}
+
+static double z_get_prom_sample(const sb_t *text, const char *name,
+                                const char *labels_end)
+{
+    t_scope;
+    pstream_t ps = ps_initsb(text);
+    const char *prefix = t_fmt("%s{", name);
+    const char *suffix = t_fmt("%s} ", labels_end);
+
+    while (!ps_done(&ps)) {
+        pstream_t line;
+        const char *value;
+
+        if (ps_get_ps_chr_and_skip(&ps, '\n', &line) < 0) {
+            break;
+        }
+        if (!ps_startswithstr(&line, prefix)) {
+            continue;
+        }
+        value = memmem(line.s, ps_len(&line), suffix, strlen(suffix));
+        if (value) {
+            return strtod(value + strlen(suffix), NULL);
+        }
+    }
+    return -1;
+}
+
 static bool check_user_version_true(uint32_t user_version)
 {
     _G.last_user_version = user_version;
@@ -522,6 +558,79 @@ Z_GROUP_EXPORT(iop_rpc)
         Z_ASSERT_P(ctx);
     } Z_TEST_END;
 
+    Z_TEST(ic_rpc_metrics, "iop-rpc: per-RPC prometheus metrics") {
+        ichannel_t ic;
+        qm_t(ic_cbs) impl = QM_INIT(ic_cbs, impl);
+        const char *labels = "rpc=\"setRootLevel\",transport=\"ic\"";
+        SB_1k(text);
+
+        MODULE_REQUIRE(ic_rpc_metrics);
+
+        ic_init(&ic);
+        ic.iop_env = _G.iop_env;
+        ic_set_local(&ic, false);
+        ic_register(&impl, core__core, log, set_root_level);
+        ic.impl = &impl;
+
+        /* Sizes are only known when the local queries are packed */
+        TEST_RPC_CALL(&ic, set_root_level, false, false, "");
+        TEST_RPC_CALL(&ic, set_root_level, true, false, "");
+
+        prom_collector_run_scrape_hooks();
+        prom_collector_bridge(&prom_collector_g, &text);
+
+        Z_ASSERT_EQ(z_get_prom_sample(&text, "ic_rpc_server_seconds_count",
+                                      labels), 4.);
+        Z_ASSERT_EQ(z_get_prom_sample(&text, "ic_rpc_request_bytes_count",
+                                      labels), 2.);
+        Z_ASSERT_EQ(z_get_prom_sample(&text, "ic_rpc_response_bytes_count",
+                                      labels), 2.);
+        Z_ASSERT_EQ(z_get_prom_sample(&text, "ic_rpc_replies_total",
+                                      t_fmt("%s,status=\"OK\"", labels)),
+                    2.);
+        Z_ASSERT_EQ(z_get_prom_sample(&text, "ic_rpc_replies_total",
+                                      t_fmt("%s,status=\"EXN\"", labels)),
+                    2.);
+
+        /* Already exported observations must not be exported twice */
+        sb_reset(&text);
+        prom_collector_run_scrape_hooks();
+        prom_collector_bridge(&prom_collector_g, &text);
+        Z_ASSERT_EQ(z_get_prom_sample(&text, "ic_rpc_server_seconds_count",
+                                      labels), 4.);
+
+        /* The reply can be sent from another thread than the query was
+         * dispatched in. */
+        {
+            const iop_rpc_t *rpc = IOP_RPC(core__core, log, set_root_level);
+            pthread_t thread;
+
+            ic_rpc_metrics_on_query(42, IC_RPC_TRANSPORT_HTTP,
+                                    LSTR("core.Log"), rpc, -1, -1);
+            Z_ASSERT_ZERO(thr_create(&thread, NULL,
+                                     &z_ic_rpc_metrics_reply_thread,
+                                     (void *)(uintptr_t)42));
+            Z_ASSERT_ZERO(pthread_join(thread, NULL));
+
+            /* Already replied: ignored. */
+            ic_rpc_metrics_on_reply(42, IC_MSG_OK, -1);
+
+            sb_reset(&text);
+            prom_collector_run_scrape_hooks();
+            prom_collector_bridge(&prom_collector_g, &text);
+            Z_ASSERT_EQ(z_get_prom_sample(&text,
+                                          "ic_rpc_server_seconds_count",
+                                          "rpc=\"setRootLevel\","
+                                          "transport=\"http\""), 1.);
+        }
+
+        qm_wipe(ic_cbs, &impl);
+        ic_disconnect(&ic);
+        ic_wipe(&ic);
+
+        MODULE_RELEASE(ic_rpc_metrics);
+    } Z_TEST_END;
+
     Z_TEST(ic_user_version, "iop-rpc: user version tests") {
         el_t server_ev;
         ichannel_t ic_client;
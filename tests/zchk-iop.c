@@ -718,6 +718,42 @@ static int z_test_iop_struct_get_field(const iop_struct_t *st,
     Z_HELPER_END;
 }
 
+/* }}} */
+/* {{{ zchk iop.bunpack_stream */
+
+/* Unpack a packed struct with a streaming unpacker, fed by chunks of `size`
+ * bytes. */
+static int z_bunpack_stream(const iop_struct_t *st, void *value,
+                            lstr_t packed, int size)
+{
+    iop_bunpack_stream_t *stream;
+    pstream_t ps = ps_initlstr(&packed);
+    int res = 0;
+
+    stream = iop_bunpack_stream_new(t_pool(), _G.iop_env, st, value, 0);
+    while (res >= 0 && !ps_done(&ps)) {
+        pstream_t chunk = __ps_get_ps(&ps, MIN(size, (int)ps_len(&ps)));
+
+        res = iop_bunpack_stream_feed(stream, chunk);
+    }
+    if (res >= 0) {
+        res = iop_bunpack_stream_finish(stream);
+    }
+    iop_bunpack_stream_delete(&stream);
+    return res;
+}
+
+/* Check that the elements are received in order, their `a` field being
+ * their index. */
+static int z_bunpack_stream_check_elem(void *priv, const iop_field_t *fdesc,
+                                       void *elem)
+{
+    int *nb_elems = priv;
+    const tstiop__my_struct_c__t *c = elem;
+
+    return c->a == (*nb_elems)++ ? 0 : -1;
+}
+
 /* }}} */
 /* {{{ Other helpers (waiting proper folds). */
 
@@ -2947,6 +2983,147 @@ Z_GROUP_EXPORT(iop)
         Z_ASSERT_STREQUAL(sb.data, json_sn_strint);
     } Z_TEST_END
     /* }}} */
+    Z_TEST(json_numbers, "test IOP JSon numbers lexing") { /* {{{ */
+        t_scope;
+        const char *doubles[] = {
+            "0.0", "-0.0", "1.5", "-2.25", "3.14159265000000021e+00",
+            "1.25000000000000000e+00", "12345678901234567890.5", "1e22",
+            "1e23", "1.7976931348623157e308", "4.9e-324", "123.456e-7",
+            "9007199254740993.0", "0.1", "2E3", "5e-1",
+        };
+        struct {
+            const char *json;
+            int64_t     val;
+        } longs[] = {
+            { "0",                     0 },
+            { "-0",                    0 },
+            { "42",                    42 },
+            { "-42",                   -42 },
+            { "9223372036854775807",   INT64_MAX },
+            { "-9223372036854775808",  INT64_MIN },
+            { "010",                   8 },
+            { "0x10",                  16 },
+            { "1 + 2",                 3 },
+            { "2\n* 3",                6 },
+            { "-1 << 4",               -16 },
+        };
+
+        carray_for_each_entry(d, doubles) {
+            t_scope;
+            tstiop__my_struct_i__t si;
+            pstream_t ps;
+            SB_1k(err);
+
+            ps = ps_initstr(t_fmt("{ d: [ %s, %s ] }", d, d));
+            Z_ASSERT_N(t_iop_junpack_ps(_G.iop_env, &ps,
+                                        &tstiop__my_struct_i__s, &si, 0,
+                                        &err),
+                       "%s: %*pM", d, SB_FMT_ARG(&err));
+            Z_ASSERT_EQ(si.d.len, 2);
+            Z_ASSERT(!memcmp(&si.d.tab[0], &(double){ strtod(d, NULL) },
+                             sizeof(double)),
+                     "%s: got %.17g", d, si.d.tab[0]);
+        }
+
+        carray_for_each_ptr(l, longs) {
+            t_scope;
+            tstiop__my_struct_i__t si;
+            pstream_t ps;
+            SB_1k(err);
+
+            ps = ps_initstr(t_fmt("{ l: [ %s ] }", l->json));
+            Z_ASSERT_N(t_iop_junpack_ps(_G.iop_env, &ps,
+                                        &tstiop__my_struct_i__s, &si, 0,
+                                        &err),
+                       "%s: %*pM", l->json, SB_FMT_ARG(&err));
+            Z_ASSERT_EQ(si.l.len, 1);
+            Z_ASSERT_EQ(si.l.tab[0], l->val, "%s", l->json);
+        }
+
+        /* errors are still reported at the right place */
+        {
+            SB_1k(err);
+            tstiop__my_struct_i__t si;
+            pstream_t ps = ps_initstr("{\n  l: [ 1,\n 12a ] }");
+
+            Z_ASSERT_NEG(t_iop_junpack_ps(_G.iop_env, &ps,
+                                          &tstiop__my_struct_i__s, &si, 0,
+                                          &err));
+            Z_ASSERT(strstr(err.data, "3:"), "%*pM", SB_FMT_ARG(&err));
+        }
+    } Z_TEST_END
+    /* }}} */
+    Z_TEST(json_par, "test parallel unpacking of JSon values") { /* {{{ */
+        t_scope;
+        iop_junpack_par_res_t res;
+        sb_t array;
+        sb_t stream;
+        SB_1k(err);
+        struct {
+            const char *json;
+            const char *err;
+        } errors[] = {
+            { "[ { i: [ 1 ] }, { i: [ 2 ] }",        "1:29: end of file" },
+            { "[ { i: [ 1 ] }, , { i: [ 2 ] } ]",    "1:17: unexpected" },
+            { "[ { i: [ 1 ] } ] }",                  "1:18: unexpected" },
+            { "[ { i: [ 1 ] }, { j: \"a ] }",        "1:22: unclosed str" },
+            { "[ { i: [ 1 ] } /* ]",                 "1:16: unclosed com" },
+            { "[ { i: [ 1 ] },\n  { i: [ 1 ],\n x: 2 } ]", "3:" },
+        };
+
+        /* A large array, and the same values as a stream, with the usual
+         * JSon oddities in the middle. */
+        t_sb_init(&array, 1 << 20);
+        t_sb_init(&stream, 1 << 20);
+        sb_adds(&array, "// values\n[");
+        for (int i = 0; i < 10000; i++) {
+            const char *v;
+
+            v = t_fmt("{ i: [ %d ], l: [ %d, -%d ], d: [ 0.5 ], "
+                      "e: [ \"%s\" ] /* ] } */ }", i, i, i,
+                      i % 2 ? "C" : "A");
+            sb_addf(&array, "%s%s\n", v, i == 9999 ? "" : ",");
+            sb_addf(&stream, "%s\n", v);
+        }
+        sb_adds(&array, "] # end\n");
+
+        MODULE_REQUIRE(thr);
+        for (int k = 0; k < 2; k++) {
+            sb_t *sb = k ? &stream : &array;
+
+            Z_ASSERT_N(iop_junpack_par(_G.iop_env, ps_initsb(sb),
+                                       &tstiop__my_struct_i__s, 0, &res,
+                                       &err), "%*pM", SB_FMT_ARG(&err));
+            Z_ASSERT_EQ(res.values.len, 10000);
+            for (int i = 0; i < res.values.len; i++) {
+                const tstiop__my_struct_i__t *si = res.values.tab[i];
+
+                Z_ASSERT_EQ(si->i.len, 1);
+                Z_ASSERT_EQ(si->i.tab[0], i);
+                Z_ASSERT_EQ(si->l.len, 2);
+                Z_ASSERT_EQ(si->l.tab[1], -i);
+                Z_ASSERT_EQ(si->e.tab[0], i % 2 ? MY_ENUM_C_C : MY_ENUM_C_A);
+            }
+            iop_junpack_par_res_wipe(&res);
+        }
+        MODULE_RELEASE(thr);
+
+        Z_ASSERT_N(iop_junpack_par(_G.iop_env, ps_initstr(" [ ] "),
+                                   &tstiop__my_struct_i__s, 0, &res, &err));
+        Z_ASSERT_EQ(res.values.len, 0);
+        iop_junpack_par_res_wipe(&res);
+
+        carray_for_each_ptr(e, errors) {
+            sb_reset(&err);
+            Z_ASSERT_NEG(iop_junpack_par(_G.iop_env, ps_initstr(e->json),
+                                         &tstiop__my_struct_i__s, 0, &res,
+                                         &err), "%s", e->json);
+            Z_ASSERT(strstart(err.data, e->err, NULL), "%s: %*pM",
+                     e->json, SB_FMT_ARG(&err));
+            iop_junpack_par_res_wipe(&res);
+        }
+    } Z_TEST_END
+    /* }}} */
     Z_TEST(json_big_bytes, "test JSON packing big bytes fields") { /* {{{ */
         SB_1k(sb);
         tstiop__my_struct_a_opt__t sn;
@@ -3625,6 +3802,315 @@ Z_GROUP_EXPORT(iop)
         Z_HELPER_RUN(iop_std_test_struct_flags(st_sg, &sg, flags, "sg-diff"));
     } Z_TEST_END
     /* }}} */
+    Z_TEST(specialized, "test IOP std: specialized codecs") { /* {{{ */
+        t_scope;
+        const iop_struct_t *st_s = &tstiop__specialized_struct__s;
+        const iop_struct_t *st_u = &tstiop__unspecialized_struct__s;
+        tstiop__specialized_struct__t ss;
+        tstiop__specialized_struct__t res;
+        tstiop__unspecialized_struct__t us;
+        lstr_t packed;
+        sb_t sb;
+
+        STATIC_ASSERT(sizeof(ss) == sizeof(us));
+
+        Z_ASSERT(st_s->st_attrs && st_s->st_attrs->codec);
+        Z_ASSERT_NULL(st_u->st_attrs);
+
+        iop_init(tstiop__specialized_struct, &ss);
+        ss.a = -42;
+        ss.b = 3000000000U;
+        ss.c = -7;
+        ss.d = 200;
+        ss.e = -3000;
+        ss.f = 60000;
+        ss.g = -(1LL << 40);
+        ss.h = UINT64_MAX;
+        ss.i = true;
+        ss.j = 3.14;
+        ss.k = MY_ENUM_A_D;
+        ss.l = LSTR("string");
+        ss.m = LSTR_EMPTY_V;
+        OPT_SET(ss.n, 1 << 20);
+        ss.s = 12;
+
+        /* The specialized packer produces the same bytes as the generic
+         * one. */
+        memcpy(&us, &ss, sizeof(ss));
+        Z_ASSERT_LSTREQUAL(t_iop_bpack_struct(st_s, &ss),
+                           t_iop_bpack_struct(st_u, &us));
+        Z_ASSERT_LSTREQUAL(
+            t_iop_bpack_struct_flags(st_s, &ss, IOP_BPACK_SKIP_DEFVAL),
+            t_iop_bpack_struct_flags(st_u, &us, IOP_BPACK_SKIP_DEFVAL));
+
+        ss.o = LSTR("optional");
+        OPT_SET(ss.p, -0.5);
+        ss.q = 0;
+        ss.r = LSTR("not the default value");
+        memcpy(&us, &ss, sizeof(ss));
+        packed = t_iop_bpack_struct(st_s, &ss);
+        Z_ASSERT_LSTREQUAL(packed, t_iop_bpack_struct(st_u, &us));
+        Z_ASSERT_LSTREQUAL(
+            t_iop_bpack_struct_flags(st_s, &ss, IOP_BPACK_SKIP_DEFVAL),
+            t_iop_bpack_struct_flags(st_u, &us, IOP_BPACK_SKIP_DEFVAL));
+
+        /* Unpacking and comparison */
+        Z_ASSERT_N(iop_bunpack(t_pool(), _G.iop_env, st_s, &res,
+                               ps_initlstr(&packed), false));
+        Z_ASSERT_IOPEQUAL(tstiop__specialized_struct, &res, &ss);
+        res.n.has_field = false;
+        Z_ASSERT(!iop_equals_desc(st_s, &res, &ss));
+        res.n.has_field = true;
+        res.o = LSTR_NULL_V;
+        Z_ASSERT(!iop_equals_desc(st_s, &res, &ss));
+        res.o = ss.o;
+        res.j = -0.0;
+        Z_ASSERT(!iop_equals_desc(st_s, &res, &ss));
+
+        /* The absent fields get their default values */
+        ss.o = LSTR_NULL_V;
+        OPT_CLR(ss.p);
+        ss.q = 42;
+        ss.r = LSTR("default");
+        packed = t_iop_bpack_struct_flags(st_s, &ss, IOP_BPACK_SKIP_DEFVAL);
+        p_clear(&res, 1);
+        OPT_SET(res.p, 1.);
+        Z_ASSERT_N(iop_bunpack(t_pool(), _G.iop_env, st_s, &res,
+                               ps_initlstr(&packed), false));
+        Z_ASSERT_IOPEQUAL(tstiop__specialized_struct, &res, &ss);
+
+        /* Unknown fields are left to the generic unpacker */
+        t_sb_init(&sb, packed.len + 3);
+        sb_add_lstr(&sb, packed);
+        sb_addc(&sb, (IOP_WIRE_INT1 << 5) | 30);
+        sb_addc(&sb, 101);
+        sb_addc(&sb, 1);
+        Z_ASSERT_N(iop_bunpack(t_pool(), _G.iop_env, st_s, &res,
+                               ps_initsb(&sb), false));
+        Z_ASSERT_IOPEQUAL(tstiop__specialized_struct, &res, &ss);
+
+        /* And so are the errors */
+        packed = t_iop_bpack_struct(&tstiop__s1__s, &(tstiop__s1__t){
+            .i = 1,
+        });
+        Z_ASSERT_NEG(iop_bunpack(t_pool(), _G.iop_env, st_s, &res,
+                                 ps_initlstr(&packed), false));
+        Z_ASSERT_NEG(iop_bunpack(t_pool(), _G.iop_env, st_u, &us,
+                                 ps_initlstr(&packed), false));
+    } Z_TEST_END;
+    /* }}} */
+    Z_TEST(bview, "test IOP binary views") { /* {{{ */
+        t_scope;
+        uint64_t uval[] = { UINT64_MAX, INT64_MAX, 0 };
+        int8_t i8val[] = { -1, 0, 1 };
+        lstr_t svals[] = { LSTR_IMMED("foo"), LSTR_IMMED("bar") };
+        tstiop__my_union_a__t un = IOP_UNION(tstiop__my_union_a, ua, 1);
+        tstiop__my_class3__t cls3;
+        tstiop__my_struct_a__t sa;
+        tstiop__repeated__t rep;
+        iop_bview_t view;
+        iop_bview_t sub;
+        iop_array_void_t arr;
+        const iop_field_t *fdesc;
+        lstr_t packed;
+        lstr_t s;
+        int64_t i64;
+        double d;
+
+        iop_init(tstiop__my_class3, &cls3);
+        cls3.int1 = 1;
+        cls3.int2 = 2;
+        cls3.int3 = 3;
+
+        iop_init(tstiop__my_struct_a, &sa);
+        sa.g = -10000;
+        sa.htab = IOP_ARRAY(uval, countof(uval));
+        sa.j = LSTR("string");
+        sa.k = MY_ENUM_A_D;
+        sa.l = IOP_UNION(tstiop__my_union_a, us, LSTR("union"));
+        sa.lr = &un;
+        sa.cls2 = &cls3.super;
+        sa.m = 3.5;
+        packed = t_iop_bpack_struct(&tstiop__my_struct_a__s, &sa);
+
+        Z_ASSERT_N(iop_bview_init(&view, t_pool(), _G.iop_env,
+                                  &tstiop__my_struct_a__s,
+                                  ps_initlstr(&packed)));
+
+        /* scalars and strings */
+        Z_ASSERT_P(fdesc = iop_bview_get_field(&view, LSTR("g")));
+        Z_ASSERT_N(iop_bview_get_int(&view, fdesc, 0, &i64));
+        Z_ASSERT_EQ(i64, -10000);
+        Z_ASSERT_P(fdesc = iop_bview_get_field(&view, LSTR("k")));
+        Z_ASSERT_N(iop_bview_get_int(&view, fdesc, 0, &i64));
+        Z_ASSERT_EQ(i64, MY_ENUM_A_D);
+        Z_ASSERT_P(fdesc = iop_bview_get_field(&view, LSTR("m")));
+        Z_ASSERT_N(iop_bview_get_double(&view, fdesc, 0, &d));
+        Z_ASSERT_EQ(d, 3.5);
+        Z_ASSERT_NEG(iop_bview_get_lstr(&view, fdesc, 0, &s));
+        Z_ASSERT_P(fdesc = iop_bview_get_field(&view, LSTR("j")));
+        Z_ASSERT_N(iop_bview_get_lstr(&view, fdesc, 0, &s));
+        Z_ASSERT_LSTREQUAL(s, LSTR("string"));
+        Z_ASSERT(s.s >= packed.s && s.s < packed.s + packed.len,
+                 "the string should point into the packed buffer");
+        Z_ASSERT_NULL(iop_bview_get_field(&view, LSTR("notAField")));
+
+        /* repeated values, in any order */
+        Z_ASSERT_P(fdesc = iop_bview_get_field(&view, LSTR("htab")));
+        Z_ASSERT_EQ(iop_bview_get_len(&view, fdesc), 3);
+        for (int i = 0; i < countof(uval); i++) {
+            Z_ASSERT_N(iop_bview_get_int(&view, fdesc, i, &i64));
+            Z_ASSERT_EQ((uint64_t)i64, uval[i]);
+        }
+        Z_ASSERT_N(iop_bview_get_int(&view, fdesc, 1, &i64));
+        Z_ASSERT_EQ(i64, INT64_MAX);
+        Z_ASSERT_NEG(iop_bview_get_int(&view, fdesc, 3, &i64));
+
+        /* unions */
+        Z_ASSERT_P(fdesc = iop_bview_get_field(&view, LSTR("l")));
+        Z_ASSERT_N(iop_bview_get_view(&view, fdesc, 0, &sub));
+        Z_ASSERT_EQ(iop_bview_get_len(&sub, &sub.st->fields[0]), 0);
+        Z_ASSERT_P(fdesc = iop_bview_get_field(&sub, LSTR("us")));
+        Z_ASSERT_N(iop_bview_get_lstr(&sub, fdesc, 0, &s));
+        Z_ASSERT_LSTREQUAL(s, LSTR("union"));
+
+        /* classes: the view has the real type of the value */
+        Z_ASSERT_P(fdesc = iop_bview_get_field(&view, LSTR("cls2")));
+        Z_ASSERT_N(iop_bview_get_view(&view, fdesc, 0, &sub));
+        Z_ASSERT(sub.st == &tstiop__my_class3__s);
+        Z_ASSERT_P(fdesc = iop_bview_get_field(&sub, LSTR("int1")));
+        Z_ASSERT_N(iop_bview_get_int(&sub, fdesc, 0, &i64));
+        Z_ASSERT_EQ(i64, 1);
+        Z_ASSERT_P(fdesc = iop_bview_get_field(&sub, LSTR("int3")));
+        Z_ASSERT_N(iop_bview_get_int(&sub, fdesc, 0, &i64));
+        Z_ASSERT_EQ(i64, 3);
+        Z_ASSERT_P(fdesc = iop_bview_get_field(&sub, LSTR("string1")));
+        Z_ASSERT_ZERO(iop_bview_get_len(&sub, fdesc));
+        Z_ASSERT_NEG(iop_bview_get_lstr(&sub, fdesc, 0, &s));
+
+        /* a field of another struct */
+        Z_ASSERT_NEG(iop_bview_get_int(&sub, &tstiop__my_struct_a__s.fields[0],
+                                       0, &i64));
+
+        /* raw arrays */
+        iop_init(tstiop__repeated, &rep);
+        rep.i8 = IOP_ARRAY(i8val, countof(i8val));
+        rep.s = IOP_ARRAY(svals, countof(svals));
+        packed = t_iop_bpack_struct(&tstiop__repeated__s, &rep);
+        Z_ASSERT_N(iop_bview_init(&view, t_pool(), _G.iop_env,
+                                  &tstiop__repeated__s, ps_initlstr(&packed)));
+        Z_ASSERT_P(fdesc = iop_bview_get_field(&view, LSTR("i8")));
+        Z_ASSERT_EQ(iop_bview_get_raw_array(&view, fdesc, &arr), 1);
+        Z_ASSERT_EQ(arr.len, countof(i8val));
+        Z_ASSERT_EQUAL((const int8_t *)arr.tab, arr.len, i8val,
+                       countof(i8val));
+        Z_ASSERT_N(iop_bview_get_int(&view, fdesc, 0, &i64));
+        Z_ASSERT_EQ(i64, -1);
+        Z_ASSERT_P(fdesc = iop_bview_get_field(&view, LSTR("s")));
+        Z_ASSERT_ZERO(iop_bview_get_raw_array(&view, fdesc, &arr));
+        for (int i = countof(svals); i-- > 0;) {
+            Z_ASSERT_N(iop_bview_get_lstr(&view, fdesc, i, &s));
+            Z_ASSERT_LSTREQUAL(s, svals[i]);
+        }
+        Z_ASSERT_P(fdesc = iop_bview_get_field(&view, LSTR("u8")));
+        Z_ASSERT_ZERO(iop_bview_get_len(&view, fdesc));
+
+        /* truncated buffer */
+        packed.len--;
+        Z_ASSERT_N(iop_bview_init(&view, t_pool(), _G.iop_env,
+                                  &tstiop__repeated__s, ps_initlstr(&packed)));
+        Z_ASSERT_NEG(iop_bview_get_len(&view, fdesc));
+        Z_ASSERT(strstr(iop_get_err(), "invalid binary encoding"), "%s",
+                 iop_get_err());
+    } Z_TEST_END;
+    /* }}} */
+    Z_TEST(bunpack_stream, "test the streaming binary unpacker") { /* {{{ */
+        t_scope;
+        int chunk_sizes[] = { 1, 2, 3, 7, 64, INT_MAX };
+        tstiop__my_struct_c__t leaves[3];
+        tstiop__my_struct_c__t mid;
+        tstiop__my_struct_c__t opt;
+        tstiop__my_struct_c__t root;
+        tstiop__my_struct_c__t out;
+        tstiop__my_struct_a__t sa;
+        tstiop__my_struct_a__t sa_out;
+        tstiop__my_class3__t cls3;
+        const iop_field_t *fdesc;
+        iop_bunpack_stream_t *stream;
+        lstr_t packed;
+        int nb_elems = 0;
+
+        for (int i = 0; i < countof(leaves); i++) {
+            iop_init(tstiop__my_struct_c, &leaves[i]);
+            leaves[i].a = i;
+        }
+        iop_init(tstiop__my_struct_c, &mid);
+        mid.a = 10;
+        mid.b = &leaves[0];
+        mid.c = IOP_TYPED_ARRAY(tstiop__my_struct_c, leaves, 3);
+        iop_init(tstiop__my_struct_c, &opt);
+        opt.a = 20;
+        opt.c = IOP_TYPED_ARRAY(tstiop__my_struct_c, &leaves[1], 2);
+        iop_init(tstiop__my_struct_c, &root);
+        root.a = 100;
+        root.b = &opt;
+        root.c = IOP_TYPED_ARRAY(tstiop__my_struct_c, &mid, 1);
+        packed = t_iop_bpack_struct(&tstiop__my_struct_c__s, &root);
+
+        /* nested structs and arrays, whatever the size of the chunks */
+        carray_for_each_entry(size, chunk_sizes) {
+            Z_ASSERT_N(z_bunpack_stream(&tstiop__my_struct_c__s, &out,
+                                        packed, size),
+                       "chunks of %d bytes: %s", size, iop_get_err());
+            Z_ASSERT_IOPEQUAL(tstiop__my_struct_c, &out, &root);
+        }
+
+        /* all kinds of fields */
+        iop_init(tstiop__my_class3, &cls3);
+        cls3.int1 = 1;
+        cls3.int3 = 3;
+        iop_init(tstiop__my_struct_a, &sa);
+        sa.g = -10000;
+        sa.j = LSTR("string");
+        sa.l = IOP_UNION(tstiop__my_union_a, us, LSTR("union"));
+        sa.lr = &sa.l;
+        sa.cls2 = &cls3.super;
+        sa.m = 3.5;
+        packed = t_iop_bpack_struct(&tstiop__my_struct_a__s, &sa);
+        carray_for_each_entry(size, chunk_sizes) {
+            Z_ASSERT_N(z_bunpack_stream(&tstiop__my_struct_a__s, &sa_out,
+                                        packed, size),
+                       "chunks of %d bytes: %s", size, iop_get_err());
+            Z_ASSERT_IOPEQUAL(tstiop__my_struct_a, &sa_out, &sa);
+        }
+
+        /* truncated value */
+        packed.len--;
+        Z_ASSERT_NEG(z_bunpack_stream(&tstiop__my_struct_a__s, &sa_out,
+                                      packed, 5));
+        Z_ASSERT(strstr(iop_get_err(), "truncated"), "%s", iop_get_err());
+
+        /* elements of a repeated field handed to a callback */
+        packed = t_iop_bpack_struct(&tstiop__my_struct_c__s, &mid);
+        Z_ASSERT_N(iop_field_find_by_name(&tstiop__my_struct_c__s, LSTR("c"),
+                                          NULL, &fdesc));
+        stream = iop_bunpack_stream_new(t_pool(), _G.iop_env,
+                                        &tstiop__my_struct_c__s, &out, 0);
+        iop_bunpack_stream_set_cb(stream, fdesc,
+                                  &z_bunpack_stream_check_elem, &nb_elems);
+        for (int i = 0; i < packed.len; i++) {
+            Z_ASSERT_N(iop_bunpack_stream_feed(stream,
+                                               ps_init(packed.s + i, 1)),
+                       "%s", iop_get_err());
+        }
+        Z_ASSERT_N(iop_bunpack_stream_finish(stream));
+        iop_bunpack_stream_delete(&stream);
+        Z_ASSERT_EQ(nb_elems, 3);
+        Z_ASSERT_EQ(out.a, 10);
+        Z_ASSERT_EQ(out.b->a, 0);
+        Z_ASSERT_EQ(out.c.len, 0);
+    } Z_TEST_END;
+    /* }}} */
     Z_TEST(private, "test private attribute with binary packing") { /* {{{ */
         t_scope;
         void *out = NULL;
@@ -4700,6 +5186,101 @@ Z_GROUP_EXPORT(iop)
         ADD_PARAM("htab", IOP_SORT_REVERSE);
         SORT_AND_CHECK(2, 1, 0);
 
+#undef ADD_PARAM
+#undef SORT_AND_CHECK
+
+    } Z_TEST_END;
+    /* }}} */
+    Z_TEST(iop_msort_radix, "test IOP radix sorting of large vectors") { /* {{{ */
+        t_scope;
+        enum { N = 100000 };
+        const char *strs[] = {
+            "Toto", "tutu", "TOTO", "toto2", "a", "", "zebra-crossing-a",
+            "Zebra-crossing-b", "zebra-cross",
+        };
+        tstiop__filtered_struct__t *objs;
+        qv_t(iop_sort) params;
+        byte *seen;
+
+        objs = t_new(tstiop__filtered_struct__t, N);
+        t_qv_init(&params, 2);
+        seen = t_new(byte, BITS_TO_ARRAY_LEN(byte, N));
+
+#define ADD_PARAM(_field, _flags)  do {                                      \
+        qv_append(&params, ((iop_sort_t){                                    \
+            .field_path = LSTR(_field),                                      \
+            .flags = _flags,                                                 \
+        }));                                                                 \
+    } while (0)
+
+        /* Check that the vector is a permutation of the objects, ordered
+         * according to `_cmp`. */
+#define SORT_AND_CHECK(_len, _cmp)  do {                                     \
+        Z_ASSERT_N(iop_msort(_G.iop_env, tstiop__filtered_struct, objs,      \
+                             (_len), &params, NULL));                        \
+        p_clear(seen, BITS_TO_ARRAY_LEN(byte, N));                           \
+        for (int i = 0; i < (_len); i++) {                                   \
+            Z_ASSERT(!TST_BIT(seen, objs[i].b));                             \
+            SET_BIT(seen, objs[i].b);                                        \
+            if (i) {                                                         \
+                const tstiop__filtered_struct__t *o1 = &objs[i - 1];         \
+                const tstiop__filtered_struct__t *o2 = &objs[i];             \
+                                                                             \
+                Z_ASSERT_LE((_cmp), 0, "at %d", i);                          \
+            }                                                                \
+        }                                                                    \
+    } while (0)
+
+        for (int k = 0; k < 2; k++) {
+            int len = k ? N : 1000;
+
+            if (k) {
+                MODULE_REQUIRE(thr);
+            }
+            for (int i = 0; i < len; i++) {
+                iop_init(tstiop__filtered_struct, &objs[i]);
+                objs[i].a = (int)(i * 2654435761U) >> 8;
+                objs[i].b = i;
+                objs[i].d = i % 7;
+                objs[i].s = LSTR(strs[i % countof(strs)]);
+                if (i % 5) {
+                    objs[i].long_string = t_lstr_fmt("%s%d",
+                                                     strs[i % 3], i % 11);
+                }
+            }
+
+            qv_clear(&params);
+            ADD_PARAM("a", IOP_SORT_REVERSE);
+            SORT_AND_CHECK(len, CMP(o2->a, o1->a));
+
+            qv_clear(&params);
+            ADD_PARAM("s", 0);
+            ADD_PARAM("b", IOP_SORT_REVERSE);
+            SORT_AND_CHECK(len, lstr_utf8_icmp(o1->s, o2->s)
+                           ?: CMP(o2->b, o1->b));
+
+            qv_clear(&params);
+            ADD_PARAM("longString", IOP_SORT_NULL_FIRST);
+            ADD_PARAM("d", 0);
+            SORT_AND_CHECK(len,
+                           CMP(!!o1->long_string.s, !!o2->long_string.s)
+                           ?: lstr_utf8_icmp(o1->long_string,
+                                             o2->long_string)
+                           ?: CMP(o1->d, o2->d));
+
+            /* Non-ASCII strings cannot be sorted with the radix sort. */
+            objs[len / 2].s = LSTR("\xc3\xa9t\xc3\xa9");
+            qv_clear(&params);
+            ADD_PARAM("s", IOP_SORT_REVERSE);
+            ADD_PARAM("b", 0);
+            SORT_AND_CHECK(len, lstr_utf8_icmp(o2->s, o1->s)
+                           ?: CMP(o1->b, o2->b));
+
+            if (k) {
+                MODULE_RELEASE(thr);
+            }
+        }
+
 #undef ADD_PARAM
 #undef SORT_AND_CHECK
 
@@ -5218,6 +5799,292 @@ Z_GROUP_EXPORT(iop)
 
     } Z_TEST_END;
     /* }}} */
+    Z_TEST(iop_filter_prog, "test compiled IOP filters") { /* {{{ */
+        t_scope;
+        SB_1k(err);
+        enum { N = 100003 };
+        tstiop__filtered_struct__t *objs;
+        int a_vals[] = { 50, 3, 10, 3 };
+        uint8_t d_vals[] = { 255, 7 };
+        int c_vals[] = { 4, 1 };
+        lstr_t s_vals[] = { LSTR("TOTO"), LSTR("tutu") };
+        void *a_ptrs[countof(a_vals)];
+        void *d_ptrs[countof(d_vals)];
+        void *c_ptrs[countof(c_vals)];
+        void *s_ptrs[countof(s_vals)];
+        byte *bitmap;
+        iop_filter_prog_t *prog;
+
+        objs = t_new(tstiop__filtered_struct__t, N);
+        for (int i = 0; i < N; i++) {
+            iop_init(tstiop__filtered_struct, &objs[i]);
+            objs[i].a = i % 97;
+            objs[i].d = i % 256;
+            if (i % 3) {
+                objs[i].c = T_IOP_ARRAY(i32, i % 5, i % 7);
+            }
+            objs[i].s = i % 2 ? LSTR("toto") : LSTR("titi");
+        }
+        carray_for_each_pos(pos, a_vals) {
+            a_ptrs[pos] = &a_vals[pos];
+        }
+        carray_for_each_pos(pos, d_vals) {
+            d_ptrs[pos] = &d_vals[pos];
+        }
+        carray_for_each_pos(pos, c_vals) {
+            c_ptrs[pos] = &c_vals[pos];
+        }
+        carray_for_each_pos(pos, s_vals) {
+            s_ptrs[pos] = &s_vals[pos];
+        }
+        bitmap = t_new(byte, BITS_TO_ARRAY_LEN(byte, N));
+
+        /* The results are checked both on the monothread and the threaded
+         * runs. */
+        for (int k = 0; k < 2; k++) {
+            if (k) {
+                MODULE_REQUIRE(thr);
+            }
+
+            /* Direct access to an int field, with duplicated values. */
+            p_clear(bitmap, BITS_TO_ARRAY_LEN(byte, N));
+            prog = mp_iop_filter_prog_compile(t_pool(), _G.iop_env,
+                                              &tstiop__filtered_struct__s,
+                                              LSTR("a"), a_ptrs,
+                                              countof(a_ptrs), 0, &err);
+            Z_ASSERT_P(prog, "%*pM", SB_FMT_ARG(&err));
+            iop_filter_prog_run(prog, objs, N, BITMAP_OP_OR, bitmap);
+            for (int i = 0; i < N; i++) {
+                int a = i % 97;
+                bool exp = a == 3 || a == 10 || a == 50;
+
+                Z_ASSERT_EQ(!!TST_BIT(bitmap, i), exp, "object %d", i);
+                Z_ASSERT_EQ(iop_filter_prog_matches(prog, &objs[i]), exp);
+            }
+
+            /* Intersection with an inverted filter on an ubyte field. */
+            prog = mp_iop_filter_prog_compile(t_pool(), _G.iop_env,
+                                              &tstiop__filtered_struct__s,
+                                              LSTR("d"), d_ptrs,
+                                              countof(d_ptrs),
+                                              IOP_FILTER_INVERT_MATCH, &err);
+            Z_ASSERT_P(prog, "%*pM", SB_FMT_ARG(&err));
+            iop_filter_prog_run(prog, objs, N, BITMAP_OP_AND, bitmap);
+            for (int i = 0; i < N; i++) {
+                int a = i % 97;
+                int d = i % 256;
+                bool exp = (a == 3 || a == 10 || a == 50)
+                        && d != 7 && d != 255;
+
+                Z_ASSERT_EQ(!!TST_BIT(bitmap, i), exp, "object %d", i);
+            }
+
+            /* Sorted values on a repeated field. */
+            p_clear(bitmap, BITS_TO_ARRAY_LEN(byte, N));
+            prog = mp_iop_filter_prog_compile(t_pool(), _G.iop_env,
+                                              &tstiop__filtered_struct__s,
+                                              LSTR("c"), c_ptrs,
+                                              countof(c_ptrs), 0, &err);
+            Z_ASSERT_P(prog, "%*pM", SB_FMT_ARG(&err));
+            iop_filter_prog_run(prog, objs, N, BITMAP_OP_OR, bitmap);
+            for (int i = 0; i < N; i++) {
+                bool exp = (i % 3) && (i % 5 == 1 || i % 5 == 4
+                                   ||  i % 7 == 1 || i % 7 == 4);
+
+                Z_ASSERT_EQ(!!TST_BIT(bitmap, i), exp, "object %d", i);
+            }
+
+            /* Sorted string values, compared case-insensitively. */
+            p_clear(bitmap, BITS_TO_ARRAY_LEN(byte, N));
+            prog = mp_iop_filter_prog_compile(t_pool(), _G.iop_env,
+                                              &tstiop__filtered_struct__s,
+                                              LSTR("s"), s_ptrs,
+                                              countof(s_ptrs), 0, &err);
+            Z_ASSERT_P(prog, "%*pM", SB_FMT_ARG(&err));
+            iop_filter_prog_run(prog, objs, N, BITMAP_OP_OR, bitmap);
+            for (int i = 0; i < N; i++) {
+                Z_ASSERT_EQ(!!TST_BIT(bitmap, i), i % 2 == 1, "object %d", i);
+            }
+
+            /* Presence of a repeated field. */
+            p_clear(bitmap, BITS_TO_ARRAY_LEN(byte, N));
+            prog = mp_iop_filter_opt_prog_compile(t_pool(), _G.iop_env,
+                                                  &tstiop__filtered_struct__s,
+                                                  LSTR("c"), true, &err);
+            Z_ASSERT_P(prog, "%*pM", SB_FMT_ARG(&err));
+            iop_filter_prog_run(prog, objs, N, BITMAP_OP_OR, bitmap);
+            for (int i = 0; i < N; i++) {
+                Z_ASSERT_EQ(!!TST_BIT(bitmap, i), i % 3 != 0, "object %d", i);
+            }
+
+            if (k) {
+                MODULE_RELEASE(thr);
+            }
+        }
+
+        /* Invalid filters. */
+        sb_reset(&err);
+        prog = mp_iop_filter_opt_prog_compile(t_pool(), _G.iop_env,
+                                              &tstiop__filtered_struct__s,
+                                              LSTR("a"), true, &err);
+        Z_ASSERT_NULL(prog);
+        Z_ASSERT(strstr(err.data, "neither optional nor repeated"),
+                 "%*pM", SB_FMT_ARG(&err));
+        sb_reset(&err);
+        prog = mp_iop_filter_prog_compile(t_pool(), _G.iop_env,
+                                          &tstiop__filtered_struct__s,
+                                          LSTR("unknown"), a_ptrs, 1, 0,
+                                          &err);
+        Z_ASSERT_NULL(prog);
+    } Z_TEST_END;
+    /* }}} */
+    Z_TEST(iop_columns, "test IOP columnar batches") { /* {{{ */
+        t_scope;
+        SB_1k(err);
+        enum { N = 1000 };
+        const iop_struct_t *st = &tstiop__filtered_struct__s;
+        tstiop__filtered_struct__t *objs;
+        tstiop__filtered_struct__t *out;
+        iop_columns_t cols;
+        const iop_column_t *col;
+        qv_t(iop_sort) sorts;
+        int *perm;
+        uint8_t d_vals[] = { 3, 200, 3 };
+        void *d_ptrs[countof(d_vals)];
+        lstr_t like = LSTR("%1%");
+        void *like_ptrs[] = { &like };
+        byte *exp_bitmap;
+        byte *bitmap;
+        int len;
+
+        objs = t_new(tstiop__filtered_struct__t, N);
+        for (int i = 0; i < N; i++) {
+            iop_init(tstiop__filtered_struct, &objs[i]);
+            objs[i].a = (i * 7919) % 101 - 50;
+            objs[i].d = (i * 31) % 256;
+            objs[i].s = t_lstr_fmt("s%d", i % 13);
+            if (i % 4) {
+                objs[i].long_string = t_lstr_fmt("l%d", i % 17);
+            }
+        }
+        carray_for_each_pos(pos, d_vals) {
+            d_ptrs[pos] = &d_vals[pos];
+        }
+
+        /* Conversion. */
+        Z_ASSERT_N(iop_columns_init(&cols, t_pool(), st, objs, N, NULL, 0,
+                                    &err), "%*pM", SB_FMT_ARG(&err));
+        Z_ASSERT_EQ(cols.len, N);
+        Z_ASSERT_EQ(cols.columns_len, 5);
+        Z_ASSERT_NULL(iop_columns_get(&cols, LSTR("c")));
+        Z_ASSERT_P(col = iop_columns_get(&cols, LSTR("d")));
+        Z_ASSERT_NULL(col->is_set);
+        Z_ASSERT_EQ(((uint8_t *)col->values)[10], objs[10].d);
+        Z_ASSERT_P(col = iop_columns_get(&cols, LSTR("longString")));
+        Z_ASSERT_P(col->is_set);
+        Z_ASSERT(!TST_BIT(col->is_set, 8));
+        Z_ASSERT(TST_BIT(col->is_set, 9));
+        Z_ASSERT_LSTREQUAL(((lstr_t *)col->values)[9], LSTR("l9"));
+
+        out = t_new(tstiop__filtered_struct__t, N);
+        for (int i = 0; i < N; i++) {
+            iop_init(tstiop__filtered_struct, &out[i]);
+        }
+        iop_columns_to_vec(&cols, out);
+        for (int i = 0; i < N; i++) {
+            Z_ASSERT_IOPEQUAL(tstiop__filtered_struct, &out[i], &objs[i]);
+        }
+
+        /* Sort on a single integer column. */
+        perm = t_new_raw(int, N);
+        t_qv_init(&sorts, 2);
+        qv_append(&sorts, ((iop_sort_t){ LSTR("a"), IOP_SORT_REVERSE }));
+        Z_ASSERT_N(iop_columns_sort(&cols, &sorts, perm, &err));
+        for (int i = 1; i < N; i++) {
+            const tstiop__filtered_struct__t *o1 = &objs[perm[i - 1]];
+            const tstiop__filtered_struct__t *o2 = &objs[perm[i]];
+
+            Z_ASSERT_GE(o1->a, o2->a);
+            if (o1->a == o2->a) {
+                Z_ASSERT_LT(perm[i - 1], perm[i]);
+            }
+        }
+
+        /* Sort on an optional column, then on a string. */
+        qv_clear(&sorts);
+        qv_append(&sorts, ((iop_sort_t){ LSTR("longString"),
+                                         IOP_SORT_NULL_FIRST }));
+        qv_append(&sorts, ((iop_sort_t){ LSTR("s"), 0 }));
+        Z_ASSERT_N(iop_columns_sort(&cols, &sorts, perm, &err));
+        for (int i = 1; i < N; i++) {
+            const tstiop__filtered_struct__t *o1 = &objs[perm[i - 1]];
+            const tstiop__filtered_struct__t *o2 = &objs[perm[i]];
+            int res;
+
+            Z_ASSERT(o1->long_string.s || o2->long_string.s
+                 ||  lstr_cmp(o1->s, o2->s) <= 0);
+            Z_ASSERT(!o1->long_string.s || o2->long_string.s);
+            if (o1->long_string.s) {
+                res = lstr_cmp(o1->long_string, o2->long_string);
+                Z_ASSERT_LE(res, 0);
+                Z_ASSERT(res || lstr_cmp(o1->s, o2->s) <= 0);
+            }
+        }
+
+        qv_clear(&sorts);
+        qv_append(&sorts, ((iop_sort_t){ LSTR("c"), 0 }));
+        sb_reset(&err);
+        Z_ASSERT_NEG(iop_columns_sort(&cols, &sorts, perm, &err));
+
+        /* Filters, compared to the filters on the objects. */
+        bitmap = t_new(byte, BITS_TO_ARRAY_LEN(byte, N));
+        exp_bitmap = NULL;
+        Z_ASSERT_N(t_iop_filter_bitmap(_G.iop_env, st, objs, N, LSTR("d"),
+                                       d_ptrs, countof(d_ptrs), 0,
+                                       BITMAP_OP_OR, &exp_bitmap, &err));
+        Z_ASSERT_N(t_iop_filter_bitmap(_G.iop_env, st, objs, N,
+                                       LSTR("longString"), like_ptrs, 1,
+                                       IOP_FILTER_SQL_LIKE |
+                                       IOP_FILTER_INVERT_MATCH,
+                                       BITMAP_OP_OR, &exp_bitmap, &err));
+        Z_ASSERT_N(iop_columns_filter_bitmap(&cols, LSTR("d"), d_ptrs,
+                                             countof(d_ptrs), 0,
+                                             BITMAP_OP_OR, bitmap, &err));
+        Z_ASSERT_N(iop_columns_filter_bitmap(&cols, LSTR("longString"),
+                                             like_ptrs, 1,
+                                             IOP_FILTER_SQL_LIKE |
+                                             IOP_FILTER_INVERT_MATCH,
+                                             BITMAP_OP_OR, bitmap, &err));
+        Z_ASSERT_EQUAL(bitmap, BITS_TO_ARRAY_LEN(byte, N),
+                       exp_bitmap, BITS_TO_ARRAY_LEN(byte, N));
+
+        /* Permutation and compaction. */
+        len = N;
+        iop_filter_bitmap_apply(st, objs, &len, bitmap);
+        iop_columns_filter_apply(&cols, bitmap);
+        Z_ASSERT_EQ(cols.len, len);
+        p_clear(out, N);
+        for (int i = 0; i < len; i++) {
+            iop_init(tstiop__filtered_struct, &out[i]);
+            perm[i] = len - 1 - i;
+        }
+        iop_columns_permute(&cols, perm);
+        iop_columns_to_vec(&cols, out);
+        for (int i = 0; i < len; i++) {
+            Z_ASSERT_IOPEQUAL(tstiop__filtered_struct, &out[i],
+                              &objs[len - 1 - i]);
+        }
+
+        iop_columns_wipe(&cols);
+
+        /* Errors. */
+        sb_reset(&err);
+        Z_ASSERT_NEG(iop_columns_init(&cols, t_pool(), st, objs, N,
+                                      (lstr_t[]){ LSTR("c") }, 1, &err));
+        Z_ASSERT(strstr(err.data, "cannot be put in a column"),
+                 "%*pM", SB_FMT_ARG(&err));
+    } Z_TEST_END;
+    /* }}} */
     Z_TEST(iop_prune, "check gen attr filtering") { /* {{{ */
         tstiop__filtered_struct__t obj;
         int arr[] = { 1, 2, 3 };
@@ -7781,6 +8648,38 @@ Z_GROUP_EXPORT(iop)
         }
     } Z_TEST_END;
     /* }}} */
+    Z_TEST(enum_printf_nested, "test %*pE in a compiled format") { /* {{{ */
+        /* The formatter of %*pE outputs a format of its own: use the format
+         * at enough addresses for one of them to share its slot in the
+         * cache of the compiled formats. */
+#define F1   "%*pE|%d\0"
+#define F4   F1 F1 F1 F1
+#define F16  F4 F4 F4 F4
+#define F64  F16 F16 F16 F16
+        static const char fmts[] = F64 F64 F64 F64;
+#undef F64
+#undef F16
+#undef F4
+#undef F1
+        int fmt_size = strlen(fmts) + 1;
+        SB_1k(sb);
+
+        CC_WARNING_IGNORE_PUSH
+        CC_WARNING_IGNORE_FORMAT_NONLITERAL
+
+        for (int i = 0; i < ssizeof(fmts) / fmt_size; i++) {
+            t_scope;
+
+            sb_reset(&sb);
+            sb_addf(&sb, fmts + i * fmt_size,
+                    IOP_ENUM_FMT_ARG_FLAGS(tstiop__my_enum_d, MY_ENUM_D_BAR,
+                                           IOP_ENUM_FMT_FULL), i);
+            Z_ASSERT_STREQUAL(sb.data, t_fmt("BAR(2)|%d", i));
+        }
+
+        CC_WARNING_IGNORE_POP
+    } Z_TEST_END;
+    /* }}} */
     Z_TEST(union_printf, "test %*pU in format string for IOP union types") { /* {{{ */
         t_scope;
         tstiop__my_union_c__t uc;
@@ -7999,6 +8898,70 @@ Z_GROUP_EXPORT(iop)
         Z_ASSERT_NULL(res);
     } Z_TEST_END;
     /* }}} */
+    Z_TEST(iop_image, "test relocatable images of IOP values") { /* {{{ */
+        t_scope;
+        SB_1k(err);
+        const char *path;
+        tstiop__full_struct__t fs;
+        tstiop__full_struct__t *res;
+        const iop_struct_t *st = tstiop__full_struct__sp;
+        const iop_struct_t *cls_st;
+        lstr_t image;
+        uint64_t *buf;
+        tstiop__two_strings__t strs;
+        lstr_t *s;
+        void *obj;
+
+        path = t_fmt("%*pM/samples/z-full-struct.json",
+                     LSTR_FMT_ARG(z_cmddir_g));
+        Z_ASSERT_N(t_iop_junpack_file(_G.iop_env, path, st, &fs, 0, NULL,
+                                      &err),
+                   "%pL", &err);
+
+        /* The image does not depend on its address. */
+        image = t_iop_image_dup(tstiop__full_struct, &fs);
+        buf = t_new_raw(uint64_t, DIV_ROUND_UP(image.len, 8));
+        memcpy(buf, image.s, image.len);
+        res = iop_image_load(_G.iop_env, tstiop__full_struct, buf,
+                             image.len);
+        Z_ASSERT_P(res, "%s", iop_get_err());
+        Z_ASSERT_IOPEQUAL(tstiop__full_struct, res, &fs);
+
+        /* Classes. */
+        cls_st = fs.required.o->__vptr;
+        image = mp_iop_image_dup_desc(t_pool(), cls_st, fs.required.o);
+        obj = iop_image_load_desc(_G.iop_env, cls_st, image.v, image.len);
+        Z_ASSERT_P(obj, "%s", iop_get_err());
+        Z_ASSERT(*(const iop_struct_t **)obj == cls_st);
+        Z_ASSERT_IOPEQUAL_DESC(cls_st, obj, fs.required.o);
+
+        /* Invalid images. */
+        image = t_iop_image_dup(tstiop__full_struct, &fs);
+        Z_ASSERT_NULL(iop_image_load(_G.iop_env, tstiop__full_struct,
+                                     image.v, image.len - 1));
+        Z_ASSERT_NULL(iop_image_load_desc(_G.iop_env,
+                                          &tstiop__my_struct_a__s,
+                                          image.v, image.len));
+        Z_ASSERT(strstr(iop_get_err(), "is not an image of"));
+
+        /* Out of bounds string. */
+        iop_init(tstiop__two_strings, &strs);
+        strs.a = LSTR("foo");
+        strs.b = LSTR("bar");
+        image = t_iop_image_dup(tstiop__two_strings, &strs);
+        buf = t_new_raw(uint64_t, DIV_ROUND_UP(image.len, 8));
+        memcpy(buf, image.s, image.len);
+        obj = iop_image_load(_G.iop_env, tstiop__two_strings, image.v,
+                             image.len);
+        Z_ASSERT_P(obj);
+        s = (lstr_t *)((byte *)buf + ((byte *)obj - (byte *)image.v)
+                       + offsetof(tstiop__two_strings__t, b));
+        s->data = (void *)(uintptr_t)(image.len - s->len);
+        Z_ASSERT_NULL(iop_image_load(_G.iop_env, tstiop__two_strings, buf,
+                                     image.len));
+        Z_ASSERT(strstr(iop_get_err(), "corrupted image"));
+    } Z_TEST_END;
+    /* }}} */
     Z_TEST(nr_58558, "avoid leak when copying an IOP with no value") { /* {{{ */
         tstiop__my_struct_c__t st;
         tstiop__my_struct_c__t *p;
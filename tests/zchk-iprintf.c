@@ -238,6 +238,78 @@ Z_GROUP_EXPORT(iprintf) {
 
 #undef T
     } Z_TEST_END;
+
+    Z_TEST(decimal, "compare the decimal conversions with the libc") {
+        /* snprintf is a macro for isnprintf, the parentheses call the libc
+         * version. */
+        static int64_t values[] = {
+            0, 1, 9, 10, 11, 99, 100, 101, 999, 1000, 9999, 10000,
+            99999999, 100000000, 123456789, INT32_MAX, INT32_MIN,
+            UINT32_MAX, (int64_t)UINT32_MAX + 1, 999999999999999999,
+            INT64_MAX, INT64_MIN, -1, -9, -10, -99, -100, -101,
+        };
+
+        carray_for_each_entry(v, values) {
+            char ibuf[128];
+            char buf[128];
+
+#define T(_fmt, ...) \
+            do {                                                             \
+                int len = isnprintf(ibuf, sizeof(ibuf), _fmt, __VA_ARGS__);  \
+                                                                             \
+                (snprintf)(buf, sizeof(buf), _fmt, __VA_ARGS__);             \
+                Z_ASSERT_STREQUAL(ibuf, buf, "format: `%s'", _fmt);          \
+                Z_ASSERT_EQ(len, (int)strlen(buf), "format: `%s'", _fmt);    \
+            } while (0)
+
+            T("%d", (int)v);
+            T("%u|%hd|%hhu", (unsigned)v, (short)v, (unsigned char)v);
+            T("%ld|%lu|%lld", (long)v, (unsigned long)v, (long long)v);
+            T("%5d|%-12ld|%020lu|%.3d|%+d|% d", (int)v, (long)v,
+              (unsigned long)v, (int)v, (int)v, (int)v);
+            T("%jd|%zu|%lx|%#lo", (intmax_t)v, (size_t)v,
+              (unsigned long)v, (unsigned long)v);
+#undef T
+        }
+    } Z_TEST_END;
+
+    Z_TEST(compiled_formats, "the formats are compiled on their first use") {
+        t_scope;
+        static const char *truncated_fmts[] = { "ab%", "ab%-l" };
+        char buf[128];
+        char fmt[32];
+        int n = 0;
+
+        /* the same literal format is parsed once and then reused */
+        for (int i = 0; i < 3; i++) {
+            Z_ASSERT_EQ(isnprintf(buf, sizeof(buf), "%s:%*d|%-4.*s|%n%c%%",
+                                  "a", 3, i, 2, "xyz", &n, 'z'), 13);
+            Z_ASSERT_STREQUAL(buf, t_fmt("a:  %d|xy  |z%%", i));
+            Z_ASSERT_EQ(n, 11);
+        }
+
+        CC_WARNING_IGNORE_PUSH
+        CC_WARNING_IGNORE_FORMAT_NONLITERAL
+
+        /* the formats built at runtime can change at the same address */
+        for (int i = 0; i < 3; i++) {
+            isnprintf(fmt, sizeof(fmt), "%%0%dd|%%s", i + 2);
+            isnprintf(buf, sizeof(buf), fmt, 7, "b");
+            Z_ASSERT_STREQUAL(buf, t_fmt("%0*d|b", i + 2, 7));
+        }
+
+        /* truncated conversions are not output */
+        carray_for_each_entry(truncated, truncated_fmts) {
+            Z_ASSERT_EQ(isnprintf(buf, sizeof(buf), truncated), 2);
+            Z_ASSERT_STREQUAL(buf, "ab");
+        }
+
+        CC_WARNING_IGNORE_POP
+
+        /* the output is truncated as usual */
+        Z_ASSERT_EQ(isnprintf(buf, 8, "%d-%d", 123456, 789), 10);
+        Z_ASSERT_STREQUAL(buf, "123456-");
+    } Z_TEST_END;
 } Z_GROUP_END
 
 /* LCOV_EXCL_STOP */
@@ -88,6 +88,177 @@ static int z_memtoxll_ext(bool str, bool sgn, const char *p, int len,
     Z_HELPER_END;
 }
 
+static ssize_t z_ob_writev(int fd, const struct iovec *iov, int iovcnt,
+                           void *priv)
+{
+    return writev(fd, iov, iovcnt);
+}
+
+/* Write a file range with some data around it in an outbuf, flush it in a
+ * file, and check the content of the written file. */
+static int z_ob_file_range(const char *src, lstr_t content, int offset,
+                           int len, bool custom_writer)
+{
+    t_scope;
+    const char *dst = t_fmt("%*pM/ob-dst", LSTR_FMT_ARG(z_tmpdir_g));
+    outbuf_t ob;
+    int ifd;
+    int ofd;
+    lstr_t res;
+
+    ob_init(&ob);
+    ob_adds(&ob, "head");
+    Z_ASSERT_N(ifd = open(src, O_RDONLY));
+    Z_ASSERT_N(ob_add_file_range(&ob, ifd, offset, len, true));
+    ob_adds(&ob, "tail");
+    Z_ASSERT_EQ(ob.length, len + 8);
+
+    Z_ASSERT_N(ofd = open(dst, O_WRONLY | O_CREAT | O_TRUNC, 0644));
+    while (!ob_is_empty(&ob)) {
+        if (custom_writer) {
+            Z_ASSERT_N(ob_write_with(&ob, ofd, &z_ob_writev, NULL));
+        } else {
+            Z_ASSERT_N(ob_write(&ob, ofd));
+        }
+    }
+    p_close(&ofd);
+    ob_wipe(&ob);
+
+    Z_ASSERT_N(lstr_init_from_file(&res, dst, PROT_READ, MAP_SHARED));
+    Z_ASSERT_LSTREQUAL(LSTR_INIT_V(res.s, 4), LSTR("head"));
+    Z_ASSERT_LSTREQUAL(LSTR_INIT_V(res.s + 4, len),
+                       LSTR_INIT_V(content.s + offset, len));
+    Z_ASSERT_LSTREQUAL(LSTR_INIT_V(res.s + 4 + len, 4), LSTR("tail"));
+    Z_ASSERT_EQ(res.len, len + 8);
+    lstr_wipe(&res);
+
+    Z_HELPER_END;
+}
+
+/* Send slices of a shared buffer with some data around them on a TCP
+ * connection, and check the received data. */
+static int z_ob_shared(outbuf_shared_t *obs, lstr_t content, bool zerocopy)
+{
+    t_scope;
+    sockunion_t su;
+    int server;
+    int wfd;
+    int rfd;
+    int refcnt = obs->refcnt;
+    outbuf_t ob;
+    sb_t exp;
+    sb_t res;
+
+    Z_ASSERT_N(addr_info_str(&su, "127.0.0.1", 0, AF_INET));
+    Z_ASSERT_N(server = listenx(-1, &su, 1, SOCK_STREAM, IPPROTO_TCP, 0));
+    sockunion_setport(&su, getsockport(server, AF_INET));
+    Z_ASSERT_N(wfd = connectx(-1, &su, 1, SOCK_STREAM, IPPROTO_TCP, 0));
+    Z_ASSERT_N(rfd = acceptx(server, 0));
+    p_close(&server);
+    Z_ASSERT_N(fd_set_features(wfd, O_NONBLOCK));
+
+    ob_init(&ob);
+    if (zerocopy) {
+        Z_ASSERT_N(ob_enable_zerocopy(&ob, wfd));
+    }
+    t_sb_init(&exp, 2 * content.len);
+
+    /* Small slices are copied, the other ones are referenced. */
+    ob_adds(&ob, "head");
+    ob_add_shared(&ob, obs, 17, 100);
+    ob_add_shared(&ob, obs, 1000, 200000);
+    ob_add_shared(&ob, obs, 300000, 500000);
+    ob_adds(&ob, "mid");
+    ob_add_shared(&ob, obs, 0, content.len);
+    ob_adds(&ob, "tail");
+    ob_check_invariants(&ob);
+    Z_ASSERT_EQ(obs->refcnt, refcnt + 3);
+
+    sb_adds(&exp, "head");
+    sb_add(&exp, content.s + 17, 100);
+    sb_add(&exp, content.s + 1000, 200000);
+    sb_add(&exp, content.s + 300000, 500000);
+    sb_adds(&exp, "mid");
+    sb_add_lstr(&exp, content);
+    sb_adds(&exp, "tail");
+    Z_ASSERT_EQ(ob.length, exp.len);
+
+    /* The chunks sent with MSG_ZEROCOPY are kept until their completion. */
+    t_sb_init(&res, exp.len + 1);
+    while (res.len < exp.len || ob_has_zerocopy_pending(&ob)) {
+        Z_ASSERT(ob_write(&ob, wfd) >= 0 || ERR_RW_RETRIABLE(errno));
+        if (res.len < exp.len) {
+            Z_ASSERT_N(sb_read(&res, rfd, 0));
+        } else {
+            usleep(1000);
+        }
+    }
+    Z_ASSERT(ob_is_empty(&ob));
+    Z_ASSERT_EQ(obs->refcnt, refcnt);
+    Z_ASSERT_LSTREQUAL(LSTR_SB_V(&res), LSTR_SB_V(&exp));
+
+    ob_wipe(&ob);
+    p_close(&wfd);
+    p_close(&rfd);
+
+    Z_HELPER_END;
+}
+
+/* An outbuf is wiped while its zero-copy sends are in flight: their chunks
+ * are kept until the completion of the sends. */
+static int z_ob_shared_wiped(outbuf_shared_t *obs)
+{
+    sockunion_t su;
+    int server;
+    int wfd;
+    int rfd;
+    int refcnt = obs->refcnt;
+    int n;
+    outbuf_t ob;
+    sb_t res;
+
+    Z_ASSERT_N(addr_info_str(&su, "127.0.0.1", 0, AF_INET));
+    Z_ASSERT_N(server = listenx(-1, &su, 1, SOCK_STREAM, IPPROTO_TCP, 0));
+    sockunion_setport(&su, getsockport(server, AF_INET));
+    Z_ASSERT_N(wfd = connectx(-1, &su, 1, SOCK_STREAM, IPPROTO_TCP, 0));
+    Z_ASSERT_N(rfd = acceptx(server, 0));
+    p_close(&server);
+    Z_ASSERT_N(fd_set_features(wfd, O_NONBLOCK));
+
+    ob_init(&ob);
+    Z_ASSERT_N(ob_enable_zerocopy(&ob, wfd));
+    ob_add_shared(&ob, obs, 0, obs->length);
+    Z_ASSERT_N(ob_write(&ob, wfd));
+    ob_wipe(&ob);
+    p_close(&wfd);
+    Z_ASSERT_GT(obs->refcnt, refcnt);
+
+    /* The connection is shut down after the data in flight. */
+    sb_init(&res);
+    do {
+        Z_ASSERT_N(n = sb_read(&res, rfd, 0));
+    } while (n > 0);
+    Z_ASSERT_GT(res.len, 0);
+    Z_ASSERT_LE(res.len, obs->length);
+    sb_wipe(&res);
+    p_close(&rfd);
+
+    /* The completions are read when other outbufs use zero-copy. */
+    for (int i = 0; obs->refcnt > refcnt && i < 1000; i++) {
+        int fd;
+
+        usleep(1000);
+        Z_ASSERT_N(fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP));
+        ob_init(&ob);
+        Z_ASSERT_N(ob_enable_zerocopy(&ob, fd));
+        ob_wipe(&ob);
+        p_close(&fd);
+    }
+    Z_ASSERT_EQ(obs->refcnt, refcnt);
+
+    Z_HELPER_END;
+}
+
 Z_GROUP_EXPORT(str) {
     Z_TEST(lstr_equal) {
         Z_ASSERT_LSTREQUAL(LSTR_EMPTY_V, LSTR_EMPTY_V);
@@ -1137,6 +1308,112 @@ Z_GROUP_EXPORT(str) {
 #undef T_OVERFLOW
     } Z_TEST_END;
 
+    Z_TEST(dtoa_shortest) {
+        char buf[DTOA_SHORTEST_BUFSIZ];
+
+#define T(d, exp)  \
+        do {                                                                 \
+            Z_ASSERT_EQ(dtoa_shortest(buf, d), (int)strlen(exp));            \
+            Z_ASSERT_STREQUAL(buf, exp);                                     \
+        } while (0)
+
+        T(0., "0");
+        T(-0., "-0");
+        T(1., "1");
+        T(-2.5, "-2.5");
+        T(0.1, "0.1");
+        T(1. / 3, "0.3333333333333333");
+        T(3.1000000000000041, "3.100000000000004");
+        T(100., "100");
+        T(1e16, "10000000000000000");
+        T(1e17, "1e+17");
+        T(1e22, "1e+22");
+        T(123456789012345678., "1.2345678901234568e+17");
+        T(1e-4, "0.0001");
+        T(1e-5, "1e-05");
+        T(-2.5e-7, "-2.5e-07");
+        T(5e-324, "5e-324");
+        T(2.2250738585072014e-308, "2.2250738585072014e-308");
+        T(-1.7976931348623157e308, "-1.7976931348623157e+308");
+#undef T
+
+        /* Random doubles must be parsed back to themselves by strtod, and
+         * must never be longer than what "%.17g" gives. */
+        for (int i = 0; i < 1000000; i++) {
+            union { double d; uint64_t u; } v = { .u = rand64() };
+            char ref[64];
+            double d;
+            int len;
+
+            if (i % 2) {
+                v.d = rand_range(-1000000000, 1000000000)
+                    / (double)rand_range(1, 100000);
+            }
+            if (!isfinite(v.d)) {
+                continue;
+            }
+            len = dtoa_shortest(buf, v.d);
+            d = strtod(buf, NULL);
+            Z_ASSERT_EQ(memcmp(&d, &v.d, sizeof(d)), 0,
+                        "%s does not parse back to %a", buf, v.d);
+            Z_ASSERT_LE(len, sprintf(ref, "%.17g", v.d),
+                        "%s is longer than %s", buf, ref);
+        }
+    } Z_TEST_END;
+
+    Z_TEST(memtod_fast) {
+        static const char *const refs[] = {
+            "0", "-0", "1", "+1", "1.5", "-2.25", ".5", "5.", "-.0e5",
+            "0.1", "1e22", "1e23", "123.456e-7", "1.7976931348623157e308",
+            "2.2250738585072014e-308", "9007199254740993",
+            "1234567890123456789", "12345678901234567890",
+            "0.000000000000000000000000001",
+            "4.68120573995851602e-310", "5e-324", "1e400", "1e-400",
+            "0x10", "inf", "nan", " 1", "e5", "1e", "1e+", "12z", "1.5e+3x",
+        };
+
+        /* Whatever memtod_fast parses must be parsed the same way by
+         * strtod. */
+        carray_for_each_entry(s, refs) {
+            double d, ref;
+            char *end;
+            int len = memtod_fast(s, -1, &d);
+
+            ref = strtod(s, &end);
+            if (len >= 0) {
+                Z_ASSERT_EQ(len, end - s, "%s", s);
+                Z_ASSERT_EQ(memcmp(&d, &ref, sizeof(d)), 0, "%s", s);
+                Z_ASSERT_EQ(memtod_fast(s, len, &d), len, "%s", s);
+                Z_ASSERT_EQ(memcmp(&d, &ref, sizeof(d)), 0, "%s", s);
+            }
+        }
+        Z_ASSERT_EQ(memtod_fast("1.5", -1, &(double){ 0 }), 3);
+        Z_ASSERT_EQ(memtod_fast("1.5", 2, &(double){ 0 }), 2);
+        Z_ASSERT_NEG(memtod_fast("0x10", -1, &(double){ 0 }));
+        Z_ASSERT_NEG(memtod_fast(" 1", -1, &(double){ 0 }));
+
+        for (int i = 0; i < 1000000; i++) {
+            union { double d; uint64_t u; } v = { .u = rand64() };
+            char buf[64];
+            double d, ref;
+            int len;
+
+            if (!isfinite(v.d)) {
+                continue;
+            }
+            if (i % 2) {
+                len = sprintf(buf, "%.17g", v.d);
+            } else {
+                /* shorter numbers, not always exactly representable */
+                len = sprintf(buf, "%.*e", i % 17, v.d);
+            }
+            ref = strtod(buf, NULL);
+            if (memtod_fast(buf, len, &d) >= 0) {
+                Z_ASSERT_EQ(memcmp(&d, &ref, sizeof(d)), 0, "%s", buf);
+            }
+        }
+    } Z_TEST_END;
+
     Z_TEST(memtoxllp) {
         lstr_t s = LSTR("123");
         const byte *end;
@@ -2518,6 +2795,63 @@ Z_GROUP_EXPORT(str) {
         lstr_wipe(&map);
     } Z_TEST_END;
 
+    Z_TEST(ob_add_file_range) {
+        t_scope;
+        const char *path;
+        sb_t content;
+
+        path = t_fmt("%*pM/file-test", LSTR_FMT_ARG(z_tmpdir_g));
+        t_sb_init(&content, 1 << 20);
+        for (int i = 0; content.len < (1 << 20); i++) {
+            sb_addf(&content, "%d,", i);
+        }
+        Z_ASSERT_N(xwrite_file(path, content.data, content.len));
+
+        /* Small ranges are copied in the buffer. */
+        Z_HELPER_RUN(z_ob_file_range(path, LSTR_SB_V(&content), 17, 100,
+                                     false));
+
+        /* Large ranges are sent with sendfile() or read chunk by chunk when
+         * using a custom writer. */
+        Z_HELPER_RUN(z_ob_file_range(path, LSTR_SB_V(&content), 1234,
+                                     content.len - 4321, false));
+        Z_HELPER_RUN(z_ob_file_range(path, LSTR_SB_V(&content), 1234,
+                                     content.len - 4321, true));
+
+        /* Reading after the end of the file is an error. */
+        {
+            outbuf_t ob;
+            int fd;
+
+            ob_init(&ob);
+            Z_ASSERT_N(fd = open(path, O_RDONLY));
+            Z_ASSERT_NEG(ob_add_file_range(&ob, fd, content.len - 10, 100,
+                                           true));
+            ob_wipe(&ob);
+        }
+    } Z_TEST_END;
+
+    Z_TEST(ob_add_shared) {
+        t_scope;
+        outbuf_shared_t *obs;
+        sb_t content;
+
+        t_sb_init(&content, 1 << 20);
+        for (int i = 0; content.len < (1 << 20); i++) {
+            sb_addf(&content, "%d,", i);
+        }
+        obs = ob_shared_new_dup(content.data, content.len);
+
+        /* The same buffer is sent on several connections, with and
+         * without zero-copy. */
+        Z_HELPER_RUN(z_ob_shared(obs, LSTR_SB_V(&content), false));
+        Z_HELPER_RUN(z_ob_shared(obs, LSTR_SB_V(&content), true));
+        Z_HELPER_RUN(z_ob_shared_wiped(obs));
+
+        Z_ASSERT_EQ(obs->refcnt, 1);
+        ob_shared_release(&obs);
+    } Z_TEST_END;
+
     Z_TEST(lstr_dupz) {
         t_scope;
         char *s;